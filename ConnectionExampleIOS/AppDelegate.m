@@ -16,6 +16,8 @@
 #import "AppDelegate.h"
 #import "BackOffReconnectionStrategy.h"
 
+#import "DiffusionEventLog.h"
+#import "DiffusionLog.h"
 #import "DiffusionManager.h"
 #import "DiffusionManagerWithReconnectionStrategy.h"
 
@@ -32,6 +34,23 @@ static NSString *const _TopicSelectorExpressionForAll = @">Demos//";
 
 - (BOOL)application:(UIApplication *)application didFinishLaunchingWithOptions:(NSDictionary *)launchOptions {
     // Override point for customization after application launch.
+    
+    // the library logs go through the same ring as ours, instead of synchronous NSLog calls
+    PTDiffusionLogging.logging.destinationConfiguration = DiffusionLog.diffusionDestinationConfiguration;
+
+    // last known values are available straight away, live ones replace them once the session is open
+    DiffusionManager *manager = DiffusionManagerWithReconnectionStrategy.sharedManager;
+    NSURL *caches = [NSFileManager.defaultManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+    manager.snapshotURL = [caches URLByAppendingPathComponent:@"DiffusionTopicSnapshot.bin"];
+    [manager loadSnapshot];
+
+    // cheap enough to keep on: decode it with Tools/DiffusionEventLogDecoder.c
+    NSError *error = nil;
+    manager.eventLog = [[DiffusionEventLog alloc] initWithURL:[caches URLByAppendingPathComponent:@"DiffusionEvents.log"] topicIndex:manager.topicIndex error:&error];
+    if (!manager.eventLog)
+    {
+        DiffusionLogError(@"Application: no event log: %@", error);
+    }
     return YES;
 }
 
@@ -42,14 +61,19 @@ static NSString *const _TopicSelectorExpressionForAll = @">Demos//";
 - (void)applicationWillResignActive:(UIApplication *)application {
     // Sent when the application is about to move from active to inactive state. This can occur for certain types of temporary interruptions (such as an incoming phone call or SMS message) or when the user quits the application and it begins the transition to the background state.
     // Use this method to pause ongoing tasks, disable timers, and invalidate graphics rendering callbacks. Games should use this method to pause the game.
-    NSLog(@"Application: will resign active");
+    DiffusionLogInfo(@"Application: will resign active");
 }
 
 
 - (void)applicationDidEnterBackground:(UIApplication *)application {
     // Use this method to release shared resources, save user data, invalidate timers, and store enough application state information to restore your application to its current state in case it is terminated later.
     // If your application supports background execution, this method is called instead of applicationWillTerminate: when the user quits.
-    NSLog(@"Application: in the background");
+    DiffusionLogInfo(@"Application: in the background");
+    [DiffusionManagerWithReconnectionStrategy.sharedManager writeSnapshot];
+    [[DiffusionManagerWithReconnectionStrategy.sharedManager eventLog] flush];
+    // pings back off while the connection stays idle in the background
+    [[DiffusionManagerWithReconnectionStrategy.sharedManager livenessScheduler] setInBackground:YES];
+    [DiffusionLog flush];
     //
     //NSLog(@"Application: attempting to unsubscribe from topics");
     //[DiffusionManager.sharedManager unsubscribeFrom:_TopicSelectorExpression];
@@ -58,26 +82,27 @@ static NSString *const _TopicSelectorExpressionForAll = @">Demos//";
 
 - (void)applicationWillEnterForeground:(UIApplication *)application {
     // Called as part of the transition from the background to the active state; here you can undo many of the changes made on entering the background.
-    NSLog(@"Application: entering the foreground");
+    DiffusionLogInfo(@"Application: entering the foreground");
+    [[DiffusionManagerWithReconnectionStrategy.sharedManager livenessScheduler] setInBackground:NO];
 }
 
 
 - (void)applicationDidBecomeActive:(UIApplication *)application {
     // Restart any tasks that were paused (or not yet started) while the application was inactive. If the application was previously in the background, optionally refresh the user interface.
-    NSLog(@"Application: active");
+    DiffusionLogInfo(@"Application: active");
     
     NSURL *url = [NSURL URLWithString:_ServerAddress];
     [DiffusionManagerWithReconnectionStrategy.sharedManager connectToURL:url withCompletionHandler:^(PTDiffusionSession * _Nullable session, NSError * _Nullable error) {
         if (session)
         {
-            NSLog(@"Application: session is active");
+            DiffusionLogInfo(@"Application: session is active");
             
             //NSLog(@"Application: attempting to subscribe to topics");
             //[DiffusionManager.sharedManager subscribeTo:_TopicSelectorExpression];
         }
         else
         {
-            NSLog(@"Application: error while creating session: %@", error);
+            DiffusionLogError(@"Application: error while creating session: %@", error);
         }
     }];
 }
@@ -85,9 +110,10 @@ static NSString *const _TopicSelectorExpressionForAll = @">Demos//";
 
 - (void)applicationWillTerminate:(UIApplication *)application {
     // Called when the application is about to terminate. Save data if appropriate. See also applicationDidEnterBackground:.
-    NSLog(@"Application: will terminate");
+    DiffusionLogInfo(@"Application: will terminate");
     
     [DiffusionManagerWithReconnectionStrategy.sharedManager closeSession];
+    [DiffusionLog flush];
 }
 
 
@@ -0,0 +1,50 @@
+//
+//  DiffusionTopicSnapshotFile.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 26/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionTopicValueCache.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSErrorDomain const DiffusionTopicSnapshotErrorDomain;
+
+typedef NS_ERROR_ENUM(DiffusionTopicSnapshotErrorDomain, DiffusionTopicSnapshotError) {
+    DiffusionTopicSnapshotErrorInvalidFile = 1,
+};
+
+/**
+
+    Compact on-disk copy of the topic value cache, read back through a memory mapping.
+
+    The file is a small header, a fixed size index entry per topic (offsets and lengths of the path and the value, and
+    the topic type) and then the paths and values back to back. Opening it only maps the file and checks the index; the
+    values handed out point into the mapping, so nothing is read from disk until a value is actually used.
+    Only the topic type of the specification is kept, which is all that is needed to decode a value.
+
+    A snapshot is written to a temporary file which then replaces the previous one, so a crash while writing never
+    leaves a broken snapshot behind.
+
+ */
+@interface DiffusionTopicSnapshotFile : NSObject
+
+@property(nonatomic, readonly) NSURL *url;
+@property(nonatomic, readonly) NSUInteger count;
+
+// nil if the file is missing or is not a valid snapshot
++ (nullable instancetype)snapshotWithContentsOfURL:(NSURL *)url error:(NSError **)error;
+-(instancetype) init NS_UNAVAILABLE;
+
+// every value of the snapshot, marked as stale
+- (NSArray<DiffusionTopicValue *> *)values;
+
++ (BOOL)writeValues:(NSArray<DiffusionTopicValue *> *)values toURL:(NSURL *)url error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,215 @@
+//
+//  DiffusionTopicSnapshotFile.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 26/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTopicSnapshotFile.h"
+
+NSErrorDomain const DiffusionTopicSnapshotErrorDomain = @"DiffusionTopicSnapshotErrorDomain";
+
+// 'DTS1', little endian like every other field of the file
+static const uint32_t _Magic = 0x31535444;
+static const uint32_t _Version = 1;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} _SnapshotHeader;
+
+typedef struct {
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t dataOffset;
+    uint32_t dataLength;
+    uint32_t topicType;
+} _SnapshotEntry;
+
+@implementation DiffusionTopicSnapshotFile
+{
+    NSData *_mapping;
+}
+
+
+-(instancetype) initWithURL:(NSURL *)url mapping:(NSData *)mapping count:(NSUInteger)count
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _url = [url copy];
+    _mapping = mapping;
+    _count = count;
+
+    return self;
+}
+
++ (NSError *)invalidFileError:(NSURL *)url reason:(NSString *)reason
+{
+    return [NSError errorWithDomain:DiffusionTopicSnapshotErrorDomain
+                               code:DiffusionTopicSnapshotErrorInvalidFile
+                           userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Invalid topic snapshot %@: %@", url.lastPathComponent, reason]}];
+}
+
++ (nullable instancetype)snapshotWithContentsOfURL:(NSURL *)url error:(NSError **)error
+{
+    NSData *const mapping = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:error];
+    if (!mapping)
+    {
+        return nil;
+    }
+
+    const uint8_t *const bytes = mapping.bytes;
+    const uint64_t length = mapping.length;
+    if (length < sizeof(_SnapshotHeader))
+    {
+        if (error)
+        {
+            *error = [self invalidFileError:url reason:@"too short"];
+        }
+        return nil;
+    }
+
+    _SnapshotHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (CFSwapInt32LittleToHost(header.magic) != _Magic || CFSwapInt32LittleToHost(header.version) != _Version)
+    {
+        if (error)
+        {
+            *error = [self invalidFileError:url reason:@"unknown format"];
+        }
+        return nil;
+    }
+
+    // every entry is checked once here, so reading values later never goes out of the mapping
+    const uint32_t count = CFSwapInt32LittleToHost(header.count);
+    if (sizeof(_SnapshotHeader) + (uint64_t)count * sizeof(_SnapshotEntry) > length)
+    {
+        if (error)
+        {
+            *error = [self invalidFileError:url reason:@"truncated index"];
+        }
+        return nil;
+    }
+    const _SnapshotEntry *const entries = (const _SnapshotEntry *)(bytes + sizeof(_SnapshotHeader));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint64_t pathEnd = (uint64_t)CFSwapInt32LittleToHost(entries[i].pathOffset) + CFSwapInt32LittleToHost(entries[i].pathLength);
+        const uint64_t dataEnd = (uint64_t)CFSwapInt32LittleToHost(entries[i].dataOffset) + CFSwapInt32LittleToHost(entries[i].dataLength);
+        if (pathEnd > length || dataEnd > length)
+        {
+            if (error)
+            {
+                *error = [self invalidFileError:url reason:@"entry out of bounds"];
+            }
+            return nil;
+        }
+    }
+
+    return [[self alloc] initWithURL:url mapping:mapping count:count];
+}
+
+
+- (NSArray<DiffusionTopicValue *> *)values
+{
+    NSData *const mapping = _mapping;
+    const uint8_t *const bytes = mapping.bytes;
+    const _SnapshotEntry *const entries = (const _SnapshotEntry *)(bytes + sizeof(_SnapshotHeader));
+
+    NSMutableArray<DiffusionTopicValue *> *const values = [NSMutableArray arrayWithCapacity:_count];
+    NSMutableDictionary<NSNumber *, PTDiffusionTopicSpecification *> *const specifications = [NSMutableDictionary dictionary];
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        const _SnapshotEntry entry = entries[i];
+        NSString *const path = [[NSString alloc] initWithBytes:bytes + CFSwapInt32LittleToHost(entry.pathOffset)
+                                                        length:CFSwapInt32LittleToHost(entry.pathLength)
+                                                      encoding:NSUTF8StringEncoding];
+        if (!path)
+        {
+            continue;
+        }
+
+        // the value keeps the mapping alive for as long as it is in use
+        NSData *const data = [[NSData alloc] initWithBytesNoCopy:(void *)(bytes + CFSwapInt32LittleToHost(entry.dataOffset))
+                                                          length:CFSwapInt32LittleToHost(entry.dataLength)
+                                                     deallocator:^(void *valueBytes, NSUInteger valueLength) {
+            (void)mapping;
+        }];
+
+        NSNumber *const type = @(CFSwapInt32LittleToHost(entry.topicType));
+        PTDiffusionTopicSpecification *specification = specifications[type];
+        if (!specification)
+        {
+            specification = [[PTDiffusionTopicSpecification alloc] initWithType:(PTDiffusionTopicType)type.unsignedIntValue];
+            specifications[type] = specification;
+        }
+
+        [values addObject:[[DiffusionTopicValue alloc] initWithTopicPath:path data:data specification:specification stale:YES]];
+    }
+    return values;
+}
+
+
++ (BOOL)writeValues:(NSArray<DiffusionTopicValue *> *)values toURL:(NSURL *)url error:(NSError **)error
+{
+    NSMutableArray<NSData *> *const paths = [NSMutableArray arrayWithCapacity:values.count];
+    uint64_t length = sizeof(_SnapshotHeader) + (uint64_t)values.count * sizeof(_SnapshotEntry);
+    for (DiffusionTopicValue *value in values)
+    {
+        NSData *const path = [value.topicPath dataUsingEncoding:NSUTF8StringEncoding];
+        [paths addObject:path];
+        length += path.length + value.data.length;
+    }
+    if (length > UINT32_MAX)
+    {
+        if (error)
+        {
+            *error = [self invalidFileError:url reason:@"larger than 4GB"];
+        }
+        return NO;
+    }
+
+    NSMutableData *const file = [NSMutableData dataWithLength:(NSUInteger)length];
+    uint8_t *const bytes = file.mutableBytes;
+
+    const _SnapshotHeader header = {
+        .magic = CFSwapInt32HostToLittle(_Magic),
+        .version = CFSwapInt32HostToLittle(_Version),
+        .count = CFSwapInt32HostToLittle((uint32_t)values.count),
+        .reserved = 0,
+    };
+    memcpy(bytes, &header, sizeof(header));
+
+    _SnapshotEntry *const entries = (_SnapshotEntry *)(bytes + sizeof(_SnapshotHeader));
+    uint32_t offset = (uint32_t)(sizeof(_SnapshotHeader) + values.count * sizeof(_SnapshotEntry));
+    for (NSUInteger i = 0; i < values.count; i++)
+    {
+        NSData *const path = paths[i];
+        NSData *const data = values[i].data;
+
+        entries[i].pathOffset = CFSwapInt32HostToLittle(offset);
+        entries[i].pathLength = CFSwapInt32HostToLittle((uint32_t)path.length);
+        memcpy(bytes + offset, path.bytes, path.length);
+        offset += path.length;
+
+        entries[i].dataOffset = CFSwapInt32HostToLittle(offset);
+        entries[i].dataLength = CFSwapInt32HostToLittle((uint32_t)data.length);
+        if (data.length)
+        {
+            memcpy(bytes + offset, data.bytes, data.length);
+        }
+        offset += data.length;
+
+        entries[i].topicType = CFSwapInt32HostToLittle((uint32_t)values[i].specification.type);
+    }
+
+    // written next to the destination and renamed over it
+    return [file writeToURL:url options:NSDataWritingAtomic error:error];
+}
+
+@end
@@ -0,0 +1,70 @@
+//
+//  DiffusionTopicValueCache.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 25/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// last value received for a topic. immutable, so it can be handed to any thread
+@interface DiffusionTopicValue : NSObject
+
+@property(nonatomic, readonly) NSString *topicPath;
+@property(nonatomic, readonly) NSData *data;
+@property(nonatomic, readonly) PTDiffusionTopicSpecification *specification;
+// restored from a snapshot of an earlier run, not received from the current session
+@property(nonatomic, readonly, getter=isStale) BOOL stale;
+
+-(instancetype) initWithTopicPath:(NSString *)topicPath data:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification;
+-(instancetype) initWithTopicPath:(NSString *)topicPath data:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification stale:(BOOL)stale NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+@end
+
+/**
+
+    Thread safe cache of the last value of every subscribed topic, keyed by topic path.
+
+    Reads never take a lock. Topic paths are spread over shards, and each shard publishes an immutable dictionary
+    of slots, one per topic, that readers look into directly. Updating a topic swaps the value in its slot. Adding or
+    removing topics copies the dictionary of the shard, changes the copy and swaps it in (read-copy-update), once for
+    all the topics of a batch.
+    What a write replaces is released by epochs: once every reader that entered the shard before the replacement has
+    left, so a reader never sees a value being freed under it, and a busy shard never holds more than two epochs of
+    replaced objects. Writes to the same shard are serialised by a lock.
+
+ */
+@interface DiffusionTopicValueCache : NSObject
+
+@property(nonatomic, readonly) NSUInteger shardCount;
+// number of topics with a value. not a snapshot: shards are counted one after the other
+@property(nonatomic, readonly) NSUInteger count;
+// changes every time a value is stored or removed
+@property(nonatomic, readonly) NSUInteger generation;
+// replaced values and dictionaries waiting for the readers that might still see them
+@property(nonatomic, readonly) NSUInteger retiredCount;
+
+-(instancetype) initWithShardCount:(NSUInteger)shardCount NS_DESIGNATED_INITIALIZER;
+// 64 shards
+-(instancetype) init;
+
+- (nullable DiffusionTopicValue *)valueForTopicPath:(NSString *)topicPath;
+// every value, shard by shard
+- (NSArray<DiffusionTopicValue *> *)allValues;
+
+- (void)storeValue:(DiffusionTopicValue *)value;
+// one copy per shard, whatever the number of values. values already in the cache are only replaced if replace is YES
+- (void)storeValues:(NSArray<DiffusionTopicValue *> *)values replacingExisting:(BOOL)replace;
+- (void)storeData:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification forTopicPath:(NSString *)topicPath;
+- (void)removeValueForTopicPath:(NSString *)topicPath;
+- (void)removeAllValues;
+
+@end
+
+NS_ASSUME_NONNULL_END
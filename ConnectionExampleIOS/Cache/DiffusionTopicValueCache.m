@@ -0,0 +1,418 @@
+//
+//  DiffusionTopicValueCache.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 25/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTopicValueCache.h"
+
+#import <os/lock.h>
+#import <stdatomic.h>
+
+@implementation DiffusionTopicValue
+
+
+-(instancetype) initWithTopicPath:(NSString *)topicPath data:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification
+{
+    return [self initWithTopicPath:topicPath data:data specification:specification stale:NO];
+}
+
+-(instancetype) initWithTopicPath:(NSString *)topicPath data:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification stale:(BOOL)stale
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _topicPath = [topicPath copy];
+    _data = [data copy];
+    _specification = specification;
+    _stale = stale;
+
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %@ (%lu bytes%@)>", NSStringFromClass(self.class), _topicPath, (unsigned long)_data.length, _stale ? @", stale" : @""];
+}
+
+@end
+
+
+// the current value of one topic. replaced in place, so that updating a topic does not copy its shard
+@interface DiffusionTopicValueSlot : NSObject
+
+-(instancetype) initWithValue:(DiffusionTopicValue *)value;
+// only inside a read section of the shard
+- (DiffusionTopicValue *)value;
+// returns the value replaced, which readers may still be looking at
+- (DiffusionTopicValue *)exchangeValue:(DiffusionTopicValue *)value;
+
+@end
+
+@implementation DiffusionTopicValueSlot
+{
+    // retained
+    _Atomic(void *) _value;
+}
+
+-(instancetype) initWithValue:(DiffusionTopicValue *)value
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    atomic_init(&_value, (__bridge_retained void *)value);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    CFBridgingRelease(atomic_load(&_value));
+}
+
+- (DiffusionTopicValue *)value
+{
+    return (__bridge DiffusionTopicValue *)atomic_load(&_value);
+}
+
+- (DiffusionTopicValue *)exchangeValue:(DiffusionTopicValue *)value
+{
+    return CFBridgingRelease(atomic_exchange(&_value, (__bridge_retained void *)value));
+}
+
+@end
+
+
+@interface DiffusionTopicValueCacheShard : NSObject
+
+@property(nonatomic, readonly) NSUInteger retiredCount;
+
+- (nullable DiffusionTopicValue *)valueForTopicPath:(NSString *)topicPath;
+- (NSUInteger)count;
+- (NSArray<DiffusionTopicValue *> *)allValues;
+- (void)storeValues:(NSArray<DiffusionTopicValue *> *)values replacingExisting:(BOOL)replace;
+- (void)removeValueForTopicPath:(NSString *)topicPath;
+- (void)removeAllValues;
+
+@end
+
+@implementation DiffusionTopicValueCacheShard
+{
+    // the published slot of each topic, retained. only replaced when topics are added or removed, never mutated
+    _Atomic(void *) _slots;
+    // readers inside the shard, by the parity of the epoch they entered in
+    atomic_uint _readers[2];
+    atomic_uint _epoch;
+    // serialises writers and guards everything below
+    os_unfair_lock _lock;
+    // what was unpublished in the current epoch, and in the one before, by parity
+    NSMutableArray *_retired[2];
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    atomic_init(&_slots, (__bridge_retained void *)@{});
+    atomic_init(&_readers[0], 0);
+    atomic_init(&_readers[1], 0);
+    atomic_init(&_epoch, 0);
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _retired[0] = [NSMutableArray array];
+    _retired[1] = [NSMutableArray array];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    CFBridgingRelease(atomic_load(&_slots));
+}
+
+
+#pragma mark - reading
+
+// a reader counts itself in before it loads anything published, and out once it holds what it read
+- (unsigned)enter
+{
+    const unsigned parity = atomic_load(&_epoch) & 1;
+    atomic_fetch_add(&_readers[parity], 1);
+    return parity;
+}
+
+- (void)leave:(unsigned)parity
+{
+    atomic_fetch_sub(&_readers[parity], 1);
+}
+
+- (NSDictionary<NSString *, DiffusionTopicValueSlot *> *)slots
+{
+    return (__bridge NSDictionary *)atomic_load(&_slots);
+}
+
+- (nullable DiffusionTopicValue *)valueForTopicPath:(NSString *)topicPath
+{
+    const unsigned parity = [self enter];
+    DiffusionTopicValue *const value = [self.slots[topicPath] value];
+    [self leave:parity];
+    return value;
+}
+
+- (NSUInteger)count
+{
+    const unsigned parity = [self enter];
+    const NSUInteger count = self.slots.count;
+    [self leave:parity];
+    return count;
+}
+
+- (NSArray<DiffusionTopicValue *> *)allValues
+{
+    const unsigned parity = [self enter];
+    NSDictionary<NSString *, DiffusionTopicValueSlot *> *const slots = self.slots;
+    NSMutableArray<DiffusionTopicValue *> *const values = [NSMutableArray arrayWithCapacity:slots.count];
+    for (DiffusionTopicValueSlot *slot in slots.objectEnumerator)
+    {
+        [values addObject:slot.value];
+    }
+    [self leave:parity];
+    return values;
+}
+
+
+#pragma mark - writing
+
+- (NSUInteger)retiredCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _retired[0].count + _retired[1].count;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+// called with the lock held, once the object can no longer be reached from what is published.
+// a reader that could still be looking at it entered in this epoch or the one before. once every reader of the one
+// before has left, what was retired then is released and a new epoch starts: retired objects never outlive two
+// epochs, however busy the shard is
+- (void)retire:(id)object
+{
+    const unsigned epoch = atomic_load(&_epoch);
+    [_retired[epoch & 1] addObject:object];
+    if (atomic_load(&_readers[(epoch + 1) & 1]) == 0)
+    {
+        [_retired[(epoch + 1) & 1] removeAllObjects];
+        atomic_store(&_epoch, epoch + 1);
+    }
+}
+
+// called with the lock held
+- (void)publishSlots:(NSDictionary<NSString *, DiffusionTopicValueSlot *> *)slots
+{
+    [self retire:CFBridgingRelease(atomic_exchange(&_slots, (__bridge_retained void *)slots))];
+}
+
+- (void)storeValues:(NSArray<DiffusionTopicValue *> *)values replacingExisting:(BOOL)replace
+{
+    os_unfair_lock_lock(&_lock);
+
+    // a topic with a slot is updated in place. only new topics cost a copy of the shard, one for all of them
+    NSDictionary<NSString *, DiffusionTopicValueSlot *> *const slots = self.slots;
+    NSMutableDictionary<NSString *, DiffusionTopicValueSlot *> *added = nil;
+    for (DiffusionTopicValue *value in values)
+    {
+        DiffusionTopicValueSlot *const slot = slots[value.topicPath] ?: added[value.topicPath];
+        if (slot)
+        {
+            if (replace)
+            {
+                [self retire:[slot exchangeValue:value]];
+            }
+            continue;
+        }
+        if (!added)
+        {
+            added = [NSMutableDictionary dictionary];
+        }
+        added[value.topicPath] = [[DiffusionTopicValueSlot alloc] initWithValue:value];
+    }
+    if (added)
+    {
+        NSMutableDictionary<NSString *, DiffusionTopicValueSlot *> *const next = [slots mutableCopy];
+        [next addEntriesFromDictionary:added];
+        [self publishSlots:next];
+    }
+
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)removeValueForTopicPath:(NSString *)topicPath
+{
+    os_unfair_lock_lock(&_lock);
+    NSDictionary<NSString *, DiffusionTopicValueSlot *> *const slots = self.slots;
+    if (slots[topicPath])
+    {
+        NSMutableDictionary<NSString *, DiffusionTopicValueSlot *> *const next = [slots mutableCopy];
+        [next removeObjectForKey:topicPath];
+        [self publishSlots:next];
+    }
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)removeAllValues
+{
+    os_unfair_lock_lock(&_lock);
+    if (self.slots.count)
+    {
+        [self publishSlots:@{}];
+    }
+    os_unfair_lock_unlock(&_lock);
+}
+
+@end
+
+
+@implementation DiffusionTopicValueCache
+{
+    NSArray<DiffusionTopicValueCacheShard *> *_shards;
+    atomic_ulong _generation;
+}
+
+@synthesize shardCount = _shardCount;
+
+
+-(instancetype) init
+{
+    return [self initWithShardCount:64];
+}
+
+-(instancetype) initWithShardCount:(NSUInteger)shardCount
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _shardCount = MAX(shardCount, (NSUInteger)1);
+
+    NSMutableArray<DiffusionTopicValueCacheShard *> *const shards = [NSMutableArray arrayWithCapacity:_shardCount];
+    for (NSUInteger i = 0; i < _shardCount; i++)
+    {
+        [shards addObject:[[DiffusionTopicValueCacheShard alloc] init]];
+    }
+    _shards = shards;
+    atomic_init(&_generation, 0);
+
+    return self;
+}
+
+
+- (NSUInteger)shardIndexForTopicPath:(NSString *)topicPath
+{
+    // shards only live as long as the process. NSString's hash covers the end of a path, where sibling topics differ
+    return topicPath.hash % _shardCount;
+}
+
+- (DiffusionTopicValueCacheShard *)shardForTopicPath:(NSString *)topicPath
+{
+    return _shards[[self shardIndexForTopicPath:topicPath]];
+}
+
+- (NSUInteger)count
+{
+    NSUInteger count = 0;
+    for (DiffusionTopicValueCacheShard *shard in _shards)
+    {
+        count += shard.count;
+    }
+    return count;
+}
+
+- (NSUInteger)generation
+{
+    return atomic_load_explicit(&_generation, memory_order_relaxed);
+}
+
+- (nullable DiffusionTopicValue *)valueForTopicPath:(NSString *)topicPath
+{
+    return [[self shardForTopicPath:topicPath] valueForTopicPath:topicPath];
+}
+
+- (NSArray<DiffusionTopicValue *> *)allValues
+{
+    NSMutableArray<DiffusionTopicValue *> *const values = [NSMutableArray array];
+    for (DiffusionTopicValueCacheShard *shard in _shards)
+    {
+        [values addObjectsFromArray:shard.allValues];
+    }
+    return values;
+}
+
+- (NSUInteger)retiredCount
+{
+    NSUInteger count = 0;
+    for (DiffusionTopicValueCacheShard *shard in _shards)
+    {
+        count += shard.retiredCount;
+    }
+    return count;
+}
+
+- (void)storeValue:(DiffusionTopicValue *)value
+{
+    [[self shardForTopicPath:value.topicPath] storeValues:@[value] replacingExisting:YES];
+    atomic_fetch_add_explicit(&_generation, 1, memory_order_relaxed);
+}
+
+- (void)storeValues:(NSArray<DiffusionTopicValue *> *)values replacingExisting:(BOOL)replace
+{
+    NSMutableArray<NSMutableArray<DiffusionTopicValue *> *> *const byShard = [NSMutableArray arrayWithCapacity:_shardCount];
+    for (NSUInteger i = 0; i < _shardCount; i++)
+    {
+        [byShard addObject:[NSMutableArray array]];
+    }
+    for (DiffusionTopicValue *value in values)
+    {
+        [byShard[[self shardIndexForTopicPath:value.topicPath]] addObject:value];
+    }
+
+    [byShard enumerateObjectsUsingBlock:^(NSMutableArray<DiffusionTopicValue *> *shardValues, NSUInteger index, BOOL *stop) {
+        if (!shardValues.count)
+        {
+            return;
+        }
+        [self->_shards[index] storeValues:shardValues replacingExisting:replace];
+    }];
+    atomic_fetch_add_explicit(&_generation, 1, memory_order_relaxed);
+}
+
+- (void)storeData:(NSData *)data specification:(PTDiffusionTopicSpecification *)specification forTopicPath:(NSString *)topicPath
+{
+    [self storeValue:[[DiffusionTopicValue alloc] initWithTopicPath:topicPath data:data specification:specification]];
+}
+
+- (void)removeValueForTopicPath:(NSString *)topicPath
+{
+    [[self shardForTopicPath:topicPath] removeValueForTopicPath:topicPath];
+    atomic_fetch_add_explicit(&_generation, 1, memory_order_relaxed);
+}
+
+- (void)removeAllValues
+{
+    for (DiffusionTopicValueCacheShard *shard in _shards)
+    {
+        [shard removeAllValues];
+    }
+    atomic_fetch_add_explicit(&_generation, 1, memory_order_relaxed);
+}
+
+@end
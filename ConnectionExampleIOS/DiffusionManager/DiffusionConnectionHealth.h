@@ -0,0 +1,70 @@
+//
+//  DiffusionConnectionHealth.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, DiffusionConnectionState) {
+    DiffusionConnectionStateConnecting = 0,
+    DiffusionConnectionStateConnected = 1,
+    DiffusionConnectionStateRecovering = 2,
+    DiffusionConnectionStateClosed = 3,
+};
+
+/**
+
+    Folds the health signals of a connection into a single score, from 0 (dead) to 1 (healthy).
+
+    Over a rolling window it tracks the share of time the session was connected, the ping failure rate, a smoothed
+    round trip time with its jitter, and stalls of the update stream: a gap several times longer than the usual time
+    between updates. The score is
+
+        availability × (1 - failure rate) × stall × (½ latency + ½ jitter)
+
+    where latency and jitter each go from 1 (fine) to 0 (bad) between two thresholds, and stall from 1 while updates
+    arrive as usual towards 0 as an ongoing stall grows. A stream stalled for long enough degrades the connection on
+    its own, even while pings still get through.
+
+    Times are in seconds on any monotonic clock, given by the caller. Thread safe.
+
+ */
+@interface DiffusionConnectionHealth : NSObject
+
+// default 60
+@property(nonatomic) NSTimeInterval window;
+// below this score the connection is degraded (default 0.3)
+@property(nonatomic) double degradedThreshold;
+// how long it must stay degraded before the session is worth replacing (default 30)
+@property(nonatomic) NSTimeInterval degradedDuration;
+
+@property(nonatomic, readonly) NSTimeInterval smoothedRoundTripTime;
+@property(nonatomic, readonly) NSTimeInterval jitter;
+// update stalls detected so far
+@property(nonatomic, readonly) NSUInteger stallCount;
+
+// forgets everything, for a new session
+- (void)resetAtTime:(NSTimeInterval)time;
+
+- (void)noteState:(DiffusionConnectionState)state atTime:(NSTimeInterval)time;
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime atTime:(NSTimeInterval)time;
+- (void)notePingFailureAtTime:(NSTimeInterval)time;
+- (void)noteUpdateAtTime:(NSTimeInterval)time;
+
+- (double)scoreAtTime:(NSTimeInterval)time;
+// share of the window spent in the state
+- (double)fractionOfTimeInState:(DiffusionConnectionState)state atTime:(NSTimeInterval)time;
+- (double)pingFailureRateAtTime:(NSTimeInterval)time;
+
+// meant to be called periodically: remembers when the score dropped below the threshold,
+// and says YES once it has stayed there for the degraded duration
+- (BOOL)shouldRecycleSessionAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,284 @@
+//
+//  DiffusionConnectionHealth.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionConnectionHealth.h"
+
+#import <os/lock.h>
+
+// latency is fine up to the first value and hopeless from the second
+static const NSTimeInterval _GoodRoundTripTime = 0.2;
+static const NSTimeInterval _BadRoundTripTime = 2.0;
+// jitter as a share of the round trip time
+static const double _GoodJitter = 0.25;
+static const double _BadJitter = 1.0;
+// a gap this many times the usual one, and at least the minimum, is a stall
+static const double _StallFactor = 4.0;
+static const NSTimeInterval _MinimumStall = 1.0;
+
+static double _Falling(double value, double good, double bad)
+{
+    return MIN(MAX((bad - value) / (bad - good), 0.0), 1.0);
+}
+
+
+@interface DiffusionHealthEvent : NSObject
+
+@property(nonatomic) NSTimeInterval time;
+// a state, or whether a ping failed
+@property(nonatomic) NSInteger value;
+
+@end
+
+@implementation DiffusionHealthEvent
+
+@end
+
+
+@implementation DiffusionConnectionHealth
+{
+    os_unfair_lock _lock;
+    // the last one may be older than the window: it gives the state at its start
+    NSMutableArray<DiffusionHealthEvent *> *_states;
+    NSMutableArray<DiffusionHealthEvent *> *_pings;
+    NSTimeInterval _start;
+    NSTimeInterval _lastUpdate;
+    NSTimeInterval _meanUpdateGap;
+    NSTimeInterval _degradedSince;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _window = 60.0;
+    _degradedThreshold = 0.3;
+    _degradedDuration = 30.0;
+    _states = [NSMutableArray array];
+    _pings = [NSMutableArray array];
+    [self resetAtTime:0];
+
+    return self;
+}
+
+- (void)resetAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    [_states removeAllObjects];
+    [_pings removeAllObjects];
+    _start = time;
+    _lastUpdate = NAN;
+    _meanUpdateGap = 0;
+    _smoothedRoundTripTime = 0;
+    _jitter = 0;
+    _degradedSince = NAN;
+    os_unfair_lock_unlock(&_lock);
+}
+
+// called with the lock held
+- (void)pruneAtTime:(NSTimeInterval)time
+{
+    const NSTimeInterval from = time - _window;
+    while (_pings.count && _pings.firstObject.time < from)
+    {
+        [_pings removeObjectAtIndex:0];
+    }
+    // keeps the last state entered before the window
+    while (_states.count > 1 && _states[1].time <= from)
+    {
+        [_states removeObjectAtIndex:0];
+    }
+}
+
+- (void)addEvent:(NSInteger)value atTime:(NSTimeInterval)time to:(NSMutableArray<DiffusionHealthEvent *> *)events
+{
+    DiffusionHealthEvent *const event = [[DiffusionHealthEvent alloc] init];
+    event.time = time;
+    event.value = value;
+    [events addObject:event];
+}
+
+
+#pragma mark - signals
+
+- (void)noteState:(DiffusionConnectionState)state atTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    if (!_states.count || _states.lastObject.value != state)
+    {
+        [self addEvent:state atTime:time to:_states];
+    }
+    [self pruneAtTime:time];
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime atTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    [self addEvent:NO atTime:time to:_pings];
+    if (_smoothedRoundTripTime <= 0)
+    {
+        _smoothedRoundTripTime = roundTripTime;
+        _jitter = roundTripTime / 2;
+    }
+    else
+    {
+        _jitter = 0.75 * _jitter + 0.25 * fabs(_smoothedRoundTripTime - roundTripTime);
+        _smoothedRoundTripTime = 0.875 * _smoothedRoundTripTime + 0.125 * roundTripTime;
+    }
+    [self pruneAtTime:time];
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)notePingFailureAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    [self addEvent:YES atTime:time to:_pings];
+    [self pruneAtTime:time];
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)noteUpdateAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    if (!isnan(_lastUpdate))
+    {
+        const NSTimeInterval gap = time - _lastUpdate;
+        if (_meanUpdateGap > 0 && gap > MAX(_meanUpdateGap * _StallFactor, _MinimumStall))
+        {
+            _stallCount++;
+        }
+        _meanUpdateGap = _meanUpdateGap > 0 ? 0.9 * _meanUpdateGap + 0.1 * gap : gap;
+    }
+    _lastUpdate = time;
+    os_unfair_lock_unlock(&_lock);
+}
+
+
+#pragma mark - score
+
+- (double)fractionOfTimeInState:(DiffusionConnectionState)state atTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    const double fraction = [self lockedFractionOfTimeInState:state atTime:time];
+    os_unfair_lock_unlock(&_lock);
+    return fraction;
+}
+
+- (double)lockedFractionOfTimeInState:(DiffusionConnectionState)state atTime:(NSTimeInterval)time
+{
+    const NSTimeInterval from = MAX(time - _window, _start);
+    if (!_states.count || time <= from)
+    {
+        // nothing known: assume the session is what it claims to be
+        return state == DiffusionConnectionStateConnected ? 1.0 : 0.0;
+    }
+    NSTimeInterval inState = 0;
+    NSTimeInterval observed = 0;
+    for (NSUInteger i = 0; i < _states.count; i++)
+    {
+        const NSTimeInterval begin = MAX(_states[i].time, from);
+        const NSTimeInterval end = i + 1 < _states.count ? _states[i + 1].time : time;
+        if (end <= begin)
+        {
+            continue;
+        }
+        observed += end - begin;
+        if (_states[i].value == state)
+        {
+            inState += end - begin;
+        }
+    }
+    return observed > 0 ? inState / observed : (_states.lastObject.value == state ? 1.0 : 0.0);
+}
+
+- (double)pingFailureRateAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    const double rate = [self lockedPingFailureRateAtTime:time];
+    os_unfair_lock_unlock(&_lock);
+    return rate;
+}
+
+- (double)lockedPingFailureRateAtTime:(NSTimeInterval)time
+{
+    [self pruneAtTime:time];
+    if (!_pings.count)
+    {
+        return 0;
+    }
+    NSUInteger failures = 0;
+    for (DiffusionHealthEvent *ping in _pings)
+    {
+        failures += ping.value ? 1 : 0;
+    }
+    return (double)failures / _pings.count;
+}
+
+- (double)lockedScoreAtTime:(NSTimeInterval)time
+{
+    const double availability = [self lockedFractionOfTimeInState:DiffusionConnectionStateConnected atTime:time];
+    const double reliability = 1.0 - [self lockedPingFailureRateAtTime:time];
+
+    double latency = 1.0;
+    double jitter = 1.0;
+    if (_smoothedRoundTripTime > 0)
+    {
+        latency = _Falling(_smoothedRoundTripTime, _GoodRoundTripTime, _BadRoundTripTime);
+        jitter = _Falling(_jitter / _smoothedRoundTripTime, _GoodJitter, _BadJitter);
+    }
+
+    // an ongoing stall counts as soon as it is longer than usual, not only once the next update arrives. it scales the
+    // whole score: a connection that stopped delivering is not saved by its pings
+    double stall = 1.0;
+    if (_meanUpdateGap > 0 && !isnan(_lastUpdate))
+    {
+        const NSTimeInterval expected = MAX(_meanUpdateGap * _StallFactor, _MinimumStall);
+        const NSTimeInterval gap = time - _lastUpdate;
+        if (gap > expected)
+        {
+            stall = expected / gap;
+        }
+    }
+
+    return availability * reliability * stall * (0.5 * latency + 0.5 * jitter);
+}
+
+- (double)scoreAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    const double score = [self lockedScoreAtTime:time];
+    os_unfair_lock_unlock(&_lock);
+    return score;
+}
+
+- (BOOL)shouldRecycleSessionAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    BOOL recycle = NO;
+    if ([self lockedScoreAtTime:time] >= _degradedThreshold)
+    {
+        _degradedSince = NAN;
+    }
+    else if (isnan(_degradedSince))
+    {
+        _degradedSince = time;
+    }
+    else
+    {
+        recycle = time - _degradedSince >= _degradedDuration;
+    }
+    os_unfair_lock_unlock(&_lock);
+    return recycle;
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  DiffusionLivenessScheduler.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    Decides when the connection needs a ping to prove it is alive.
+
+    Any inbound traffic is as good a proof as a ping, so no ping is sent while updates keep arriving within the
+    interval. The interval itself adapts: it is halved for each consecutive ping failure, and halved once when the
+    round trip time becomes erratic (its variance, tracked the way TCP does, grows beyond half its average),
+    so that a dying connection is noticed sooner. In the background, each ping that finds the connection idle doubles
+    the interval up to the background maximum, which saves radio wakeups.
+
+    Times are in seconds on any monotonic clock, given by the caller, so that it can be driven by a test clock.
+    Not thread safe; the manager uses it from the main queue.
+
+ */
+@interface DiffusionLivenessScheduler : NSObject
+
+// interval in the foreground when nothing goes wrong (default 3)
+@property(nonatomic) NSTimeInterval interval;
+// shortest interval when pings fail or the round trip time is erratic (default 0.5)
+@property(nonatomic) NSTimeInterval minimumInterval;
+// interval in the background while idle, doubled up to the maximum (defaults 30 and 300)
+@property(nonatomic) NSTimeInterval backgroundInterval;
+@property(nonatomic) NSTimeInterval maximumBackgroundInterval;
+
+@property(nonatomic, getter=isInBackground) BOOL inBackground;
+
+// smoothed round trip time and its mean deviation, 0 until the first ping
+@property(nonatomic, readonly) NSTimeInterval smoothedRoundTripTime;
+@property(nonatomic, readonly) NSTimeInterval roundTripTimeVariation;
+@property(nonatomic, readonly) NSUInteger consecutiveFailures;
+
+// counters
+@property(nonatomic, readonly) NSUInteger pingCount;
+// checks where recent traffic made the ping unnecessary
+@property(nonatomic, readonly) NSUInteger skippedCount;
+
+// what the interval is now, given failures, round trip times and background
+- (NSTimeInterval)currentInterval;
+
+- (void)noteInboundTrafficAtTime:(NSTimeInterval)time;
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime atTime:(NSTimeInterval)time;
+- (void)notePingFailureAtTime:(NSTimeInterval)time;
+
+// YES if a ping should be sent now, which counts it as sent. NO when traffic proved the connection alive recently
+- (BOOL)shouldPingAtTime:(NSTimeInterval)time;
+// how long to wait before asking again
+- (NSTimeInterval)delayBeforeNextCheckAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
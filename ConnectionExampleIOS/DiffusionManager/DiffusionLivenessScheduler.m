@@ -0,0 +1,125 @@
+//
+//  DiffusionLivenessScheduler.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionLivenessScheduler.h"
+
+@implementation DiffusionLivenessScheduler
+{
+    // NAN until there has been any traffic
+    NSTimeInterval _lastTraffic;
+    NSTimeInterval _lastPing;
+    // background pings in a row that found no traffic since the previous one
+    NSUInteger _idlePings;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _interval = 3.0;
+    _minimumInterval = 0.5;
+    _backgroundInterval = 30.0;
+    _maximumBackgroundInterval = 300.0;
+    _lastTraffic = NAN;
+    _lastPing = NAN;
+
+    return self;
+}
+
+
+- (void)setInBackground:(BOOL)inBackground
+{
+    _inBackground = inBackground;
+    _idlePings = 0;
+}
+
+- (NSTimeInterval)currentInterval
+{
+    if (_consecutiveFailures)
+    {
+        // something is wrong: find out quickly, even in the background
+        return MAX(_interval / (double)(1u << MIN(_consecutiveFailures, (NSUInteger)8)), _minimumInterval);
+    }
+    if (_inBackground)
+    {
+        return MIN(_backgroundInterval * (double)(1u << MIN(_idlePings, (NSUInteger)16)), _maximumBackgroundInterval);
+    }
+    if (_smoothedRoundTripTime > 0 && _roundTripTimeVariation * 2 > _smoothedRoundTripTime)
+    {
+        return MAX(_interval / 2, _minimumInterval);
+    }
+    return _interval;
+}
+
+- (void)noteInboundTrafficAtTime:(NSTimeInterval)time
+{
+    _lastTraffic = time;
+    _idlePings = 0;
+    // the connection works, whatever the last ping said
+    _consecutiveFailures = 0;
+}
+
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime atTime:(NSTimeInterval)time
+{
+    _consecutiveFailures = 0;
+    // RFC 6298
+    if (_smoothedRoundTripTime <= 0)
+    {
+        _smoothedRoundTripTime = roundTripTime;
+        _roundTripTimeVariation = roundTripTime / 2;
+    }
+    else
+    {
+        _roundTripTimeVariation = 0.75 * _roundTripTimeVariation + 0.25 * fabs(_smoothedRoundTripTime - roundTripTime);
+        _smoothedRoundTripTime = 0.875 * _smoothedRoundTripTime + 0.125 * roundTripTime;
+    }
+}
+
+- (void)notePingFailureAtTime:(NSTimeInterval)time
+{
+    _consecutiveFailures++;
+}
+
+- (BOOL)shouldPingAtTime:(NSTimeInterval)time
+{
+    const NSTimeInterval interval = self.currentInterval;
+    // a failing connection is pinged whatever the traffic, which may be what is left of a buffer
+    if (!_consecutiveFailures && !isnan(_lastTraffic) && time - _lastTraffic < interval)
+    {
+        _skippedCount++;
+        return NO;
+    }
+    if (_inBackground && !isnan(_lastPing) && (isnan(_lastTraffic) || _lastTraffic < _lastPing))
+    {
+        _idlePings++;
+    }
+    _lastPing = time;
+    _pingCount++;
+    return YES;
+}
+
+- (NSTimeInterval)delayBeforeNextCheckAtTime:(NSTimeInterval)time
+{
+    const NSTimeInterval interval = self.currentInterval;
+    if (!_consecutiveFailures && !isnan(_lastTraffic))
+    {
+        // the traffic proves the connection alive until one interval after it
+        const NSTimeInterval proven = _lastTraffic + interval - time;
+        if (proven > 0)
+        {
+            return proven;
+        }
+    }
+    return interval;
+}
+
+@end
@@ -10,23 +10,125 @@
 
 @import Diffusion;
 
+#import "DiffusionConnectionHealth.h"
+#import "DiffusionLivenessScheduler.h"
+#import "DiffusionMetrics.h"
+#import "DiffusionSubscriptionBatcher.h"
+#import "DiffusionSubscriptionRegistry.h"
+#import "DiffusionTopicPathIndex.h"
+#import "DiffusionTopicValueCache.h"
+#import "DiffusionTypedStreamDispatcher.h"
+
+@class DiffusionEventLog;
+@class DiffusionInboundQueue;
+@class DiffusionProcessingLanes;
+@class DiffusionSessionPool;
+@class DiffusionTimerWheel;
+@class DiffusionTrafficRecorder;
+@class DiffusionUpdateConflator;
+
 NS_ASSUME_NONNULL_BEGIN
 
-@interface DiffusionManager : NSObject <PTDiffusionJSONValueStreamDelegate, PTDiffusionFetchStreamDelegate, PTDiffusionSessionResponseStreamDelegate>
+typedef void (^DiffusionTopicUpdateHandler)(NSString *topicPath, PTDiffusionTopicSpecification *specification, PTDiffusionJSON *value);
 
-// only one session in the Diffusion Manager
+@interface DiffusionManager : NSObject <DiffusionTypedStreamDispatcherDelegate, PTDiffusionFetchStreamDelegate, PTDiffusionSessionResponseStreamDelegate>
+
+// primary session. pings and anything not sharded by selector go through it
 @property (nullable) PTDiffusionSession *session;
 @property (nullable) NSURL *url;
+// outbound message limit of each session, in messages (default: the Diffusion default)
+@property (nonatomic) NSUInteger maximumQueueSize;
+
+// number of sessions opened to the same URL on connect (default 1). subscriptions are sharded across them
+@property (nonatomic) NSUInteger sessionPoolSize;
+// the sessions opened on connect. a stand-in server playing several sessions without a network sets its own
+@property (nullable) DiffusionSessionPool *sessionPool;
+
+// the one timer behind the liveness checks, snapshots, subscription debounce window and reconnection delays. timers close
+// in time share a wakeup, its counters tell how many were saved. its clock times the connection health, the liveness
+// checks and the metrics too
+@property (readonly) DiffusionTimerWheel *timerWheel;
+
+// pings the server while a session is open, only when recent traffic does not already prove the connection alive.
+// tell it when the application moves to the background
+@property (readonly) DiffusionLivenessScheduler *livenessScheduler;
+// default YES. testConnectionWithServer still pings on demand when disabled
+@property (nonatomic, getter=isLivenessCheckEnabled) BOOL livenessCheckEnabled;
+// pings, updates and session states folded into one score. the reconnection strategy can read it too
+@property (readonly) DiffusionConnectionHealth *connectionHealth;
+// default YES. on a liveness check, a session degraded for longer than the health's degraded duration is replaced
+@property BOOL recyclesDegradedSessions;
+
+// every selector subscribed through the manager. replayed on each new session
+@property (readonly) DiffusionSubscriptionRegistry *subscriptions;
+// subscribe and unsubscribe calls go through it. set its window to debounce them into combined requests
+@property (readonly) DiffusionSubscriptionBatcher *subscriptionBatcher;
+
+// an ID for every topic subscribed to so far, for anything that wants to key topics by ID rather than by path
+@property (readonly) DiffusionTopicPathIndex *topicIndex;
 
+// last value of every subscribed topic, so a screen can render without waiting for the next update
+@property (readonly) DiffusionTopicValueCache *valueCache;
+// file the value cache is periodically written to while a session is open. nil (the default) disables snapshots
+@property (nullable, nonatomic) NSURL *snapshotURL;
+// seconds between two snapshots (default 10). nothing is written if no value changed
+@property (nonatomic) NSTimeInterval snapshotInterval;
+
+// a stream per topic type on every session. set its handlers for string, number, binary and record topics
+@property (readonly) DiffusionTypedStreamDispatcher *streamDispatcher;
+
+// latency histograms and counters. take a snapshot of it at any time
+@property (readonly) DiffusionMetrics *metrics;
+
+// when set, session state changes, ping results, subscription results and updates are recorded to it
+@property (nullable) DiffusionEventLog *eventLog;
+// when set, subscriptions, updates with their values, session state changes and pings are recorded to it for replay
+@property (nullable) DiffusionTrafficRecorder *trafficRecorder;
+
+// application work for each JSON topic update. runs on the delivery queue unless processing lanes are set
+@property (nullable, copy) DiffusionTopicUpdateHandler updateHandler;
+// when set, updates are handed to these lanes: ordered per topic, unrelated topics processed in parallel. ignored
+// with an inbound queue, which runs updates on its own processing lanes, if any
+@property (nullable) DiffusionProcessingLanes *processingLanes;
+// when set, updates wait in this bounded queue for the handlers, and its policy decides what happens when they fall
+// behind. create it with processing lanes to run the handlers on them. updates are queued from the main queue, so the
+// blocking policy is refused
+@property (nullable, nonatomic) DiffusionInboundQueue *inboundQueue;
+// when set, JSON values are also handed to it, for screens that only want the latest value once per frame
+@property (nullable) DiffusionUpdateConflator *conflator;
+
+// timers on a wheel of 10 ms ticks firing on the main queue
+- (instancetype)init;
+// timers on the given wheel. they run the manager's own bookkeeping, so the wheel must fire where the manager is used
+// from, or be driven by hand on that thread
+- (instancetype)initWithTimerWheel:(DiffusionTimerWheel *)timerWheel NS_DESIGNATED_INITIALIZER;
 
 - (void)connectToURL:(NSURL *)url withCompletionHandler:(void (^ _Nullable)(PTDiffusionSession * _Nullable session, NSError * _Nullable error)) completionHandler;
 - (void)closeSession;
 
 - (void)subscribeTo:(NSString *)selector;
+- (void)subscribeTo:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority;
+- (void)subscribeTo:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler;
 - (void)unsubscribeFrom:(NSString *)selector;
+- (void)unsubscribeFrom:(NSString *)selector completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler;
+
+// handlers for the topics selected by a selector. the returned token removes the handler
+- (id<NSObject>)addUpdateHandler:(DiffusionTopicUpdateHandler)handler forSelector:(NSString *)selector;
+- (void)removeUpdateHandler:(id<NSObject>)token;
 
 - (void)testConnectionWithServer;
 
+// the bookkeeping for a state change of the primary session and for each ping result. the session observers call
+// them, and so can a stand-in server driving the manager without a network
+- (void)noteSessionStateChangeFrom:(DiffusionConnectionState)previousState to:(DiffusionConnectionState)state;
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime;
+- (void)notePingFailure;
+- (void)notePingFailureWithError:(nullable NSError *)error;
+
+// seeds the value cache with the stale values of the last snapshot, without replacing live values. returns how many
+- (NSUInteger)loadSnapshot;
+- (void)writeSnapshot;
+
 - (PTDiffusionSessionConfiguration *)sessionConfiguration;
 - (NSString *)LogHeader;
 
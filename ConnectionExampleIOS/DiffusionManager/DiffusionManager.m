@@ -7,10 +7,140 @@
 //
 
 #import "DiffusionManager.h"
+#import "DiffusionEventLog.h"
+#import "DiffusionInboundQueue.h"
+#import "DiffusionLog.h"
+#import "DiffusionProcessingLanes.h"
+#import "DiffusionSelectorCoalescer.h"
+#import "DiffusionSessionPool.h"
+#import "DiffusionTimerWheel.h"
+#import "DiffusionTopicSelectorMatcher.h"
+#import "DiffusionTopicSnapshotFile.h"
+#import "DiffusionTrafficRecorder.h"
+#import "DiffusionUpdateConflator.h"
+
+@interface DiffusionSelectorUpdateHandler : NSObject
+
+@property (readonly) NSString *selector;
+@property (readonly) DiffusionTopicUpdateHandler handler;
+
+@end
+
+@implementation DiffusionSelectorUpdateHandler
+
+- (instancetype)initWithSelector:(NSString *)selector handler:(DiffusionTopicUpdateHandler)handler
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _selector = [selector copy];
+    _handler = [handler copy];
+
+    return self;
+}
+
+@end
+
+
+// how late a timer may fire, as a fraction of its delay
+static const double _LivenessCheckLeeway = 0.1;
+static const double _SnapshotLeeway = 0.25;
+
+static uint32_t _EventLogState(PTDiffusionSessionState *state)
+{
+    return (state.isConnected ? DiffusionEventSessionStateConnected : 0)
+        | (state.isRecovering ? DiffusionEventSessionStateRecovering : 0)
+        | (state.isClosed ? DiffusionEventSessionStateClosed : 0)
+        | (state.error ? DiffusionEventSessionStateError : 0);
+}
+
+static DiffusionConnectionState _HealthState(PTDiffusionSessionState *state)
+{
+    if (state.isConnected)
+    {
+        return DiffusionConnectionStateConnected;
+    }
+    if (state.isRecovering)
+    {
+        return DiffusionConnectionStateRecovering;
+    }
+    return state.isClosed ? DiffusionConnectionStateClosed : DiffusionConnectionStateConnecting;
+}
+
+
+@interface DiffusionManager ()
+
+// minimal covering set of the registry, which is what the server is actually asked for
+@property (readonly) DiffusionSelectorCoalescer *coalescer;
+// snapshots are written off the main queue, one at a time
+@property (readonly) dispatch_queue_t snapshotQueue;
+@property NSUInteger snapshotGeneration;
+@property BOOL snapshotScheduled;
+// selector scoped update handlers, and all their selectors compiled together. rebuilt when the handlers change
+@property (readonly) NSMutableArray<DiffusionSelectorUpdateHandler *> *selectorUpdateHandlers;
+@property (nullable) DiffusionTopicSelectorMatcher *updateHandlerMatcher;
+// the critical selectors of the registry, to give updates their priority in the inbound queue
+@property (nullable) DiffusionTopicSelectorMatcher *criticalSelectorMatcher;
+// when the current sessions opened, until their first update. NAN once it has arrived
+@property NSTimeInterval sessionOpenTime;
+// time of the last update of each topic in nanoseconds, by topic ID. 0 before its first
+@property (readonly) NSMutableData *lastUpdateTimes;
+@property BOOL livenessCheckScheduled;
+// state observers of the current sessions, removed when they are closed
+@property (readonly) NSMutableArray<id<NSObject>> *sessionObservers;
+
+@end
 
 @implementation DiffusionManager
 
 
+- (instancetype)init
+{
+    return [self initWithTimerWheel:[[DiffusionTimerWheel alloc] init]];
+}
+
+- (instancetype)initWithTimerWheel:(DiffusionTimerWheel *)timerWheel
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _timerWheel = timerWheel;
+    _sessionPoolSize = 1;
+    _maximumQueueSize = PTDiffusionSessionConfiguration.defaultMaximumQueueSize;
+    _subscriptions = [[DiffusionSubscriptionRegistry alloc] init];
+    _coalescer = [[DiffusionSelectorCoalescer alloc] init];
+    _subscriptionBatcher = [[DiffusionSubscriptionBatcher alloc] init];
+    _subscriptionBatcher.scheduler = _timerWheel;
+    _topicIndex = [[DiffusionTopicPathIndex alloc] init];
+    _selectorUpdateHandlers = [NSMutableArray array];
+    _sessionObservers = [NSMutableArray array];
+    _streamDispatcher = [[DiffusionTypedStreamDispatcher alloc] init];
+    _streamDispatcher.delegate = self;
+    _valueCache = [[DiffusionTopicValueCache alloc] init];
+    _metrics = [[DiffusionMetrics alloc] init];
+    _livenessScheduler = [[DiffusionLivenessScheduler alloc] init];
+    _livenessCheckEnabled = YES;
+    _connectionHealth = [[DiffusionConnectionHealth alloc] init];
+    _recyclesDegradedSessions = YES;
+    _sessionOpenTime = NAN;
+    _lastUpdateTimes = [NSMutableData data];
+    _snapshotInterval = 10.0;
+    _snapshotQueue = dispatch_queue_create("DiffusionManager.snapshot", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+
+    __weak DiffusionManager *weakSelf = self;
+    _subscriptionBatcher.referenceCountHandler = ^NSUInteger(NSString *selector) {
+        return [weakSelf.subscriptions referenceCountOfSelector:selector];
+    };
+    _subscriptionBatcher.flushHandler = ^(NSArray<DiffusionSubscriptionIntent *> *intents) {
+        [weakSelf applySubscriptionIntents:intents];
+    };
+
+    return self;
+}
 
 + (id)sharedManager
 {
@@ -22,6 +152,13 @@
     return _manager;
 }
 
+// everything is timed on the timer wheel's clock: the liveness checks and reconnection delays run on it, and the
+// reconnection strategies read the connection health at its times
+- (NSTimeInterval)currentTime
+{
+    return self.timerWheel.currentTime;
+}
+
 
 #pragma mark - actions
 
@@ -29,58 +166,157 @@
 {
     if (self.session)
     {
-        NSLog(@"%@: detected existing session", self.LogHeader);
+        DiffusionLogInfo(@"%@: detected existing session", self.LogHeader);
         if ([self.url isEqual:url])
         {
-            NSLog(@"%@: detected session is connected to the same URL. Testing connection with server", self.LogHeader);
+            DiffusionLogInfo(@"%@: detected session is connected to the same URL. Testing connection with server", self.LogHeader);
             [self testConnectionWithServer];
         }
         else
         {
-            NSLog(@"%@: detected session is connected to a different URL. closing current session and opening a new one", self.LogHeader);
+            DiffusionLogInfo(@"%@: detected session is connected to a different URL. closing current session and opening a new one", self.LogHeader);
             [self.session close];
+            [self.sessionPool close];
+            self.sessionPool = nil;
             
             [self createNewSession:url withCompletionHandler:completionHandler];
         }
     }
     else
     {
-        NSLog(@"%@: no session detected. Creating a new one", self.LogHeader);
+        DiffusionLogInfo(@"%@: no session detected. Creating a new one", self.LogHeader);
         [self createNewSession:url withCompletionHandler:completionHandler];
     }
 }
 
 - (void) createNewSession:(NSURL *)url withCompletionHandler:(void (^)(PTDiffusionSession * _Nullable session, NSError * _Nullable error)) completionHandler
 {
-    [PTDiffusionSession openWithURL:url configuration:self.sessionConfiguration completionHandler:^(PTDiffusionSession * _Nullable session, NSError * _Nullable error) {
-        if (!session)
+    const NSUInteger poolSize = MAX(self.sessionPoolSize, (NSUInteger)1);
+    if (poolSize > 1)
+    {
+        DiffusionLogInfo(@"%@: opening a pool of %lu sessions", self.LogHeader, (unsigned long)poolSize);
+    }
+
+    // slots keep the shard order stable regardless of the order in which the sessions finish opening
+    NSMutableArray *const slots = [NSMutableArray arrayWithCapacity:poolSize];
+    for (NSUInteger i = 0; i < poolSize; i++)
+    {
+        [slots addObject:[NSNull null]];
+    }
+    __block NSError *firstError = nil;
+    dispatch_group_t const group = dispatch_group_create();
+
+    for (NSUInteger i = 0; i < poolSize; i++)
+    {
+        dispatch_group_enter(group);
+        [PTDiffusionSession openWithURL:url configuration:self.sessionConfiguration completionHandler:^(PTDiffusionSession * _Nullable session, NSError * _Nullable error) {
+            if (!session)
+            {
+                DiffusionLogError(@"%@: failed to open session: %@", self.LogHeader, error);
+                if (!firstError)
+                {
+                    firstError = error;
+                }
+            }
+            else
+            {
+                DiffusionLogInfo(@"%@: session opened [%@]", self.LogHeader, session.sessionId);
+                slots[i] = session;
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        NSMutableArray<PTDiffusionSession *> *const sessions = [NSMutableArray arrayWithCapacity:poolSize];
+        for (id slot in slots)
         {
-            NSLog(@"%@: failed to open session: %@", self.LogHeader, error);
+            if (slot != [NSNull null])
+            {
+                [sessions addObject:slot];
+            }
         }
-        else
+
+        PTDiffusionSession *const session = sessions.firstObject;
+        if (session)
         {
-            NSLog(@"%@: session opened [%@]", self.LogHeader, session.sessionId);
             self.session = session;
             self.url = url;
-            
-            // fallback streams are for subscribed topics that do not have a value/topic stream registered specifically for it
-            NSLog(@"%@: setting up a fallback stream for JSON", self.LogHeader);
-            PTDiffusionValueStream *const stream = [PTDiffusionJSON valueStreamWithDelegate:self];
-            [session.topics addFallbackStream:stream];
-            
-            NSLog(@"%@: setting up a session state observer", self.LogHeader);
-            NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
-            [nc addObserverForName:PTDiffusionSessionStateDidChangeNotification object:session queue:nil usingBlock:^(NSNotification * _Nonnull note) {
-                PTDiffusionSessionStateChange* change = note.userInfo[PTDiffusionSessionStateChangeUserInfoKey];
-                NSLog(@"%@: Session State Change: %@", self.LogHeader, change);
+            self.sessionPool = [[DiffusionSessionPool alloc] initWithSessions:sessions];
+            self.sessionOpenTime = self.currentTime;
+            [self.connectionHealth resetAtTime:self.sessionOpenTime];
+            [self.connectionHealth noteState:DiffusionConnectionStateConnected atTime:self.sessionOpenTime];
+
+            [sessions enumerateObjectsUsingBlock:^(PTDiffusionSession *pooled, NSUInteger shard, BOOL *stop) {
+                [self setUpSession:pooled shard:shard];
             }];
+
+            // a new session starts without any subscription, give it back everything that is active
+            [self replaySubscriptions];
+            [self scheduleSnapshot];
+            [self scheduleLivenessCheck];
         }
-        
+
         if (completionHandler)
         {
-            completionHandler(session, error);
+            completionHandler(session, session ? nil : firstError);
         }
-    }];
+    });
+}
+
+- (void) setUpSession:(PTDiffusionSession *)session shard:(NSUInteger)shard
+{
+    // fallback streams are for subscribed topics that do not have a value/topic stream registered specifically for it
+    DiffusionLogInfo(@"%@: setting up a fallback stream per topic type", self.LogHeader);
+    for (PTDiffusionValueStream *stream in [self.streamDispatcher addFallbackStreamsToSession:session])
+    {
+        [self.sessionPool registerStream:stream forShard:shard];
+    }
+
+    DiffusionLogInfo(@"%@: setting up a session state observer", self.LogHeader);
+    NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
+    __weak DiffusionManager *weakSelf = self;
+    __weak PTDiffusionSession *weakSession = session;
+    [self.sessionObservers addObject:[nc addObserverForName:PTDiffusionSessionStateDidChangeNotification object:session queue:nil usingBlock:^(NSNotification * _Nonnull note) {
+        DiffusionManager *const manager = weakSelf;
+        PTDiffusionSession *const observed = weakSession;
+        if (!manager || !observed)
+        {
+            return;
+        }
+        PTDiffusionSessionStateChange* change = note.userInfo[PTDiffusionSessionStateChangeUserInfoKey];
+        DiffusionLogInfo(@"%@: Session State Change: %@", manager.LogHeader, change);
+        [manager.eventLog recordSessionStateChangeFrom:_EventLogState(change.previousState) to:_EventLogState(change.state) sessionID:observed.sessionId.description];
+        // the other sessions of a pool share the same network, the primary one speaks for them
+        if (observed == manager.session)
+        {
+            [manager noteSessionStateChangeFrom:_HealthState(change.previousState) to:_HealthState(change.state)];
+        }
+    }]];
+}
+
+- (void)removeSessionObservers
+{
+    for (id<NSObject> observer in self.sessionObservers)
+    {
+        [NSNotificationCenter.defaultCenter removeObserver:observer];
+    }
+    [self.sessionObservers removeAllObjects];
+}
+
+- (void)dealloc
+{
+    [self removeSessionObservers];
+}
+
+- (void)noteSessionStateChangeFrom:(DiffusionConnectionState)previousState to:(DiffusionConnectionState)state
+{
+    if (previousState == DiffusionConnectionStateRecovering && state == DiffusionConnectionStateConnected)
+    {
+        [self.metrics noteReconnect];
+    }
+    [self.trafficRecorder recordSessionStateChangeFrom:previousState to:state];
+    [self.connectionHealth noteState:state atTime:self.currentTime];
 }
 
 
@@ -88,9 +324,13 @@
 {
     if (self.session)
     {
-        NSLog(@"%@: closing session", self.LogHeader);
+        DiffusionLogInfo(@"%@: closing session", self.LogHeader);
+        [self writeSnapshot];
+        [self removeSessionObservers];
         [self.session close];
+        [self.sessionPool close];
         self.session = nil;
+        self.sessionPool = nil;
     }
 }
                   
@@ -98,7 +338,9 @@
 
 - (PTDiffusionSessionConfiguration *)sessionConfiguration
 {
-    return [[PTDiffusionSessionConfiguration alloc] initWithPrincipal:nil credentials:nil];
+    PTDiffusionMutableSessionConfiguration *const configuration = [[PTDiffusionMutableSessionConfiguration alloc] initWithPrincipal:nil credentials:nil];
+    configuration.maximumQueueSize = self.maximumQueueSize;
+    return configuration;
 }
 
 - (NSString *)LogHeader
@@ -110,63 +352,491 @@
 {
     if (self.session)
     {
-        [self.session.pings pingServerWithCompletionHandler:^(PTDiffusionPingDetails * _Nullable details, NSError * _Nullable error) {
-            if (error)
-            {
-                // only goes here after attempting all possible solutions in the reconnection strategy
-                NSLog(@"%@: Error detected while pinging the server: %@", self.LogHeader, error);
-                
-                if ([error.domain isEqualToString:PTDiffusionSessionErrorDomain])
-                {
-                    NSLog(@"%@: Session has been closed. Opening a new one", self.LogHeader);
-                    [self.session close];
-                    self.session = nil;
-                    [self connectToURL:self->_url withCompletionHandler:nil];
-                }
-            }
-            else
+        DiffusionSessionPool *const pool = self.sessionPool;
+        NSArray<PTDiffusionSession *> *const sessions = pool.sessions.count ? pool.sessions : @[self.session];
+        for (PTDiffusionSession *session in sessions)
+        {
+            [self testConnectionWithSession:session pool:pool];
+        }
+    }
+    else
+    {
+        DiffusionLogInfo(@"%@: no session detected. Aborting", self.LogHeader);
+    }
+}
+
+- (void)testConnectionWithSession:(PTDiffusionSession *)session pool:(nullable DiffusionSessionPool *)pool
+{
+    [session.pings pingServerWithCompletionHandler:^(PTDiffusionPingDetails * _Nullable details, NSError * _Nullable error) {
+        if (error)
+        {
+            // only goes here after attempting all possible solutions in the reconnection strategy
+            DiffusionLogError(@"%@: Error detected while pinging the server: %@", self.LogHeader, error);
+            [self notePingFailureWithError:error];
+            
+            // with a pool every session is pinged, only the first failure within the current pool replaces it
+            if ([error.domain isEqualToString:PTDiffusionSessionErrorDomain] && pool == self.sessionPool)
             {
-                NSLog(@"%@: ping successful (%dms)", self.LogHeader, (int) round(details.roundTripTime * 1000));
+                DiffusionLogInfo(@"%@: Session has been closed. Opening a new one", self.LogHeader);
+                [self replaceSession];
             }
-        }];
+        }
+        else
+        {
+            DiffusionLogInfo(@"%@: ping successful (%dms)", self.LogHeader, (int) round(details.roundTripTime * 1000));
+            [self notePingRoundTripTime:details.roundTripTime];
+        }
+    }];
+}
+
+- (void)notePingRoundTripTime:(NSTimeInterval)roundTripTime
+{
+    const NSTimeInterval now = self.currentTime;
+    [self.eventLog recordPingRoundTripTime:roundTripTime];
+    [self.trafficRecorder recordPingRoundTripTime:roundTripTime];
+    [self.metrics.pingRoundTripTime recordTimeInterval:roundTripTime];
+    [self.livenessScheduler notePingRoundTripTime:roundTripTime atTime:now];
+    [self.connectionHealth notePingRoundTripTime:roundTripTime atTime:now];
+}
+
+- (void)notePingFailure
+{
+    [self notePingFailureWithError:nil];
+}
+
+- (void)notePingFailureWithError:(nullable NSError *)error
+{
+    const NSTimeInterval now = self.currentTime;
+    [self.eventLog recordPingFailureWithErrorCode:error.code];
+    [self.trafficRecorder recordPingFailure];
+    [self.livenessScheduler notePingFailureAtTime:now];
+    [self.connectionHealth notePingFailureAtTime:now];
+}
+
+- (void)replaceSession
+{
+    [self.metrics noteSessionReplacement];
+    [self removeSessionObservers];
+    [self.session close];
+    [self.sessionPool close];
+    self.session = nil;
+    self.sessionPool = nil;
+    [self connectToURL:self->_url withCompletionHandler:nil];
+}
+
+- (void)scheduleLivenessCheck
+{
+    if (!self.livenessCheckEnabled || self.livenessCheckScheduled)
+    {
+        return;
     }
-    else
+    self.livenessCheckScheduled = YES;
+
+    const NSTimeInterval delay = [self.livenessScheduler delayBeforeNextCheckAtTime:self.currentTime];
+    __weak DiffusionManager *weakSelf = self;
+    // a check a little late costs nothing, and shares its wakeup with whatever else is due
+    [self.timerWheel scheduleAfterDelay:delay leeway:delay * _LivenessCheckLeeway block:^{
+        DiffusionManager *const manager = weakSelf;
+        manager.livenessCheckScheduled = NO;
+        if (!manager.session || !manager.livenessCheckEnabled)
+        {
+            return;
+        }
+        const NSTimeInterval now = manager.currentTime;
+        if (manager.recyclesDegradedSessions && [manager.connectionHealth shouldRecycleSessionAtTime:now])
+        {
+            DiffusionLogInfo(@"%@: connection degraded for too long (health %.2f). Opening a new session", manager.LogHeader, [manager.connectionHealth scoreAtTime:now]);
+            [manager replaceSession];
+            return;
+        }
+        if ([manager.livenessScheduler shouldPingAtTime:now])
+        {
+            [manager testConnectionWithServer];
+        }
+        [manager scheduleLivenessCheck];
+    }];
+}
+
+- (void)setLivenessCheckEnabled:(BOOL)livenessCheckEnabled
+{
+    _livenessCheckEnabled = livenessCheckEnabled;
+    if (livenessCheckEnabled && self.session)
+    {
+        [self scheduleLivenessCheck];
+    }
+}
+
+- (void)setInboundQueue:(nullable DiffusionInboundQueue *)inboundQueue
+{
+    if (inboundQueue && inboundQueue.policy == DiffusionInboundQueuePolicyBlock)
     {
-        NSLog(@"%@: no session detected. Aborting", self.LogHeader);
+        // a full queue would stop the main queue, and the application with it
+        [NSException raise:NSInvalidArgumentException format:@"%@: an inbound queue with the blocking policy cannot be used on the main queue", self.LogHeader];
     }
+    _inboundQueue = inboundQueue;
 }
 
 
 
 - (void)unsubscribeFrom:(NSString *)selector
 {
-    NSLog(@"DiffusionManager: Unsubscribing from [%@]", selector);
+    [self unsubscribeFrom:selector completionHandler:nil];
+}
+
+- (void)unsubscribeFrom:(NSString *)selector completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    DiffusionLogInfo(@"DiffusionManager: Unsubscribing from [%@]", selector);
+    [self.subscriptionBatcher addUnsubscribe:selector completionHandler:completionHandler];
+}
+
+
+- (void)subscribeTo:(NSString *)selector
+{
+    [self subscribeTo:selector priority:DiffusionSubscriptionPriorityNormal];
+}
+
+- (void)subscribeTo:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority
+{
+    [self subscribeTo:selector priority:priority completionHandler:nil];
+}
+
+- (void)subscribeTo:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    DiffusionLogInfo(@"%@: Subscribing to [%@]", self.LogHeader, selector);
+    [self.subscriptionBatcher addSubscribe:selector priority:priority completionHandler:completionHandler];
+}
+
+- (id<NSObject>)addUpdateHandler:(DiffusionTopicUpdateHandler)handler forSelector:(NSString *)selector
+{
+    DiffusionSelectorUpdateHandler *const entry = [[DiffusionSelectorUpdateHandler alloc] initWithSelector:selector handler:handler];
+    [self.selectorUpdateHandlers addObject:entry];
+    self.updateHandlerMatcher = nil;
+    return entry;
+}
+
+- (void)removeUpdateHandler:(id<NSObject>)token
+{
+    [self.selectorUpdateHandlers removeObjectIdenticalTo:(DiffusionSelectorUpdateHandler *)token];
+    self.updateHandlerMatcher = nil;
+}
+
+- (PTDiffusionSession *)sessionForSelector:(NSString *)selector
+{
+    return self.sessionPool ? [self.sessionPool sessionForSelector:selector] : self.session;
+}
+
+// what survived the batching window
+- (void)applySubscriptionIntents:(NSArray<DiffusionSubscriptionIntent *> *)intents
+{
+    NSMutableDictionary<NSString *, NSArray<DiffusionSubscriptionCompletionHandler> *> *const handlers = [NSMutableDictionary dictionary];
+    for (DiffusionSubscriptionIntent *intent in intents)
+    {
+        if (intent.isSubscribe)
+        {
+            for (NSUInteger i = 0; i < intent.referenceCount; i++)
+            {
+                [self.subscriptions addSelector:intent.selector priority:intent.priority];
+            }
+        }
+        else
+        {
+            if (![self.subscriptions containsSelector:intent.selector])
+            {
+                DiffusionLogInfo(@"%@: [%@] is not subscribed. Ignoring", self.LogHeader, intent.selector);
+                [self completeHandlers:intent.completionHandlers error:nil];
+                continue;
+            }
+            for (NSUInteger i = 0; i < intent.referenceCount; i++)
+            {
+                [self.subscriptions removeSelector:intent.selector];
+            }
+            if ([self.subscriptions containsSelector:intent.selector])
+            {
+                DiffusionLogInfo(@"%@: [%@] is still subscribed by %lu others", self.LogHeader, intent.selector, (unsigned long)[self.subscriptions referenceCountOfSelector:intent.selector]);
+                [self completeHandlers:intent.completionHandlers error:nil];
+                continue;
+            }
+        }
+        handlers[intent.selector] = intent.completionHandlers;
+    }
+    self.criticalSelectorMatcher = nil;
     
-    [self.session.topics unsubscribeFromTopicSelectorExpression:selector completionHandler:^(NSError * _Nullable error) {
+    [self applySubscriptionChangesWithCompletionHandlers:handlers];
+}
+
+// brings the server in line with the covering set of the registry.
+// handlers are keyed by the selector the caller asked for and completed with the request that carried it
+- (void)applySubscriptionChangesWithCompletionHandlers:(NSDictionary<NSString *, NSArray<DiffusionSubscriptionCompletionHandler> *> *)handlers
+{
+    DiffusionSelectorChanges *const changes = [self.coalescer updateWithSelectors:self.subscriptions.selectors];
+    if (changes.empty)
+    {
+        DiffusionLogInfo(@"%@: selectors already covered, nothing to send", self.LogHeader);
+        [self completeAllHandlers:handlers error:nil];
+        return;
+    }
+    if (!self.session)
+    {
+        DiffusionLogInfo(@"%@: no session detected. Selectors will be subscribed once a session is open", self.LogHeader);
+        [self completeAllHandlers:handlers error:nil];
+        return;
+    }
+    
+    NSMapTable<PTDiffusionSession *, NSMutableArray<NSString *> *> *const unsubscriptions = [NSMapTable strongToStrongObjectsMapTable];
+    NSMutableSet<PTDiffusionSession *> *const narrowed = [NSMutableSet set];
+    for (NSString *selector in changes.removed)
+    {
+        PTDiffusionSession *const session = [self sessionForSelector:selector];
+        NSString *const covering = [self.coalescer selectorCovering:selector];
+        
+        // unsubscribing is by topic: a selector that became covered must stay on the server when the wider
+        // selector is on the same session, or the topics they share would be dropped
+        if (covering && [self sessionForSelector:covering] == session)
+        {
+            continue;
+        }
+        [self addSelector:selector forSession:session toRequests:unsubscriptions];
+        [narrowed addObject:session];
+    }
+    
+    NSMutableArray<NSString *> *const toSubscribe = [changes.added mutableCopy];
+    if (narrowed.count)
+    {
+        // selectors that cannot be compared might share topics with what was just unsubscribed, assert them again.
+        // the server handles the requests of a session in order, so they land after the unsubscription
+        for (NSString *selector in self.coalescer.effectiveSelectors)
+        {
+            if (![DiffusionSelectorCoalescer isPathSelector:selector]
+                && [narrowed containsObject:[self sessionForSelector:selector]]
+                && ![toSubscribe containsObject:selector])
+            {
+                [toSubscribe addObject:selector];
+            }
+        }
+    }
+    NSMapTable<PTDiffusionSession *, NSMutableArray<NSString *> *> *const subscriptions = [NSMapTable strongToStrongObjectsMapTable];
+    for (NSString *selector in toSubscribe)
+    {
+        [self addSelector:selector forSession:[self sessionForSelector:selector] toRequests:subscriptions];
+    }
+    
+    // one combined request per session and direction, every unsubscription is sent before the subscriptions
+    NSMutableDictionary<NSString *, NSArray<DiffusionSubscriptionCompletionHandler> *> *const remaining = [handlers mutableCopy];
+    NSUInteger requests = 0;
+    for (PTDiffusionSession *session in unsubscriptions)
+    {
+        NSArray<NSString *> *const selectors = [unsubscriptions objectForKey:session];
+        [self unsubscribeSession:session
+                  fromExpression:[DiffusionSubscriptionRegistry expressionForSelectors:selectors]
+              completionHandlers:[self takeHandlersForSelectors:selectors from:remaining]];
+        requests++;
+    }
+    for (PTDiffusionSession *session in subscriptions)
+    {
+        NSArray<NSString *> *const selectors = [subscriptions objectForKey:session];
+        [self subscribeSession:session
+                  toExpression:[DiffusionSubscriptionRegistry expressionForSelectors:selectors]
+            completionHandlers:[self takeHandlersForSelectors:selectors from:remaining]];
+        requests++;
+    }
+    [self.subscriptionBatcher noteSentRequests:requests];
+    
+    // callers whose selector needed no request at all, e.g. it is covered by one already on the server
+    [self completeAllHandlers:remaining error:nil];
+}
+
+- (void)addSelector:(NSString *)selector forSession:(PTDiffusionSession *)session toRequests:(NSMapTable<PTDiffusionSession *, NSMutableArray<NSString *> *> *)requests
+{
+    NSMutableArray<NSString *> *selectors = [requests objectForKey:session];
+    if (!selectors)
+    {
+        selectors = [NSMutableArray array];
+        [requests setObject:selectors forKey:session];
+    }
+    [selectors addObject:selector];
+}
+
+// removes and returns the handlers of the callers whose selector is carried by a request, directly or through a covering selector
+- (NSArray<DiffusionSubscriptionCompletionHandler> *)takeHandlersForSelectors:(NSArray<NSString *> *)selectors from:(NSMutableDictionary<NSString *, NSArray<DiffusionSubscriptionCompletionHandler> *> *)handlers
+{
+    NSMutableArray<DiffusionSubscriptionCompletionHandler> *const taken = [NSMutableArray array];
+    for (NSString *selector in handlers.allKeys)
+    {
+        NSString *const covering = [self.coalescer selectorCovering:selector];
+        if ([selectors containsObject:selector] || (covering && [selectors containsObject:covering]))
+        {
+            [taken addObjectsFromArray:handlers[selector]];
+            [handlers removeObjectForKey:selector];
+        }
+    }
+    return taken;
+}
+
+- (void)completeAllHandlers:(NSDictionary<NSString *, NSArray<DiffusionSubscriptionCompletionHandler> *> *)handlers error:(nullable NSError *)error
+{
+    for (NSArray<DiffusionSubscriptionCompletionHandler> *selectorHandlers in handlers.allValues)
+    {
+        [self completeHandlers:selectorHandlers error:error];
+    }
+}
+
+- (void)completeHandlers:(nullable NSArray<DiffusionSubscriptionCompletionHandler> *)handlers error:(nullable NSError *)error
+{
+    for (DiffusionSubscriptionCompletionHandler handler in handlers)
+    {
+        handler(error);
+    }
+}
+
+- (void)subscribeSession:(PTDiffusionSession *)session toExpression:(NSString *)expression completionHandlers:(nullable NSArray<DiffusionSubscriptionCompletionHandler> *)handlers
+{
+    const NSTimeInterval sent = self.currentTime;
+    [session.topics subscribeWithTopicSelectorExpression:expression completionHandler:^(NSError * _Nullable error) {
+        [self.metrics.subscribeRoundTripTime recordTimeInterval:self.currentTime - sent];
+        [self.eventLog recordSubscribeResultForSelector:expression subscribe:YES errorCode:error.code];
         if (error)
         {
-            NSLog(@"\t\tDiffusionManager: Unsubscribe request ([%@]) failed: %@", selector, error);
+            DiffusionLogError(@"\t\%@: Subscribe request ([%@]) failed: %@", self.LogHeader, expression, error);
         }
         else
         {
-            NSLog(@"\t\tDiffusionManagerUnsubscribe request ([%@]) succeeeded", selector);
+            DiffusionLogInfo(@"\t\%@: Subscribe request ([%@]) succeeded", self.LogHeader, expression);
         }
+        [self completeHandlers:handlers error:error];
     }];
 }
 
+- (void)unsubscribeSession:(PTDiffusionSession *)session fromExpression:(NSString *)expression completionHandlers:(nullable NSArray<DiffusionSubscriptionCompletionHandler> *)handlers
+{
+    [session.topics unsubscribeFromTopicSelectorExpression:expression completionHandler:^(NSError * _Nullable error) {
+        [self.eventLog recordSubscribeResultForSelector:expression subscribe:NO errorCode:error.code];
+        if (error)
+        {
+            DiffusionLogError(@"\t\tDiffusionManager: Unsubscribe request ([%@]) failed: %@", expression, error);
+        }
+        else
+        {
+            DiffusionLogInfo(@"\t\tDiffusionManagerUnsubscribe request ([%@]) succeeeded", expression);
+        }
+        [self completeHandlers:handlers error:error];
+    }];
+}
 
-- (void)subscribeTo:(NSString *)selector
+- (void)replaySubscriptions
 {
-    NSLog(@"%@: Subscribing to [%@]", self.LogHeader, selector);
+    [self.coalescer updateWithSelectors:self.subscriptions.selectors];
+    NSArray<NSString *> *const effective = self.coalescer.effectiveSelectors;
+    if (!effective.count)
+    {
+        return;
+    }
+    DiffusionLogInfo(@"%@: replaying %lu subscriptions as %lu selectors", self.LogHeader, (unsigned long)self.subscriptions.count, (unsigned long)effective.count);
     
-    [self.session.topics subscribeWithTopicSelectorExpression:selector completionHandler:^(NSError * _Nullable error) {
-        if (error)
+    // a covering selector is as important as the most important selector it hides
+    NSMutableSet<NSString *> *const critical = [NSMutableSet set];
+    for (NSString *selector in [self.subscriptions selectorsWithPriority:DiffusionSubscriptionPriorityCritical])
+    {
+        [critical addObject:[self.coalescer selectorCovering:selector] ?: selector];
+    }
+    NSMutableArray<NSString *> *const criticalBatch = [NSMutableArray array];
+    NSMutableArray<NSString *> *const normalBatch = [NSMutableArray array];
+    for (NSString *selector in effective)
+    {
+        if ([critical containsObject:selector])
         {
-            NSLog(@"\t\%@: Subscribe request ([%@]) failed: %@", self.LogHeader, selector, error);
+            [criticalBatch addObject:selector];
         }
         else
         {
-            NSLog(@"\t\%@: Subscribe request ([%@]) succeeded", self.LogHeader, selector);
+            [normalBatch addObject:selector];
+        }
+    }
+    
+    // one combined request per priority and per session, critical selectors are sent first.
+    // the server handles the requests of a session in order, so critical topics are subscribed to first
+    for (NSArray<NSString *> *batch in @[criticalBatch, normalBatch])
+    {
+        NSMutableDictionary<NSNumber *, NSMutableArray<NSString *> *> *const shards = [NSMutableDictionary dictionary];
+        for (NSString *selector in batch)
+        {
+            NSNumber *const shard = @(self.sessionPool ? [self.sessionPool shardForSelector:selector] : 0);
+            if (!shards[shard])
+            {
+                shards[shard] = [NSMutableArray array];
+            }
+            [shards[shard] addObject:selector];
+        }
+        
+        [shards enumerateKeysAndObjectsUsingBlock:^(NSNumber *shard, NSMutableArray<NSString *> *selectors, BOOL *stop) {
+            PTDiffusionSession *const session = self.sessionPool ? self.sessionPool.sessions[shard.unsignedIntegerValue] : self.session;
+            [self subscribeSession:session toExpression:[DiffusionSubscriptionRegistry expressionForSelectors:selectors] completionHandlers:nil];
+        }];
+    }
+}
+
+#pragma mark - snapshot
+
+- (NSUInteger)loadSnapshot
+{
+    if (!self.snapshotURL)
+    {
+        return 0;
+    }
+    
+    NSError *error = nil;
+    DiffusionTopicSnapshotFile *const snapshot = [DiffusionTopicSnapshotFile snapshotWithContentsOfURL:self.snapshotURL error:&error];
+    if (!snapshot)
+    {
+        DiffusionLogError(@"%@: no snapshot loaded: %@", self.LogHeader, error.localizedDescription);
+        return 0;
+    }
+    
+    NSArray<DiffusionTopicValue *> *const values = snapshot.values;
+    [self.valueCache storeValues:values replacingExisting:NO];
+    // nothing new to write until a live value arrives
+    self.snapshotGeneration = self.valueCache.generation;
+    DiffusionLogInfo(@"%@: loaded %lu stale values from snapshot", self.LogHeader, (unsigned long)values.count);
+    return values.count;
+}
+
+- (void)writeSnapshot
+{
+    NSURL *const url = self.snapshotURL;
+    const NSUInteger generation = self.valueCache.generation;
+    if (!url || generation == self.snapshotGeneration)
+    {
+        return;
+    }
+    self.snapshotGeneration = generation;
+    
+    DiffusionTopicValueCache *const cache = self.valueCache;
+    dispatch_async(self.snapshotQueue, ^{
+        NSArray<DiffusionTopicValue *> *const values = cache.allValues;
+        NSError *error = nil;
+        if (![DiffusionTopicSnapshotFile writeValues:values toURL:url error:&error])
+        {
+            DiffusionLogError(@"%@: failed to write snapshot: %@", self.LogHeader, error);
+        }
+    });
+}
+
+- (void)scheduleSnapshot
+{
+    if (!self.snapshotURL || self.snapshotScheduled)
+    {
+        return;
+    }
+    self.snapshotScheduled = YES;
+    
+    __weak DiffusionManager *weakSelf = self;
+    const NSTimeInterval interval = self.snapshotInterval;
+    [self.timerWheel scheduleAfterDelay:interval leeway:interval * _SnapshotLeeway block:^{
+        DiffusionManager *const manager = weakSelf;
+        manager.snapshotScheduled = NO;
+        if (manager.session)
+        {
+            [manager writeSnapshot];
+            [manager scheduleSnapshot];
         }
     }];
 }
@@ -174,31 +844,181 @@
 #pragma mark - Diffusion delegates
 
 - (void)diffusionDidCloseStream:(nonnull PTDiffusionStream *)stream {
-    NSLog(@"\t\%@: Stream closed", self.LogHeader);
+    DiffusionLogInfo(@"\t\%@: Stream closed", self.LogHeader);
 }
 
 - (void)diffusionStream:(nonnull PTDiffusionStream *)stream didFailWithError:(nonnull NSError *)error {
-    NSLog(@"\t\%@: Stream failed with error: %@", self.LogHeader, error);
+    DiffusionLogError(@"\t\%@: Stream failed with error: %@", self.LogHeader, error);
+}
+
+- (BOOL)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher shouldDeliverTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream {
+    // with a pool, updates of a topic already delivered by another session are dropped
+    return !self.sessionPool || [self.sessionPool acceptTopicPath:topicPath fromStream:stream];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didSubscribeToTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification fromStream:(PTDiffusionStream *)stream {
+    if (self.sessionPool && ![self.sessionPool retainTopicPath:topicPath fromStream:stream])
+    {
+        // another session of the pool is already subscribed to it
+        return;
+    }
+    DiffusionLogDebug(@"\t\%@: Subscribed to %@ (%@)", self.LogHeader, topicPath, specification);
+    [self.trafficRecorder recordSubscriptionToTopicPath:topicPath topicType:specification.type];
+    [self.topicIndex internTopicPath:topicPath];
 }
 
-- (void)diffusionStream:(nonnull PTDiffusionStream *)stream didSubscribeToTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification {
-    NSLog(@"\t\%@: Subscribed to %@ (%@)", self.LogHeader, topicPath, specification);
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUnsubscribeFromTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification reason:(PTDiffusionTopicUnsubscriptionReason)reason fromStream:(PTDiffusionStream *)stream {
+    if (self.sessionPool && ![self.sessionPool releaseTopicPath:topicPath fromStream:stream])
+    {
+        // another session of the pool is still subscribed to it, and keeps its value current
+        return;
+    }
+    DiffusionLogDebug(@"\t\%@: Unsubscribed from %@ (%@)", self.LogHeader, topicPath, specification);
+    [self.trafficRecorder recordUnsubscriptionFromTopicPath:topicPath topicType:specification.type reason:reason];
+    [self.valueCache removeValueForTopicPath:topicPath];
+
+    // the next update after subscribing again is not an inter-arrival time
+    const DiffusionTopicID topicID = [self.topicIndex IDForTopicPath:topicPath];
+    if ((topicID + 1) * sizeof(uint64_t) <= self.lastUpdateTimes.length)
+    {
+        ((uint64_t *)self.lastUpdateTimes.mutableBytes)[topicID] = 0;
+    }
 }
 
-- (void)diffusionStream:(nonnull PTDiffusionStream *)stream didUnsubscribeFromTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification reason:(PTDiffusionTopicUnsubscriptionReason)reason {
-    NSLog(@"\t\%@: Unsubscribed from %@ (%@)", self.LogHeader, topicPath, specification);
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification bytes:(PTDiffusionBytes *)value {
+    DiffusionLogDebug(@"\t\%@: Updated %@ = %@", self.LogHeader, topicPath, value);
+    [self storeUpdateOfTopicPath:topicPath specification:specification data:value.data];
+    if (specification.type == PTDiffusionTopicType_JSON)
+    {
+        [self deliverUpdateOfTopicPath:topicPath specification:specification value:(PTDiffusionJSON *)value];
+    }
 }
 
-- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldJSON:(nullable PTDiffusionJSON *)oldJson newJSON:(nonnull PTDiffusionJSON *)newJson {
-    NSLog(@"\t\%@: Updated %@ = %@", self.LogHeader, topicPath, newJson);
+// the value cache keeps bytes, so primitive values are encoded here, once for it and the recorders
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification stringValue:(nullable NSString *)value {
+    DiffusionLogDebug(@"\t\%@: Updated %@ = %@", self.LogHeader, topicPath, value);
+    [self storeUpdateOfTopicPath:topicPath specification:specification data:[DiffusionTypedStreamDispatcher dataWithString:value]];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification int64Value:(int64_t)value {
+    DiffusionLogDebug(@"\t\%@: Updated %@ = %lld", self.LogHeader, topicPath, (long long)value);
+    [self storeUpdateOfTopicPath:topicPath specification:specification data:[DiffusionTypedStreamDispatcher dataWithInt64:value]];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification doubleValue:(double)value {
+    DiffusionLogDebug(@"\t\%@: Updated %@ = %g", self.LogHeader, topicPath, value);
+    [self storeUpdateOfTopicPath:topicPath specification:specification data:[DiffusionTypedStreamDispatcher dataWithDouble:value]];
+}
+
+- (void)storeUpdateOfTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification data:(NSData *)data
+{
+    [self.eventLog recordUpdateOfTopicPath:topicPath length:data.length topicType:specification.type];
+    [self.trafficRecorder recordUpdateOfTopicPath:topicPath topicType:specification.type value:data];
+    [self noteUpdateOfTopicPath:topicPath length:data.length];
+    [self.valueCache storeData:data specification:specification forTopicPath:topicPath];
+}
+
+// called on the delivery queue
+- (void)noteUpdateOfTopicPath:(NSString *)topicPath length:(NSUInteger)length
+{
+    const NSTimeInterval time = self.currentTime;
+    [self.metrics noteUpdateOfLength:length];
+    [self.livenessScheduler noteInboundTrafficAtTime:time];
+    [self.connectionHealth noteUpdateAtTime:time];
+    if (!isnan(self.sessionOpenTime))
+    {
+        [self.metrics.timeToFirstUpdate recordTimeInterval:time - self.sessionOpenTime];
+        self.sessionOpenTime = NAN;
+    }
+
+    const DiffusionTopicID topicID = [self.topicIndex IDForTopicPath:topicPath];
+    if (topicID == DiffusionTopicIDNone)
+    {
+        return;
+    }
+    NSMutableData *const times = self.lastUpdateTimes;
+    if (times.length < (topicID + 1) * sizeof(uint64_t))
+    {
+        times.length = MAX(times.length * 2, (topicID + 1) * sizeof(uint64_t));
+    }
+    const uint64_t now = (uint64_t)llround(time * NSEC_PER_SEC);
+    uint64_t *const last = (uint64_t *)times.mutableBytes + topicID;
+    if (*last)
+    {
+        [self.metrics.updateInterArrivalTime recordValue:(now - *last) / NSEC_PER_USEC];
+    }
+    *last = now;
+}
+
+- (void)deliverUpdateOfTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification value:(PTDiffusionJSON *)value
+{
+    [self.conflator addValue:value forTopicPath:topicPath];
+
+    NSMutableArray<DiffusionTopicUpdateHandler> *const handlers = [NSMutableArray array];
+    if (self.updateHandler)
+    {
+        [handlers addObject:self.updateHandler];
+    }
+    if (self.selectorUpdateHandlers.count)
+    {
+        if (!self.updateHandlerMatcher)
+        {
+            self.updateHandlerMatcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:[self.selectorUpdateHandlers valueForKey:@"selector"]];
+        }
+        // one pass over the path, however many handlers there are
+        NSArray<DiffusionSelectorUpdateHandler *> *const entries = self.selectorUpdateHandlers;
+        [[self.updateHandlerMatcher indexesOfSelectorsMatchingTopicPath:topicPath] enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+            [handlers addObject:entries[index].handler];
+        }];
+    }
+    if (!handlers.count)
+    {
+        return;
+    }
+    
+    DiffusionHistogram *const executionTime = self.metrics.handlerExecutionTime;
+    DiffusionTimerWheel *const clock = self.timerWheel;
+    void (^const deliver)(void) = ^{
+        const NSTimeInterval start = clock.currentTime;
+        for (DiffusionTopicUpdateHandler handler in handlers)
+        {
+            handler(topicPath, specification, value);
+        }
+        [executionTime recordTimeInterval:clock.currentTime - start];
+    };
+    DiffusionProcessingLanes *const lanes = self.processingLanes;
+    DiffusionInboundQueue *const queue = self.inboundQueue;
+    if (queue)
+    {
+        // the queue keeps the update until it can run, on its lanes if it has any
+        [queue enqueueBlock:deliver forTopicPath:topicPath priority:[self priorityOfTopicPath:topicPath]];
+    }
+    else if (lanes)
+    {
+        [lanes dispatchForTopicPath:topicPath block:deliver];
+    }
+    else
+    {
+        deliver();
+    }
+}
+
+// critical if any critical selector selects the topic
+- (DiffusionSubscriptionPriority)priorityOfTopicPath:(NSString *)topicPath
+{
+    if (!self.criticalSelectorMatcher)
+    {
+        self.criticalSelectorMatcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:[self.subscriptions selectorsWithPriority:DiffusionSubscriptionPriorityCritical]];
+    }
+    return [self.criticalSelectorMatcher anySelectorMatchesTopicPath:topicPath] ? DiffusionSubscriptionPriorityCritical : DiffusionSubscriptionPriorityNormal;
 }
 
 - (void)diffusionStream:(nonnull PTDiffusionStream *)stream didFetchTopicPath:(nonnull NSString *)topicPath content:(nonnull PTDiffusionContent *)content {
-    NSLog(@"\t\%@: Fetch result: %@ = %@", self.LogHeader, topicPath, content);
+    DiffusionLogDebug(@"\t\%@: Fetch result: %@ = %@", self.LogHeader, topicPath, content);
 }
 
 - (void)diffusionStream:(nonnull PTDiffusionStream *)stream didReceiveError:(nonnull NSError *)error fromSessionId:(nonnull PTDiffusionSessionId *)sessionId {
-    NSLog(@"\t\%@: Session error: %@", self.LogHeader, error);
+    DiffusionLogError(@"\t\%@: Session error: %@", self.LogHeader, error);
 }
 
 @end
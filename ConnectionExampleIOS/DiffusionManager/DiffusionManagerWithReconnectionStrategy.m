@@ -8,15 +8,87 @@
 
 #import "DiffusionManagerWithReconnectionStrategy.h"
 
+@import Network;
+
 #import "BackOffReconnectionStrategy.h"
+#import "CircuitBreakerReconnectionStrategy.h"
+#import "DiffusionTimerWheel.h"
 
 @implementation DiffusionManagerWithReconnectionStrategy
 
+static const NSTimeInterval _ProbeTimeout = 5.0;
+// how long a session may try to reconnect. set explicitly: the breaker holds attempts for a probe interval, and an
+// attempt that could only start after the timeout is aborted, so the timeout must leave room for several probes
+static const NSTimeInterval _ReconnectionTimeout = 300.0;
+static const NSTimeInterval _ProbeInterval = 20.0;
+
+// a TCP handshake with the server, much cheaper than a session handshake
+static void _ProbeServer(NSURL *url, DiffusionTimerWheel *timerWheel, void (^completionHandler)(BOOL reachable))
+{
+    if (!url.host)
+    {
+        completionHandler(YES);
+        return;
+    }
+    NSString *const port = url.port ? url.port.stringValue : ([url.scheme isEqualToString:@"wss"] ? @"443" : @"80");
+    nw_endpoint_t const endpoint = nw_endpoint_create_host(url.host.UTF8String, port.UTF8String);
+    nw_parameters_t const parameters = nw_parameters_create_secure_tcp(NW_PARAMETERS_DISABLE_PROTOCOL, NW_PARAMETERS_DEFAULT_CONFIGURATION);
+    nw_connection_t const connection = nw_connection_create(endpoint, parameters);
+
+    __block BOOL finished = NO;
+    __block id<NSObject> timeout = nil;
+    void (^const finish)(BOOL) = ^(BOOL reachable) {
+        if (finished)
+        {
+            return;
+        }
+        finished = YES;
+        [timerWheel cancelTimer:timeout];
+        // the handler holds the connection, let go of it
+        nw_connection_set_state_changed_handler(connection, NULL);
+        nw_connection_cancel(connection);
+        completionHandler(reachable);
+    };
+    nw_connection_set_queue(connection, dispatch_get_main_queue());
+    nw_connection_set_state_changed_handler(connection, ^(nw_connection_state_t state, nw_error_t error) {
+        if (state == nw_connection_state_ready)
+        {
+            finish(YES);
+        }
+        else if (state == nw_connection_state_waiting || state == nw_connection_state_failed)
+        {
+            finish(NO);
+        }
+    });
+    nw_connection_start(connection);
+    // the wheel fires on the main queue as well
+    timeout = [timerWheel scheduleAfterDelay:_ProbeTimeout leeway:_ProbeTimeout * 0.1 block:^{
+        finish(NO);
+    }];
+}
+
 
 - (PTDiffusionSessionConfiguration *)sessionConfiguration
 {
-    PTDiffusionMutableSessionConfiguration *config = [[[PTDiffusionSessionConfiguration alloc] initWithPrincipal:nil credentials:nil] mutableCopy];
-    config.reconnectionStrategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    PTDiffusionMutableSessionConfiguration *config = [[super sessionConfiguration] mutableCopy];
+    config.reconnectionTimeout = @(_ReconnectionTimeout);
+    BackOffReconnectionStrategy *const backOff = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    // a server restart drops every client at once. jittered delays keep them from all coming back at once
+    backOff.mode = BackOffModeDecorrelatedJitter;
+    backOff.health = self.connectionHealth;
+    // reconnection delays share the wakeups of the other timers of the manager
+    backOff.scheduler = self.timerWheel;
+
+    // once the server is clearly down, only a cheap probe now and then until it is back
+    CircuitBreakerReconnectionStrategy *const strategy = [[CircuitBreakerReconnectionStrategy alloc] initWithBackOffStrategy:backOff];
+    DiffusionTimerWheel *const timerWheel = self.timerWheel;
+    strategy.scheduler = timerWheel;
+    strategy.probeInterval = _ProbeInterval;
+    __weak typeof(self) weakSelf = self;
+    strategy.probe = ^(void (^completionHandler)(BOOL reachable)) {
+        _ProbeServer(weakSelf.url, timerWheel, completionHandler);
+    };
+    config.reconnectionStrategy = strategy;
     
     return config;
 }
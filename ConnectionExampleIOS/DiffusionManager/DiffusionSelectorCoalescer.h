@@ -0,0 +1,51 @@
+//
+//  DiffusionSelectorCoalescer.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 22/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface DiffusionSelectorChanges : NSObject
+
+// selectors that became part of the covering set and must be subscribed
+@property(nonatomic, readonly) NSArray<NSString *> *added;
+// selectors that left the covering set, either removed or now covered by a wider one
+@property(nonatomic, readonly) NSArray<NSString *> *removed;
+
+@property(nonatomic, readonly, getter=isEmpty) BOOL empty;
+
+@end
+
+/**
+
+    Keeps the minimal set of selectors that selects the same topics as all the active ones.
+
+    Path selectors (">A/B", ">A/B/" for the descendants of A/B and ">A/B//" for A/B and its descendants) are compared
+    segment by segment, so ">Demos//" covers ">Demos/Sportsbook/Football/England//" and only the former is sent to the
+    server. Split path, full path and selector set expressions cannot be compared that way and are only deduplicated.
+
+    When a covering selector goes away, the selectors it was hiding come back into the covering set.
+
+ */
+@interface DiffusionSelectorCoalescer : NSObject
+
+// the current covering set, in the order the selectors were first seen
+@property(nonatomic, readonly) NSArray<NSString *> *effectiveSelectors;
+
+- (DiffusionSelectorChanges *)updateWithSelectors:(NSArray<NSString *> *)selectors;
+
+// the member of the covering set selecting every topic the given selector does, if any other than itself
+- (nullable NSString *)selectorCovering:(NSString *)selector;
+
++ (NSArray<NSString *> *)coveringSetOfSelectors:(NSArray<NSString *> *)selectors;
++ (BOOL)selector:(NSString *)selector covers:(NSString *)other;
++ (BOOL)isPathSelector:(NSString *)selector;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,224 @@
+//
+//  DiffusionSelectorCoalescer.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 22/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionSelectorCoalescer.h"
+
+#import "DiffusionParsedTopicSelector.h"
+
+@implementation DiffusionSelectorChanges
+
+- (instancetype)initWithAdded:(NSArray<NSString *> *)added removed:(NSArray<NSString *> *)removed
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _added = [added copy];
+    _removed = [removed copy];
+
+    return self;
+}
+
+- (BOOL)isEmpty
+{
+    return _added.count == 0 && _removed.count == 0;
+}
+
+@end
+
+
+@implementation DiffusionSelectorCoalescer
+{
+    NSArray<NSString *> *_effectiveSelectors;
+    // base path -> the effective selector with the widest qualifier on it, for "/" and "//" selectors only
+    NSDictionary<NSString *, NSString *> *_effectiveWide;
+}
+
+@synthesize effectiveSelectors = _effectiveSelectors;
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _effectiveSelectors = @[];
+    _effectiveWide = @{};
+
+    return self;
+}
+
+
+- (DiffusionSelectorChanges *)updateWithSelectors:(NSArray<NSString *> *)selectors
+{
+    NSArray<NSString *> *const previous = _effectiveSelectors;
+    NSArray<NSString *> *const current = [DiffusionSelectorCoalescer coveringSetOfSelectors:selectors];
+
+    NSSet<NSString *> *const previousSet = [NSSet setWithArray:previous];
+    NSSet<NSString *> *const currentSet = [NSSet setWithArray:current];
+    NSMutableArray<NSString *> *const added = [NSMutableArray array];
+    NSMutableArray<NSString *> *const removed = [NSMutableArray array];
+    for (NSString *selector in current)
+    {
+        if (![previousSet containsObject:selector])
+        {
+            [added addObject:selector];
+        }
+    }
+    for (NSString *selector in previous)
+    {
+        if (![currentSet containsObject:selector])
+        {
+            [removed addObject:selector];
+        }
+    }
+
+    NSMutableDictionary<NSString *, NSString *> *const wide = [NSMutableDictionary dictionary];
+    for (NSString *selector in current)
+    {
+        DiffusionParsedTopicSelector *const parsed = [DiffusionParsedTopicSelector parsePath:selector];
+        if (parsed && parsed.qualifier != DiffusionPathQualifierNone)
+        {
+            DiffusionParsedTopicSelector *const existing = wide[parsed.base] ? [DiffusionParsedTopicSelector parsePath:wide[parsed.base]] : nil;
+            if (!existing || existing.qualifier < parsed.qualifier)
+            {
+                wide[parsed.base] = selector;
+            }
+        }
+    }
+    _effectiveSelectors = current;
+    _effectiveWide = wide;
+
+    return [[DiffusionSelectorChanges alloc] initWithAdded:added removed:removed];
+}
+
+- (nullable NSString *)selectorCovering:(NSString *)selector
+{
+    DiffusionParsedTopicSelector *const parsed = [DiffusionParsedTopicSelector parsePath:selector];
+    if (!parsed)
+    {
+        // only ever deduplicated, nothing else can cover it
+        return nil;
+    }
+
+    // widest first: the closest ancestor to the root is the one that stays in the covering set
+    NSMutableString *const prefix = [NSMutableString string];
+    for (NSUInteger i = 0; i < parsed.segments.count; i++)
+    {
+        NSString *const covering = _effectiveWide[prefix];
+        if (covering)
+        {
+            return covering;
+        }
+        if (i > 0)
+        {
+            [prefix appendString:@"/"];
+        }
+        [prefix appendString:parsed.segments[i]];
+    }
+
+    NSString *const same = _effectiveWide[parsed.base];
+    if (same && ![same isEqualToString:selector] && [DiffusionSelectorCoalescer selector:same covers:selector])
+    {
+        return same;
+    }
+    return nil;
+}
+
+
+#pragma mark - covering
+
++ (BOOL)isPathSelector:(NSString *)selector
+{
+    return [DiffusionParsedTopicSelector parsePath:selector] != nil;
+}
+
++ (BOOL)isPath:(DiffusionParsedTopicSelector *)parsed coveredByWide:(NSDictionary<NSString *, NSNumber *> *)wide
+{
+    if (wide[parsed.base].integerValue == DiffusionPathQualifierPathAndDescendants
+        && parsed.qualifier != DiffusionPathQualifierPathAndDescendants)
+    {
+        return YES;
+    }
+
+    // every proper ancestor, starting from the root
+    NSMutableString *const prefix = [NSMutableString string];
+    for (NSUInteger i = 0; i < parsed.segments.count; i++)
+    {
+        if (wide[prefix])
+        {
+            return YES;
+        }
+        if (i > 0)
+        {
+            [prefix appendString:@"/"];
+        }
+        [prefix appendString:parsed.segments[i]];
+    }
+    return NO;
+}
+
++ (NSArray<NSString *> *)coveringSetOfSelectors:(NSArray<NSString *> *)selectors
+{
+    NSMutableArray *const parsed = [NSMutableArray arrayWithCapacity:selectors.count];
+    // base path -> widest qualifier among the "/" and "//" selectors on it
+    NSMutableDictionary<NSString *, NSNumber *> *const wide = [NSMutableDictionary dictionary];
+    for (NSString *selector in selectors)
+    {
+        DiffusionParsedTopicSelector *const path = [DiffusionParsedTopicSelector parsePath:selector];
+        [parsed addObject:path ?: [NSNull null]];
+        if (path && path.qualifier != DiffusionPathQualifierNone && wide[path.base].integerValue < path.qualifier)
+        {
+            wide[path.base] = @(path.qualifier);
+        }
+    }
+
+    NSMutableArray<NSString *> *const covering = [NSMutableArray arrayWithCapacity:selectors.count];
+    NSMutableSet<NSString *> *const seen = [NSMutableSet setWithCapacity:selectors.count];
+    [selectors enumerateObjectsUsingBlock:^(NSString *selector, NSUInteger i, BOOL *stop) {
+        DiffusionParsedTopicSelector *const path = parsed[i] == [NSNull null] ? nil : parsed[i];
+        NSString *const key = path ? path.canonical : selector;
+        if ([seen containsObject:key])
+        {
+            return;
+        }
+        if (path && [DiffusionSelectorCoalescer isPath:path coveredByWide:wide])
+        {
+            return;
+        }
+        [seen addObject:key];
+        [covering addObject:selector];
+    }];
+    return covering;
+}
+
++ (BOOL)selector:(NSString *)selector covers:(NSString *)other
+{
+    DiffusionParsedTopicSelector *const a = [DiffusionParsedTopicSelector parsePath:selector];
+    DiffusionParsedTopicSelector *const b = [DiffusionParsedTopicSelector parsePath:other];
+    if (!a || !b)
+    {
+        return [selector isEqualToString:other];
+    }
+
+    if ([a.base isEqualToString:b.base])
+    {
+        return a.qualifier == DiffusionPathQualifierPathAndDescendants || a.qualifier == b.qualifier;
+    }
+
+    if (a.qualifier == DiffusionPathQualifierNone || a.segments.count >= b.segments.count)
+    {
+        return NO;
+    }
+    return [[b.segments subarrayWithRange:NSMakeRange(0, a.segments.count)] isEqualToArray:a.segments];
+}
+
+@end
@@ -0,0 +1,66 @@
+//
+//  DiffusionSessionPool.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 20/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    A fixed set of sessions opened to the same URL.
+
+    Subscriptions are sharded across the sessions by a stable hash of the selector expression, so one hot branch
+    of the topic tree only fills the server queue of its own session.
+    Updates from every session are merged back into a single stream: the first session that delivers a topic owns
+    it, and updates for that topic arriving from any other session are dropped. As each session delivers in order,
+    this keeps the merged stream ordered per topic.
+    Selectors on different sessions can select the same topic, so the pool counts the sessions subscribed to each
+    topic: the topic is only gone once the last of them has unsubscribed.
+
+    The pool is not thread safe. Like the Diffusion delegate callbacks, it is expected to be used from the main queue.
+
+ */
+@interface DiffusionSessionPool : NSObject
+
+@property(nonatomic, readonly) NSArray<PTDiffusionSession *> *sessions;
+@property(nonatomic, readonly) NSUInteger shardCount;
+
+-(instancetype) initWithSessions:(NSArray<PTDiffusionSession *> *)sessions;
+-(instancetype) initWithShardCount:(NSUInteger)shardCount NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
++ (NSUInteger)shardForSelector:(NSString *)selector shardCount:(NSUInteger)shardCount;
+
+- (NSUInteger)shardForSelector:(NSString *)selector;
+- (PTDiffusionSession *)sessionForSelector:(NSString *)selector;
+
+// streams registered on a pooled session, so callbacks can be traced back to their shard
+- (void)registerStream:(PTDiffusionStream *)stream forShard:(NSUInteger)shard;
+- (NSUInteger)shardForStream:(PTDiffusionStream *)stream;
+
+// merging: YES when the update must be forwarded, NO when another shard already delivers this topic
+- (BOOL)acceptTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard;
+- (BOOL)acceptTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream;
+
+// subscriptions: YES for the first shard subscribed to the topic
+- (BOOL)retainTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard;
+- (BOOL)retainTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream;
+// unsubscriptions: YES when no shard is subscribed to the topic any more. a shard that owned the topic gives it up,
+// and another shard still subscribed takes over with its next update
+- (BOOL)releaseTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard;
+- (BOOL)releaseTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream;
+// number of shards subscribed to the topic
+- (NSUInteger)referenceCountOfTopicPath:(NSString *)topicPath;
+
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
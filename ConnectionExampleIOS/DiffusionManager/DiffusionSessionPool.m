@@ -0,0 +1,179 @@
+//
+//  DiffusionSessionPool.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 20/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionSessionPool.h"
+
+#import "DiffusionHash.h"
+
+@implementation DiffusionSessionPool
+{
+    NSMapTable<PTDiffusionStream *, NSNumber *> *_streamShards;
+    NSMutableDictionary<NSString *, NSNumber *> *_topicOwners;
+    // the shards subscribed to each topic
+    NSMutableDictionary<NSString *, NSMutableIndexSet *> *_topicShards;
+}
+
+@synthesize sessions = _sessions;
+@synthesize shardCount = _shardCount;
+
+
+-(instancetype) initWithSessions:(NSArray<PTDiffusionSession *> *)sessions
+{
+    self = [self initWithShardCount:sessions.count];
+    if (!self)
+    {
+        return nil;
+    }
+    _sessions = [sessions copy];
+
+    return self;
+}
+
+-(instancetype) initWithShardCount:(NSUInteger)shardCount
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _sessions = @[];
+    _shardCount = MAX(shardCount, (NSUInteger)1);
+    _streamShards = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality | NSPointerFunctionsStrongMemory
+                                          valueOptions:NSPointerFunctionsStrongMemory];
+    _topicOwners = [NSMutableDictionary dictionary];
+    _topicShards = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+
+#pragma mark - sharding
+
++ (NSUInteger)shardForSelector:(NSString *)selector shardCount:(NSUInteger)shardCount
+{
+    if (shardCount <= 1)
+    {
+        return 0;
+    }
+
+    // a selector must land on the same session every time it is replayed
+    return DiffusionHashString(selector) % shardCount;
+}
+
+- (NSUInteger)shardForSelector:(NSString *)selector
+{
+    return [DiffusionSessionPool shardForSelector:selector shardCount:_shardCount];
+}
+
+- (PTDiffusionSession *)sessionForSelector:(NSString *)selector
+{
+    return _sessions[[self shardForSelector:selector]];
+}
+
+
+#pragma mark - merging
+
+- (void)registerStream:(PTDiffusionStream *)stream forShard:(NSUInteger)shard
+{
+    [_streamShards setObject:@(shard) forKey:stream];
+}
+
+- (NSUInteger)shardForStream:(PTDiffusionStream *)stream
+{
+    return [_streamShards objectForKey:stream].unsignedIntegerValue;
+}
+
+- (BOOL)acceptTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard
+{
+    // a single session cannot deliver duplicates, skip the bookkeeping
+    if (_shardCount == 1)
+    {
+        return YES;
+    }
+
+    NSNumber *const owner = _topicOwners[topicPath];
+    if (!owner)
+    {
+        _topicOwners[topicPath] = @(shard);
+        return YES;
+    }
+    return owner.unsignedIntegerValue == shard;
+}
+
+- (BOOL)acceptTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream
+{
+    return [self acceptTopicPath:topicPath fromShard:[self shardForStream:stream]];
+}
+
+- (BOOL)retainTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard
+{
+    if (_shardCount == 1)
+    {
+        return YES;
+    }
+
+    NSMutableIndexSet *shards = _topicShards[topicPath];
+    if (!shards)
+    {
+        shards = [NSMutableIndexSet indexSet];
+        _topicShards[topicPath] = shards;
+    }
+    [shards addIndex:shard];
+    return shards.count == 1;
+}
+
+- (BOOL)retainTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream
+{
+    return [self retainTopicPath:topicPath fromShard:[self shardForStream:stream]];
+}
+
+- (BOOL)releaseTopicPath:(NSString *)topicPath fromShard:(NSUInteger)shard
+{
+    if (_shardCount == 1)
+    {
+        return YES;
+    }
+
+    NSNumber *const owner = _topicOwners[topicPath];
+    if (owner && owner.unsignedIntegerValue == shard)
+    {
+        [_topicOwners removeObjectForKey:topicPath];
+    }
+    NSMutableIndexSet *const shards = _topicShards[topicPath];
+    [shards removeIndex:shard];
+    if (shards.count)
+    {
+        return NO;
+    }
+    [_topicShards removeObjectForKey:topicPath];
+    return YES;
+}
+
+- (BOOL)releaseTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream
+{
+    return [self releaseTopicPath:topicPath fromShard:[self shardForStream:stream]];
+}
+
+- (NSUInteger)referenceCountOfTopicPath:(NSString *)topicPath
+{
+    return _topicShards[topicPath].count;
+}
+
+
+- (void)close
+{
+    for (PTDiffusionSession *session in _sessions)
+    {
+        [session close];
+    }
+    [_streamShards removeAllObjects];
+    [_topicOwners removeAllObjects];
+    [_topicShards removeAllObjects];
+}
+
+@end
@@ -0,0 +1,79 @@
+//
+//  DiffusionSubscriptionBatcher.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 23/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionScheduler.h"
+#import "DiffusionSubscriptionRegistry.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^DiffusionSubscriptionCompletionHandler)(NSError * _Nullable error);
+
+@interface DiffusionSubscriptionIntent : NSObject
+
+@property(nonatomic, readonly) NSString *selector;
+@property(nonatomic, readonly, getter=isSubscribe) BOOL subscribe;
+@property(nonatomic, readonly) DiffusionSubscriptionPriority priority;
+// references to add to the selector, or to release for an unsubscribe
+@property(nonatomic, readonly) NSUInteger referenceCount;
+// every caller that asked for the same change within the window
+@property(nonatomic, readonly) NSArray<DiffusionSubscriptionCompletionHandler> *completionHandlers;
+
+@end
+
+/**
+
+    Collects subscribe and unsubscribe intents for a short window before they are sent.
+
+    Intents for the same selector inside the window fold into one that adds or releases the difference in references
+    (see DiffusionSubscriptionRegistry). An unsubscribe never releases more references than the selector holds. When
+    the intents balance out, e.g. a subscribe and an unsubscribe, nothing reaches the server and every caller is
+    completed straight away. Otherwise every caller is completed with the folded intent. What is left is handed over
+    in one flush, so that the manager can send it as combined requests.
+
+    With a window of 0 (the default) every intent is flushed as soon as it is added.
+    Expected to be used from the queue its scheduler runs the window timer on, the main queue by default.
+
+ */
+@interface DiffusionSubscriptionBatcher : NSObject
+
+@property(nonatomic) NSTimeInterval window;
+// where the window timer runs (default: the main queue)
+@property(nonatomic) id<DiffusionScheduler> scheduler;
+
+// references the selector holds, not counting the intents still in the window. without it, no selector is taken to
+// hold any
+@property(nonatomic, copy, nullable) NSUInteger (^referenceCountHandler)(NSString *selector);
+// called with the surviving intents, in the order their selectors were first seen
+@property(nonatomic, copy, nullable) void (^flushHandler)(NSArray<DiffusionSubscriptionIntent *> *intents);
+
+// counters
+@property(nonatomic, readonly) NSUInteger receivedIntents;
+@property(nonatomic, readonly) NSUInteger cancelledIntents;
+@property(nonatomic, readonly) NSUInteger flushes;
+@property(nonatomic, readonly) NSUInteger sentRequests;
+// requests the server did not see, compared with sending one request per intent
+@property(nonatomic, readonly) NSUInteger savedRequests;
+
+@property(nonatomic, readonly) NSUInteger pendingCount;
+
+- (void)addSubscribe:(NSString *)selector
+            priority:(DiffusionSubscriptionPriority)priority
+   completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler;
+- (void)addUnsubscribe:(NSString *)selector
+     completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler;
+
+- (void)flush;
+
+// the flush handler reports how many requests it actually sent
+- (void)noteSentRequests:(NSUInteger)count;
+
+@end
+
+NS_ASSUME_NONNULL_END
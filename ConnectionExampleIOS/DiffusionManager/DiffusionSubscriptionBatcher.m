@@ -0,0 +1,212 @@
+//
+//  DiffusionSubscriptionBatcher.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 23/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionSubscriptionBatcher.h"
+
+@interface DiffusionSubscriptionIntent ()
+
+// number of intents folded into this one
+@property(nonatomic, readonly) NSUInteger intentCount;
+// as many references added as released
+@property(nonatomic, readonly, getter=isBalanced) BOOL balanced;
+
+@end
+
+@implementation DiffusionSubscriptionIntent
+{
+    NSMutableArray<DiffusionSubscriptionCompletionHandler> *_handlers;
+    // references of the selector before the window, and once the intents so far are applied
+    NSUInteger _startCount;
+    NSUInteger _count;
+}
+
+- (instancetype)initWithSelector:(NSString *)selector referenceCount:(NSUInteger)referenceCount
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _selector = [selector copy];
+    _startCount = referenceCount;
+    _count = referenceCount;
+    _priority = DiffusionSubscriptionPriorityNormal;
+    _handlers = [NSMutableArray array];
+
+    return self;
+}
+
+- (BOOL)isSubscribe
+{
+    return _count > _startCount;
+}
+
+- (NSUInteger)referenceCount
+{
+    return _count > _startCount ? _count - _startCount : _startCount - _count;
+}
+
+- (BOOL)isBalanced
+{
+    return _count == _startCount;
+}
+
+- (NSArray<DiffusionSubscriptionCompletionHandler> *)completionHandlers
+{
+    return _handlers;
+}
+
+- (void)mergeSubscribe:(BOOL)subscribe priority:(DiffusionSubscriptionPriority)priority completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    _intentCount++;
+    if (subscribe)
+    {
+        _count++;
+        _priority = MAX(_priority, priority);
+    }
+    else if (_count)
+    {
+        // an unsubscribe of a selector holding no references changes nothing
+        _count--;
+    }
+    if (completionHandler)
+    {
+        [_handlers addObject:[completionHandler copy]];
+    }
+}
+
+@end
+
+
+@implementation DiffusionSubscriptionBatcher
+{
+    NSMutableOrderedSet<NSString *> *_order;
+    NSMutableDictionary<NSString *, DiffusionSubscriptionIntent *> *_pending;
+    BOOL _flushScheduled;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _order = [NSMutableOrderedSet orderedSet];
+    _pending = [NSMutableDictionary dictionary];
+    _scheduler = DiffusionDispatchScheduler.mainQueueScheduler;
+
+    return self;
+}
+
+
+- (NSUInteger)pendingCount
+{
+    return _pending.count;
+}
+
+- (NSUInteger)savedRequests
+{
+    return _receivedIntents > _sentRequests ? _receivedIntents - _sentRequests : 0;
+}
+
+- (void)addSubscribe:(NSString *)selector
+            priority:(DiffusionSubscriptionPriority)priority
+   completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    [self addIntentForSelector:selector subscribe:YES priority:priority completionHandler:completionHandler];
+}
+
+- (void)addUnsubscribe:(NSString *)selector
+     completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    [self addIntentForSelector:selector subscribe:NO priority:DiffusionSubscriptionPriorityNormal completionHandler:completionHandler];
+}
+
+- (void)addIntentForSelector:(NSString *)selector
+                   subscribe:(BOOL)subscribe
+                    priority:(DiffusionSubscriptionPriority)priority
+           completionHandler:(nullable DiffusionSubscriptionCompletionHandler)completionHandler
+{
+    _receivedIntents++;
+
+    DiffusionSubscriptionIntent *intent = _pending[selector];
+    if (!intent)
+    {
+        const NSUInteger referenceCount = _referenceCountHandler ? _referenceCountHandler(selector) : 0;
+        intent = [[DiffusionSubscriptionIntent alloc] initWithSelector:selector referenceCount:referenceCount];
+        _pending[intent.selector] = intent;
+        [_order addObject:intent.selector];
+    }
+    [intent mergeSubscribe:subscribe priority:priority completionHandler:completionHandler];
+
+    if (intent.balanced)
+    {
+        // the window leaves the selector exactly as it was, and its callers have nothing left to wait for
+        [_pending removeObjectForKey:selector];
+        [_order removeObject:selector];
+        for (DiffusionSubscriptionCompletionHandler handler in intent.completionHandlers)
+        {
+            handler(nil);
+        }
+        _cancelledIntents += intent.intentCount;
+        return;
+    }
+
+    [self scheduleFlush];
+}
+
+- (void)scheduleFlush
+{
+    if (_window <= 0)
+    {
+        [self flush];
+        return;
+    }
+    if (_flushScheduled)
+    {
+        return;
+    }
+    _flushScheduled = YES;
+
+    __weak DiffusionSubscriptionBatcher *weakSelf = self;
+    [_scheduler scheduleAfterDelay:_window block:^{
+        [weakSelf flush];
+    }];
+}
+
+- (void)flush
+{
+    _flushScheduled = NO;
+    if (!_pending.count)
+    {
+        return;
+    }
+
+    NSMutableArray<DiffusionSubscriptionIntent *> *const intents = [NSMutableArray arrayWithCapacity:_order.count];
+    for (NSString *selector in _order)
+    {
+        [intents addObject:_pending[selector]];
+    }
+    [_pending removeAllObjects];
+    [_order removeAllObjects];
+    _flushes++;
+
+    if (_flushHandler)
+    {
+        _flushHandler(intents);
+    }
+}
+
+- (void)noteSentRequests:(NSUInteger)count
+{
+    _sentRequests += count;
+}
+
+@end
@@ -0,0 +1,54 @@
+//
+//  DiffusionSubscriptionRegistry.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 21/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, DiffusionSubscriptionPriority) {
+    DiffusionSubscriptionPriorityNormal = 0,
+    // replayed ahead of everything else when a session is replaced
+    DiffusionSubscriptionPriorityCritical = 1,
+};
+
+/**
+
+    Durable record of the selectors the application subscribed to through the DiffusionManager.
+
+    The server forgets every subscription when a session is closed. The registry outlives sessions, so that a
+    replacement session can be given all the active selectors back in a couple of requests: one combined selector for
+    the critical subscriptions, then one for the rest.
+    The registry holds what the application asked for. What is sent to the server is its covering set
+    (see DiffusionSelectorCoalescer).
+    Parts of an application subscribe to the same selector independently, so every subscription holds a reference to
+    its selector and every unsubscription releases one: a selector stays active until the last of them is released.
+
+ */
+@interface DiffusionSubscriptionRegistry : NSObject
+
+@property(nonatomic, readonly) NSUInteger count;
+// active selectors in the order they were first subscribed
+@property(nonatomic, readonly) NSArray<NSString *> *selectors;
+
+// adds a reference. YES if the selector was not active before. subscribing again keeps the highest priority
+- (BOOL)addSelector:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority;
+// releases a reference. YES if it was the last one and the selector is no longer active
+- (BOOL)removeSelector:(NSString *)selector;
+- (BOOL)containsSelector:(NSString *)selector;
+// 0 for a selector that is not active
+- (NSUInteger)referenceCountOfSelector:(NSString *)selector;
+- (DiffusionSubscriptionPriority)priorityOfSelector:(NSString *)selector;
+
+- (NSArray<NSString *> *)selectorsWithPriority:(DiffusionSubscriptionPriority)priority;
+
+// a single expression selecting everything any of the selectors does
++ (NSString *)expressionForSelectors:(NSArray<NSString *> *)selectors;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,122 @@
+//
+//  DiffusionSubscriptionRegistry.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 21/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionSubscriptionRegistry.h"
+
+@import Diffusion;
+
+@implementation DiffusionSubscriptionRegistry
+{
+    // insertion order is kept so replays happen in the order the application subscribed
+    NSMutableOrderedSet<NSString *> *_selectors;
+    NSMutableDictionary<NSString *, NSNumber *> *_priorities;
+    NSMutableDictionary<NSString *, NSNumber *> *_referenceCounts;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _selectors = [NSMutableOrderedSet orderedSet];
+    _priorities = [NSMutableDictionary dictionary];
+    _referenceCounts = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+
+- (NSUInteger)count
+{
+    return _selectors.count;
+}
+
+- (NSArray<NSString *> *)selectors
+{
+    return _selectors.array;
+}
+
+- (BOOL)addSelector:(NSString *)selector priority:(DiffusionSubscriptionPriority)priority
+{
+    NSNumber *const existing = _priorities[selector];
+    if (existing)
+    {
+        if (existing.integerValue < priority)
+        {
+            _priorities[selector] = @(priority);
+        }
+        _referenceCounts[selector] = @(_referenceCounts[selector].unsignedIntegerValue + 1);
+        return NO;
+    }
+
+    NSString *const key = [selector copy];
+    [_selectors addObject:key];
+    _priorities[key] = @(priority);
+    _referenceCounts[key] = @1;
+    return YES;
+}
+
+- (BOOL)removeSelector:(NSString *)selector
+{
+    const NSUInteger count = _referenceCounts[selector].unsignedIntegerValue;
+    if (count > 1)
+    {
+        _referenceCounts[selector] = @(count - 1);
+        return NO;
+    }
+    if (!count)
+    {
+        return NO;
+    }
+    [_selectors removeObject:selector];
+    [_priorities removeObjectForKey:selector];
+    [_referenceCounts removeObjectForKey:selector];
+    return YES;
+}
+
+- (NSUInteger)referenceCountOfSelector:(NSString *)selector
+{
+    return _referenceCounts[selector].unsignedIntegerValue;
+}
+
+- (BOOL)containsSelector:(NSString *)selector
+{
+    return _priorities[selector] != nil;
+}
+
+- (DiffusionSubscriptionPriority)priorityOfSelector:(NSString *)selector
+{
+    return (DiffusionSubscriptionPriority)_priorities[selector].integerValue;
+}
+
+- (NSArray<NSString *> *)selectorsWithPriority:(DiffusionSubscriptionPriority)priority
+{
+    NSMutableArray<NSString *> *const selectors = [NSMutableArray array];
+    for (NSString *selector in _selectors)
+    {
+        if (_priorities[selector].integerValue == priority)
+        {
+            [selectors addObject:selector];
+        }
+    }
+    return selectors;
+}
+
++ (NSString *)expressionForSelectors:(NSArray<NSString *> *)selectors
+{
+    if (selectors.count == 1)
+    {
+        return selectors.firstObject;
+    }
+    return [PTDiffusionTopicSelector topicSelectorWithAnyExpression:selectors].expression;
+}
+
+@end
@@ -0,0 +1,84 @@
+//
+//  DiffusionInboundQueue.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionSubscriptionRegistry.h"
+
+@class DiffusionProcessingLanes;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// what happens to an update arriving when the queue is full
+typedef NS_ENUM(NSInteger, DiffusionInboundQueuePolicy) {
+    // the caller waits for room. the backlog moves back into the session, up to its own queue limits. not for callers
+    // on the main queue, which would stop the application while they wait
+    DiffusionInboundQueuePolicyBlock = 0,
+    // the update that waited longest is dropped
+    DiffusionInboundQueuePolicyDropOldest = 1,
+    // an update replaces the one of the same topic still queued, whether the queue is full or not.
+    // when it is full and the topic has nothing queued, the oldest update is dropped
+    DiffusionInboundQueuePolicyConflate = 2,
+    // the oldest update of the lowest priority is dropped, which may be the one arriving
+    DiffusionInboundQueuePolicyDropByPriority = 3,
+};
+
+/**
+
+    A bounded queue between the Diffusion callbacks and the application handlers.
+
+    Updates are run one at a time, in the order they were queued, on a serial queue of their own. When the handlers
+    cannot keep up, the policy decides between slowing the producer down and dropping updates, instead of letting
+    the backlog grow without limit. Every drop is counted.
+
+    With processing lanes, updates are run on the lane of their topic instead, at most one per lane at a time. An
+    update stays in the queue until its lane is free, so the capacity, the policy and the priorities apply to
+    everything waiting to run, whichever lane it waits for. Updates of a topic still run in the order they were queued.
+
+    Updates can be queued from any thread, but with the blocking policy neither from the main queue nor from a handler
+    run by the queue itself.
+
+ */
+@interface DiffusionInboundQueue : NSObject
+
+@property(nonatomic, readonly) NSUInteger capacity;
+@property(nonatomic, readonly) DiffusionInboundQueuePolicy policy;
+@property(nonatomic, readonly, nullable) DiffusionProcessingLanes *processingLanes;
+
+// metrics
+@property(nonatomic, readonly) NSUInteger depth;
+@property(nonatomic, readonly) NSUInteger maximumDepth;
+@property(nonatomic, readonly) NSUInteger enqueuedCount;
+@property(nonatomic, readonly) NSUInteger deliveredCount;
+@property(nonatomic, readonly) NSUInteger droppedCount;
+// updates replaced by a newer one of the same topic
+@property(nonatomic, readonly) NSUInteger conflatedCount;
+// times a caller had to wait for room, and for how long in total (seconds)
+@property(nonatomic, readonly) NSUInteger blockedCount;
+@property(nonatomic, readonly) NSTimeInterval blockedTime;
+// from being queued to being run, for the updates that were run (seconds)
+@property(nonatomic, readonly) NSTimeInterval averageTimeInQueue;
+@property(nonatomic, readonly) NSTimeInterval maximumTimeInQueue;
+
+-(instancetype) initWithCapacity:(NSUInteger)capacity policy:(DiffusionInboundQueuePolicy)policy;
+-(instancetype) initWithCapacity:(NSUInteger)capacity
+                          policy:(DiffusionInboundQueuePolicy)policy
+                 processingLanes:(nullable DiffusionProcessingLanes *)processingLanes NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// NO if the block was dropped on arrival
+- (BOOL)enqueueBlock:(dispatch_block_t)block
+        forTopicPath:(NSString *)topicPath
+            priority:(DiffusionSubscriptionPriority)priority;
+
+// blocks until everything queued so far has run. meant for tests and shutdown
+- (void)drain;
+
+@end
+
+NS_ASSUME_NONNULL_END
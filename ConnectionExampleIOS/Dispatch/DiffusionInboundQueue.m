@@ -0,0 +1,315 @@
+//
+//  DiffusionInboundQueue.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionInboundQueue.h"
+
+#import <time.h>
+
+#import "DiffusionProcessingLanes.h"
+
+static uint64_t _Now(void)
+{
+    return clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+}
+
+
+@interface DiffusionInboundEntry : NSObject
+
+@property(nonatomic) NSString *topicPath;
+@property(nonatomic) DiffusionSubscriptionPriority priority;
+@property(nonatomic) dispatch_block_t block;
+@property(nonatomic) uint64_t enqueuedAt;
+// with processing lanes
+@property(nonatomic) NSUInteger lane;
+
+@end
+
+@implementation DiffusionInboundEntry
+
+@end
+
+
+@implementation DiffusionInboundQueue
+{
+    // guards everything below, and wakes up callers waiting for room or for the queue to drain
+    NSCondition *_condition;
+    NSMutableArray<DiffusionInboundEntry *> *_entries;
+    // the queued entry of each topic, with the conflating policy
+    NSMutableDictionary<NSString *, DiffusionInboundEntry *> *_entriesByTopic;
+    // without processing lanes
+    dispatch_queue_t _queue;
+    BOOL _consuming;
+    // with processing lanes, the lanes running an update
+    NSMutableIndexSet *_busyLanes;
+    NSUInteger _runningCount;
+    uint64_t _totalTimeInQueue;
+    uint64_t _maximumTimeInQueue;
+    uint64_t _blockedTime;
+}
+
+
+-(instancetype) initWithCapacity:(NSUInteger)capacity policy:(DiffusionInboundQueuePolicy)policy
+{
+    return [self initWithCapacity:capacity policy:policy processingLanes:nil];
+}
+
+-(instancetype) initWithCapacity:(NSUInteger)capacity
+                          policy:(DiffusionInboundQueuePolicy)policy
+                 processingLanes:(nullable DiffusionProcessingLanes *)processingLanes
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _capacity = MAX(capacity, (NSUInteger)1);
+    _policy = policy;
+    _condition = [[NSCondition alloc] init];
+    _entries = [NSMutableArray arrayWithCapacity:_capacity];
+    if (policy == DiffusionInboundQueuePolicyConflate)
+    {
+        _entriesByTopic = [NSMutableDictionary dictionaryWithCapacity:_capacity];
+    }
+    _processingLanes = processingLanes;
+    if (processingLanes)
+    {
+        _busyLanes = [NSMutableIndexSet indexSet];
+    }
+    else
+    {
+        _queue = dispatch_queue_create("DiffusionInboundQueue", DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+
+#pragma mark - metrics
+
+- (NSUInteger)depth
+{
+    [_condition lock];
+    const NSUInteger depth = _entries.count;
+    [_condition unlock];
+    return depth;
+}
+
+- (NSTimeInterval)averageTimeInQueue
+{
+    [_condition lock];
+    const NSTimeInterval average = _deliveredCount ? _totalTimeInQueue / 1e9 / _deliveredCount : 0;
+    [_condition unlock];
+    return average;
+}
+
+- (NSTimeInterval)maximumTimeInQueue
+{
+    [_condition lock];
+    const NSTimeInterval maximum = _maximumTimeInQueue / 1e9;
+    [_condition unlock];
+    return maximum;
+}
+
+- (NSTimeInterval)blockedTime
+{
+    [_condition lock];
+    const NSTimeInterval blocked = _blockedTime / 1e9;
+    [_condition unlock];
+    return blocked;
+}
+
+
+#pragma mark - queueing
+
+- (BOOL)enqueueBlock:(dispatch_block_t)block
+        forTopicPath:(NSString *)topicPath
+            priority:(DiffusionSubscriptionPriority)priority
+{
+    [_condition lock];
+    _enqueuedCount++;
+
+    if (_entriesByTopic)
+    {
+        DiffusionInboundEntry *const queued = _entriesByTopic[topicPath];
+        if (queued)
+        {
+            // keeps its place in the queue and the time it was first queued
+            queued.block = block;
+            queued.priority = MAX(queued.priority, priority);
+            _conflatedCount++;
+            [_condition unlock];
+            return YES;
+        }
+    }
+
+    if (_entries.count >= _capacity && ![self makeRoomForPriority:priority])
+    {
+        _droppedCount++;
+        [_condition unlock];
+        return NO;
+    }
+
+    DiffusionInboundEntry *const entry = [[DiffusionInboundEntry alloc] init];
+    entry.topicPath = [topicPath copy];
+    entry.priority = priority;
+    entry.block = block;
+    entry.enqueuedAt = _Now();
+    entry.lane = [_processingLanes laneForTopicPath:entry.topicPath];
+    [_entries addObject:entry];
+    _entriesByTopic[entry.topicPath] = entry;
+    _maximumDepth = MAX(_maximumDepth, _entries.count);
+
+    if (_processingLanes)
+    {
+        [self runOnFreeLanes];
+    }
+    else if (!_consuming)
+    {
+        _consuming = YES;
+        dispatch_async(_queue, ^{
+            [self consume];
+        });
+    }
+    [_condition unlock];
+    return YES;
+}
+
+// called with the lock held on a full queue. NO if the arriving update is the one to drop
+- (BOOL)makeRoomForPriority:(DiffusionSubscriptionPriority)priority
+{
+    switch (_policy)
+    {
+        case DiffusionInboundQueuePolicyBlock:
+        {
+            NSAssert(!NSThread.isMainThread, @"DiffusionInboundQueue: the blocking policy would stop the main queue");
+            const uint64_t start = _Now();
+            _blockedCount++;
+            while (_entries.count >= _capacity)
+            {
+                [_condition wait];
+            }
+            _blockedTime += _Now() - start;
+            return YES;
+        }
+
+        case DiffusionInboundQueuePolicyDropOldest:
+        case DiffusionInboundQueuePolicyConflate:
+            [self dropEntryAtIndex:0];
+            return YES;
+
+        case DiffusionInboundQueuePolicyDropByPriority:
+        {
+            NSUInteger lowest = NSNotFound;
+            for (NSUInteger i = 0; i < _entries.count; i++)
+            {
+                if (lowest == NSNotFound || _entries[i].priority < _entries[lowest].priority)
+                {
+                    lowest = i;
+                    if (_entries[i].priority <= DiffusionSubscriptionPriorityNormal)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (_entries[lowest].priority > priority)
+            {
+                return NO;
+            }
+            [self dropEntryAtIndex:lowest];
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (void)dropEntryAtIndex:(NSUInteger)index
+{
+    DiffusionInboundEntry *const entry = _entries[index];
+    [_entries removeObjectAtIndex:index];
+    [_entriesByTopic removeObjectForKey:entry.topicPath];
+    _droppedCount++;
+}
+
+// called with the lock held. the entry leaves the queue to run
+- (DiffusionInboundEntry *)takeEntryAtIndex:(NSUInteger)index
+{
+    DiffusionInboundEntry *const entry = _entries[index];
+    [_entries removeObjectAtIndex:index];
+    if (_entriesByTopic[entry.topicPath] == entry)
+    {
+        [_entriesByTopic removeObjectForKey:entry.topicPath];
+    }
+    const uint64_t waited = _Now() - entry.enqueuedAt;
+    _totalTimeInQueue += waited;
+    _maximumTimeInQueue = MAX(_maximumTimeInQueue, waited);
+    _runningCount++;
+    // room for a blocked caller
+    [_condition broadcast];
+    return entry;
+}
+
+- (void)consume
+{
+    [_condition lock];
+    while (_entries.count)
+    {
+        DiffusionInboundEntry *const entry = [self takeEntryAtIndex:0];
+        [_condition unlock];
+
+        entry.block();
+
+        [_condition lock];
+        _runningCount--;
+        _deliveredCount++;
+    }
+    _consuming = NO;
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+// called with the lock held. hands the oldest update waiting for each free lane to it. an update runs once the one
+// before it on its lane has finished, so the rest of the backlog stays in the queue, under its capacity and policy
+- (void)runOnFreeLanes
+{
+    const NSUInteger laneCount = _processingLanes.laneCount;
+    NSUInteger index = 0;
+    while (index < _entries.count && _busyLanes.count < laneCount)
+    {
+        const NSUInteger lane = _entries[index].lane;
+        if ([_busyLanes containsIndex:lane])
+        {
+            index++;
+            continue;
+        }
+        [_busyLanes addIndex:lane];
+        DiffusionInboundEntry *const entry = [self takeEntryAtIndex:index];
+        [_processingLanes dispatchForTopicPath:entry.topicPath block:^{
+            entry.block();
+
+            [self->_condition lock];
+            [self->_busyLanes removeIndex:lane];
+            self->_runningCount--;
+            self->_deliveredCount++;
+            [self runOnFreeLanes];
+            [self->_condition broadcast];
+            [self->_condition unlock];
+        }];
+    }
+}
+
+- (void)drain
+{
+    [_condition lock];
+    while (_entries.count || _runningCount)
+    {
+        [_condition wait];
+    }
+    [_condition unlock];
+}
+
+@end
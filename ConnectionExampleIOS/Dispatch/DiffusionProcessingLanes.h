@@ -0,0 +1,44 @@
+//
+//  DiffusionProcessingLanes.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 24/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    A fixed pool of serial queues that topic updates are handed to, away from the queue Diffusion delivers on.
+
+    The lane of an update is chosen by a hash of its topic path, so every update of a topic runs on the same serial
+    queue and in the order it was received, while updates of unrelated topics are processed in parallel.
+
+    Can be used from any queue.
+
+ */
+@interface DiffusionProcessingLanes : NSObject
+
+@property(nonatomic, readonly) NSUInteger laneCount;
+// blocks handed over so far
+@property(nonatomic, readonly) NSUInteger dispatchedCount;
+
+// one lane per active core
++ (NSUInteger)defaultLaneCount;
++ (NSUInteger)laneForTopicPath:(NSString *)topicPath laneCount:(NSUInteger)laneCount;
+
+// init uses the default lane count
+-(instancetype) initWithLaneCount:(NSUInteger)laneCount NS_DESIGNATED_INITIALIZER;
+
+- (NSUInteger)laneForTopicPath:(NSString *)topicPath;
+- (void)dispatchForTopicPath:(NSString *)topicPath block:(dispatch_block_t)block;
+
+// blocks until everything dispatched so far has run. meant for tests and shutdown
+- (void)drain;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,91 @@
+//
+//  DiffusionProcessingLanes.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 24/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionProcessingLanes.h"
+
+#import <stdatomic.h>
+
+#import "DiffusionHash.h"
+
+@implementation DiffusionProcessingLanes
+{
+    NSArray<dispatch_queue_t> *_lanes;
+    atomic_ulong _dispatched;
+}
+
+@synthesize laneCount = _laneCount;
+
+
+-(instancetype) init
+{
+    return [self initWithLaneCount:[DiffusionProcessingLanes defaultLaneCount]];
+}
+
+-(instancetype) initWithLaneCount:(NSUInteger)laneCount
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _laneCount = MAX(laneCount, (NSUInteger)1);
+
+    NSMutableArray<dispatch_queue_t> *const lanes = [NSMutableArray arrayWithCapacity:_laneCount];
+    dispatch_queue_attr_t const attributes = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0);
+    for (NSUInteger i = 0; i < _laneCount; i++)
+    {
+        NSString *const label = [NSString stringWithFormat:@"DiffusionProcessingLanes.%lu", (unsigned long)i];
+        [lanes addObject:dispatch_queue_create(label.UTF8String, attributes)];
+    }
+    _lanes = lanes;
+    atomic_init(&_dispatched, 0);
+
+    return self;
+}
+
+
++ (NSUInteger)defaultLaneCount
+{
+    return MAX(NSProcessInfo.processInfo.activeProcessorCount, (NSUInteger)1);
+}
+
++ (NSUInteger)laneForTopicPath:(NSString *)topicPath laneCount:(NSUInteger)laneCount
+{
+    if (laneCount <= 1)
+    {
+        return 0;
+    }
+
+    return DiffusionHashString(topicPath) % laneCount;
+}
+
+- (NSUInteger)laneForTopicPath:(NSString *)topicPath
+{
+    return [DiffusionProcessingLanes laneForTopicPath:topicPath laneCount:_laneCount];
+}
+
+- (NSUInteger)dispatchedCount
+{
+    return atomic_load_explicit(&_dispatched, memory_order_relaxed);
+}
+
+- (void)dispatchForTopicPath:(NSString *)topicPath block:(dispatch_block_t)block
+{
+    atomic_fetch_add_explicit(&_dispatched, 1, memory_order_relaxed);
+    dispatch_async(_lanes[[self laneForTopicPath:topicPath]], block);
+}
+
+- (void)drain
+{
+    for (dispatch_queue_t lane in _lanes)
+    {
+        dispatch_sync(lane, ^{});
+    }
+}
+
+@end
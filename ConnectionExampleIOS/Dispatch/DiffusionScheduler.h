@@ -0,0 +1,60 @@
+//
+//  DiffusionScheduler.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// where timed work runs, and the clock its delays are measured on
+@protocol DiffusionScheduler <NSObject>
+
+// in seconds
+@property(nonatomic, readonly) NSTimeInterval currentTime;
+
+- (void)scheduleAfterDelay:(NSTimeInterval)delay block:(dispatch_block_t)block;
+
+@end
+
+// dispatch_after on a queue. its clock is the one dispatch_after waits on, CLOCK_UPTIME_RAW, which stops while the
+// device sleeps
+@interface DiffusionDispatchScheduler : NSObject <DiffusionScheduler>
+
+@property(nonatomic, readonly) dispatch_queue_t queue;
+
++ (instancetype)mainQueueScheduler;
+
+-(instancetype) initWithQueue:(dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+@end
+
+/**
+
+    A clock that only moves when told to, running the blocks due in time order, those due at the same time in the order
+    they were scheduled. Nothing waits for real time, so hours of timers run in moments. For tests and simulations.
+    Not thread safe: schedule and run from one thread.
+
+ */
+@interface DiffusionVirtualScheduler : NSObject <DiffusionScheduler>
+
+@property(nonatomic, readonly) NSUInteger pendingCount;
+@property(nonatomic, readonly) uint64_t executedCount;
+
+// the clock starts at 0
+-(instancetype) init;
+-(instancetype) initWithTime:(NSTimeInterval)time NS_DESIGNATED_INITIALIZER;
+
+// runs the next block due, moving the clock to its time. NO when nothing is scheduled
+- (BOOL)runNext;
+// runs every block due up to the time, including those they schedule, then moves the clock to the time
+- (void)runUntilTime:(NSTimeInterval)time;
+- (void)runUntilIdle;
+
+@end
+
+NS_ASSUME_NONNULL_END
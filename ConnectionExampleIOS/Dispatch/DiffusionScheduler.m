@@ -0,0 +1,197 @@
+//
+//  DiffusionScheduler.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionScheduler.h"
+
+@implementation DiffusionDispatchScheduler
+
+
++ (instancetype)mainQueueScheduler
+{
+    static DiffusionDispatchScheduler *scheduler;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        scheduler = [[DiffusionDispatchScheduler alloc] initWithQueue:dispatch_get_main_queue()];
+    });
+    return scheduler;
+}
+
+-(instancetype) initWithQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _queue = queue;
+
+    return self;
+}
+
+
+- (NSTimeInterval)currentTime
+{
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / (NSTimeInterval)NSEC_PER_SEC;
+}
+
+- (void)scheduleAfterDelay:(NSTimeInterval)delay block:(dispatch_block_t)block
+{
+    if (delay <= 0)
+    {
+        dispatch_async(_queue, block);
+        return;
+    }
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, block);
+}
+
+@end
+
+
+// a binary min-heap on (time, sequence). the block is retained by the heap
+typedef struct {
+    NSTimeInterval time;
+    uint64_t sequence;
+    void *block;
+} _VirtualEvent;
+
+static inline BOOL _Before(const _VirtualEvent *a, const _VirtualEvent *b)
+{
+    return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+}
+
+@implementation DiffusionVirtualScheduler
+{
+    NSTimeInterval _time;
+    _VirtualEvent *_events;
+    NSUInteger _count;
+    NSUInteger _capacity;
+    uint64_t _sequence;
+}
+
+
+-(instancetype) init
+{
+    return [self initWithTime:0];
+}
+
+-(instancetype) initWithTime:(NSTimeInterval)time
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _time = time;
+    _capacity = 64;
+    _events = malloc(_capacity * sizeof(_VirtualEvent));
+
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        CFRelease(_events[i].block);
+    }
+    free(_events);
+}
+
+
+- (NSTimeInterval)currentTime
+{
+    return _time;
+}
+
+- (NSUInteger)pendingCount
+{
+    return _count;
+}
+
+- (void)scheduleAfterDelay:(NSTimeInterval)delay block:(dispatch_block_t)block
+{
+    if (_count == _capacity)
+    {
+        _capacity *= 2;
+        _events = realloc(_events, _capacity * sizeof(_VirtualEvent));
+    }
+    _VirtualEvent event = {_time + MAX(delay, 0.0), _sequence++, (void *)CFBridgingRetain([block copy])};
+
+    // sift up
+    NSUInteger i = _count++;
+    while (i > 0)
+    {
+        const NSUInteger parent = (i - 1) / 2;
+        if (!_Before(&event, &_events[parent]))
+        {
+            break;
+        }
+        _events[i] = _events[parent];
+        i = parent;
+    }
+    _events[i] = event;
+}
+
+- (BOOL)runNext
+{
+    if (_count == 0)
+    {
+        return NO;
+    }
+    const _VirtualEvent next = _events[0];
+
+    // sift the last event down from the root
+    const _VirtualEvent last = _events[--_count];
+    NSUInteger i = 0;
+    for (;;)
+    {
+        NSUInteger child = 2 * i + 1;
+        if (child >= _count)
+        {
+            break;
+        }
+        if (child + 1 < _count && _Before(&_events[child + 1], &_events[child]))
+        {
+            child++;
+        }
+        if (!_Before(&_events[child], &last))
+        {
+            break;
+        }
+        _events[i] = _events[child];
+        i = child;
+    }
+    if (_count > 0)
+    {
+        _events[i] = last;
+    }
+
+    _time = MAX(_time, next.time);
+    _executedCount++;
+    dispatch_block_t const block = CFBridgingRelease(next.block);
+    block();
+    return YES;
+}
+
+- (void)runUntilTime:(NSTimeInterval)time
+{
+    while (_count > 0 && _events[0].time <= time)
+    {
+        [self runNext];
+    }
+    _time = MAX(_time, time);
+}
+
+- (void)runUntilIdle
+{
+    while ([self runNext])
+    {
+    }
+}
+
+@end
@@ -0,0 +1,44 @@
+//
+//  DiffusionTickSource.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^DiffusionTickHandler)(NSTimeInterval time);
+
+// something that calls back at a regular pace, e.g. once per screen refresh
+@protocol DiffusionTickSource <NSObject>
+
+// in seconds, on the same clock as the ticks
+@property(nonatomic, readonly) NSTimeInterval currentTime;
+
+- (void)startWithHandler:(DiffusionTickHandler)handler;
+- (void)stop;
+
+@end
+
+// ticks once per frame on the main queue
+@interface DiffusionDisplayLinkTickSource : NSObject <DiffusionTickSource>
+
+// 0 (the default) follows the refresh rate of the display
+@property(nonatomic) NSInteger preferredFramesPerSecond;
+
+@end
+
+// ticks when told to, at the time it is told. for tests and simulations
+@interface DiffusionManualTickSource : NSObject <DiffusionTickSource>
+
+@property(nonatomic) NSTimeInterval currentTime;
+
+// moves the clock to the time and ticks
+- (void)tickAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,78 @@
+//
+//  DiffusionTickSource.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTickSource.h"
+
+#import <QuartzCore/QuartzCore.h>
+
+@implementation DiffusionDisplayLinkTickSource
+{
+    CADisplayLink *_displayLink;
+    DiffusionTickHandler _handler;
+}
+
+
+- (NSTimeInterval)currentTime
+{
+    return CACurrentMediaTime();
+}
+
+- (void)startWithHandler:(DiffusionTickHandler)handler
+{
+    [self stop];
+    _handler = [handler copy];
+    // the display link retains its target, it is invalidated by stop
+    _displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(displayLinkDidFire:)];
+    _displayLink.preferredFramesPerSecond = _preferredFramesPerSecond;
+    [_displayLink addToRunLoop:NSRunLoop.mainRunLoop forMode:NSRunLoopCommonModes];
+}
+
+- (void)stop
+{
+    [_displayLink invalidate];
+    _displayLink = nil;
+    _handler = nil;
+}
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink
+{
+    if (_handler)
+    {
+        _handler(displayLink.timestamp);
+    }
+}
+
+@end
+
+
+@implementation DiffusionManualTickSource
+{
+    DiffusionTickHandler _handler;
+}
+
+
+- (void)startWithHandler:(DiffusionTickHandler)handler
+{
+    _handler = [handler copy];
+}
+
+- (void)stop
+{
+    _handler = nil;
+}
+
+- (void)tickAtTime:(NSTimeInterval)time
+{
+    _currentTime = time;
+    if (_handler)
+    {
+        _handler(time);
+    }
+}
+
+@end
@@ -0,0 +1,68 @@
+//
+//  DiffusionTimerWheel.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionScheduler.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    One timer for many: a hierarchical timing wheel behind a single dispatch timer.
+
+    Timers are kept in 4 levels of 64 slots, each level 64 times coarser than the one below, so scheduling and
+    cancelling cost the same however many timers are pending, and the next wakeup is found by looking at a few slots.
+    A timer beyond the top level waits in an overflow list.
+
+    Each timer may fire late by up to its leeway. The wheel wakes at the earliest time a pending timer must fire by,
+    and fires every timer already due then, so timers close in time share one wakeup. What fires in a wakeup is run in a
+    single block on the target queue, in deadline order.
+
+    With no target queue, the wheel is driven by advanceToTime: and its clock starts at 0, for tests and simulations.
+    Otherwise it runs on the clock of its dispatch timer, CLOCK_UPTIME_RAW, which stops while the device sleeps: a delay
+    only counts time awake, and currentTime cannot be compared with CLOCK_MONOTONIC_RAW times. Timers can be scheduled
+    and cancelled from any thread.
+
+ */
+@interface DiffusionTimerWheel : NSObject <DiffusionScheduler>
+
+// seconds per tick (default 0.01)
+@property(nonatomic, readonly) NSTimeInterval resolution;
+// where timers fire. nil for a wheel driven by advanceToTime:
+@property(nonatomic, readonly, nullable) dispatch_queue_t targetQueue;
+// leeway of the timers scheduled through scheduleAfterDelay:block:, as a fraction of their delay (default 0.1)
+@property(nonatomic) double defaultLeewayFraction;
+
+@property(nonatomic, readonly) NSUInteger pendingCount;
+// the time of the next wakeup. infinity when nothing is pending
+@property(nonatomic, readonly) NSTimeInterval nextWakeupTime;
+
+// counters
+@property(nonatomic, readonly) uint64_t scheduledCount;
+@property(nonatomic, readonly) uint64_t firedCount;
+@property(nonatomic, readonly) uint64_t cancelledCount;
+@property(nonatomic, readonly) uint64_t wakeupCount;
+// timers that fired in the wakeup of another one: the wakeups a timer of their own would have cost
+@property(nonatomic, readonly) uint64_t savedWakeupCount;
+
+// 10 ms ticks, fires on the main queue
+-(instancetype) init;
+-(instancetype) initWithResolution:(NSTimeInterval)resolution targetQueue:(nullable dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+
+// fires no sooner than the delay and no later than the delay plus the leeway, give or take a tick. the returned
+// timer cancels it
+- (id<NSObject>)scheduleAfterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway block:(dispatch_block_t)block;
+- (void)cancelTimer:(id<NSObject>)timer;
+
+// for a wheel with no target queue: moves the clock to the time and runs what is due, on the calling thread
+- (void)advanceToTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,415 @@
+//
+//  DiffusionTimerWheel.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTimerWheel.h"
+
+#import <os/lock.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+
+// times a hair over a tick boundary are still on it
+static const double _TickEpsilon = 1e-9;
+
+
+@interface DiffusionWheelTimer : NSObject
+
+// ticks: the timer may fire from the deadline and must by the latest
+@property(nonatomic) uint64_t deadline;
+@property(nonatomic) uint64_t latest;
+@property(nonatomic, nullable, copy) dispatch_block_t block;
+// cancelled or fired
+@property(nonatomic, getter=isDone) BOOL done;
+
+@end
+
+@implementation DiffusionWheelTimer
+
+@end
+
+
+@implementation DiffusionTimerWheel
+{
+    os_unfair_lock _lock;
+    // times of tick 0 and of the manual clock
+    NSTimeInterval _origin;
+    NSTimeInterval _time;
+    // every timer due by this tick has fired
+    uint64_t _tick;
+
+    // a slot holds the timers due in its span, in the order they got there. created when first used
+    NSMutableArray<DiffusionWheelTimer *> *_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    // a bit per slot that may hold timers. cancelled timers are only dropped when their slot is emptied
+    uint64_t _occupied[TIMER_WHEEL_LEVELS];
+    // due after the span of the top level
+    NSMutableArray<DiffusionWheelTimer *> *_overflow;
+
+    dispatch_queue_t _queue;
+    dispatch_source_t _source;
+    // the tick the source is set for. UINT64_MAX when it is not
+    uint64_t _armedTick;
+}
+
+
+-(instancetype) init
+{
+    return [self initWithResolution:0.01 targetQueue:dispatch_get_main_queue()];
+}
+
+-(instancetype) initWithResolution:(const NSTimeInterval)resolution targetQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _resolution = resolution;
+    _defaultLeewayFraction = 0.1;
+    _overflow = [NSMutableArray array];
+    _armedTick = UINT64_MAX;
+    _targetQueue = queue;
+    if (!queue)
+    {
+        return self;
+    }
+
+    // the bookkeeping stays off the target queue, which only sees the timers that fire
+    _origin = self.currentTime;
+    _queue = dispatch_queue_create("DiffusionTimerWheel", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(_source, ^{
+        [weakSelf wakeUp];
+    });
+    dispatch_source_set_timer(_source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    dispatch_resume(_source);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_source)
+    {
+        dispatch_source_cancel(_source);
+    }
+}
+
+
+- (NSTimeInterval)currentTime
+{
+    if (!_targetQueue)
+    {
+        os_unfair_lock_lock(&_lock);
+        const NSTimeInterval time = _time;
+        os_unfair_lock_unlock(&_lock);
+        return time;
+    }
+    // the clock of dispatch_time(DISPATCH_TIME_NOW, ...), so that the source wakes when the wheel expects it to
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / (NSTimeInterval)NSEC_PER_SEC;
+}
+
+- (NSTimeInterval)nextWakeupTime
+{
+    os_unfair_lock_lock(&_lock);
+    const uint64_t tick = [self nextWakeupTickLocked];
+    os_unfair_lock_unlock(&_lock);
+    return tick == UINT64_MAX ? INFINITY : _origin + tick * _resolution;
+}
+
+- (NSUInteger)pendingCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = (NSUInteger)(_scheduledCount - _firedCount - _cancelledCount);
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+
+- (void)scheduleAfterDelay:(NSTimeInterval)delay block:(dispatch_block_t)block
+{
+    [self scheduleAfterDelay:delay leeway:MAX(delay, 0.0) * _defaultLeewayFraction block:block];
+}
+
+- (id<NSObject>)scheduleAfterDelay:(NSTimeInterval)delay leeway:(NSTimeInterval)leeway block:(dispatch_block_t)block
+{
+    const NSTimeInterval now = self.currentTime;
+    DiffusionWheelTimer *const timer = [DiffusionWheelTimer new];
+    timer.block = block;
+
+    os_unfair_lock_lock(&_lock);
+    const NSTimeInterval due = now - _origin + MAX(delay, 0.0);
+    timer.deadline = MAX((uint64_t)ceil(due / _resolution - _TickEpsilon), _tick + 1);
+    timer.latest = MAX((uint64_t)floor((due + MAX(leeway, 0.0)) / _resolution + _TickEpsilon), timer.deadline);
+    [self insertLocked:timer];
+    _scheduledCount++;
+    if (_source && timer.latest < _armedTick)
+    {
+        [self armAtTickLocked:timer.latest];
+    }
+    os_unfair_lock_unlock(&_lock);
+
+    return timer;
+}
+
+- (void)cancelTimer:(id<NSObject>)timer
+{
+    if (![timer isKindOfClass:DiffusionWheelTimer.class])
+    {
+        return;
+    }
+    DiffusionWheelTimer *const wheelTimer = (DiffusionWheelTimer *)timer;
+
+    os_unfair_lock_lock(&_lock);
+    if (!wheelTimer.isDone)
+    {
+        wheelTimer.done = YES;
+        wheelTimer.block = nil;
+        _cancelledCount++;
+        // no wakeup for nothing
+        if (_source && wheelTimer.latest == _armedTick)
+        {
+            [self armAtTickLocked:[self nextWakeupTickLocked]];
+        }
+    }
+    os_unfair_lock_unlock(&_lock);
+}
+
+
+- (void)insertLocked:(DiffusionWheelTimer *)timer
+{
+    // the lowest level whose span around the current tick holds the deadline
+    const uint64_t deadline = timer.deadline;
+    for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        const unsigned above = (level + 1) * TIMER_WHEEL_BITS;
+        if ((deadline >> above) == (_tick >> above))
+        {
+            const unsigned slot = (unsigned)((deadline >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+            if (!_slots[level][slot])
+            {
+                _slots[level][slot] = [NSMutableArray array];
+            }
+            [_slots[level][slot] addObject:timer];
+            _occupied[level] |= 1ull << slot;
+            return;
+        }
+    }
+    [_overflow addObject:timer];
+}
+
+- (NSArray<DiffusionWheelTimer *> *)takeSlotLocked:(unsigned)slot level:(unsigned)level
+{
+    NSArray<DiffusionWheelTimer *> *const timers = [_slots[level][slot] copy];
+    [_slots[level][slot] removeAllObjects];
+    _occupied[level] &= ~(1ull << slot);
+    return timers;
+}
+
+// the earliest tick a pending timer must fire by. UINT64_MAX when none is pending
+- (uint64_t)nextWakeupTickLocked
+{
+    uint64_t best = UINT64_MAX;
+    // slots are looked at in deadline order, until they start after the best tick found
+    for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        const unsigned shift = level * TIMER_WHEEL_BITS;
+        const uint64_t index = (_tick >> shift) & TIMER_WHEEL_MASK;
+        // the current slot of each level is empty: it fired or cascaded when the tick reached it
+        uint64_t occupied = index == TIMER_WHEEL_MASK ? 0 : _occupied[level] & (~0ull << (index + 1));
+        while (occupied)
+        {
+            const unsigned slot = (unsigned)__builtin_ctzll(occupied);
+            occupied &= occupied - 1;
+            const uint64_t start = ((_tick >> (shift + TIMER_WHEEL_BITS)) << (shift + TIMER_WHEEL_BITS)) | ((uint64_t)slot << shift);
+            if (start > best)
+            {
+                return best;
+            }
+            for (DiffusionWheelTimer *const timer in _slots[level][slot])
+            {
+                if (!timer.isDone)
+                {
+                    best = MIN(best, timer.latest);
+                }
+            }
+        }
+    }
+    for (DiffusionWheelTimer *const timer in _overflow)
+    {
+        if (!timer.isDone)
+        {
+            best = MIN(best, timer.latest);
+        }
+    }
+    return best;
+}
+
+// moves to the tick, firing every timer due by it into fired
+- (void)advanceToTickLocked:(uint64_t)target fired:(NSMutableArray<dispatch_block_t> *)fired
+{
+    while (_tick < target)
+    {
+        uint64_t next = _tick + 1;
+        if ((next & TIMER_WHEEL_MASK) != 0)
+        {
+            // nothing to do until the next occupied slot of level 0 or the end of its span
+            const uint64_t occupied = _occupied[0] & (~0ull << (next & TIMER_WHEEL_MASK));
+            next = occupied ? (next & ~TIMER_WHEEL_MASK) + (uint64_t)__builtin_ctzll(occupied) : (next | TIMER_WHEEL_MASK) + 1;
+            if (next > target)
+            {
+                _tick = target;
+                return;
+            }
+        }
+        [self processTickLocked:next fired:fired];
+    }
+}
+
+- (void)processTickLocked:(uint64_t)tick fired:(NSMutableArray<dispatch_block_t> *)fired
+{
+    _tick = tick;
+
+    // at the start of a span, its timers move down a level. highest level first, they may move down again
+    const unsigned topShift = TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS;
+    if ((tick & ((1ull << topShift) - 1)) == 0 && _overflow.count > 0)
+    {
+        NSArray<DiffusionWheelTimer *> *const overflow = [_overflow copy];
+        [_overflow removeAllObjects];
+        for (DiffusionWheelTimer *const timer in overflow)
+        {
+            if (!timer.isDone)
+            {
+                [self insertLocked:timer];
+            }
+        }
+    }
+    for (unsigned level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+    {
+        const unsigned shift = level * TIMER_WHEEL_BITS;
+        if ((tick & ((1ull << shift) - 1)) != 0)
+        {
+            continue;
+        }
+        const unsigned slot = (unsigned)((tick >> shift) & TIMER_WHEEL_MASK);
+        if (!(_occupied[level] & (1ull << slot)))
+        {
+            continue;
+        }
+        for (DiffusionWheelTimer *const timer in [self takeSlotLocked:slot level:level])
+        {
+            if (!timer.isDone)
+            {
+                [self insertLocked:timer];
+            }
+        }
+    }
+
+    const unsigned slot = (unsigned)(tick & TIMER_WHEEL_MASK);
+    if (!(_occupied[0] & (1ull << slot)))
+    {
+        return;
+    }
+    for (DiffusionWheelTimer *const timer in [self takeSlotLocked:slot level:0])
+    {
+        if (timer.isDone)
+        {
+            continue;
+        }
+        [fired addObject:timer.block];
+        timer.block = nil;
+        timer.done = YES;
+        _firedCount++;
+    }
+}
+
+- (void)countWakeupLocked:(NSUInteger)firedCount
+{
+    _wakeupCount++;
+    if (firedCount > 1)
+    {
+        _savedWakeupCount += firedCount - 1;
+    }
+}
+
+
+- (void)armAtTickLocked:(uint64_t)tick
+{
+    if (tick == _armedTick)
+    {
+        return;
+    }
+    _armedTick = tick;
+    if (tick == UINT64_MAX)
+    {
+        dispatch_source_set_timer(_source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+    const NSTimeInterval delay = MAX(_origin + tick * _resolution - self.currentTime, 0.0);
+    // the wheel has already coalesced, the system only gets a tick of leeway
+    dispatch_source_set_timer(_source, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, (uint64_t)(_resolution * NSEC_PER_SEC));
+}
+
+- (void)wakeUp
+{
+    NSMutableArray<dispatch_block_t> *const fired = [NSMutableArray array];
+
+    os_unfair_lock_lock(&_lock);
+    const uint64_t now = (uint64_t)floor((self.currentTime - _origin) / _resolution + _TickEpsilon);
+    const uint64_t target = _armedTick == UINT64_MAX ? now : MAX(now, _armedTick);
+    _armedTick = UINT64_MAX;
+    [self advanceToTickLocked:target fired:fired];
+    [self countWakeupLocked:fired.count];
+    [self armAtTickLocked:[self nextWakeupTickLocked]];
+    os_unfair_lock_unlock(&_lock);
+
+    if (fired.count == 0)
+    {
+        return;
+    }
+    // one hop to the target queue for everything that fired
+    dispatch_async(_targetQueue, ^{
+        for (dispatch_block_t const block in fired)
+        {
+            block();
+        }
+    });
+}
+
+- (void)advanceToTime:(NSTimeInterval)time
+{
+    NSAssert(!_targetQueue, @"only a wheel with no target queue is advanced by hand");
+    for (;;)
+    {
+        NSMutableArray<dispatch_block_t> *const fired = [NSMutableArray array];
+
+        os_unfair_lock_lock(&_lock);
+        const uint64_t wakeup = [self nextWakeupTickLocked];
+        if (wakeup == UINT64_MAX || wakeup > (uint64_t)floor(MAX(time - _origin, 0.0) / _resolution + _TickEpsilon))
+        {
+            _time = MAX(_time, time);
+            os_unfair_lock_unlock(&_lock);
+            return;
+        }
+        _time = MAX(_time, _origin + wakeup * _resolution);
+        [self advanceToTickLocked:wakeup fired:fired];
+        [self countWakeupLocked:fired.count];
+        os_unfair_lock_unlock(&_lock);
+
+        // unlocked: they may schedule more
+        for (dispatch_block_t const block in fired)
+        {
+            block();
+        }
+    }
+}
+
+@end
@@ -0,0 +1,86 @@
+//
+//  DiffusionTypedStreamDispatcher.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 29/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class DiffusionTypedStreamDispatcher;
+
+typedef void (^DiffusionInt64UpdateHandler)(NSString *topicPath, int64_t value);
+typedef void (^DiffusionDoubleUpdateHandler)(NSString *topicPath, double value);
+typedef void (^DiffusionStringUpdateHandler)(NSString *topicPath, NSString * _Nullable value);
+typedef void (^DiffusionBytesUpdateHandler)(NSString *topicPath, PTDiffusionTopicSpecification *specification, PTDiffusionBytes *value);
+
+@protocol DiffusionTypedStreamDispatcherDelegate <NSObject>
+
+// asked before an update is delivered, e.g. to drop the copy of a topic that another session of a pool delivers
+- (BOOL)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher shouldDeliverTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream;
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didSubscribeToTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification fromStream:(PTDiffusionStream *)stream;
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUnsubscribeFromTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification reason:(PTDiffusionTopicUnsubscriptionReason)reason fromStream:(PTDiffusionStream *)stream;
+// every update, before it is handed to the handler of its type. JSON, binary and record values arrive as bytes, and so
+// does a number topic with no value, as CBOR null. string, int64 and double values arrive as they are, with nothing
+// allocated for them: a delegate that needs their bytes encodes them (see dataWithString: and the like)
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification bytes:(PTDiffusionBytes *)value;
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification stringValue:(nullable NSString *)value;
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification int64Value:(int64_t)value;
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification doubleValue:(double)value;
+
+@end
+
+/**
+
+    Registers one value stream per topic type on a session and routes each update to the handler for its type.
+
+    The single JSON fallback stream the manager used to register left every other topic type without a stream, so
+    their updates were never seen. Every update first goes to the delegate, so the manager sees all of them, then to
+    the handler of its type. Int64 and double values reach their handler as plain int64_t and double, and string
+    values as the string Diffusion decoded. Topics with no value (a nil number) are not passed to the number handlers.
+
+    Like the Diffusion callbacks, used from the main queue.
+
+ */
+@interface DiffusionTypedStreamDispatcher : NSObject
+
+@property(nonatomic, weak, nullable) id<DiffusionTypedStreamDispatcherDelegate> delegate;
+
+@property(nonatomic, copy, nullable) DiffusionBytesUpdateHandler JSONHandler;
+@property(nonatomic, copy, nullable) DiffusionBytesUpdateHandler binaryHandler;
+@property(nonatomic, copy, nullable) DiffusionBytesUpdateHandler recordHandler;
+@property(nonatomic, copy, nullable) DiffusionStringUpdateHandler stringHandler;
+@property(nonatomic, copy, nullable) DiffusionInt64UpdateHandler int64Handler;
+@property(nonatomic, copy, nullable) DiffusionDoubleUpdateHandler doubleHandler;
+
+// updates seen, whether or not a handler was set
+@property(nonatomic, readonly) NSUInteger updateCount;
+
+// a stream for each of the topic types handled, not yet added to any session
+- (NSArray<PTDiffusionValueStream *> *)makeStreams;
+// the same, keyed by the PTDiffusionTopicType each receives, for whatever delivers updates as a session would
+- (NSDictionary<NSNumber *, PTDiffusionValueStream *> *)makeStreamsByTopicType;
+
+// the CBOR encoding of a primitive value, the way Diffusion sends it. nil is CBOR null
++ (NSData *)dataWithString:(nullable NSString *)value;
++ (NSData *)dataWithInt64:(int64_t)value;
++ (NSData *)dataWithDouble:(double)value;
++ (NSData *)dataWithNumber:(nullable NSNumber *)value topicType:(PTDiffusionTopicType)topicType;
+// back from the encoding. nil for CBOR null, or for data that does not hold a value of the type
++ (nullable NSString *)stringWithData:(NSData *)data;
++ (nullable NSNumber *)numberWithData:(NSData *)data;
+
+// adds a fallback stream per type to the session and returns them
+- (NSArray<PTDiffusionValueStream *> *)addFallbackStreamsToSession:(PTDiffusionSession *)session;
+// adds a stream per type for the topics of the selector only
+- (NSArray<PTDiffusionValueStream *> *)addStreamsToSession:(PTDiffusionSession *)session withSelectorExpression:(NSString *)expression;
+
+@end
+
+NS_ASSUME_NONNULL_END
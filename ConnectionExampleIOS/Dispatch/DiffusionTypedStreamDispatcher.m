@@ -0,0 +1,358 @@
+//
+//  DiffusionTypedStreamDispatcher.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 29/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTypedStreamDispatcher.h"
+
+#import "DiffusionLog.h"
+
+@interface DiffusionTypedStreamDispatcher () <PTDiffusionJSONValueStreamDelegate, PTDiffusionBinaryValueStreamDelegate, PTDiffusionRecordV2ValueStreamDelegate, PTDiffusionStringValueStreamDelegate, PTDiffusionNumberValueStreamDelegate>
+
+@end
+
+
+// CBOR major types and simple values used by Diffusion's primitive topics
+enum
+{
+    _CBORUnsigned = 0,
+    _CBORNegative = 1,
+    _CBORText = 3,
+    _CBORSimple = 7,
+};
+static const uint8_t _CBORNull = 0xF6;
+static const uint8_t _CBORHalf = 0xF9;
+static const uint8_t _CBORSingle = 0xFA;
+static const uint8_t _CBORDouble = 0xFB;
+
+static void _AppendCBORHead(NSMutableData *data, uint8_t major, uint64_t argument)
+{
+    uint8_t bytes[9];
+    size_t length;
+    if (argument < 24)
+    {
+        bytes[0] = (uint8_t)(major << 5 | argument);
+        length = 1;
+    }
+    else
+    {
+        const size_t size = argument <= UINT8_MAX ? 1 : argument <= UINT16_MAX ? 2 : argument <= UINT32_MAX ? 4 : 8;
+        bytes[0] = (uint8_t)(major << 5 | (size == 1 ? 24 : size == 2 ? 25 : size == 4 ? 26 : 27));
+        for (size_t i = 0; i < size; i++)
+        {
+            bytes[size - i] = (uint8_t)(argument >> (8 * i));
+        }
+        length = size + 1;
+    }
+    [data appendBytes:bytes length:length];
+}
+
+// the head of the item at the start of the bytes. NO if there is not a whole one
+static BOOL _ReadCBORHead(const uint8_t *bytes, NSUInteger length, uint8_t *major, uint8_t *info, uint64_t *argument, NSUInteger *headLength)
+{
+    if (!length)
+    {
+        return NO;
+    }
+    *major = bytes[0] >> 5;
+    *info = bytes[0] & 0x1F;
+    if (*info < 24)
+    {
+        *argument = *info;
+        *headLength = 1;
+        return YES;
+    }
+    if (*info > 27)
+    {
+        return NO;
+    }
+    const NSUInteger size = (NSUInteger)1 << (*info - 24);
+    if (length < size + 1)
+    {
+        return NO;
+    }
+    *argument = 0;
+    for (NSUInteger i = 0; i < size; i++)
+    {
+        *argument = *argument << 8 | bytes[1 + i];
+    }
+    *headLength = size + 1;
+    return YES;
+}
+
+static double _HalfToDouble(uint16_t half)
+{
+    const int exponent = (half >> 10) & 0x1F;
+    const int mantissa = half & 0x3FF;
+    double value;
+    if (exponent == 0)
+    {
+        value = ldexp(mantissa, -24);
+    }
+    else if (exponent == 31)
+    {
+        value = mantissa ? NAN : INFINITY;
+    }
+    else
+    {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+// the value of a number topic that has none, made once
+static PTDiffusionBytes *_NullBytes(void)
+{
+    static PTDiffusionBytes *bytes;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        bytes = [[PTDiffusionBytes alloc] initWithData:[NSData dataWithBytes:&_CBORNull length:1]];
+    });
+    return bytes;
+}
+
+@implementation DiffusionTypedStreamDispatcher
+
+
+- (NSArray<PTDiffusionValueStream *> *)makeStreams
+{
+    return [self makeStreamsByTopicType].allValues;
+}
+
+- (NSDictionary<NSNumber *, PTDiffusionValueStream *> *)makeStreamsByTopicType
+{
+    // int64 and double topics have their own stream each, a number stream only receives the type it was created for
+    return @{@(PTDiffusionTopicType_JSON): [PTDiffusionJSON valueStreamWithDelegate:self],
+             @(PTDiffusionTopicType_Binary): [PTDiffusionBinary valueStreamWithDelegate:self],
+             @(PTDiffusionTopicType_RecordV2): [PTDiffusionRecordV2 valueStreamWithDelegate:self],
+             @(PTDiffusionTopicType_String): [PTDiffusionPrimitive stringValueStreamWithDelegate:self],
+             @(PTDiffusionTopicType_Int64): [PTDiffusionPrimitive int64NumberValueStreamWithDelegate:self],
+             @(PTDiffusionTopicType_Double): [PTDiffusionPrimitive doubleFloatNumberValueStreamWithDelegate:self]};
+}
+
+- (NSArray<PTDiffusionValueStream *> *)addFallbackStreamsToSession:(PTDiffusionSession *)session
+{
+    NSArray<PTDiffusionValueStream *> *const streams = [self makeStreams];
+    for (PTDiffusionValueStream *stream in streams)
+    {
+        [session.topics addFallbackStream:stream];
+    }
+    return streams;
+}
+
+- (NSArray<PTDiffusionValueStream *> *)addStreamsToSession:(PTDiffusionSession *)session withSelectorExpression:(NSString *)expression
+{
+    NSArray<PTDiffusionValueStream *> *const streams = [self makeStreams];
+    for (PTDiffusionValueStream *stream in streams)
+    {
+        [session.topics addStream:stream withSelectorExpression:expression];
+    }
+    return streams;
+}
+
+
+#pragma mark - primitive values
+
++ (NSData *)dataWithString:(nullable NSString *)value
+{
+    if (!value)
+    {
+        return [NSData dataWithBytes:&_CBORNull length:1];
+    }
+    const char *const UTF8 = value.UTF8String;
+    const size_t length = strlen(UTF8);
+    NSMutableData *const data = [NSMutableData dataWithCapacity:length + 9];
+    _AppendCBORHead(data, _CBORText, length);
+    [data appendBytes:UTF8 length:length];
+    return data;
+}
+
++ (NSData *)dataWithInt64:(int64_t)value
+{
+    NSMutableData *const data = [NSMutableData dataWithCapacity:9];
+    // a negative integer n is encoded as -1 - n, which cannot overflow
+    _AppendCBORHead(data, value < 0 ? _CBORNegative : _CBORUnsigned, value < 0 ? (uint64_t)(-1 - value) : (uint64_t)value);
+    return data;
+}
+
++ (NSData *)dataWithDouble:(double)value
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t bytes[9] = {_CBORDouble};
+    for (size_t i = 0; i < 8; i++)
+    {
+        bytes[8 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
++ (NSData *)dataWithNumber:(nullable NSNumber *)value topicType:(PTDiffusionTopicType)topicType
+{
+    if (!value)
+    {
+        return [NSData dataWithBytes:&_CBORNull length:1];
+    }
+    return topicType == PTDiffusionTopicType_Int64 ? [self dataWithInt64:value.longLongValue] : [self dataWithDouble:value.doubleValue];
+}
+
++ (nullable NSString *)stringWithData:(NSData *)data
+{
+    const uint8_t *const bytes = data.bytes;
+    uint8_t major, info;
+    uint64_t argument;
+    NSUInteger headLength;
+    if (!_ReadCBORHead(bytes, data.length, &major, &info, &argument, &headLength) || major != _CBORText || argument > data.length - headLength)
+    {
+        return nil;
+    }
+    return [[NSString alloc] initWithBytes:bytes + headLength length:(NSUInteger)argument encoding:NSUTF8StringEncoding];
+}
+
++ (nullable NSNumber *)numberWithData:(NSData *)data
+{
+    const uint8_t *const bytes = data.bytes;
+    uint8_t major, info;
+    uint64_t argument;
+    NSUInteger headLength;
+    if (!_ReadCBORHead(bytes, data.length, &major, &info, &argument, &headLength))
+    {
+        return nil;
+    }
+    switch (major)
+    {
+        case _CBORUnsigned:
+            return argument <= INT64_MAX ? @((int64_t)argument) : nil;
+        case _CBORNegative:
+            return argument <= INT64_MAX ? @(-1 - (int64_t)argument) : nil;
+        case _CBORSimple:
+            if (bytes[0] == _CBORHalf)
+            {
+                return @(_HalfToDouble((uint16_t)argument));
+            }
+            if (bytes[0] == _CBORSingle)
+            {
+                const uint32_t bits = (uint32_t)argument;
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                return @((double)value);
+            }
+            if (bytes[0] == _CBORDouble)
+            {
+                double value;
+                memcpy(&value, &argument, sizeof(value));
+                return @(value);
+            }
+            return nil;
+        default:
+            return nil;
+    }
+}
+
+
+#pragma mark - delivery
+
+- (BOOL)shouldDeliverTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream
+{
+    _updateCount++;
+    id<DiffusionTypedStreamDispatcherDelegate> const delegate = _delegate;
+    return !delegate || [delegate typedStreamDispatcher:self shouldDeliverTopicPath:topicPath fromStream:stream];
+}
+
+- (void)deliverBytes:(PTDiffusionBytes *)value
+         toHandler:(nullable DiffusionBytesUpdateHandler)handler
+         topicPath:(NSString *)topicPath
+     specification:(PTDiffusionTopicSpecification *)specification
+        fromStream:(PTDiffusionStream *)stream
+{
+    if (![self shouldDeliverTopicPath:topicPath fromStream:stream])
+    {
+        return;
+    }
+    [_delegate typedStreamDispatcher:self didUpdateTopicPath:topicPath specification:specification bytes:value];
+    if (handler)
+    {
+        handler(topicPath, specification, value);
+    }
+}
+
+
+#pragma mark - Diffusion delegates
+
+- (void)diffusionDidCloseStream:(nonnull PTDiffusionStream *)stream {
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionStream *)stream didFailWithError:(nonnull NSError *)error {
+    DiffusionLogError(@"\tDiffusionTypedStreamDispatcher: Stream failed with error: %@", error);
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionStream *)stream didSubscribeToTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification {
+    [_delegate typedStreamDispatcher:self didSubscribeToTopicPath:topicPath specification:specification fromStream:stream];
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionStream *)stream didUnsubscribeFromTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification reason:(PTDiffusionTopicUnsubscriptionReason)reason {
+    [_delegate typedStreamDispatcher:self didUnsubscribeFromTopicPath:topicPath specification:specification reason:reason fromStream:stream];
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldJSON:(nullable PTDiffusionJSON *)oldJson newJSON:(nonnull PTDiffusionJSON *)newJson {
+    [self deliverBytes:newJson toHandler:_JSONHandler topicPath:topicPath specification:specification fromStream:stream];
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldBinary:(nullable PTDiffusionBinary *)oldBinary newBinary:(nonnull PTDiffusionBinary *)newBinary {
+    [self deliverBytes:newBinary toHandler:_binaryHandler topicPath:topicPath specification:specification fromStream:stream];
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldRecord:(nullable PTDiffusionRecordV2 *)oldRecord newRecord:(nonnull PTDiffusionRecordV2 *)newRecord {
+    [self deliverBytes:newRecord toHandler:_recordHandler topicPath:topicPath specification:specification fromStream:stream];
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldString:(nullable NSString *)oldString newString:(nullable NSString *)newString {
+    if (![self shouldDeliverTopicPath:topicPath fromStream:stream])
+    {
+        return;
+    }
+    [_delegate typedStreamDispatcher:self didUpdateTopicPath:topicPath specification:specification stringValue:newString];
+    DiffusionStringUpdateHandler const handler = _stringHandler;
+    if (handler)
+    {
+        handler(topicPath, newString);
+    }
+}
+
+- (void)diffusionStream:(nonnull PTDiffusionValueStream *)stream didUpdateTopicPath:(nonnull NSString *)topicPath specification:(nonnull PTDiffusionTopicSpecification *)specification oldNumber:(nullable NSNumber *)oldNumber newNumber:(nullable NSNumber *)newNumber {
+    if (![self shouldDeliverTopicPath:topicPath fromStream:stream])
+    {
+        return;
+    }
+    id<DiffusionTypedStreamDispatcherDelegate> const delegate = _delegate;
+    if (!newNumber)
+    {
+        [delegate typedStreamDispatcher:self didUpdateTopicPath:topicPath specification:specification bytes:_NullBytes()];
+        return;
+    }
+    if (specification.type == PTDiffusionTopicType_Int64)
+    {
+        const int64_t value = newNumber.longLongValue;
+        [delegate typedStreamDispatcher:self didUpdateTopicPath:topicPath specification:specification int64Value:value];
+        DiffusionInt64UpdateHandler const handler = _int64Handler;
+        if (handler)
+        {
+            handler(topicPath, value);
+        }
+    }
+    else
+    {
+        const double value = newNumber.doubleValue;
+        [delegate typedStreamDispatcher:self didUpdateTopicPath:topicPath specification:specification doubleValue:value];
+        DiffusionDoubleUpdateHandler const handler = _doubleHandler;
+        if (handler)
+        {
+            handler(topicPath, value);
+        }
+    }
+}
+
+@end
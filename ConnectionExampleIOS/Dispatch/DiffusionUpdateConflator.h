@@ -0,0 +1,55 @@
+//
+//  DiffusionUpdateConflator.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionTickSource.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// topic path -> latest value received since the previous tick
+typedef void (^DiffusionConflatedBatchHandler)(NSDictionary<NSString *, id> *batch);
+
+/**
+
+    Keeps only the latest value of each topic between two ticks and hands them to the batch handlers in one go.
+
+    A topic updating faster than the screen refreshes is drawn once per frame instead of once per update. The price
+    is staleness: a value waits for the next tick, which is at most one tick period with a display link.
+    Values can be added from any thread; batches are delivered on the thread of the tick source.
+
+ */
+@interface DiffusionUpdateConflator : NSObject
+
+@property(nonatomic, readonly) id<DiffusionTickSource> tickSource;
+
+// counters, readable from any thread
+@property(nonatomic, readonly) NSUInteger receivedCount;
+@property(nonatomic, readonly) NSUInteger deliveredCount;
+// values replaced by a newer one before they were delivered
+@property(nonatomic, readonly) NSUInteger conflatedCount;
+@property(nonatomic, readonly) NSUInteger batchCount;
+// time between a delivered value arriving and the tick that delivered it, in seconds
+@property(nonatomic, readonly) NSTimeInterval averageStaleness;
+@property(nonatomic, readonly) NSTimeInterval maximumStaleness;
+
+-(instancetype) initWithTickSource:(id<DiffusionTickSource>)tickSource NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// the tick source runs while there is at least one handler. the returned token removes the handler
+- (id<NSObject>)addBatchHandler:(DiffusionConflatedBatchHandler)handler;
+- (void)removeBatchHandler:(id<NSObject>)token;
+
+- (void)addValue:(id)value forTopicPath:(NSString *)topicPath;
+
+// delivers what is pending now, as a tick would
+- (void)flushAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
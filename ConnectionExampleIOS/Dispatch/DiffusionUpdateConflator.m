@@ -0,0 +1,188 @@
+//
+//  DiffusionUpdateConflator.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionUpdateConflator.h"
+
+#import <os/lock.h>
+
+@interface DiffusionConflatedValue : NSObject
+
+@property(nonatomic) id value;
+// when the first value still pending for the topic arrived
+@property(nonatomic) NSTimeInterval arrival;
+
+@end
+
+@implementation DiffusionConflatedValue
+
+@end
+
+
+@implementation DiffusionUpdateConflator
+{
+    os_unfair_lock _lock;
+    NSMutableDictionary<NSString *, DiffusionConflatedValue *> *_pending;
+    NSTimeInterval _totalStaleness;
+
+    // only touched from the thread of the tick source
+    NSMutableArray<DiffusionConflatedBatchHandler> *_handlers;
+}
+
+
+-(instancetype) initWithTickSource:(id<DiffusionTickSource>)tickSource
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _tickSource = tickSource;
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _pending = [NSMutableDictionary dictionary];
+    _handlers = [NSMutableArray array];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_tickSource stop];
+}
+
+
+- (id<NSObject>)addBatchHandler:(DiffusionConflatedBatchHandler)handler
+{
+    DiffusionConflatedBatchHandler const copied = [handler copy];
+    [_handlers addObject:copied];
+    if (_handlers.count == 1)
+    {
+        __weak DiffusionUpdateConflator *weakSelf = self;
+        [_tickSource startWithHandler:^(NSTimeInterval time) {
+            [weakSelf flushAtTime:time];
+        }];
+    }
+    return copied;
+}
+
+- (void)removeBatchHandler:(id<NSObject>)token
+{
+    [_handlers removeObjectIdenticalTo:(DiffusionConflatedBatchHandler)token];
+    if (!_handlers.count)
+    {
+        [_tickSource stop];
+    }
+}
+
+// the counters are written under the lock, from the thread adding values and from the tick source's
+- (NSUInteger)receivedCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _receivedCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)deliveredCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _deliveredCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)conflatedCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _conflatedCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)batchCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _batchCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSTimeInterval)maximumStaleness
+{
+    os_unfair_lock_lock(&_lock);
+    const NSTimeInterval maximum = _maximumStaleness;
+    os_unfair_lock_unlock(&_lock);
+    return maximum;
+}
+
+- (NSTimeInterval)averageStaleness
+{
+    os_unfair_lock_lock(&_lock);
+    const NSTimeInterval average = _deliveredCount ? _totalStaleness / _deliveredCount : 0;
+    os_unfair_lock_unlock(&_lock);
+    return average;
+}
+
+- (void)addValue:(id)value forTopicPath:(NSString *)topicPath
+{
+    const NSTimeInterval now = _tickSource.currentTime;
+    os_unfair_lock_lock(&_lock);
+    _receivedCount++;
+    DiffusionConflatedValue *pending = _pending[topicPath];
+    if (!pending)
+    {
+        pending = [[DiffusionConflatedValue alloc] init];
+        pending.arrival = now;
+        _pending[topicPath] = pending;
+    }
+    else
+    {
+        _conflatedCount++;
+    }
+    pending.value = value;
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)flushAtTime:(NSTimeInterval)time
+{
+    os_unfair_lock_lock(&_lock);
+    if (!_pending.count)
+    {
+        os_unfair_lock_unlock(&_lock);
+        return;
+    }
+    NSDictionary<NSString *, DiffusionConflatedValue *> *const pending = _pending;
+    _pending = [NSMutableDictionary dictionaryWithCapacity:pending.count];
+    os_unfair_lock_unlock(&_lock);
+
+    NSMutableDictionary<NSString *, id> *const batch = [NSMutableDictionary dictionaryWithCapacity:pending.count];
+    NSTimeInterval staleness = 0;
+    NSTimeInterval maximum = 0;
+    for (NSString *topicPath in pending)
+    {
+        DiffusionConflatedValue *const entry = pending[topicPath];
+        batch[topicPath] = entry.value;
+        // staleness of the oldest value the topic had pending: the worst a reader of that topic experienced
+        const NSTimeInterval waited = MAX(time - entry.arrival, 0.0);
+        staleness += waited;
+        maximum = MAX(maximum, waited);
+    }
+
+    os_unfair_lock_lock(&_lock);
+    _deliveredCount += pending.count;
+    _batchCount++;
+    _totalStaleness += staleness;
+    _maximumStaleness = MAX(_maximumStaleness, maximum);
+    os_unfair_lock_unlock(&_lock);
+
+    for (DiffusionConflatedBatchHandler handler in [_handlers copy])
+    {
+        handler(batch);
+    }
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  DiffusionEventLog.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionEventLogFormat.h"
+#import "DiffusionTopicPathIndex.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    Writes the events of the manager to a file as compact binary records (see DiffusionEventLogFormat.h), cheap
+    enough to leave on in production.
+
+    Nothing is formatted when an event is recorded: topics are identified by their ID in the topic index, selectors by
+    an ID of the log, and the arguments are raw integers. Records go through a DiffusionRecordFileWriter, which
+    buffers them in memory and writes them on a background queue. Tools/DiffusionEventLogDecoder.c turns a file back
+    into text or CSV.
+
+    A log is capped: once it reaches the maximum file size it is moved aside to URL.1 and a new one is started, so a
+    long run keeps the latest events without filling the disk. Releasing the log flushes and closes it.
+
+    Events can be recorded from any thread.
+
+ */
+@interface DiffusionEventLog : NSObject
+
+@property(nonatomic, readonly) NSURL *URL;
+@property(nonatomic, readonly) NSUInteger recordCount;
+// bytes recorded so far, including what has not reached the file yet
+@property(nonatomic, readonly) unsigned long long byteCount;
+// size at which the log is rotated (default 8 MB). 0 lets it grow without limit
+@property(nonatomic) unsigned long long maximumFileSize;
+// rotated logs kept besides the current one (default 1)
+@property(nonatomic) NSUInteger maximumFileCount;
+
+// replaces any existing file at the URL
+-(nullable instancetype) initWithURL:(NSURL *)URL topicIndex:(DiffusionTopicPathIndex *)topicIndex error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// the session ID is the one Diffusion gave the session, to tell the sessions of a pool apart. nil if unknown
+- (void)recordSessionStateChangeFrom:(uint32_t)previousState to:(uint32_t)state sessionID:(nullable NSString *)sessionID;
+- (void)recordPingRoundTripTime:(NSTimeInterval)roundTripTime;
+- (void)recordPingFailureWithErrorCode:(NSInteger)errorCode;
+- (void)recordSubscribeResultForSelector:(NSString *)selector subscribe:(BOOL)subscribe errorCode:(NSInteger)errorCode;
+- (void)recordUpdateOfTopicPath:(NSString *)topicPath length:(NSUInteger)length topicType:(NSInteger)topicType;
+
+- (void)recordEvent:(DiffusionEvent)event ID:(uint32_t)ID arguments:(const int64_t *)arguments count:(NSUInteger)count;
+
+// blocks until everything recorded so far is in the file
+- (void)flush;
+// flushes and closes the file. later events are ignored
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
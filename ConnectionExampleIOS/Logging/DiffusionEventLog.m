@@ -0,0 +1,214 @@
+//
+//  DiffusionEventLog.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionEventLog.h"
+
+#import <os/lock.h>
+
+#import "DiffusionRecordFileWriter.h"
+
+// the buffer is handed to the writing queue once it is this large
+static const NSUInteger _WriteThreshold = 64 * 1024;
+static const unsigned long long _MaximumFileSize = 8 * 1024 * 1024;
+
+@implementation DiffusionEventLog
+{
+    DiffusionTopicPathIndex *_topicIndex;
+    DiffusionRecordFileWriter *_writer;
+
+    // guards the selector and session IDs
+    os_unfair_lock _lock;
+    NSMutableDictionary<NSString *, NSNumber *> *_selectorIDs;
+    NSMutableDictionary<NSString *, NSNumber *> *_sessionIDs;
+}
+
+
+-(nullable instancetype) initWithURL:(NSURL *)URL topicIndex:(DiffusionTopicPathIndex *)topicIndex error:(NSError **)error
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _topicIndex = topicIndex;
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _selectorIDs = [NSMutableDictionary dictionary];
+    _sessionIDs = [NSMutableDictionary dictionary];
+    _writer = [[DiffusionRecordFileWriter alloc] initWithURL:URL name:@"DiffusionEventLog" writeThreshold:_WriteThreshold fileHeader:^NSData *(uint64_t startTime) {
+        const DiffusionEventLogFileHeader header = {
+            .magic = CFSwapInt32HostToLittle(DIFFUSION_EVENT_LOG_MAGIC),
+            .version = CFSwapInt16HostToLittle(DIFFUSION_EVENT_LOG_VERSION),
+            .headerSize = CFSwapInt16HostToLittle(sizeof(DiffusionEventLogFileHeader)),
+            .startTime = CFSwapInt64HostToLittle(startTime),
+        };
+        return [NSData dataWithBytes:&header length:sizeof(header)];
+    } error:error];
+    if (!_writer)
+    {
+        return nil;
+    }
+    _writer.maximumFileSize = _MaximumFileSize;
+
+    return self;
+}
+
+
+#pragma mark - recording
+
+- (NSURL *)URL
+{
+    return _writer.URL;
+}
+
+- (NSUInteger)recordCount
+{
+    return _writer.recordCount;
+}
+
+- (unsigned long long)byteCount
+{
+    return _writer.byteCount;
+}
+
+- (unsigned long long)maximumFileSize
+{
+    return _writer.maximumFileSize;
+}
+
+- (void)setMaximumFileSize:(unsigned long long)maximumFileSize
+{
+    _writer.maximumFileSize = maximumFileSize;
+}
+
+- (NSUInteger)maximumFileCount
+{
+    return _writer.maximumFileCount;
+}
+
+- (void)setMaximumFileCount:(NSUInteger)maximumFileCount
+{
+    _writer.maximumFileCount = maximumFileCount;
+}
+
+// called from the block of appendRecords:
+- (void)appendEvent:(DiffusionEvent)event ID:(uint32_t)ID payload:(const void *)payload length:(NSUInteger)length
+{
+    length = MIN(length, (NSUInteger)DIFFUSION_EVENT_LOG_MAXIMUM_PAYLOAD);
+    const DiffusionEventLogRecordHeader header = {
+        .event = CFSwapInt16HostToLittle(event),
+        .length = CFSwapInt16HostToLittle((uint16_t)length),
+        .ID = CFSwapInt32HostToLittle(ID),
+        .timestamp = CFSwapInt64HostToLittle(_writer.timestamp),
+    };
+    [_writer appendHeader:&header length:sizeof(header) payload:payload length:length];
+}
+
+- (void)appendDefinition:(DiffusionEvent)event ID:(uint32_t)ID string:(NSString *)string
+{
+    NSData *const bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+    [self appendEvent:event ID:ID payload:bytes.bytes length:bytes.length];
+}
+
+- (void)recordEvent:(DiffusionEvent)event ID:(uint32_t)ID arguments:(const int64_t *)arguments count:(NSUInteger)count
+{
+    count = MIN(count, DIFFUSION_EVENT_LOG_MAXIMUM_PAYLOAD / sizeof(int64_t));
+    int64_t payload[count ?: 1];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        payload[i] = (int64_t)CFSwapInt64HostToLittle((uint64_t)arguments[i]);
+    }
+    // a block cannot capture an array, it gets a pointer to it
+    const int64_t *const bytes = payload;
+    [_writer appendRecords:^{
+        [self appendEvent:event ID:ID payload:bytes length:count * sizeof(int64_t)];
+    }];
+}
+
+// the ID of the log for a selector or a session, from 1
+- (uint32_t)IDOfName:(NSString *)name inTable:(NSMutableDictionary<NSString *, NSNumber *> *)table
+{
+    os_unfair_lock_lock(&_lock);
+    NSNumber *ID = table[name];
+    if (!ID)
+    {
+        ID = @(table.count + 1);
+        table[name] = ID;
+    }
+    os_unfair_lock_unlock(&_lock);
+    return ID.unsignedIntValue;
+}
+
+- (void)recordSessionStateChangeFrom:(uint32_t)previousState to:(uint32_t)state sessionID:(nullable NSString *)sessionID
+{
+    const int64_t arguments[] = {previousState, state};
+    if (!sessionID)
+    {
+        [self recordEvent:DiffusionEventSessionStateChange ID:0 arguments:arguments count:2];
+        return;
+    }
+    [self recordEvent:DiffusionEventSessionStateChange ID:[self IDOfName:sessionID inTable:_sessionIDs]
+           definition:DiffusionEventDefineSession string:sessionID arguments:arguments count:2];
+}
+
+- (void)recordPingRoundTripTime:(NSTimeInterval)roundTripTime
+{
+    const int64_t arguments[] = {(int64_t)llround(roundTripTime * 1e6)};
+    [self recordEvent:DiffusionEventPing ID:0 arguments:arguments count:1];
+}
+
+- (void)recordPingFailureWithErrorCode:(NSInteger)errorCode
+{
+    const int64_t arguments[] = {errorCode};
+    [self recordEvent:DiffusionEventPingFailure ID:0 arguments:arguments count:1];
+}
+
+- (void)recordSubscribeResultForSelector:(NSString *)selector subscribe:(BOOL)subscribe errorCode:(NSInteger)errorCode
+{
+    const int64_t arguments[] = {subscribe ? 1 : 0, errorCode};
+    [self recordEvent:DiffusionEventSubscribeResult ID:[self IDOfName:selector inTable:_selectorIDs]
+           definition:DiffusionEventDefineSelector string:selector arguments:arguments count:2];
+}
+
+- (void)recordUpdateOfTopicPath:(NSString *)topicPath length:(NSUInteger)length topicType:(NSInteger)topicType
+{
+    const int64_t arguments[] = {(int64_t)length, topicType};
+    [self recordEvent:DiffusionEventUpdate ID:[_topicIndex internTopicPath:topicPath] definition:DiffusionEventDefineTopic string:topicPath arguments:arguments count:2];
+}
+
+// the event, preceded by the definition of its ID unless the file already has it
+- (void)recordEvent:(DiffusionEvent)event ID:(uint32_t)ID definition:(DiffusionEvent)definition string:(NSString *)string arguments:(const int64_t *)arguments count:(NSUInteger)count
+{
+    int64_t payload[count ?: 1];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        payload[i] = (int64_t)CFSwapInt64HostToLittle((uint64_t)arguments[i]);
+    }
+    const int64_t *const bytes = payload;
+    [_writer appendRecords:^{
+        if ([self->_writer defineID:ID kind:definition])
+        {
+            [self appendDefinition:definition ID:ID string:string];
+        }
+        [self appendEvent:event ID:ID payload:bytes length:count * sizeof(int64_t)];
+    }];
+}
+
+
+#pragma mark - writing
+
+- (void)flush
+{
+    [_writer flush];
+}
+
+- (void)close
+{
+    [_writer close];
+}
+
+@end
@@ -0,0 +1,82 @@
+//
+//  DiffusionEventLogFormat.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#ifndef DiffusionEventLogFormat_h
+#define DiffusionEventLogFormat_h
+
+// plain C, shared by the app and the command line decoder in Tools
+
+#include <stdint.h>
+
+/**
+
+    An event log file is a file header followed by records back to back, all little endian.
+
+    A record is a 16 byte header and `length` bytes of payload. The payload of an event is its arguments as 64 bit
+    integers; the payload of a definition is a UTF-8 string. A topic, selector or session ID is defined once per file,
+    before the first record using it, so a file can be decoded on its own, even once the log has rotated.
+
+ */
+
+#define DIFFUSION_EVENT_LOG_MAGIC 0x314C4544u // "DEL1"
+#define DIFFUSION_EVENT_LOG_VERSION 1
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    // wall clock when the log was opened, in nanoseconds since 1970. record timestamps are relative to it
+    uint64_t startTime;
+} DiffusionEventLogFileHeader;
+
+typedef struct
+{
+    uint16_t event;
+    // bytes of payload following the header
+    uint16_t length;
+    // topic ID, selector ID or 0, depending on the event
+    uint32_t ID;
+    // nanoseconds since the log was opened
+    uint64_t timestamp;
+} DiffusionEventLogRecordHeader;
+
+typedef uint16_t DiffusionEvent;
+enum
+{
+    // ID: a topic ID. payload: its path
+    DiffusionEventDefineTopic = 1,
+    // ID: a selector ID. payload: the selector
+    DiffusionEventDefineSelector = 2,
+    // ID: a session ID of the log. payload: the Diffusion session ID
+    DiffusionEventDefineSession = 3,
+
+    // ID: a session ID, or 0 in logs that do not say. arguments: previous state, new state, as DiffusionEventSessionState bits
+    DiffusionEventSessionStateChange = 16,
+    // arguments: round trip time in microseconds
+    DiffusionEventPing = 17,
+    // ID: a selector ID. arguments: 1 for a subscription or 0 for an unsubscription, error code or 0 on success
+    DiffusionEventSubscribeResult = 18,
+    // ID: a topic ID. arguments: value length in bytes, topic type
+    DiffusionEventUpdate = 19,
+    // arguments: error code, or 0 when the failure has no error
+    DiffusionEventPingFailure = 20,
+};
+
+enum
+{
+    DiffusionEventSessionStateConnected = 1 << 0,
+    DiffusionEventSessionStateRecovering = 1 << 1,
+    DiffusionEventSessionStateClosed = 1 << 2,
+    DiffusionEventSessionStateError = 1 << 3,
+};
+
+// a string payload longer than this is truncated
+#define DIFFUSION_EVENT_LOG_MAXIMUM_PAYLOAD 4096
+
+#endif /* DiffusionEventLogFormat_h */
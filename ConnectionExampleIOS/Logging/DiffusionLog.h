@@ -0,0 +1,86 @@
+//
+//  DiffusionLog.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PTDiffusionLoggingDestinationConfiguration;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, DiffusionLogLevel) {
+    DiffusionLogLevelTrace = 0,
+    DiffusionLogLevelDebug = 1,
+    DiffusionLogLevelInfo = 2,
+    DiffusionLogLevelWarn = 3,
+    DiffusionLogLevelError = 4,
+    DiffusionLogLevelOff = 5,
+};
+
+// calls below this level are compiled out. override it in the build settings, e.g. DIFFUSION_LOG_MINIMUM_LEVEL=4
+#ifndef DIFFUSION_LOG_MINIMUM_LEVEL
+#if DEBUG
+#define DIFFUSION_LOG_MINIMUM_LEVEL 1
+#else
+#define DIFFUSION_LOG_MINIMUM_LEVEL 2
+#endif
+#endif
+
+// the arguments are not evaluated when the level is compiled out or disabled at runtime
+#define DIFFUSION_LOG(lvl, fmt, ...) \
+    do { \
+        if ((lvl) >= DIFFUSION_LOG_MINIMUM_LEVEL && (lvl) >= DiffusionLogCurrentLevel) \
+        { \
+            DiffusionLogWrite((lvl), fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define DiffusionLogTrace(fmt, ...) DIFFUSION_LOG(DiffusionLogLevelTrace, fmt, ##__VA_ARGS__)
+#define DiffusionLogDebug(fmt, ...) DIFFUSION_LOG(DiffusionLogLevelDebug, fmt, ##__VA_ARGS__)
+#define DiffusionLogInfo(fmt, ...) DIFFUSION_LOG(DiffusionLogLevelInfo, fmt, ##__VA_ARGS__)
+#define DiffusionLogWarn(fmt, ...) DIFFUSION_LOG(DiffusionLogLevelWarn, fmt, ##__VA_ARGS__)
+#define DiffusionLogError(fmt, ...) DIFFUSION_LOG(DiffusionLogLevelError, fmt, ##__VA_ARGS__)
+
+// runtime level, on top of the compile time one. read without synchronisation on every call
+FOUNDATION_EXPORT DiffusionLogLevel DiffusionLogCurrentLevel;
+
+FOUNDATION_EXPORT void DiffusionLogWrite(DiffusionLogLevel level, NSString *format, ...) NS_FORMAT_FUNCTION(2, 3);
+FOUNDATION_EXPORT void DiffusionLogWriteMessage(DiffusionLogLevel level, NSString *message);
+
+// receives the formatted lines of one flush, each ending with a newline
+typedef void (^DiffusionLogSink)(const char *lines, size_t length);
+
+/**
+
+    Asynchronous logger meant to replace NSLog on the update path.
+
+    A call formats its message and copies it into a slot of a fixed ring shared by every thread; claiming a slot is a
+    single compare and swap, with no lock and no system call. A background thread empties the ring every few
+    milliseconds, or as soon as it is half full, and hands the lines to the sink (standard error by default) in one
+    write. When the ring is full the message is dropped and counted rather than making the caller wait.
+    Messages longer than a slot are truncated.
+
+ */
+@interface DiffusionLog : NSObject
+
+@property(class, nonatomic) DiffusionLogLevel level;
+// nil restores the default sink
+@property(class, nonatomic, copy, null_resettable) DiffusionLogSink sink;
+
+// counters
+@property(class, nonatomic, readonly) NSUInteger writtenCount;
+@property(class, nonatomic, readonly) NSUInteger droppedCount;
+
+// a destination sending the Diffusion library logs through the ring, at info level
+@property(class, nonatomic, readonly) PTDiffusionLoggingDestinationConfiguration *diffusionDestinationConfiguration;
+
+// blocks until everything logged so far has reached the sink
++ (void)flush;
+
+@end
+
+NS_ASSUME_NONNULL_END
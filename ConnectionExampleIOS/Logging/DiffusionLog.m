@@ -0,0 +1,263 @@
+//
+//  DiffusionLog.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionLog.h"
+
+@import Diffusion;
+
+#import <os/lock.h>
+#import <pthread.h>
+#import <sched.h>
+#import <stdatomic.h>
+#import <time.h>
+#import <unistd.h>
+
+// a power of 2
+#define DIFFUSION_LOG_SLOT_COUNT 4096
+#define DIFFUSION_LOG_SLOT_MASK (DIFFUSION_LOG_SLOT_COUNT - 1)
+// a slot is 256 bytes
+#define DIFFUSION_LOG_TEXT_LENGTH 232
+// the flusher wakes up at least this often
+#define DIFFUSION_LOG_FLUSH_INTERVAL_MS 5
+
+typedef struct
+{
+    // bounded multi producer queue: a producer may fill the slot when it equals its position,
+    // the flusher may read it when it equals the position + 1
+    _Atomic(uint64_t) sequence;
+    uint64_t timestamp;
+    uint32_t thread;
+    uint16_t length;
+    uint8_t level;
+    char text[DIFFUSION_LOG_TEXT_LENGTH];
+} DiffusionLogSlot;
+
+DiffusionLogLevel DiffusionLogCurrentLevel = DIFFUSION_LOG_MINIMUM_LEVEL;
+
+static DiffusionLogSlot _slots[DIFFUSION_LOG_SLOT_COUNT];
+static _Atomic(uint64_t) _enqueuePosition;
+static _Atomic(uint64_t) _written;
+static _Atomic(uint64_t) _dropped;
+static dispatch_semaphore_t _wakeup;
+// set by the producer that wakes the flusher, so that the others do not signal it again
+static atomic_bool _wakeupPending;
+
+// held while draining, which happens on the flusher thread or in +flush
+static os_unfair_lock _drainLock = OS_UNFAIR_LOCK_INIT;
+// written under the drain lock. producers read it to know how far behind the flusher is
+static _Atomic(uint64_t) _dequeuePosition;
+static DiffusionLogSink _sink;
+static char _lines[64 * 1024];
+
+
+static void _DiffusionLogDefaultSink(const char *lines, size_t length)
+{
+    while (length)
+    {
+        const ssize_t written = write(STDERR_FILENO, lines, length);
+        if (written <= 0)
+        {
+            return;
+        }
+        lines += written;
+        length -= (size_t)written;
+    }
+}
+
+static size_t _DiffusionLogFormatSlot(const DiffusionLogSlot *slot, char *line, size_t capacity)
+{
+    static const char levels[] = "TDIWE";
+    const time_t seconds = (time_t)(slot->timestamp / NSEC_PER_SEC);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    const int length = snprintf(line, capacity, "%02d:%02d:%02d.%03d %c [%x] %.*s\n",
+                                local.tm_hour, local.tm_min, local.tm_sec, (int)(slot->timestamp % NSEC_PER_SEC / NSEC_PER_MSEC),
+                                levels[MIN(slot->level, (uint8_t)4)], slot->thread, (int)slot->length, slot->text);
+    return length < 0 ? 0 : MIN((size_t)length, capacity - 1);
+}
+
+static void _DiffusionLogDrain(void)
+{
+    os_unfair_lock_lock(&_drainLock);
+    DiffusionLogSink const sink = _sink;
+    size_t used = 0;
+    uint64_t position = atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+    for (;;)
+    {
+        DiffusionLogSlot *const slot = &_slots[position & DIFFUSION_LOG_SLOT_MASK];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != position + 1)
+        {
+            // empty, or the next message is still being written
+            break;
+        }
+        if (sizeof(_lines) - used < DIFFUSION_LOG_TEXT_LENGTH + 64)
+        {
+            sink ? sink(_lines, used) : _DiffusionLogDefaultSink(_lines, used);
+            used = 0;
+        }
+        used += _DiffusionLogFormatSlot(slot, _lines + used, sizeof(_lines) - used);
+        atomic_store_explicit(&slot->sequence, position + DIFFUSION_LOG_SLOT_COUNT, memory_order_release);
+        position++;
+        atomic_store_explicit(&_dequeuePosition, position, memory_order_relaxed);
+    }
+    if (used)
+    {
+        sink ? sink(_lines, used) : _DiffusionLogDefaultSink(_lines, used);
+    }
+    os_unfair_lock_unlock(&_drainLock);
+}
+
+static void _DiffusionLogStart(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (uint64_t i = 0; i < DIFFUSION_LOG_SLOT_COUNT; i++)
+        {
+            atomic_init(&_slots[i].sequence, i);
+        }
+        _wakeup = dispatch_semaphore_create(0);
+
+        NSThread *const flusher = [[NSThread alloc] initWithBlock:^{
+            for (;;)
+            {
+                dispatch_semaphore_wait(_wakeup, dispatch_time(DISPATCH_TIME_NOW, DIFFUSION_LOG_FLUSH_INTERVAL_MS * NSEC_PER_MSEC));
+                atomic_store_explicit(&_wakeupPending, false, memory_order_relaxed);
+                _DiffusionLogDrain();
+            }
+        }];
+        flusher.name = @"DiffusionLog";
+        flusher.qualityOfService = NSQualityOfServiceUtility;
+        [flusher start];
+    });
+}
+
+
+void DiffusionLogWriteMessage(DiffusionLogLevel level, NSString *message)
+{
+    _DiffusionLogStart();
+
+    uint64_t position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    DiffusionLogSlot *slot;
+    for (;;)
+    {
+        slot = &_slots[position & DIFFUSION_LOG_SLOT_MASK];
+        const int64_t lag = (int64_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - position);
+        if (lag == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&_enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (lag < 0)
+        {
+            // the flusher has not caught up with a whole ring of messages
+            atomic_fetch_add_explicit(&_dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+        }
+    }
+
+    slot->timestamp = clock_gettime_nsec_np(CLOCK_REALTIME);
+    slot->thread = pthread_mach_thread_np(pthread_self());
+    slot->level = (uint8_t)level;
+    NSUInteger length = 0;
+    // stops at a character boundary when the message does not fit
+    [message getBytes:slot->text maxLength:DIFFUSION_LOG_TEXT_LENGTH usedLength:&length encoding:NSUTF8StringEncoding
+              options:0 range:NSMakeRange(0, message.length) remainingRange:NULL];
+    slot->length = (uint16_t)length;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    atomic_fetch_add_explicit(&_written, 1, memory_order_relaxed);
+
+    // half a ring behind the flusher: wake it up rather than wait for its next round
+    // signed: the flusher may already be past this message, with those logged after it
+    const int64_t depth = (int64_t)(position + 1 - atomic_load_explicit(&_dequeuePosition, memory_order_relaxed));
+    if (depth >= DIFFUSION_LOG_SLOT_COUNT / 2 && !atomic_exchange_explicit(&_wakeupPending, true, memory_order_relaxed))
+    {
+        dispatch_semaphore_signal(_wakeup);
+    }
+}
+
+void DiffusionLogWrite(DiffusionLogLevel level, NSString *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    NSString *const message = [[NSString alloc] initWithFormat:format arguments:arguments];
+    va_end(arguments);
+    DiffusionLogWriteMessage(level, message);
+}
+
+
+@implementation DiffusionLog
+
++ (DiffusionLogLevel)level
+{
+    return DiffusionLogCurrentLevel;
+}
+
++ (void)setLevel:(DiffusionLogLevel)level
+{
+    DiffusionLogCurrentLevel = level;
+}
+
++ (DiffusionLogSink)sink
+{
+    os_unfair_lock_lock(&_drainLock);
+    DiffusionLogSink const sink = _sink;
+    os_unfair_lock_unlock(&_drainLock);
+    return sink ?: ^(const char *lines, size_t length) {
+        _DiffusionLogDefaultSink(lines, length);
+    };
+}
+
++ (void)setSink:(nullable DiffusionLogSink)sink
+{
+    DiffusionLogSink const copied = [sink copy];
+    os_unfair_lock_lock(&_drainLock);
+    _sink = copied;
+    os_unfair_lock_unlock(&_drainLock);
+}
+
++ (NSUInteger)writtenCount
+{
+    return (NSUInteger)atomic_load_explicit(&_written, memory_order_relaxed);
+}
+
++ (NSUInteger)droppedCount
+{
+    return (NSUInteger)atomic_load_explicit(&_dropped, memory_order_relaxed);
+}
+
++ (PTDiffusionLoggingDestinationConfiguration *)diffusionDestinationConfiguration
+{
+    // the library has already formatted the message, so all that is left is copying it into the ring
+    return [[PTDiffusionLoggingDestinationConfiguration alloc] initWithMessagePrinter:^(NSString *message) {
+        DiffusionLogWriteMessage(DiffusionLogLevelInfo, message);
+    }];
+}
+
++ (void)flush
+{
+    _DiffusionLogStart();
+    // a drain stops at a slot claimed but not yet filled: wait for its producer rather than leave what follows behind
+    const uint64_t target = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    for (;;)
+    {
+        _DiffusionLogDrain();
+        if (atomic_load_explicit(&_dequeuePosition, memory_order_relaxed) >= target)
+        {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+@end
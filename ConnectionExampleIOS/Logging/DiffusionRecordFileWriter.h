@@ -0,0 +1,71 @@
+//
+//  DiffusionRecordFileWriter.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// the file header for a file started at the time, in nanoseconds since 1970
+typedef NSData * _Nonnull (^DiffusionRecordFileHeaderBlock)(uint64_t startTime);
+
+/**
+
+    Appends binary records to a file through a memory buffer. The event log and the traffic recorder write with it.
+
+    Records are appended to the buffer under a lock, and the buffer is written on a background queue once it is large
+    enough, and at least every second. Record timestamps are nanoseconds since the current file was started. A file
+    can define an ID once, in a record of its own, before the first record using it: the writer keeps track of the IDs
+    defined so far.
+
+    With a maximum file size, a full file is moved aside to URL.1 (URL.1 to URL.2, and so on, up to the maximum file
+    count) and a new one is started, with its own header and definitions. Records appended together always go to the
+    same file.
+
+    Can be used from any thread.
+
+ */
+@interface DiffusionRecordFileWriter : NSObject
+
+@property(nonatomic, readonly) NSURL *URL;
+@property(nonatomic, readonly) NSUInteger recordCount;
+// bytes recorded so far, in every file, including what has not reached the file yet
+@property(nonatomic, readonly) unsigned long long byteCount;
+// 0 (the default) for a single file that grows without limit. a file may go past it by the records appended last
+@property(atomic) unsigned long long maximumFileSize;
+// files kept besides the current one when rotating (default 1)
+@property(atomic) NSUInteger maximumFileCount;
+// files started after the first, because the previous one was full
+@property(nonatomic, readonly) NSUInteger rotationCount;
+
+// replaces any existing file at the URL. the buffer is handed to the writing queue once it holds writeThreshold bytes
+-(nullable instancetype) initWithURL:(NSURL *)URL
+                                name:(NSString *)name
+                      writeThreshold:(NSUInteger)writeThreshold
+                          fileHeader:(DiffusionRecordFileHeaderBlock)fileHeader
+                               error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// runs the block with the writer locked, to append the records that belong together, e.g. a definition and the first
+// record using it. the block is not run once the writer is closed
+- (void)appendRecords:(NS_NOESCAPE void (^)(void))block;
+
+// only from the block of appendRecords:
+// nanoseconds since the current file was started
+- (uint64_t)timestamp;
+// YES the first time the ID of the kind is asked for in the current file: the caller appends its definition
+- (BOOL)defineID:(uint32_t)ID kind:(uint16_t)kind;
+- (void)appendHeader:(const void *)header length:(NSUInteger)headerLength payload:(nullable const void *)payload length:(NSUInteger)payloadLength;
+
+// blocks until everything recorded so far is in the file
+- (void)flush;
+// flushes and closes the file. later records are ignored. also done when the writer is released
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
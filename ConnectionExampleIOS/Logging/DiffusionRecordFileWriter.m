@@ -0,0 +1,293 @@
+//
+//  DiffusionRecordFileWriter.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionRecordFileWriter.h"
+
+#import <os/lock.h>
+#import <time.h>
+
+#import "DiffusionLog.h"
+
+static const NSTimeInterval _WriteInterval = 1.0;
+
+@implementation DiffusionRecordFileWriter
+{
+    DiffusionRecordFileHeaderBlock _fileHeader;
+    NSUInteger _writeThreshold;
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    // only used on the queue
+    NSFileHandle *_file;
+
+    // guards everything below
+    os_unfair_lock _lock;
+    NSMutableData *_buffer;
+    // where the next file starts in the buffer, NSNotFound if it all goes to the current one
+    NSUInteger _rotateAt;
+    BOOL _writeScheduled;
+    BOOL _closed;
+    // when the current file was started, and its size so far
+    uint64_t _start;
+    unsigned long long _fileBytes;
+    // IDs already defined in the current file, the kind in the high 32 bits
+    NSMutableIndexSet *_definedIDs;
+}
+
+@synthesize recordCount = _recordCount;
+@synthesize byteCount = _byteCount;
+@synthesize rotationCount = _rotationCount;
+
+
+-(nullable instancetype) initWithURL:(NSURL *)URL
+                                name:(NSString *)name
+                      writeThreshold:(NSUInteger)writeThreshold
+                          fileHeader:(DiffusionRecordFileHeaderBlock)fileHeader
+                               error:(NSError **)error
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _URL = [URL copy];
+    _fileHeader = [fileHeader copy];
+    _writeThreshold = writeThreshold;
+    _maximumFileCount = 1;
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _buffer = [NSMutableData dataWithCapacity:writeThreshold];
+    _rotateAt = NSNotFound;
+    _definedIDs = [NSMutableIndexSet indexSet];
+    _start = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+
+    NSData *const header = fileHeader(clock_gettime_nsec_np(CLOCK_REALTIME));
+    if (![header writeToURL:URL options:0 error:error])
+    {
+        return nil;
+    }
+    _file = [NSFileHandle fileHandleForWritingToURL:URL error:error];
+    if (!_file)
+    {
+        return nil;
+    }
+    [_file seekToEndOfFile];
+    _fileBytes = header.length;
+
+    _queue = dispatch_queue_create(name.UTF8String, dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_WriteInterval * NSEC_PER_SEC)), (uint64_t)(_WriteInterval * NSEC_PER_SEC), NSEC_PER_SEC / 10);
+    __weak DiffusionRecordFileWriter *weakSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+        [weakSelf writeBuffer];
+    });
+    dispatch_resume(_timer);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer)
+    {
+        dispatch_source_cancel(_timer);
+    }
+    // every block on the queue holds the writer, so nothing else can be using the file any more
+    if (_file)
+    {
+        [self writeData:_buffer rotatingAt:_rotateAt];
+        [_file closeFile];
+    }
+}
+
+
+#pragma mark - appending
+
+- (NSUInteger)recordCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _recordCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (unsigned long long)byteCount
+{
+    os_unfair_lock_lock(&_lock);
+    const unsigned long long count = _byteCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)rotationCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _rotationCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (void)appendRecords:(NS_NOESCAPE void (^)(void))block
+{
+    const unsigned long long maximumFileSize = self.maximumFileSize;
+    os_unfair_lock_lock(&_lock);
+    if (!_closed)
+    {
+        // one rotation at a time: until the full file is written, the new one may grow past the maximum
+        if (maximumFileSize && _fileBytes >= maximumFileSize && _rotateAt == NSNotFound)
+        {
+            [self startNextFile];
+        }
+        block();
+    }
+    os_unfair_lock_unlock(&_lock);
+}
+
+// called with the lock held
+- (void)startNextFile
+{
+    NSData *const header = _fileHeader(clock_gettime_nsec_np(CLOCK_REALTIME));
+    _rotateAt = _buffer.length;
+    _start = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+    [_buffer appendData:header];
+    _fileBytes = header.length;
+    [_definedIDs removeAllIndexes];
+    _rotationCount++;
+    [self scheduleWrite];
+}
+
+// called with the lock held
+- (void)scheduleWrite
+{
+    if (_writeScheduled)
+    {
+        return;
+    }
+    _writeScheduled = YES;
+    dispatch_async(_queue, ^{
+        [self writeBuffer];
+    });
+}
+
+- (uint64_t)timestamp
+{
+    return clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW) - _start;
+}
+
+- (BOOL)defineID:(uint32_t)ID kind:(uint16_t)kind
+{
+    const NSUInteger key = (NSUInteger)kind << 32 | ID;
+    if ([_definedIDs containsIndex:key])
+    {
+        return NO;
+    }
+    [_definedIDs addIndex:key];
+    return YES;
+}
+
+- (void)appendHeader:(const void *)header length:(NSUInteger)headerLength payload:(nullable const void *)payload length:(NSUInteger)payloadLength
+{
+    [_buffer appendBytes:header length:headerLength];
+    if (payloadLength)
+    {
+        [_buffer appendBytes:payload length:payloadLength];
+    }
+    _recordCount++;
+    _byteCount += headerLength + payloadLength;
+    _fileBytes += headerLength + payloadLength;
+
+    if (_buffer.length >= _writeThreshold)
+    {
+        [self scheduleWrite];
+    }
+}
+
+
+#pragma mark - writing
+
+- (void)writeBuffer
+{
+    os_unfair_lock_lock(&_lock);
+    NSData *const pending = _buffer;
+    const NSUInteger rotateAt = _rotateAt;
+    _buffer = [NSMutableData dataWithCapacity:_writeThreshold];
+    _rotateAt = NSNotFound;
+    _writeScheduled = NO;
+    os_unfair_lock_unlock(&_lock);
+
+    [self writeData:pending rotatingAt:rotateAt];
+}
+
+// on the queue
+- (void)writeData:(NSData *)data rotatingAt:(NSUInteger)rotateAt
+{
+    if (!_file)
+    {
+        return;
+    }
+    if (rotateAt == NSNotFound)
+    {
+        if (data.length)
+        {
+            [_file writeData:data];
+        }
+        return;
+    }
+
+    [_file writeData:[data subdataWithRange:NSMakeRange(0, rotateAt)]];
+    [_file closeFile];
+    _file = nil;
+    [self moveFilesAside];
+
+    NSError *error = nil;
+    NSData *const next = [data subdataWithRange:NSMakeRange(rotateAt, data.length - rotateAt)];
+    if (![next writeToURL:_URL options:0 error:&error] || !(_file = [NSFileHandle fileHandleForWritingToURL:_URL error:&error]))
+    {
+        DiffusionLogError(@"DiffusionRecordFileWriter: failed to start %@: %@", _URL.lastPathComponent, error);
+        return;
+    }
+    [_file seekToEndOfFile];
+}
+
+- (NSURL *)URLOfFileAside:(NSUInteger)index
+{
+    return [_URL URLByAppendingPathExtension:[NSString stringWithFormat:@"%lu", (unsigned long)index]];
+}
+
+- (void)moveFilesAside
+{
+    NSFileManager *const fileManager = NSFileManager.defaultManager;
+    const NSUInteger count = MAX(self.maximumFileCount, (NSUInteger)1);
+    [fileManager removeItemAtURL:[self URLOfFileAside:count] error:nil];
+    for (NSUInteger index = count; index > 1; index--)
+    {
+        [fileManager moveItemAtURL:[self URLOfFileAside:index - 1] toURL:[self URLOfFileAside:index] error:nil];
+    }
+    [fileManager moveItemAtURL:_URL toURL:[self URLOfFileAside:1] error:nil];
+}
+
+- (void)flush
+{
+    dispatch_sync(_queue, ^{
+        [self writeBuffer];
+    });
+}
+
+- (void)close
+{
+    os_unfair_lock_lock(&_lock);
+    _closed = YES;
+    os_unfair_lock_unlock(&_lock);
+
+    dispatch_source_cancel(_timer);
+    dispatch_sync(_queue, ^{
+        [self writeBuffer];
+        [self->_file closeFile];
+        self->_file = nil;
+    });
+}
+
+@end
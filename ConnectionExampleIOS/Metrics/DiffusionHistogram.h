@@ -0,0 +1,52 @@
+//
+//  DiffusionHistogram.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// a copy of the counts of a histogram at one point in time
+@interface DiffusionHistogramSnapshot : NSObject
+
+@property(nonatomic, readonly) uint64_t count;
+@property(nonatomic, readonly) uint64_t minimum;
+@property(nonatomic, readonly) uint64_t maximum;
+@property(nonatomic, readonly) double mean;
+
+// the highest value equivalent to the one at the percentile (0 to 100)
+- (uint64_t)valueAtPercentile:(double)percentile;
+
+// count, min, max, mean, p50, p90, p99, p99.9. for JSON export
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation;
+
+@end
+
+/**
+
+    A histogram of integer values (typically microseconds) in the style of HdrHistogram.
+
+    Values are counted in log-linear buckets: exact up to 127, then 64 buckets per power of 2, so any value is known to
+    within 1.6% whatever its magnitude, in a fixed 18KB. Values from 2^40 up are counted as 2^40 - 1.
+    Recording is a few relaxed atomic increments and can be done from any thread; a snapshot copies the counts
+    without stopping the threads recording.
+
+ */
+@interface DiffusionHistogram : NSObject
+
++ (uint64_t)highestTrackableValue;
+
+- (void)recordValue:(uint64_t)value;
+// in microseconds
+- (void)recordTimeInterval:(NSTimeInterval)interval;
+
+- (DiffusionHistogramSnapshot *)snapshot;
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
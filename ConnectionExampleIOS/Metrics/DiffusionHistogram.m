@@ -0,0 +1,186 @@
+//
+//  DiffusionHistogram.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionHistogram.h"
+
+#import <stdatomic.h>
+
+// 128 exact values, then buckets of 64 sub-buckets per power of 2 up to 2^40
+#define DIFFUSION_HISTOGRAM_SUB_BUCKET_BITS 7
+#define DIFFUSION_HISTOGRAM_SUB_BUCKETS (1u << DIFFUSION_HISTOGRAM_SUB_BUCKET_BITS)
+#define DIFFUSION_HISTOGRAM_HALF (DIFFUSION_HISTOGRAM_SUB_BUCKETS / 2)
+#define DIFFUSION_HISTOGRAM_MAXIMUM_BITS 40
+#define DIFFUSION_HISTOGRAM_COUNTS (DIFFUSION_HISTOGRAM_SUB_BUCKETS + (DIFFUSION_HISTOGRAM_MAXIMUM_BITS - DIFFUSION_HISTOGRAM_SUB_BUCKET_BITS) * DIFFUSION_HISTOGRAM_HALF)
+
+static const uint64_t _HighestTrackableValue = (1ull << DIFFUSION_HISTOGRAM_MAXIMUM_BITS) - 1;
+
+static inline NSUInteger _IndexOfValue(uint64_t value)
+{
+    if (value < DIFFUSION_HISTOGRAM_SUB_BUCKETS)
+    {
+        return (NSUInteger)value;
+    }
+    // values of the bucket share their top 7 bits
+    const unsigned shift = (63 - (unsigned)__builtin_clzll(value)) - (DIFFUSION_HISTOGRAM_SUB_BUCKET_BITS - 1);
+    return DIFFUSION_HISTOGRAM_SUB_BUCKETS + (shift - 1) * DIFFUSION_HISTOGRAM_HALF + (NSUInteger)((value >> shift) - DIFFUSION_HISTOGRAM_HALF);
+}
+
+static inline uint64_t _HighestValueAtIndex(NSUInteger index)
+{
+    if (index < DIFFUSION_HISTOGRAM_SUB_BUCKETS)
+    {
+        return index;
+    }
+    const unsigned shift = (unsigned)((index - DIFFUSION_HISTOGRAM_SUB_BUCKETS) / DIFFUSION_HISTOGRAM_HALF) + 1;
+    const uint64_t subBucket = (index - DIFFUSION_HISTOGRAM_SUB_BUCKETS) % DIFFUSION_HISTOGRAM_HALF + DIFFUSION_HISTOGRAM_HALF;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+
+@implementation DiffusionHistogramSnapshot
+{
+    NSData *_counts;
+}
+
+- (instancetype)initWithCounts:(NSData *)counts count:(uint64_t)count minimum:(uint64_t)minimum maximum:(uint64_t)maximum sum:(uint64_t)sum
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _counts = counts;
+    _count = count;
+    _minimum = count ? minimum : 0;
+    _maximum = maximum;
+    _mean = count ? (double)sum / count : 0;
+
+    return self;
+}
+
+- (uint64_t)valueAtPercentile:(double)percentile
+{
+    if (!_count)
+    {
+        return 0;
+    }
+    const uint64_t *const counts = _counts.bytes;
+    const NSUInteger length = _counts.length / sizeof(uint64_t);
+    const uint64_t target = MAX((uint64_t)ceil(MIN(MAX(percentile, 0.0), 100.0) / 100.0 * _count), (uint64_t)1);
+    uint64_t seen = 0;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        seen += counts[i];
+        if (seen >= target)
+        {
+            return MIN(_HighestValueAtIndex(i), _maximum);
+        }
+    }
+    return _maximum;
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation
+{
+    return @{
+        @"count": @(_count),
+        @"min": @(_minimum),
+        @"max": @(_maximum),
+        @"mean": @(_mean),
+        @"p50": @([self valueAtPercentile:50]),
+        @"p90": @([self valueAtPercentile:90]),
+        @"p99": @([self valueAtPercentile:99]),
+        @"p99.9": @([self valueAtPercentile:99.9]),
+    };
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"count %llu, min %llu, p50 %llu, p99 %llu, max %llu", _count, _minimum, [self valueAtPercentile:50], [self valueAtPercentile:99], _maximum];
+}
+
+@end
+
+
+@implementation DiffusionHistogram
+{
+    _Atomic(uint64_t) _counts[DIFFUSION_HISTOGRAM_COUNTS];
+    _Atomic(uint64_t) _sum;
+    _Atomic(uint64_t) _minimum;
+    _Atomic(uint64_t) _maximum;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    // the counts are zeroed by alloc
+    atomic_store_explicit(&_minimum, UINT64_MAX, memory_order_relaxed);
+
+    return self;
+}
+
++ (uint64_t)highestTrackableValue
+{
+    return _HighestTrackableValue;
+}
+
+- (void)recordValue:(uint64_t)value
+{
+    value = MIN(value, _HighestTrackableValue);
+    atomic_fetch_add_explicit(&_counts[_IndexOfValue(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_sum, value, memory_order_relaxed);
+
+    uint64_t current = atomic_load_explicit(&_minimum, memory_order_relaxed);
+    while (value < current && !atomic_compare_exchange_weak_explicit(&_minimum, &current, value, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+    current = atomic_load_explicit(&_maximum, memory_order_relaxed);
+    while (value > current && !atomic_compare_exchange_weak_explicit(&_maximum, &current, value, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+- (void)recordTimeInterval:(NSTimeInterval)interval
+{
+    [self recordValue:interval > 0 ? (uint64_t)llround(interval * 1e6) : 0];
+}
+
+- (DiffusionHistogramSnapshot *)snapshot
+{
+    NSMutableData *const counts = [NSMutableData dataWithLength:sizeof(uint64_t) * DIFFUSION_HISTOGRAM_COUNTS];
+    uint64_t *const copy = counts.mutableBytes;
+    uint64_t count = 0;
+    for (NSUInteger i = 0; i < DIFFUSION_HISTOGRAM_COUNTS; i++)
+    {
+        copy[i] = atomic_load_explicit(&_counts[i], memory_order_relaxed);
+        count += copy[i];
+    }
+    // the total is taken from the copied counts, so that percentiles are consistent with them
+    return [[DiffusionHistogramSnapshot alloc] initWithCounts:counts
+                                                        count:count
+                                                      minimum:atomic_load_explicit(&_minimum, memory_order_relaxed)
+                                                      maximum:atomic_load_explicit(&_maximum, memory_order_relaxed)
+                                                          sum:atomic_load_explicit(&_sum, memory_order_relaxed)];
+}
+
+- (void)reset
+{
+    for (NSUInteger i = 0; i < DIFFUSION_HISTOGRAM_COUNTS; i++)
+    {
+        atomic_store_explicit(&_counts[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&_sum, 0, memory_order_relaxed);
+    atomic_store_explicit(&_minimum, UINT64_MAX, memory_order_relaxed);
+    atomic_store_explicit(&_maximum, 0, memory_order_relaxed);
+}
+
+@end
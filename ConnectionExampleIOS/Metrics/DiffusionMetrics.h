@@ -0,0 +1,65 @@
+//
+//  DiffusionMetrics.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionHistogram.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// every histogram and counter of DiffusionMetrics at one point in time
+@interface DiffusionMetricsSnapshot : NSObject
+
+@property(nonatomic, readonly) NSDate *date;
+// keyed by the names of the DiffusionMetrics properties
+@property(nonatomic, readonly) NSDictionary<NSString *, DiffusionHistogramSnapshot *> *histograms;
+@property(nonatomic, readonly) NSDictionary<NSString *, NSNumber *> *counters;
+
+// plain dictionaries and numbers, ready for NSJSONSerialization
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+/**
+
+    Latency histograms and counters of a DiffusionManager. Times are in microseconds.
+
+    Everything can be recorded from any thread and a snapshot can be taken at any time, from any thread, without
+    pausing delivery.
+
+ */
+@interface DiffusionMetrics : NSObject
+
+@property(nonatomic, readonly) DiffusionHistogram *pingRoundTripTime;
+// from a session opening to its first update
+@property(nonatomic, readonly) DiffusionHistogram *timeToFirstUpdate;
+// from sending a subscribe request to its completion
+@property(nonatomic, readonly) DiffusionHistogram *subscribeRoundTripTime;
+// between two updates of the same topic, all topics together
+@property(nonatomic, readonly) DiffusionHistogram *updateInterArrivalTime;
+// running the update handlers of one update
+@property(nonatomic, readonly) DiffusionHistogram *handlerExecutionTime;
+
+// counters
+@property(nonatomic, readonly) uint64_t updateCount;
+@property(nonatomic, readonly) uint64_t byteCount;
+// sessions that recovered their connection
+@property(nonatomic, readonly) uint64_t reconnectCount;
+// sessions closed and replaced by a new one
+@property(nonatomic, readonly) uint64_t sessionReplacementCount;
+
+- (void)noteUpdateOfLength:(NSUInteger)length;
+- (void)noteReconnect;
+- (void)noteSessionReplacement;
+
+- (DiffusionMetricsSnapshot *)snapshot;
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,155 @@
+//
+//  DiffusionMetrics.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionMetrics.h"
+
+#import <stdatomic.h>
+
+@implementation DiffusionMetricsSnapshot
+
+- (instancetype)initWithHistograms:(NSDictionary<NSString *, DiffusionHistogramSnapshot *> *)histograms counters:(NSDictionary<NSString *, NSNumber *> *)counters
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _date = [NSDate date];
+    _histograms = [histograms copy];
+    _counters = [counters copy];
+
+    return self;
+}
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    NSMutableDictionary<NSString *, id> *const histograms = [NSMutableDictionary dictionaryWithCapacity:_histograms.count];
+    [_histograms enumerateKeysAndObjectsUsingBlock:^(NSString *name, DiffusionHistogramSnapshot *histogram, BOOL *stop) {
+        histograms[name] = histogram.dictionaryRepresentation;
+    }];
+    return @{
+        @"timestamp": @(_date.timeIntervalSince1970),
+        @"histograms": histograms,
+        @"counters": _counters,
+    };
+}
+
+- (NSString *)description
+{
+    NSMutableString *const description = [NSMutableString stringWithFormat:@"%@", _counters];
+    for (NSString *name in [_histograms.allKeys sortedArrayUsingSelector:@selector(compare:)])
+    {
+        [description appendFormat:@"\n%@: %@", name, _histograms[name]];
+    }
+    return description;
+}
+
+@end
+
+
+@implementation DiffusionMetrics
+{
+    _Atomic(uint64_t) _updates;
+    _Atomic(uint64_t) _bytes;
+    _Atomic(uint64_t) _reconnects;
+    _Atomic(uint64_t) _replacements;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _pingRoundTripTime = [[DiffusionHistogram alloc] init];
+    _timeToFirstUpdate = [[DiffusionHistogram alloc] init];
+    _subscribeRoundTripTime = [[DiffusionHistogram alloc] init];
+    _updateInterArrivalTime = [[DiffusionHistogram alloc] init];
+    _handlerExecutionTime = [[DiffusionHistogram alloc] init];
+
+    return self;
+}
+
+
+- (uint64_t)updateCount
+{
+    return atomic_load_explicit(&_updates, memory_order_relaxed);
+}
+
+- (uint64_t)byteCount
+{
+    return atomic_load_explicit(&_bytes, memory_order_relaxed);
+}
+
+- (uint64_t)reconnectCount
+{
+    return atomic_load_explicit(&_reconnects, memory_order_relaxed);
+}
+
+- (uint64_t)sessionReplacementCount
+{
+    return atomic_load_explicit(&_replacements, memory_order_relaxed);
+}
+
+- (void)noteUpdateOfLength:(NSUInteger)length
+{
+    atomic_fetch_add_explicit(&_updates, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_bytes, length, memory_order_relaxed);
+}
+
+- (void)noteReconnect
+{
+    atomic_fetch_add_explicit(&_reconnects, 1, memory_order_relaxed);
+}
+
+- (void)noteSessionReplacement
+{
+    atomic_fetch_add_explicit(&_replacements, 1, memory_order_relaxed);
+}
+
+- (NSDictionary<NSString *, DiffusionHistogram *> *)histogramsByName
+{
+    return @{
+        @"pingRoundTripTime": _pingRoundTripTime,
+        @"timeToFirstUpdate": _timeToFirstUpdate,
+        @"subscribeRoundTripTime": _subscribeRoundTripTime,
+        @"updateInterArrivalTime": _updateInterArrivalTime,
+        @"handlerExecutionTime": _handlerExecutionTime,
+    };
+}
+
+- (DiffusionMetricsSnapshot *)snapshot
+{
+    NSMutableDictionary<NSString *, DiffusionHistogramSnapshot *> *const histograms = [NSMutableDictionary dictionary];
+    [[self histogramsByName] enumerateKeysAndObjectsUsingBlock:^(NSString *name, DiffusionHistogram *histogram, BOOL *stop) {
+        histograms[name] = histogram.snapshot;
+    }];
+    NSDictionary<NSString *, NSNumber *> *const counters = @{
+        @"updateCount": @(self.updateCount),
+        @"byteCount": @(self.byteCount),
+        @"reconnectCount": @(self.reconnectCount),
+        @"sessionReplacementCount": @(self.sessionReplacementCount),
+    };
+    return [[DiffusionMetricsSnapshot alloc] initWithHistograms:histograms counters:counters];
+}
+
+- (void)reset
+{
+    for (DiffusionHistogram *histogram in [self histogramsByName].allValues)
+    {
+        [histogram reset];
+    }
+    atomic_store_explicit(&_updates, 0, memory_order_relaxed);
+    atomic_store_explicit(&_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&_reconnects, 0, memory_order_relaxed);
+    atomic_store_explicit(&_replacements, 0, memory_order_relaxed);
+}
+
+@end
@@ -8,14 +8,57 @@
 
 #import <Diffusion/Diffusion.h>
 
+#import "DiffusionScheduler.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
+@class DiffusionConnectionHealth;
+
+typedef NS_ENUM(NSInteger, BackOffMode) {
+    // 0, 1, 2, 3... times the base delay
+    BackOffModeLinear = 0,
+    // 0, 1, 2, 4, 8... times the base delay
+    BackOffModeExponential = 1,
+    // each delay drawn between the base delay and three times the previous one
+    BackOffModeDecorrelatedJitter = 2,
+};
+
 @interface BackOffReconnectionStrategy: NSObject<PTDiffusionSessionReconnectionStrategy>
 
 @property(nonatomic, readonly) NSTimeInterval maxDelay;
+// default BackOffModeLinear
+@property(nonatomic) BackOffMode mode;
+// the step of every mode, in seconds (default 1)
+@property(nonatomic) NSTimeInterval baseDelay;
+// fraction of each linear or exponential delay that is randomised (default 0). 1 draws each delay anywhere between 0
+// and its nominal value, so a fleet dropped at once does not come back at once
+@property(nonatomic) double jitter;
+// seeds the random numbers of the jitter. the same seed gives the same delays. seeded at random by default
+@property(nonatomic) uint64_t seed;
+// delays and the clock of the decisions (default: the main queue, on CLOCK_UPTIME_RAW, which stops while the device
+// sleeps)
+@property(nonatomic) id<DiffusionScheduler> scheduler;
+// when set, reconnecting from a degraded connection waits longer: a poor network is not worth hammering. it must be fed
+// with times from the clock of the scheduler
+@property(nonatomic, weak, nullable) DiffusionConnectionHealth *health;
+// default NO. attempts are reset when the session reaches connected. when set, they are also reset when the strategy is
+// called after more than twice the delay it would give, taken to mean the previous attempt worked
+@property(nonatomic) BOOL resetsAfterQuietPeriod;
+
+// attempts since the session was last connected
+@property(nonatomic, readonly) NSUInteger attemptCount;
+// delays of the latest attempts of the session, oldest first. a few only are kept
+@property(nonatomic, readonly) NSArray<NSNumber *> *recentAttemptDelays;
 
 -(instancetype) initWithMaxDelay:(const NSTimeInterval)delay;
 
+// the decision alone: how long to wait before the attempt being requested now. counts it as made
+- (NSTimeInterval)delayBeforeNextAttempt;
+// the same at a time of the scheduler's clock, in seconds, so a simulation can drive it with a clock of its own
+- (NSTimeInterval)delayBeforeAttemptAtTime:(NSTimeInterval)now;
+// forgets the attempts made, as when the session is connected again. done by the strategy itself for the sessions it reconnects
+- (void)reset;
+
 
 @end
 
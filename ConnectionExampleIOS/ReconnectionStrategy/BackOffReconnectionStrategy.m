@@ -8,13 +8,28 @@
 
 #import "BackOffReconnectionStrategy.h"
 
+#import "DiffusionConnectionHealth.h"
+#import "DiffusionLog.h"
+#import "DiffusionRandom.h"
+
+#define BACK_OFF_HISTORY_SIZE 16
+
 @implementation BackOffReconnectionStrategy
 {
+    // attempts since the session was last connected
     int _currentAttempt;
-    NSDate * _lastConnectionAttempt;
-}
+    // the last delay drawn by the decorrelated jitter
+    NSTimeInterval _previousDelay;
+    uint64_t _random;
 
-static const NSTimeInterval _delayIncrementation = 1.0;
+    // the latest attempts of the session, times on the clock of the scheduler in seconds. _historyCount keeps counting past the ring
+    NSTimeInterval _historyTimes[BACK_OFF_HISTORY_SIZE];
+    NSTimeInterval _historyDelays[BACK_OFF_HISTORY_SIZE];
+    NSUInteger _historyCount;
+
+    __weak PTDiffusionSession *_session;
+    id<NSObject> _observer;
+}
 
 @synthesize maxDelay = _maxDelay;
 
@@ -24,8 +39,14 @@ static const NSTimeInterval _delayIncrementation = 1.0;
  
     When this strategy is called for the first time in its session, the reconnection attempt is immediate
     If the first attempt fails, it waits for 1.0 seconds before trying again. Each subsequent failed attempt will increase the delay by another 1.0 seconds
-    If this reconnection strategy is called after an interval greater than the last reconnection attempt delay, it considers that the last attempt was a successful one, and reset the attempt counter.
-    For each reconnection attempt, the attempt timestamp is registered in the reconnection strategy
+    When the session it reconnects reaches the connected state again, the attempt counter is reset
+    For each reconnection attempt, the attempt timestamp and delay are registered in a small ring, kept per session
+    If a connection health is set and its score is below the degraded threshold, even the first attempt waits, and every delay is stretched by up to twice, still capped by the max delay
+
+    The exponential mode doubles the delay instead of adding to it. Either can be jittered, which draws each delay at random
+    below its nominal value, the first one as well.
+    The decorrelated jitter mode draws the first delay below the base delay and each next one between the base delay and
+    three times the previous one. Clients that failed together drift apart after a few attempts, and the delays still grow.
                  
  */
 -(instancetype) initWithMaxDelay:(const NSTimeInterval)delay
@@ -37,50 +58,189 @@ static const NSTimeInterval _delayIncrementation = 1.0;
     }
     _maxDelay = delay;
     _currentAttempt = 0;
+    _mode = BackOffModeLinear;
+    _baseDelay = 1.0;
+    _jitter = 0.0;
+    _scheduler = DiffusionDispatchScheduler.mainQueueScheduler;
+    
+    uint64_t seed;
+    arc4random_buf(&seed, sizeof(seed));
+    self.seed = seed;
     
     return self;
 }
 
+- (void)dealloc
+{
+    if (_observer)
+    {
+        [NSNotificationCenter.defaultCenter removeObserver:_observer];
+    }
+}
+
+
+- (void)setSeed:(uint64_t)seed
+{
+    _seed = seed;
+    _random = seed;
+}
+
+// in [0, 1)
+- (double)nextRandom
+{
+    return DiffusionRandomNext(&_random);
+}
+
+// the delay of the current attempt before any jitter, capped by the max delay. for the decorrelated jitter, the most it can be
+- (NSTimeInterval)nominalDelay
+{
+    switch (_mode)
+    {
+        case BackOffModeExponential:
+            return _currentAttempt == 0 ? 0.0 : MIN(_baseDelay * ldexp(1.0, MIN(_currentAttempt - 1, 62)), _maxDelay);
+        case BackOffModeDecorrelatedJitter:
+            return _currentAttempt == 0 ? MIN(_baseDelay, _maxDelay) : MIN(MAX(_previousDelay * 3.0, _baseDelay), _maxDelay);
+        case BackOffModeLinear:
+        default:
+            return MIN(_currentAttempt * _baseDelay, _maxDelay);
+    }
+}
+
+- (NSTimeInterval)drawDelay
+{
+    const NSTimeInterval nominal = [self nominalDelay];
+    if (_mode == BackOffModeDecorrelatedJitter)
+    {
+        const NSTimeInterval low = _currentAttempt == 0 ? 0.0 : MIN(_baseDelay, nominal);
+        _previousDelay = low + [self nextRandom] * (nominal - low);
+        return _previousDelay;
+    }
+    if (_jitter <= 0.0)
+    {
+        return nominal;
+    }
+    // the first attempt, immediate otherwise, is spread below the base delay
+    const double jitter = MIN(_jitter, 1.0);
+    return MIN(nominal * (1.0 - jitter) + jitter * [self nextRandom] * MAX(nominal, _baseDelay), _maxDelay);
+}
+
 
 - (void)diffusionSession:(PTDiffusionSession *)session wishesToReconnectWithAttempt:(PTDiffusionSessionReconnectionAttempt *)attempt
 {
-    // calculate the delay based on the amount of attempts while reconnecting to the server
-    NSTimeInterval delay = MIN(_currentAttempt * _delayIncrementation, _maxDelay);
-    
-    // if a connection attempt was made in the past of this session, _lastConnectionAttempt has a value set)
-    if (_lastConnectionAttempt)
+    // decisions and state changes are all made on the scheduler's queue
+    id<DiffusionScheduler> const scheduler = _scheduler;
+    [scheduler scheduleAfterDelay:0 block:^{
+        [self observeSession:session];
+        const NSTimeInterval delay = [self delayBeforeNextAttempt];
+        
+        // wait for [delay] seconds and attempt to reconnect
+        [scheduler scheduleAfterDelay:delay block:^{
+            DiffusionLogInfo(@"BackOffReconnectionStrategy --> attempt starting now");
+            [attempt start];
+        }];
+    }];
+}
+
+- (void)observeSession:(PTDiffusionSession *)session
+{
+    if (session == _session)
+    {
+        return;
+    }
+    if (_observer)
+    {
+        [NSNotificationCenter.defaultCenter removeObserver:_observer];
+    }
+    // the history is per session
+    _session = session;
+    [self reset];
+    _historyCount = 0;
+    __weak typeof(self) weakSelf = self;
+    _observer = [NSNotificationCenter.defaultCenter addObserverForName:PTDiffusionSessionStateDidChangeNotification object:session queue:NSOperationQueue.mainQueue usingBlock:^(NSNotification * _Nonnull note) {
+        PTDiffusionSessionStateChange *const change = note.userInfo[PTDiffusionSessionStateChangeUserInfoKey];
+        if (change.state.isConnected && !change.previousState.isConnected)
+        {
+            // on the scheduler's queue, with the decisions
+            [weakSelf.scheduler scheduleAfterDelay:0 block:^{
+                [weakSelf reset];
+            }];
+        }
+    }];
+}
+
+- (void)reset
+{
+    if (_currentAttempt > 0)
+    {
+        DiffusionLogInfo(@"BackOffReconnectionStrategy --> connected after %d attempts, reseting the reconnection attempts", _currentAttempt);
+    }
+    _currentAttempt = 0;
+    _previousDelay = 0.0;
+}
+
+- (NSUInteger)attemptCount
+{
+    return (NSUInteger)_currentAttempt;
+}
+
+- (NSArray<NSNumber *> *)recentAttemptDelays
+{
+    const NSUInteger count = MIN(_historyCount, (NSUInteger)BACK_OFF_HISTORY_SIZE);
+    NSMutableArray<NSNumber *> *const delays = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = _historyCount - count; i < _historyCount; i++)
     {
-        NSTimeInterval elapsedSinceLastConnection = [[NSDate date] timeIntervalSinceDate:_lastConnectionAttempt];
-        NSLog(@"BackOffReconnectionStrategy --> elapsed time since last attempt: %g", elapsedSinceLastConnection);
+        [delays addObject:@(_historyDelays[i % BACK_OFF_HISTORY_SIZE])];
+    }
+    return delays;
+}
+
+- (NSTimeInterval)delayBeforeNextAttempt
+{
+    // the health must be fed with times from the scheduler's clock, as the manager does with its timer wheel
+    return [self delayBeforeAttemptAtTime:_scheduler.currentTime];
+}
+
+- (NSTimeInterval)delayBeforeAttemptAtTime:(NSTimeInterval)now
+{
+    // if a connection attempt was made in the past of this session, the ring has it
+    if (_resetsAfterQuietPeriod && _historyCount > 0)
+    {
+        NSTimeInterval elapsedSinceLastConnection = now - _historyTimes[(_historyCount - 1) % BACK_OFF_HISTORY_SIZE];
+        DiffusionLogDebug(@"BackOffReconnectionStrategy --> elapsed time since last attempt: %g", elapsedSinceLastConnection);
         
         // if it elapsed more time than twice the expected delay for the last connection attempt (max delay is 5.0s, so if at least 10.0s have elapsed)
         // then we consider than the last attempt was successful and reset the attempt counter
-        if (elapsedSinceLastConnection > delay * 2)
+        if (elapsedSinceLastConnection > [self nominalDelay] * 2)
         {
-            NSLog(@"BackOffReconnectionStrategy --> previous attempt was successful, reseting the reconnection attempts");
+            DiffusionLogInfo(@"BackOffReconnectionStrategy --> previous attempt was successful, reseting the reconnection attempts");
             
             // the session is attempting to reconnect again since last disconnection, reset the attempt counter
             _currentAttempt = 0;
-            
-            // recalculate the delay as well
-            delay = MIN(_currentAttempt * _delayIncrementation, _maxDelay);
+            _previousDelay = 0.0;
         }
     }
-    // last connection timestamp is being set here (without taking into consideration the delay that is calculated right after
-    // this is to prevent multiple calls being made while waiting for the delay
-    _lastConnectionAttempt = [NSDate date];
     
+    // calculate the delay based on the amount of attempts while reconnecting to the server
+    NSTimeInterval delay = [self drawDelay];
+    
+    const double score = [_health scoreAtTime:now];
+    if (_health && score < _health.degradedThreshold)
+    {
+        delay = MIN(MAX(delay, _baseDelay) * (2.0 - score), _maxDelay);
+        DiffusionLogInfo(@"BackOffReconnectionStrategy --> connection was degraded (health %.2f), delay stretched to %g", score, delay);
+    }
+    
+    DiffusionLogInfo(@"BackOffReconnectionStrategy --> session wishes to reconnect. Current state of strategy --> attempt:[%d] delay:[%g] maxDelay:[%g]", _currentAttempt + 1, delay, _maxDelay);
     
-    NSLog(@"BackOffReconnectionStrategy --> session wishes to reconnect. Current state of strategy --> attempt:[%d] delay:[%g] maxDelay:[%g]", _currentAttempt + 1, delay, _maxDelay);
+    // the attempt timestamp is registered when it is requested, not when it starts after the delay
+    _historyTimes[_historyCount % BACK_OFF_HISTORY_SIZE] = now;
+    _historyDelays[_historyCount % BACK_OFF_HISTORY_SIZE] = delay;
+    _historyCount++;
     
-    // increment the attempt counter for the next time this is called and for future calculations of when the connection actually happened
+    // increment the attempt counter for the next time this is called
     _currentAttempt += 1;
     
-    // wait for [delay] seconds and attempt to reconnect
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-        NSLog(@"BackOffReconnectionStrategy --> attempt starting now");
-        [attempt start];
-    });
+    return delay;
 }
 
 @end
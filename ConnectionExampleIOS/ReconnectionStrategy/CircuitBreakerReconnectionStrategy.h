@@ -0,0 +1,87 @@
+//
+//  CircuitBreakerReconnectionStrategy.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Diffusion/Diffusion.h>
+
+#import "DiffusionScheduler.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class BackOffReconnectionStrategy;
+
+typedef NS_ENUM(NSInteger, CircuitBreakerState) {
+    // attempts follow the back-off
+    CircuitBreakerStateClosed = 0,
+    // the server is taken as down: only probes, on the probe interval
+    CircuitBreakerStateOpen = 1,
+    // a probe succeeded, or an attempt is standing in for one: the next result decides
+    CircuitBreakerStateHalfOpen = 2,
+};
+
+// what to do with the attempt once the delay is over
+typedef NS_ENUM(NSInteger, CircuitBreakerAction) {
+    CircuitBreakerActionStart = 0,
+    CircuitBreakerActionProbe = 1,
+    CircuitBreakerActionAbort = 2,
+};
+
+// checks the server is reachable without a session handshake, and says so once
+typedef void (^CircuitBreakerProbe)(void (^completionHandler)(BOOL reachable));
+
+/**
+
+    Wraps a back-off strategy with a circuit breaker, so a server that is clearly down is not hammered for as long as
+    the session is allowed to reconnect.
+
+    After failureThreshold consecutive failed attempts the circuit opens: the attempt is held, and the probe is run once
+    every probe interval. When a probe succeeds the attempt starts at once. Without a probe the attempt itself stands in
+    for one. When the session reaches connected again the circuit closes.
+
+    An attempt that could only start once the session's reconnection timeout is over is aborted straight away, since the
+    session would be closed by then anyway.
+
+ */
+@interface CircuitBreakerReconnectionStrategy : NSObject<PTDiffusionSessionReconnectionStrategy>
+
+@property(nonatomic, readonly) BackOffReconnectionStrategy *backOff;
+// consecutive failed attempts that open the circuit (default 5)
+@property(nonatomic) NSUInteger failureThreshold;
+// seconds between two probes while open (default 60). keep it well under the reconnection timeout, or the session
+// gives up before the first probe
+@property(nonatomic) NSTimeInterval probeInterval;
+// nil (the default) lets the attempt itself be the probe
+@property(nonatomic, copy, nullable) CircuitBreakerProbe probe;
+// for a session whose configuration has none. negative (the default) does not limit reconnecting
+@property(nonatomic) NSTimeInterval reconnectionTimeout;
+// delays and the clock of the decisions (default: the main queue, on CLOCK_UPTIME_RAW, which stops while the device
+// sleeps)
+@property(nonatomic) id<DiffusionScheduler> scheduler;
+
+@property(nonatomic, readonly) CircuitBreakerState state;
+
+// counters
+@property(nonatomic, readonly) NSUInteger startedCount;
+@property(nonatomic, readonly) NSUInteger probeCount;
+@property(nonatomic, readonly) NSUInteger openedCount;
+@property(nonatomic, readonly) NSUInteger abortedCount;
+// attempts the back-off alone would have started while the circuit was open
+@property(nonatomic, readonly) NSUInteger avoidedCount;
+
+-(instancetype) initWithBackOffStrategy:(BackOffReconnectionStrategy *)backOff NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// the decision alone, at a time of the scheduler's clock, in seconds. a negative timeout does not limit reconnecting
+- (CircuitBreakerAction)actionForAttemptAtTime:(NSTimeInterval)now reconnectionTimeout:(NSTimeInterval)timeout delay:(NSTimeInterval *)delay;
+// after a probe: start now, probe again after the delay, or abort
+- (CircuitBreakerAction)actionAfterProbe:(BOOL)reachable atTime:(NSTimeInterval)now reconnectionTimeout:(NSTimeInterval)timeout delay:(NSTimeInterval *)delay;
+// the session is connected again: closes the circuit. done by the strategy itself for the sessions it reconnects
+- (void)noteConnected;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,265 @@
+//
+//  CircuitBreakerReconnectionStrategy.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "CircuitBreakerReconnectionStrategy.h"
+
+#import "BackOffReconnectionStrategy.h"
+#import "DiffusionLog.h"
+
+@implementation CircuitBreakerReconnectionStrategy
+{
+    // all state is on the scheduler's queue
+    BOOL _reconnecting;
+    NSTimeInterval _outageStart;
+    NSUInteger _failures;
+    NSTimeInterval _nextProbe;
+
+    __weak PTDiffusionSession *_session;
+    id<NSObject> _observer;
+}
+
+
+-(instancetype) initWithBackOffStrategy:(BackOffReconnectionStrategy *)backOff
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _backOff = backOff;
+    _failureThreshold = 5;
+    _probeInterval = 60.0;
+    _state = CircuitBreakerStateClosed;
+    _reconnectionTimeout = -1.0;
+    _scheduler = DiffusionDispatchScheduler.mainQueueScheduler;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_observer)
+    {
+        [NSNotificationCenter.defaultCenter removeObserver:_observer];
+    }
+}
+
+
+#pragma mark - Decisions
+
+- (CircuitBreakerAction)actionForAttemptAtTime:(NSTimeInterval)now reconnectionTimeout:(NSTimeInterval)timeout delay:(NSTimeInterval *)delay
+{
+    // the first call of an outage is the disconnection, every next one a failed attempt
+    if (!_reconnecting)
+    {
+        _reconnecting = YES;
+        _outageStart = now;
+        _failures = 0;
+    }
+    else
+    {
+        _failures++;
+    }
+
+    if (_state == CircuitBreakerStateHalfOpen)
+    {
+        DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> attempt after a probe failed, circuit open again");
+        _state = CircuitBreakerStateOpen;
+        _nextProbe = now + _probeInterval;
+    }
+    else if (_state == CircuitBreakerStateClosed && _failures >= _failureThreshold)
+    {
+        DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> %lu consecutive failures, circuit open", (unsigned long)_failures);
+        _state = CircuitBreakerStateOpen;
+        _openedCount++;
+        _nextProbe = now + _probeInterval;
+    }
+
+    NSTimeInterval wait;
+    CircuitBreakerAction action;
+    if (_state == CircuitBreakerStateClosed)
+    {
+        wait = [_backOff delayBeforeAttemptAtTime:now];
+        action = CircuitBreakerActionStart;
+    }
+    else
+    {
+        wait = MAX(_nextProbe - now, 0.0);
+        action = _probe ? CircuitBreakerActionProbe : CircuitBreakerActionStart;
+    }
+
+    if ([self isTimedOut:timeout atTime:now + wait])
+    {
+        *delay = 0.0;
+        return [self abort];
+    }
+    if (_state == CircuitBreakerStateOpen)
+    {
+        [self noteAttemptsHeldFor:wait replacedByAttempt:action == CircuitBreakerActionStart];
+        if (action == CircuitBreakerActionStart)
+        {
+            _state = CircuitBreakerStateHalfOpen;
+        }
+    }
+    if (action == CircuitBreakerActionStart)
+    {
+        _startedCount++;
+    }
+    *delay = wait;
+    return action;
+}
+
+- (CircuitBreakerAction)actionAfterProbe:(BOOL)reachable atTime:(NSTimeInterval)now reconnectionTimeout:(NSTimeInterval)timeout delay:(NSTimeInterval *)delay
+{
+    _probeCount++;
+    if (reachable)
+    {
+        DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> probe succeeded, attempt starting now");
+        _state = CircuitBreakerStateHalfOpen;
+        _startedCount++;
+        *delay = 0.0;
+        return CircuitBreakerActionStart;
+    }
+
+    _nextProbe = now + _probeInterval;
+    if ([self isTimedOut:timeout atTime:_nextProbe])
+    {
+        *delay = 0.0;
+        return [self abort];
+    }
+    [self noteAttemptsHeldFor:_probeInterval replacedByAttempt:NO];
+    *delay = _probeInterval;
+    return CircuitBreakerActionProbe;
+}
+
+- (void)noteConnected
+{
+    if (_reconnecting)
+    {
+        DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> connected after %lu failed attempts, circuit closed", (unsigned long)_failures);
+    }
+    [self reset];
+}
+
+- (void)reset
+{
+    _state = CircuitBreakerStateClosed;
+    _reconnecting = NO;
+    _failures = 0;
+    [_backOff reset];
+}
+
+- (BOOL)isTimedOut:(NSTimeInterval)timeout atTime:(NSTimeInterval)time
+{
+    return timeout >= 0 && time - _outageStart >= timeout;
+}
+
+- (CircuitBreakerAction)abort
+{
+    DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> reconnection timeout would be over before the next attempt, aborting");
+    _abortedCount++;
+    // the session closes, whatever comes next starts afresh
+    [self reset];
+    return CircuitBreakerActionAbort;
+}
+
+// the back-off would have kept trying at its max delay
+- (void)noteAttemptsHeldFor:(NSTimeInterval)wait replacedByAttempt:(BOOL)attempt
+{
+    const NSTimeInterval interval = MAX(_backOff.maxDelay, _backOff.baseDelay);
+    NSUInteger avoided = interval > 0 ? (NSUInteger)floor(wait / interval) : 0;
+    if (attempt && avoided > 0)
+    {
+        avoided--;
+    }
+    _avoidedCount += avoided;
+}
+
+
+#pragma mark - PTDiffusionSessionReconnectionStrategy
+
+- (void)diffusionSession:(PTDiffusionSession *)session wishesToReconnectWithAttempt:(PTDiffusionSessionReconnectionAttempt *)attempt
+{
+    NSNumber *const reconnectionTimeout = session.configuration.reconnectionTimeout;
+    const NSTimeInterval timeout = reconnectionTimeout ? reconnectionTimeout.doubleValue : _reconnectionTimeout;
+    [_scheduler scheduleAfterDelay:0 block:^{
+        [self observeSession:session];
+        NSTimeInterval delay = 0.0;
+        const CircuitBreakerAction action = [self actionForAttemptAtTime:self.scheduler.currentTime reconnectionTimeout:timeout delay:&delay];
+        [self perform:action withAttempt:attempt after:delay reconnectionTimeout:timeout];
+    }];
+}
+
+- (void)perform:(CircuitBreakerAction)action withAttempt:(PTDiffusionSessionReconnectionAttempt *)attempt after:(NSTimeInterval)delay reconnectionTimeout:(NSTimeInterval)timeout
+{
+    if (action == CircuitBreakerActionAbort)
+    {
+        [attempt abort];
+        return;
+    }
+    id<DiffusionScheduler> const scheduler = _scheduler;
+    [scheduler scheduleAfterDelay:delay block:^{
+        if (action == CircuitBreakerActionStart)
+        {
+            DiffusionLogInfo(@"CircuitBreakerReconnectionStrategy --> attempt starting now");
+            [attempt start];
+            return;
+        }
+        void (^const completionHandler)(BOOL) = ^(BOOL reachable) {
+            [scheduler scheduleAfterDelay:0 block:^{
+                NSTimeInterval next = 0.0;
+                const CircuitBreakerAction after = [self actionAfterProbe:reachable atTime:scheduler.currentTime reconnectionTimeout:timeout delay:&next];
+                [self perform:after withAttempt:attempt after:next reconnectionTimeout:timeout];
+            }];
+        };
+        // the probe may have been removed in the meantime
+        CircuitBreakerProbe const probe = self.probe;
+        if (probe)
+        {
+            probe(completionHandler);
+        }
+        else
+        {
+            completionHandler(YES);
+        }
+    }];
+}
+
+- (void)observeSession:(PTDiffusionSession *)session
+{
+    if (session == _session)
+    {
+        return;
+    }
+    if (_observer)
+    {
+        [NSNotificationCenter.defaultCenter removeObserver:_observer];
+    }
+    _session = session;
+    __weak typeof(self) weakSelf = self;
+    _observer = [NSNotificationCenter.defaultCenter addObserverForName:PTDiffusionSessionStateDidChangeNotification object:session queue:NSOperationQueue.mainQueue usingBlock:^(NSNotification * _Nonnull note) {
+        PTDiffusionSessionStateChange *const change = note.userInfo[PTDiffusionSessionStateChangeUserInfoKey];
+        if (!change.state.isConnected && !change.state.isClosed)
+        {
+            return;
+        }
+        // on the scheduler's queue, with the decisions and the probe results
+        [weakSelf.scheduler scheduleAfterDelay:0 block:^{
+            if (change.state.isConnected)
+            {
+                [weakSelf noteConnected];
+            }
+            else
+            {
+                [weakSelf reset];
+            }
+        }];
+    }];
+}
+
+@end
@@ -0,0 +1,33 @@
+//
+//  DiffusionRandom.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 17/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// splitmix64: small, fast and good enough to spread delays. the same seed always gives the same sequence
+static const uint64_t DiffusionRandomIncrement = 0x9E3779B97F4A7C15ull;
+
+// the value in [0, 1) at a point of the sequence: the seed plus a number of increments. no state, so points can be
+// asked for in any order
+static inline double DiffusionRandomAt(uint64_t point)
+{
+    uint64_t z = point;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (z >> 11) * 0x1.0p-53;
+}
+
+// the next value in [0, 1), advancing the state, which starts as the seed
+static inline double DiffusionRandomNext(uint64_t *state)
+{
+    return DiffusionRandomAt(*state += DiffusionRandomIncrement);
+}
+
+NS_ASSUME_NONNULL_END
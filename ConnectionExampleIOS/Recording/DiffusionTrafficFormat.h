@@ -0,0 +1,70 @@
+//
+//  DiffusionTrafficFormat.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#ifndef DiffusionTrafficFormat_h
+#define DiffusionTrafficFormat_h
+
+// plain C, so a recording can be read without the app
+
+#include <stdint.h>
+
+/**
+
+    A traffic recording is a file header followed by records back to back, all little endian.
+
+    A record is a 24 byte header and `length` bytes of payload. Unlike an event log, updates keep their value, so a
+    recording can be replayed. A topic ID is defined once per file, before the first record using it.
+
+ */
+
+#define DIFFUSION_TRAFFIC_MAGIC 0x31525444u // "DTR1"
+#define DIFFUSION_TRAFFIC_VERSION 1
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    // wall clock when the recording started, in nanoseconds since 1970. record timestamps are relative to it
+    uint64_t startTime;
+} DiffusionTrafficFileHeader;
+
+typedef struct
+{
+    uint16_t kind;
+    // the topic type of subscriptions and updates, otherwise 0
+    uint16_t topicType;
+    // topic ID or 0, depending on the kind
+    uint32_t ID;
+    // nanoseconds since the recording started
+    uint64_t timestamp;
+    // bytes of payload following the header
+    uint32_t length;
+    uint32_t argument;
+} DiffusionTrafficRecordHeader;
+
+typedef uint16_t DiffusionTrafficKind;
+enum
+{
+    // ID: a topic ID. payload: its path
+    DiffusionTrafficDefineTopic = 1,
+
+    // ID: a topic ID
+    DiffusionTrafficSubscribe = 16,
+    // ID: a topic ID. argument: the unsubscription reason
+    DiffusionTrafficUnsubscribe = 17,
+    // ID: a topic ID. payload: the value
+    DiffusionTrafficUpdate = 18,
+    // argument: previous state in the high 16 bits, new state in the low ones, as DiffusionConnectionState
+    DiffusionTrafficSessionStateChange = 19,
+    // argument: round trip time in microseconds
+    DiffusionTrafficPing = 20,
+    DiffusionTrafficPingFailure = 21,
+};
+
+#endif /* DiffusionTrafficFormat_h */
@@ -0,0 +1,57 @@
+//
+//  DiffusionTrafficRecorder.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+#import "DiffusionConnectionHealth.h"
+#import "DiffusionTopicPathIndex.h"
+#import "DiffusionTrafficFormat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    Records what the manager receives from its sessions, with the values, to a file a DiffusionTrafficReplayer can play
+    back (see DiffusionTrafficFormat.h): subscriptions, unsubscriptions, updates of every topic type, session state
+    changes and ping results. String, int64 and double values are kept CBOR encoded, as the stream dispatcher hands
+    them over.
+
+    Written through a DiffusionRecordFileWriter, like the event log: records are buffered in memory and written on a
+    background queue. Only the topic type of a specification is kept.
+
+    Can be used from any thread.
+
+ */
+@interface DiffusionTrafficRecorder : NSObject
+
+@property(nonatomic, readonly) NSURL *URL;
+@property(nonatomic, readonly) NSUInteger recordCount;
+// bytes recorded so far, including what has not reached the file yet
+@property(nonatomic, readonly) unsigned long long byteCount;
+
+// replaces any existing file at the URL
+-(nullable instancetype) initWithURL:(NSURL *)URL topicIndex:(DiffusionTopicPathIndex *)topicIndex error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (void)recordSubscriptionToTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType;
+- (void)recordUnsubscriptionFromTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType reason:(PTDiffusionTopicUnsubscriptionReason)reason;
+- (void)recordUpdateOfTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType value:(NSData *)value;
+- (void)recordSessionStateChangeFrom:(DiffusionConnectionState)previousState to:(DiffusionConnectionState)state;
+- (void)recordPingRoundTripTime:(NSTimeInterval)roundTripTime;
+- (void)recordPingFailure;
+
+// blocks until everything recorded so far is in the file
+- (void)flush;
+// flushes and closes the file. later records are ignored
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,144 @@
+//
+//  DiffusionTrafficRecorder.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTrafficRecorder.h"
+
+#import "DiffusionRecordFileWriter.h"
+
+// the buffer is handed to the writing queue once it is this large
+static const NSUInteger _WriteThreshold = 256 * 1024;
+
+@implementation DiffusionTrafficRecorder
+{
+    DiffusionTopicPathIndex *_topicIndex;
+    DiffusionRecordFileWriter *_writer;
+}
+
+
+-(nullable instancetype) initWithURL:(NSURL *)URL topicIndex:(DiffusionTopicPathIndex *)topicIndex error:(NSError **)error
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _topicIndex = topicIndex;
+    _writer = [[DiffusionRecordFileWriter alloc] initWithURL:URL name:@"DiffusionTrafficRecorder" writeThreshold:_WriteThreshold fileHeader:^NSData *(uint64_t startTime) {
+        const DiffusionTrafficFileHeader header = {
+            .magic = CFSwapInt32HostToLittle(DIFFUSION_TRAFFIC_MAGIC),
+            .version = CFSwapInt16HostToLittle(DIFFUSION_TRAFFIC_VERSION),
+            .headerSize = CFSwapInt16HostToLittle(sizeof(DiffusionTrafficFileHeader)),
+            .startTime = CFSwapInt64HostToLittle(startTime),
+        };
+        return [NSData dataWithBytes:&header length:sizeof(header)];
+    } error:error];
+    if (!_writer)
+    {
+        return nil;
+    }
+
+    return self;
+}
+
+
+#pragma mark - recording
+
+- (NSURL *)URL
+{
+    return _writer.URL;
+}
+
+- (NSUInteger)recordCount
+{
+    return _writer.recordCount;
+}
+
+- (unsigned long long)byteCount
+{
+    return _writer.byteCount;
+}
+
+// called from the block of appendRecords:
+- (void)appendKind:(DiffusionTrafficKind)kind topicType:(uint16_t)topicType ID:(uint32_t)ID argument:(uint32_t)argument payload:(nullable const void *)payload length:(NSUInteger)length
+{
+    const DiffusionTrafficRecordHeader header = {
+        .kind = CFSwapInt16HostToLittle(kind),
+        .topicType = CFSwapInt16HostToLittle(topicType),
+        .ID = CFSwapInt32HostToLittle(ID),
+        .timestamp = CFSwapInt64HostToLittle(_writer.timestamp),
+        .length = CFSwapInt32HostToLittle((uint32_t)length),
+        .argument = CFSwapInt32HostToLittle(argument),
+    };
+    [_writer appendHeader:&header length:sizeof(header) payload:payload length:length];
+}
+
+- (void)recordKind:(DiffusionTrafficKind)kind topicType:(uint16_t)topicType ID:(uint32_t)ID argument:(uint32_t)argument payload:(nullable NSData *)payload
+{
+    [_writer appendRecords:^{
+        [self appendKind:kind topicType:topicType ID:ID argument:argument payload:payload.bytes length:payload.length];
+    }];
+}
+
+// the record of a topic, preceded by the definition of the topic unless the file already has it
+- (void)recordKind:(DiffusionTrafficKind)kind topicType:(uint16_t)topicType topicPath:(NSString *)topicPath argument:(uint32_t)argument payload:(nullable NSData *)payload
+{
+    const DiffusionTopicID ID = [_topicIndex internTopicPath:topicPath];
+    [_writer appendRecords:^{
+        if ([self->_writer defineID:ID kind:DiffusionTrafficDefineTopic])
+        {
+            NSData *const bytes = [topicPath dataUsingEncoding:NSUTF8StringEncoding];
+            [self appendKind:DiffusionTrafficDefineTopic topicType:0 ID:ID argument:0 payload:bytes.bytes length:bytes.length];
+        }
+        [self appendKind:kind topicType:topicType ID:ID argument:argument payload:payload.bytes length:payload.length];
+    }];
+}
+
+- (void)recordSubscriptionToTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType
+{
+    [self recordKind:DiffusionTrafficSubscribe topicType:(uint16_t)topicType topicPath:topicPath argument:0 payload:nil];
+}
+
+- (void)recordUnsubscriptionFromTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType reason:(PTDiffusionTopicUnsubscriptionReason)reason
+{
+    [self recordKind:DiffusionTrafficUnsubscribe topicType:(uint16_t)topicType topicPath:topicPath argument:(uint32_t)reason payload:nil];
+}
+
+- (void)recordUpdateOfTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType value:(NSData *)value
+{
+    [self recordKind:DiffusionTrafficUpdate topicType:(uint16_t)topicType topicPath:topicPath argument:0 payload:value];
+}
+
+- (void)recordSessionStateChangeFrom:(DiffusionConnectionState)previousState to:(DiffusionConnectionState)state
+{
+    [self recordKind:DiffusionTrafficSessionStateChange topicType:0 ID:0 argument:((uint32_t)previousState << 16) | (uint16_t)state payload:nil];
+}
+
+- (void)recordPingRoundTripTime:(NSTimeInterval)roundTripTime
+{
+    [self recordKind:DiffusionTrafficPing topicType:0 ID:0 argument:(uint32_t)MIN(llround(roundTripTime * 1e6), (long long)UINT32_MAX) payload:nil];
+}
+
+- (void)recordPingFailure
+{
+    [self recordKind:DiffusionTrafficPingFailure topicType:0 ID:0 argument:0 payload:nil];
+}
+
+
+#pragma mark - writing
+
+- (void)flush
+{
+    [_writer flush];
+}
+
+- (void)close
+{
+    [_writer close];
+}
+
+@end
@@ -0,0 +1,70 @@
+//
+//  DiffusionTrafficReplayer.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionTrafficFormat.h"
+
+@class DiffusionManager;
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSErrorDomain const DiffusionTrafficReplayErrorDomain;
+
+typedef NS_ERROR_ENUM(DiffusionTrafficReplayErrorDomain, DiffusionTrafficReplayError) {
+    DiffusionTrafficReplayErrorInvalidFile = 1,
+};
+
+/**
+
+    Plays a recording made by DiffusionTrafficRecorder back into a manager, without a network.
+
+    Each record reaches the manager the way it first did: subscriptions and updates through the streams of its stream
+    dispatcher, state changes and ping results through its session bookkeeping. The same recording always produces
+    the same calls in the same order, so it can feed throughput and latency benchmarks of the update path.
+
+    Time is recording time, from 0 to the duration. The file is memory mapped and checked in full when opened.
+    Used from the main queue, like the Diffusion callbacks.
+
+    The replayed calls go to the manager's own stream dispatcher, so a manager with an open session gets them mixed
+    with its live traffic, and both feed the same cache, metrics and health. Give it a manager of its own, one that is
+    never connected, to keep the two apart. A paced replay catches up with the clock on a 5 ms main queue timer, so it
+    competes with the UI; replayUntilTime: has no timer at all.
+
+ */
+@interface DiffusionTrafficReplayer : NSObject
+
+@property(nonatomic, readonly) NSURL *URL;
+// records in the file, topic definitions included
+@property(nonatomic, readonly) NSUInteger recordCount;
+// time of the last record
+@property(nonatomic, readonly) NSTimeInterval duration;
+@property(nonatomic, readonly) NSTimeInterval currentTime;
+@property(nonatomic, readonly, getter=isFinished) BOOL finished;
+
+// counters
+@property(nonatomic, readonly) NSUInteger replayedCount;
+@property(nonatomic, readonly) NSUInteger replayedUpdateCount;
+
+-(nullable instancetype) initWithURL:(NSURL *)URL manager:(DiffusionManager *)manager error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// replays every record up to the time, as fast as possible
+- (void)replayUntilTime:(NSTimeInterval)time;
+- (void)replayToEnd;
+
+// replays in step with the clock, speed times faster than the recording, until its end or stop
+- (void)startAtSpeed:(double)speed completionHandler:(nullable dispatch_block_t)completionHandler;
+- (void)stop;
+
+// back to the start, to replay again
+- (void)rewind;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,293 @@
+//
+//  DiffusionTrafficReplayer.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTrafficReplayer.h"
+
+#import "DiffusionManager.h"
+
+NSErrorDomain const DiffusionTrafficReplayErrorDomain = @"DiffusionTrafficReplayErrorDomain";
+
+// how often a paced replay catches up with the clock
+static const NSTimeInterval _PacingInterval = 0.005;
+
+static DiffusionTrafficRecordHeader _Header(const uint8_t *bytes)
+{
+    DiffusionTrafficRecordHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    header.kind = CFSwapInt16LittleToHost(header.kind);
+    header.topicType = CFSwapInt16LittleToHost(header.topicType);
+    header.ID = CFSwapInt32LittleToHost(header.ID);
+    header.timestamp = CFSwapInt64LittleToHost(header.timestamp);
+    header.length = CFSwapInt32LittleToHost(header.length);
+    header.argument = CFSwapInt32LittleToHost(header.argument);
+    return header;
+}
+
+@implementation DiffusionTrafficReplayer
+{
+    DiffusionManager *_manager;
+    NSData *_mapping;
+    NSUInteger _firstRecord;
+    // next record to replay
+    NSUInteger _offset;
+
+    NSDictionary<NSNumber *, PTDiffusionValueStream *> *_streams;
+    NSMutableDictionary<NSNumber *, NSString *> *_topicPaths;
+    NSMutableDictionary<NSNumber *, PTDiffusionTopicSpecification *> *_specifications;
+
+    dispatch_source_t _timer;
+}
+
+
+-(nullable instancetype) initWithURL:(NSURL *)URL manager:(DiffusionManager *)manager error:(NSError **)error
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _URL = [URL copy];
+    _manager = manager;
+    _mapping = [NSData dataWithContentsOfURL:URL options:NSDataReadingMappedIfSafe error:error];
+    if (!_mapping || ![self checkRecords:error])
+    {
+        return nil;
+    }
+    _streams = [manager.streamDispatcher makeStreamsByTopicType];
+    _specifications = [NSMutableDictionary dictionary];
+    [self rewind];
+
+    return self;
+}
+
+- (BOOL)checkRecords:(NSError **)error
+{
+    NSString *reason = nil;
+    const uint8_t *const bytes = _mapping.bytes;
+    const NSUInteger length = _mapping.length;
+
+    DiffusionTrafficFileHeader header;
+    if (length < sizeof(header))
+    {
+        reason = @"too short";
+    }
+    else
+    {
+        memcpy(&header, bytes, sizeof(header));
+        _firstRecord = CFSwapInt16LittleToHost(header.headerSize);
+        if (CFSwapInt32LittleToHost(header.magic) != DIFFUSION_TRAFFIC_MAGIC || CFSwapInt16LittleToHost(header.version) != DIFFUSION_TRAFFIC_VERSION)
+        {
+            reason = @"not a traffic recording";
+        }
+        else if (_firstRecord < sizeof(header) || _firstRecord > length)
+        {
+            reason = @"bad header size";
+        }
+    }
+
+    NSUInteger offset = _firstRecord;
+    while (!reason && offset < length)
+    {
+        if (length - offset < sizeof(DiffusionTrafficRecordHeader))
+        {
+            reason = @"truncated record";
+            break;
+        }
+        const DiffusionTrafficRecordHeader record = _Header(bytes + offset);
+        offset += sizeof(record);
+        if (length - offset < record.length)
+        {
+            reason = @"truncated record";
+            break;
+        }
+        offset += record.length;
+        _recordCount++;
+        _duration = record.timestamp / (NSTimeInterval)NSEC_PER_SEC;
+    }
+
+    if (reason && error)
+    {
+        *error = [NSError errorWithDomain:DiffusionTrafficReplayErrorDomain
+                                     code:DiffusionTrafficReplayErrorInvalidFile
+                                 userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Invalid traffic recording %@: %@", _URL.lastPathComponent, reason]}];
+    }
+    return !reason;
+}
+
+- (void)rewind
+{
+    [self stop];
+    _offset = _firstRecord;
+    _topicPaths = [NSMutableDictionary dictionary];
+    _currentTime = 0;
+    _finished = _offset >= _mapping.length;
+}
+
+
+#pragma mark - replaying
+
+- (nullable PTDiffusionValueStream *)streamForTopicType:(PTDiffusionTopicType)topicType
+{
+    return _streams[@(topicType)];
+}
+
+- (PTDiffusionTopicSpecification *)specificationForTopicType:(PTDiffusionTopicType)topicType
+{
+    PTDiffusionTopicSpecification *specification = _specifications[@(topicType)];
+    if (!specification)
+    {
+        specification = [[PTDiffusionTopicSpecification alloc] initWithType:topicType];
+        _specifications[@(topicType)] = specification;
+    }
+    return specification;
+}
+
+- (void)replayUpdateOfTopicPath:(NSString *)topicPath topicType:(PTDiffusionTopicType)topicType value:(NSData *)data
+{
+    PTDiffusionValueStream *const stream = [self streamForTopicType:topicType];
+    PTDiffusionTopicSpecification *const specification = [self specificationForTopicType:topicType];
+    id const dispatcher = _manager.streamDispatcher;
+    switch (topicType)
+    {
+        case PTDiffusionTopicType_JSON:
+            [(id<PTDiffusionJSONValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:specification
+                                                                        oldJSON:nil newJSON:[[PTDiffusionJSON alloc] initWithData:data]];
+            break;
+        case PTDiffusionTopicType_Binary:
+            [(id<PTDiffusionBinaryValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:specification
+                                                                        oldBinary:nil newBinary:[[PTDiffusionBinary alloc] initWithData:data]];
+            break;
+        case PTDiffusionTopicType_RecordV2:
+            [(id<PTDiffusionRecordV2ValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:specification
+                                                                          oldRecord:nil newRecord:[[PTDiffusionRecordV2 alloc] initWithData:data]];
+            break;
+        case PTDiffusionTopicType_String:
+            [(id<PTDiffusionStringValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:specification
+                                                                        oldString:nil newString:[DiffusionTypedStreamDispatcher stringWithData:data]];
+            break;
+        case PTDiffusionTopicType_Int64:
+        case PTDiffusionTopicType_Double:
+            [(id<PTDiffusionNumberValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:specification
+                                                                        oldNumber:nil newNumber:[DiffusionTypedStreamDispatcher numberWithData:data]];
+            break;
+        default:
+            return;
+    }
+    _replayedUpdateCount++;
+}
+
+- (void)replayRecord:(DiffusionTrafficRecordHeader)record payload:(const uint8_t *)payload
+{
+    NSString *const topicPath = record.ID ? _topicPaths[@(record.ID)] : nil;
+    const PTDiffusionTopicType topicType = (PTDiffusionTopicType)record.topicType;
+    id<PTDiffusionSubscriberStreamDelegate> const dispatcher = (id<PTDiffusionSubscriberStreamDelegate>)_manager.streamDispatcher;
+    switch (record.kind)
+    {
+        case DiffusionTrafficDefineTopic:
+            _topicPaths[@(record.ID)] = [[NSString alloc] initWithBytes:payload length:record.length encoding:NSUTF8StringEncoding];
+            break;
+        case DiffusionTrafficSubscribe:
+            if (topicPath && [self streamForTopicType:topicType])
+            {
+                [dispatcher diffusionStream:[self streamForTopicType:topicType] didSubscribeToTopicPath:topicPath specification:[self specificationForTopicType:topicType]];
+            }
+            break;
+        case DiffusionTrafficUnsubscribe:
+            if (topicPath && [self streamForTopicType:topicType])
+            {
+                [dispatcher diffusionStream:[self streamForTopicType:topicType] didUnsubscribeFromTopicPath:topicPath specification:[self specificationForTopicType:topicType]
+                                     reason:(PTDiffusionTopicUnsubscriptionReason)record.argument];
+            }
+            break;
+        case DiffusionTrafficUpdate:
+            if (topicPath)
+            {
+                [self replayUpdateOfTopicPath:topicPath topicType:topicType value:[NSData dataWithBytes:payload length:record.length]];
+            }
+            break;
+        case DiffusionTrafficSessionStateChange:
+            [_manager noteSessionStateChangeFrom:(DiffusionConnectionState)(record.argument >> 16) to:(DiffusionConnectionState)(record.argument & 0xFFFF)];
+            break;
+        case DiffusionTrafficPing:
+            [_manager notePingRoundTripTime:record.argument / 1e6];
+            break;
+        case DiffusionTrafficPingFailure:
+            [_manager notePingFailure];
+            break;
+        default:
+            // a kind from a later version, skipped
+            break;
+    }
+}
+
+- (void)replayUntilTime:(NSTimeInterval)time
+{
+    const uint8_t *const bytes = _mapping.bytes;
+    const NSUInteger length = _mapping.length;
+    const uint64_t end = time >= _duration ? UINT64_MAX : (uint64_t)(MAX(time, 0.0) * NSEC_PER_SEC);
+    while (_offset < length)
+    {
+        const DiffusionTrafficRecordHeader record = _Header(bytes + _offset);
+        if (record.timestamp > end)
+        {
+            break;
+        }
+        [self replayRecord:record payload:bytes + _offset + sizeof(record)];
+        _offset += sizeof(record) + record.length;
+        _replayedCount++;
+        _currentTime = record.timestamp / (NSTimeInterval)NSEC_PER_SEC;
+    }
+    _currentTime = MIN(MAX(_currentTime, time), _duration);
+    _finished = _offset >= length;
+}
+
+- (void)replayToEnd
+{
+    [self replayUntilTime:_duration];
+}
+
+- (void)startAtSpeed:(double)speed completionHandler:(nullable dispatch_block_t)completionHandler
+{
+    [self stop];
+    const uint64_t started = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+    const NSTimeInterval from = _currentTime;
+
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_NOW, (uint64_t)(_PacingInterval * NSEC_PER_SEC), (uint64_t)(_PacingInterval * NSEC_PER_SEC / 10));
+    __weak DiffusionTrafficReplayer *weakSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+        DiffusionTrafficReplayer *const replayer = weakSelf;
+        const NSTimeInterval elapsed = (clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW) - started) / (NSTimeInterval)NSEC_PER_SEC;
+        [replayer replayUntilTime:from + elapsed * speed];
+        if (replayer.finished)
+        {
+            [replayer stop];
+            if (completionHandler)
+            {
+                completionHandler();
+            }
+        }
+    });
+    dispatch_resume(_timer);
+}
+
+- (void)stop
+{
+    if (_timer)
+    {
+        dispatch_source_cancel(_timer);
+        _timer = nil;
+    }
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+@end
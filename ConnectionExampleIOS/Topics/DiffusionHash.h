@@ -0,0 +1,43 @@
+//
+//  DiffusionHash.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 27/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// FNV-1a over UTF-16 units, for topic paths and selectors. NSString's own hash only looks at the ends of long strings,
+// where paths under the same branch differ least, and is not guaranteed to be stable between OS releases: a selector
+// must land on the same session every time it is replayed
+static const uint32_t DiffusionHashSeed = 2166136261u;
+
+// continues the hash of the characters before, DiffusionHashSeed for the first ones
+static inline uint32_t DiffusionHashCharacters(const unichar *characters, NSUInteger length, uint32_t hash)
+{
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        hash ^= characters[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t DiffusionHashString(NSString *string)
+{
+    uint32_t hash = DiffusionHashSeed;
+    const NSUInteger length = string.length;
+    unichar buffer[64];
+    for (NSUInteger offset = 0; offset < length; offset += 64)
+    {
+        const NSUInteger count = MIN(length - offset, (NSUInteger)64);
+        [string getCharacters:buffer range:NSMakeRange(offset, count)];
+        hash = DiffusionHashCharacters(buffer, count, hash);
+    }
+    return hash;
+}
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,66 @@
+//
+//  DiffusionParsedTopicSelector.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 22/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, DiffusionPathQualifier) {
+    DiffusionPathQualifierNone = 0,
+    // "/": the descendants of the path, not the path itself
+    DiffusionPathQualifierDescendants = 1,
+    // "//": the path and all its descendants
+    DiffusionPathQualifierPathAndDescendants = 2,
+};
+
+typedef NS_ENUM(NSInteger, DiffusionTopicSelectorType) {
+    // ">A/B", or a path without a prefix
+    DiffusionTopicSelectorTypePath = 0,
+    // "?A/.*/C": a regular expression per segment
+    DiffusionTopicSelectorTypeSplitPath = 1,
+    // "*A/.*": one regular expression over the whole path
+    DiffusionTopicSelectorTypeFullPath = 2,
+    // "#...////...": any of its parts
+    DiffusionTopicSelectorTypeSet = 3,
+};
+
+/**
+
+    A topic selector expression taken apart: its type, its qualifier and its segments. The selector coalescer and the
+    selector matcher both read selectors through it.
+
+    Immutable, so thread safe.
+
+ */
+@interface DiffusionParsedTopicSelector : NSObject
+
+@property(nonatomic, readonly) NSString *selector;
+@property(nonatomic, readonly) DiffusionTopicSelectorType type;
+// the expression without its prefix and qualifier. a selector set keeps the qualifier of its last part
+@property(nonatomic, readonly) NSString *expression;
+// always none for a selector set
+@property(nonatomic, readonly) DiffusionPathQualifier qualifier;
+// the non-empty segments of the expression. empty for full path selectors and selector sets
+@property(nonatomic, readonly) NSArray<NSString *> *segments;
+// the segments joined. the expression of full path selectors and selector sets
+@property(nonatomic, readonly) NSString *base;
+// the selector written one way for every way of writing it, for path selectors. the selector itself for the others
+@property(nonatomic, readonly) NSString *canonical;
+// selector sets only, in the order they were written
+@property(nonatomic, readonly, nullable) NSArray<DiffusionParsedTopicSelector *> *parts;
+
+// nil for an empty selector, or a selector set with an empty part
++ (nullable instancetype)parse:(NSString *)selector;
+// nil unless it is a path selector
++ (nullable instancetype)parsePath:(NSString *)selector;
+
++ (NSArray<NSString *> *)segmentsOfPath:(NSString *)path;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,106 @@
+//
+//  DiffusionParsedTopicSelector.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 22/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionParsedTopicSelector.h"
+
+@implementation DiffusionParsedTopicSelector
+
++ (nullable instancetype)parse:(NSString *)selector
+{
+    if (!selector.length)
+    {
+        return nil;
+    }
+
+    DiffusionParsedTopicSelector *const parsed = [[self alloc] init];
+    parsed->_selector = [selector copy];
+    parsed->_segments = @[];
+    parsed->_canonical = parsed->_selector;
+
+    const unichar first = [selector characterAtIndex:0];
+    switch (first)
+    {
+        case '#':
+        {
+            parsed->_type = DiffusionTopicSelectorTypeSet;
+            parsed->_expression = [selector substringFromIndex:1];
+            parsed->_base = parsed->_expression;
+            NSMutableArray<DiffusionParsedTopicSelector *> *const parts = [NSMutableArray array];
+            for (NSString *part in [parsed->_expression componentsSeparatedByString:@"////"])
+            {
+                DiffusionParsedTopicSelector *const parsedPart = [self parse:part];
+                if (!parsedPart)
+                {
+                    return nil;
+                }
+                [parts addObject:parsedPart];
+            }
+            parsed->_parts = parts;
+            return parsed;
+        }
+        case '*':
+            parsed->_type = DiffusionTopicSelectorTypeFullPath;
+            parsed->_expression = [self stripQualifier:[selector substringFromIndex:1] qualifier:&parsed->_qualifier];
+            parsed->_base = parsed->_expression;
+            return parsed;
+        case '?':
+            parsed->_type = DiffusionTopicSelectorTypeSplitPath;
+            break;
+        default:
+            parsed->_type = DiffusionTopicSelectorTypePath;
+            break;
+    }
+
+    NSString *const path = (first == '?' || first == '>') ? [selector substringFromIndex:1] : selector;
+    parsed->_expression = [self stripQualifier:path qualifier:&parsed->_qualifier];
+    parsed->_segments = [self segmentsOfPath:parsed->_expression];
+    parsed->_base = [parsed->_segments componentsJoinedByString:@"/"];
+    if (parsed->_type == DiffusionTopicSelectorTypePath)
+    {
+        parsed->_canonical = [NSString stringWithFormat:@">%@%@", parsed->_base,
+                              parsed->_qualifier == DiffusionPathQualifierPathAndDescendants ? @"//" : (parsed->_qualifier == DiffusionPathQualifierDescendants ? @"/" : @"")];
+    }
+    return parsed;
+}
+
++ (nullable instancetype)parsePath:(NSString *)selector
+{
+    DiffusionParsedTopicSelector *const parsed = [self parse:selector];
+    return parsed.type == DiffusionTopicSelectorTypePath ? parsed : nil;
+}
+
++ (NSString *)stripQualifier:(NSString *)expression qualifier:(DiffusionPathQualifier *)qualifier
+{
+    if ([expression hasSuffix:@"//"])
+    {
+        *qualifier = DiffusionPathQualifierPathAndDescendants;
+        return [expression substringToIndex:expression.length - 2];
+    }
+    if ([expression hasSuffix:@"/"])
+    {
+        *qualifier = DiffusionPathQualifierDescendants;
+        return [expression substringToIndex:expression.length - 1];
+    }
+    *qualifier = DiffusionPathQualifierNone;
+    return expression;
+}
+
++ (NSArray<NSString *> *)segmentsOfPath:(NSString *)path
+{
+    NSMutableArray<NSString *> *const segments = [NSMutableArray array];
+    for (NSString *segment in [path componentsSeparatedByString:@"/"])
+    {
+        if (segment.length)
+        {
+            [segments addObject:segment];
+        }
+    }
+    return segments;
+}
+
+@end
@@ -0,0 +1,51 @@
+//
+//  DiffusionTopicPathIndex.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 27/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef uint32_t DiffusionTopicID;
+// never given to a path
+static const DiffusionTopicID DiffusionTopicIDNone = 0;
+
+/**
+
+    Interns topic paths into small integer IDs, so that anything keyed by topic can use an ID instead of hashing
+    the full path again.
+
+    Paths are stored in a radix tree over their segments: every distinct segment is kept once, and a chain of nodes
+    with a single child is compressed into one node. Deep paths sharing long branches, which is how topic trees are
+    laid out, cost little more than their last segments. IDs are handed out in order from 1 and stay valid for the
+    life of the index.
+    Looking a path up does not allocate. Enumerating a branch only visits the nodes under it.
+
+    Thread safe.
+
+ */
+@interface DiffusionTopicPathIndex : NSObject
+
+// interned paths
+@property(nonatomic, readonly) NSUInteger count;
+@property(nonatomic, readonly) NSUInteger nodeCount;
+@property(nonatomic, readonly) NSUInteger segmentCount;
+// bytes allocated by the index
+@property(nonatomic, readonly) size_t memoryUsage;
+
+// the ID of the path, given a new one if it was not interned yet
+- (DiffusionTopicID)internTopicPath:(NSString *)topicPath;
+// DiffusionTopicIDNone if the path was never interned
+- (DiffusionTopicID)IDForTopicPath:(NSString *)topicPath;
+- (nullable NSString *)topicPathForID:(DiffusionTopicID)topicID;
+
+// every interned path equal to the branch or below it, in no particular order
+- (void)enumerateTopicIDsInBranch:(NSString *)branch usingBlock:(void (NS_NOESCAPE ^)(DiffusionTopicID topicID, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
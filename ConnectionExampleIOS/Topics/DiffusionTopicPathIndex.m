@@ -0,0 +1,566 @@
+//
+//  DiffusionTopicPathIndex.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 27/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTopicPathIndex.h"
+
+#import <malloc/malloc.h>
+#import <os/lock.h>
+
+#import "DiffusionHash.h"
+
+static const uint32_t _NotFound = UINT32_MAX;
+// paths up to this length, and with up to this many segments, are looked up without touching the heap
+static const NSUInteger _StackCharacters = 256;
+static const NSUInteger _StackSegments = 32;
+
+
+#pragma mark - segments
+
+// every distinct segment, once. looked up straight from the characters of a path
+typedef struct {
+    unichar *characters;
+    size_t characterCount;
+    size_t characterCapacity;
+
+    // indexed by segment
+    uint32_t *offsets;
+    uint32_t *lengths;
+    uint32_t *hashes;
+    uint32_t count;
+    uint32_t capacity;
+
+    // open addressing, segment + 1 so that 0 is an empty slot
+    uint32_t *slots;
+    uint32_t slotMask;
+} _Segments;
+
+static void _SegmentsInit(_Segments *segments)
+{
+    memset(segments, 0, sizeof(*segments));
+    segments->slotMask = 255;
+    segments->slots = calloc(segments->slotMask + 1, sizeof(uint32_t));
+}
+
+static void _SegmentsFree(_Segments *segments)
+{
+    free(segments->characters);
+    free(segments->offsets);
+    free(segments->lengths);
+    free(segments->hashes);
+    free(segments->slots);
+}
+
+static uint32_t _SegmentsFind(const _Segments *segments, const unichar *characters, NSUInteger length, uint32_t hash)
+{
+    for (uint32_t slot = hash & segments->slotMask; ; slot = (slot + 1) & segments->slotMask)
+    {
+        const uint32_t entry = segments->slots[slot];
+        if (!entry)
+        {
+            return _NotFound;
+        }
+        const uint32_t segment = entry - 1;
+        if (segments->hashes[segment] == hash
+            && segments->lengths[segment] == length
+            && !memcmp(segments->characters + segments->offsets[segment], characters, length * sizeof(unichar)))
+        {
+            return segment;
+        }
+    }
+}
+
+static void _SegmentsPlace(_Segments *segments, uint32_t segment)
+{
+    uint32_t slot = segments->hashes[segment] & segments->slotMask;
+    while (segments->slots[slot])
+    {
+        slot = (slot + 1) & segments->slotMask;
+    }
+    segments->slots[slot] = segment + 1;
+}
+
+static uint32_t _SegmentsIntern(_Segments *segments, const unichar *characters, NSUInteger length)
+{
+    const uint32_t hash = DiffusionHashCharacters(characters, length, DiffusionHashSeed);
+    const uint32_t existing = _SegmentsFind(segments, characters, length, hash);
+    if (existing != _NotFound)
+    {
+        return existing;
+    }
+
+    if (segments->count == segments->capacity)
+    {
+        segments->capacity = MAX(segments->capacity * 2, 64u);
+        segments->offsets = realloc(segments->offsets, segments->capacity * sizeof(uint32_t));
+        segments->lengths = realloc(segments->lengths, segments->capacity * sizeof(uint32_t));
+        segments->hashes = realloc(segments->hashes, segments->capacity * sizeof(uint32_t));
+    }
+    if (segments->characterCount + length > segments->characterCapacity)
+    {
+        segments->characterCapacity = MAX(segments->characterCapacity * 2, segments->characterCount + length + 1024);
+        segments->characters = realloc(segments->characters, segments->characterCapacity * sizeof(unichar));
+    }
+
+    const uint32_t segment = segments->count++;
+    segments->offsets[segment] = (uint32_t)segments->characterCount;
+    segments->lengths[segment] = (uint32_t)length;
+    segments->hashes[segment] = hash;
+    if (length)
+    {
+        memcpy(segments->characters + segments->characterCount, characters, length * sizeof(unichar));
+    }
+    segments->characterCount += length;
+
+    // kept at most half full
+    if (segments->count * 2 > segments->slotMask + 1)
+    {
+        free(segments->slots);
+        segments->slotMask = segments->slotMask * 2 + 1;
+        segments->slots = calloc(segments->slotMask + 1, sizeof(uint32_t));
+        for (uint32_t i = 0; i < segments->count; i++)
+        {
+            _SegmentsPlace(segments, i);
+        }
+    }
+    else
+    {
+        _SegmentsPlace(segments, segment);
+    }
+    return segment;
+}
+
+
+#pragma mark - nodes
+
+typedef struct _Node _Node;
+struct _Node {
+    _Node *parent;
+    // segments from the parent down to this node. never empty, except for the root
+    uint32_t *label;
+    uint32_t labelLength;
+    DiffusionTopicID topicID;
+    // sorted by the first segment of their label
+    _Node **children;
+    uint32_t childCount;
+    uint32_t childCapacity;
+};
+
+static _Node *_NodeCreate(_Node *parent, const uint32_t *label, uint32_t labelLength)
+{
+    _Node *const node = calloc(1, sizeof(_Node));
+    node->parent = parent;
+    node->labelLength = labelLength;
+    if (labelLength)
+    {
+        node->label = malloc(labelLength * sizeof(uint32_t));
+        memcpy(node->label, label, labelLength * sizeof(uint32_t));
+    }
+    return node;
+}
+
+static void _NodeFree(_Node *node)
+{
+    for (uint32_t i = 0; i < node->childCount; i++)
+    {
+        _NodeFree(node->children[i]);
+    }
+    free(node->children);
+    free(node->label);
+    free(node);
+}
+
+// the child whose label starts with the segment, or where it would be inserted
+static _Node *_NodeFindChild(const _Node *node, uint32_t segment, uint32_t *position)
+{
+    uint32_t low = 0;
+    uint32_t high = node->childCount;
+    while (low < high)
+    {
+        const uint32_t middle = (low + high) / 2;
+        const uint32_t first = node->children[middle]->label[0];
+        if (first == segment)
+        {
+            *position = middle;
+            return node->children[middle];
+        }
+        if (first < segment)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    *position = low;
+    return NULL;
+}
+
+static void _NodeInsertChild(_Node *node, _Node *child, uint32_t position)
+{
+    if (node->childCount == node->childCapacity)
+    {
+        node->childCapacity = MAX(node->childCapacity * 2, 2u);
+        node->children = realloc(node->children, node->childCapacity * sizeof(_Node *));
+    }
+    memmove(node->children + position + 1, node->children + position, (node->childCount - position) * sizeof(_Node *));
+    node->children[position] = child;
+    node->childCount++;
+    child->parent = node;
+}
+
+static size_t _NodeMemoryUsage(const _Node *node)
+{
+    size_t usage = malloc_size(node) + (node->label ? malloc_size(node->label) : 0) + (node->children ? malloc_size(node->children) : 0);
+    for (uint32_t i = 0; i < node->childCount; i++)
+    {
+        usage += _NodeMemoryUsage(node->children[i]);
+    }
+    return usage;
+}
+
+
+#pragma mark - index
+
+@implementation DiffusionTopicPathIndex
+{
+    os_unfair_lock _lock;
+    _Segments _segments;
+    _Node *_root;
+    NSUInteger _nodeCount;
+
+    // indexed by ID, slot 0 is DiffusionTopicIDNone
+    _Node **_nodesByID;
+    uint32_t _idCount;
+    uint32_t _idCapacity;
+}
+
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _SegmentsInit(&_segments);
+    _root = _NodeCreate(NULL, NULL, 0);
+    _nodeCount = 1;
+    _idCapacity = 1024;
+    _nodesByID = calloc(_idCapacity, sizeof(_Node *));
+    _idCount = 1;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    _NodeFree(_root);
+    _SegmentsFree(&_segments);
+    free(_nodesByID);
+}
+
+
+- (NSUInteger)count
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _idCount - 1;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)nodeCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _nodeCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)segmentCount
+{
+    os_unfair_lock_lock(&_lock);
+    const NSUInteger count = _segments.count;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (size_t)memoryUsage
+{
+    os_unfair_lock_lock(&_lock);
+    size_t usage = _NodeMemoryUsage(_root) + malloc_size(_nodesByID) + malloc_size(_segments.slots);
+    if (_segments.characters)
+    {
+        usage += malloc_size(_segments.characters);
+    }
+    if (_segments.offsets)
+    {
+        usage += malloc_size(_segments.offsets) + malloc_size(_segments.lengths) + malloc_size(_segments.hashes);
+    }
+    os_unfair_lock_unlock(&_lock);
+    return usage;
+}
+
+
+// splits the path into segments, interning them or not. NO if a segment is unknown and intern is NO
+- (BOOL)segmentsOfPath:(NSString *)path
+            characters:(unichar *)characters
+                  into:(uint32_t **)segments
+                 count:(NSUInteger *)count
+              capacity:(NSUInteger)capacity
+                intern:(BOOL)intern
+{
+    const NSUInteger length = path.length;
+    [path getCharacters:characters range:NSMakeRange(0, length)];
+
+    NSUInteger n = 0;
+    NSUInteger start = 0;
+    for (NSUInteger i = 0; i <= length; i++)
+    {
+        if (i < length && characters[i] != '/')
+        {
+            continue;
+        }
+        if (n == capacity)
+        {
+            // only deeper than the stack buffer of the caller
+            const BOOL onHeap = capacity > _StackSegments;
+            capacity *= 2;
+            uint32_t *const grown = onHeap ? realloc(*segments, capacity * sizeof(uint32_t)) : malloc(capacity * sizeof(uint32_t));
+            if (!onHeap)
+            {
+                memcpy(grown, *segments, n * sizeof(uint32_t));
+            }
+            *segments = grown;
+        }
+
+        const unichar *const segment = characters + start;
+        const NSUInteger segmentLength = i - start;
+        uint32_t segmentID;
+        if (intern)
+        {
+            segmentID = _SegmentsIntern(&_segments, segment, segmentLength);
+        }
+        else
+        {
+            segmentID = _SegmentsFind(&_segments, segment, segmentLength, DiffusionHashCharacters(segment, segmentLength, DiffusionHashSeed));
+            if (segmentID == _NotFound)
+            {
+                *count = n;
+                return NO;
+            }
+        }
+        (*segments)[n++] = segmentID;
+        start = i + 1;
+    }
+    *count = n;
+    return YES;
+}
+
+// runs the block with the segments of the path, from stack buffers whenever the path is small enough
+- (BOOL)withSegmentsOfPath:(NSString *)path intern:(BOOL)intern block:(void (NS_NOESCAPE ^)(const uint32_t *segments, NSUInteger count))block
+{
+    const NSUInteger length = path.length;
+    unichar stackCharacters[_StackCharacters];
+    uint32_t stackSegments[_StackSegments];
+    unichar *const characters = length <= _StackCharacters ? stackCharacters : malloc(length * sizeof(unichar));
+    uint32_t *segments = stackSegments;
+    NSUInteger count = 0;
+
+    const BOOL found = [self segmentsOfPath:path characters:characters into:&segments count:&count capacity:_StackSegments intern:intern];
+    if (found)
+    {
+        block(segments, count);
+    }
+
+    if (characters != stackCharacters)
+    {
+        free(characters);
+    }
+    if (segments != stackSegments)
+    {
+        free(segments);
+    }
+    return found;
+}
+
+// the node of the path. when the path ends inside the label of a node, that node and whether the match was partial
+- (nullable _Node *)findNodeForSegments:(const uint32_t *)segments count:(NSUInteger)count partial:(BOOL *)partial
+{
+    _Node *node = _root;
+    NSUInteger i = 0;
+    *partial = NO;
+    while (i < count)
+    {
+        uint32_t position;
+        _Node *const child = _NodeFindChild(node, segments[i], &position);
+        if (!child)
+        {
+            return NULL;
+        }
+        uint32_t matched = 0;
+        while (matched < child->labelLength && i + matched < count && child->label[matched] == segments[i + matched])
+        {
+            matched++;
+        }
+        if (matched < child->labelLength)
+        {
+            if (i + matched == count)
+            {
+                *partial = YES;
+                return child;
+            }
+            return NULL;
+        }
+        node = child;
+        i += matched;
+    }
+    return node;
+}
+
+- (_Node *)insertSegments:(const uint32_t *)segments count:(NSUInteger)count
+{
+    _Node *node = _root;
+    NSUInteger i = 0;
+    while (i < count)
+    {
+        uint32_t position;
+        _Node *child = _NodeFindChild(node, segments[i], &position);
+        if (!child)
+        {
+            // the rest of the path becomes a single leaf
+            _Node *const leaf = _NodeCreate(node, segments + i, (uint32_t)(count - i));
+            _NodeInsertChild(node, leaf, position);
+            _nodeCount++;
+            return leaf;
+        }
+
+        uint32_t matched = 0;
+        while (matched < child->labelLength && i + matched < count && child->label[matched] == segments[i + matched])
+        {
+            matched++;
+        }
+        if (matched < child->labelLength)
+        {
+            // the path leaves the label half way: the common part becomes a node of its own
+            _Node *const split = _NodeCreate(node, child->label, matched);
+            node->children[position] = split;
+            memmove(child->label, child->label + matched, (child->labelLength - matched) * sizeof(uint32_t));
+            child->labelLength -= matched;
+            _NodeInsertChild(split, child, 0);
+            _nodeCount++;
+            child = split;
+        }
+        node = child;
+        i += matched;
+    }
+    return node;
+}
+
+
+- (DiffusionTopicID)internTopicPath:(NSString *)topicPath
+{
+    __block DiffusionTopicID topicID = DiffusionTopicIDNone;
+    os_unfair_lock_lock(&_lock);
+    [self withSegmentsOfPath:topicPath intern:YES block:^(const uint32_t *segments, NSUInteger count) {
+        _Node *const node = [self insertSegments:segments count:count];
+        if (node->topicID == DiffusionTopicIDNone)
+        {
+            if (self->_idCount == self->_idCapacity)
+            {
+                self->_idCapacity *= 2;
+                self->_nodesByID = realloc(self->_nodesByID, self->_idCapacity * sizeof(_Node *));
+            }
+            node->topicID = self->_idCount++;
+            self->_nodesByID[node->topicID] = node;
+        }
+        topicID = node->topicID;
+    }];
+    os_unfair_lock_unlock(&_lock);
+    return topicID;
+}
+
+- (DiffusionTopicID)IDForTopicPath:(NSString *)topicPath
+{
+    __block DiffusionTopicID topicID = DiffusionTopicIDNone;
+    os_unfair_lock_lock(&_lock);
+    [self withSegmentsOfPath:topicPath intern:NO block:^(const uint32_t *segments, NSUInteger count) {
+        BOOL partial;
+        _Node *const node = [self findNodeForSegments:segments count:count partial:&partial];
+        if (node && !partial)
+        {
+            topicID = node->topicID;
+        }
+    }];
+    os_unfair_lock_unlock(&_lock);
+    return topicID;
+}
+
+- (nullable NSString *)topicPathForID:(DiffusionTopicID)topicID
+{
+    os_unfair_lock_lock(&_lock);
+    if (topicID == DiffusionTopicIDNone || topicID >= _idCount)
+    {
+        os_unfair_lock_unlock(&_lock);
+        return nil;
+    }
+
+    // labels are collected leaf first
+    NSMutableArray<NSString *> *const reversed = [NSMutableArray array];
+    for (const _Node *node = _nodesByID[topicID]; node->parent; node = node->parent)
+    {
+        for (uint32_t i = node->labelLength; i > 0; i--)
+        {
+            const uint32_t segment = node->label[i - 1];
+            [reversed addObject:[NSString stringWithCharacters:_segments.characters + _segments.offsets[segment] length:_segments.lengths[segment]]];
+        }
+    }
+    os_unfair_lock_unlock(&_lock);
+
+    return [reversed.reverseObjectEnumerator.allObjects componentsJoinedByString:@"/"];
+}
+
+- (void)enumerateTopicIDsInBranch:(NSString *)branch usingBlock:(void (NS_NOESCAPE ^)(DiffusionTopicID topicID, BOOL *stop))block
+{
+    NSMutableData *const found = [NSMutableData data];
+    os_unfair_lock_lock(&_lock);
+    [self withSegmentsOfPath:branch intern:NO block:^(const uint32_t *segments, NSUInteger count) {
+        BOOL partial;
+        _Node *const top = [self findNodeForSegments:segments count:count partial:&partial];
+        if (!top)
+        {
+            return;
+        }
+
+        // depth first over the branch only. the IDs are handed out once the lock is released
+        NSMutableData *const stack = [NSMutableData dataWithBytes:&top length:sizeof(_Node *)];
+        while (stack.length)
+        {
+            _Node *node;
+            memcpy(&node, (const uint8_t *)stack.bytes + stack.length - sizeof(_Node *), sizeof(_Node *));
+            stack.length -= sizeof(_Node *);
+            if (node->topicID != DiffusionTopicIDNone)
+            {
+                [found appendBytes:&node->topicID length:sizeof(DiffusionTopicID)];
+            }
+            [stack appendBytes:node->children length:node->childCount * sizeof(_Node *)];
+        }
+    }];
+    os_unfair_lock_unlock(&_lock);
+
+    const DiffusionTopicID *const topicIDs = found.bytes;
+    const NSUInteger count = found.length / sizeof(DiffusionTopicID);
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < count && !stop; i++)
+    {
+        block(topicIDs[i], &stop);
+    }
+}
+
+@end
@@ -0,0 +1,42 @@
+//
+//  DiffusionTopicSelectorMatcher.h
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 28/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    A set of topic selectors compiled into one automaton over path segments, to find every selector that selects a
+    topic path in a single pass over the path.
+
+    Path (">A/B") and split path ("?A/.*/C") selectors, with their "/" and "//" qualifiers, share one tree: literal
+    segments are found by comparing the UTF-8 bytes of the path with a binary search, and each distinct split path
+    regular expression is evaluated once per segment, over a range of the path, whatever the number of selectors using
+    it. Full path selectors ("*A/.*") cannot be split into segments and are tested one after the other. Selector sets
+    ("#...////...") are compiled as each of their parts. Selectors are read with DiffusionParsedTopicSelector.
+    Walking the tree allocates nothing for paths up to 256 bytes long: no string per segment, no state sets.
+
+    Selectors are identified by their index in the array the matcher was created with. Immutable, so thread safe.
+
+ */
+@interface DiffusionTopicSelectorMatcher : NSObject
+
+@property(nonatomic, readonly) NSArray<NSString *> *selectors;
+// selectors that could not be compiled, e.g. an invalid regular expression. they never match
+@property(nonatomic, readonly) NSIndexSet *invalidSelectors;
+
+-(instancetype) initWithSelectors:(NSArray<NSString *> *)selectors NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (NSIndexSet *)indexesOfSelectorsMatchingTopicPath:(NSString *)topicPath;
+- (BOOL)anySelectorMatchesTopicPath:(NSString *)topicPath;
+
+@end
+
+NS_ASSUME_NONNULL_END
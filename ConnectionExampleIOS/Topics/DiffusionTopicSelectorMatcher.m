@@ -0,0 +1,557 @@
+//
+//  DiffusionTopicSelectorMatcher.m
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 28/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionTopicSelectorMatcher.h"
+
+#import "DiffusionParsedTopicSelector.h"
+
+@class DiffusionSelectorMatcherNode;
+
+// paths up to this many UTF-8 bytes, and automata up to this many states and expressions, are matched without touching
+// the heap
+static const NSUInteger _StackBytes = 256;
+static const NSUInteger _StackStates = 64;
+static const NSUInteger _StackRegexes = 64;
+
+// a literal segment leading out of a state, as the UTF-8 bytes a path segment is compared with
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+    __unsafe_unretained DiffusionSelectorMatcherNode *node;
+} _LiteralEdge;
+
+static int _CompareBytes(const uint8_t *bytes, NSUInteger length, const uint8_t *otherBytes, NSUInteger otherLength)
+{
+    if (length != otherLength)
+    {
+        return length < otherLength ? -1 : 1;
+    }
+    return memcmp(bytes, otherBytes, length);
+}
+
+static int _CompareEdges(const void *a, const void *b)
+{
+    const _LiteralEdge *const edge = a;
+    const _LiteralEdge *const other = b;
+    return _CompareBytes(edge->bytes, edge->length, other->bytes, other->length);
+}
+
+// a state of the automaton: the paths whose first segments led here
+@interface DiffusionSelectorMatcherNode : NSObject
+
+// only while compiling
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, DiffusionSelectorMatcherNode *> *literalChildren;
+@property(nonatomic, readonly) NSMutableArray<DiffusionSelectorMatcherNode *> *patternChildren;
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, DiffusionSelectorMatcherNode *> *patternChildrenByPattern;
+// the segment regular expression leading into a pattern child, and its position among the matcher's expressions
+@property(nonatomic, nullable) NSRegularExpression *regex;
+@property(nonatomic) NSUInteger regexIndex;
+// selectors matching a path that ends here
+@property(nonatomic, readonly) NSMutableIndexSet *exact;
+// selectors matching any path that goes deeper than here
+@property(nonatomic, readonly) NSMutableIndexSet *descendants;
+
+@end
+
+@implementation DiffusionSelectorMatcherNode
+{
+    // the literal children sorted by their UTF-8 bytes, which the keys hold
+    _LiteralEdge *_edges;
+    NSUInteger _edgeCount;
+    NSArray<NSData *> *_edgeKeys;
+}
+
+-(instancetype) init
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _literalChildren = [NSMutableDictionary dictionary];
+    _patternChildren = [NSMutableArray array];
+    _patternChildrenByPattern = [NSMutableDictionary dictionary];
+    _exact = [NSMutableIndexSet indexSet];
+    _descendants = [NSMutableIndexSet indexSet];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_edges);
+}
+
+- (void)acceptSelector:(NSUInteger)index qualifier:(DiffusionPathQualifier)qualifier
+{
+    if (qualifier != DiffusionPathQualifierDescendants)
+    {
+        [_exact addIndex:index];
+    }
+    if (qualifier != DiffusionPathQualifierNone)
+    {
+        [_descendants addIndex:index];
+    }
+}
+
+// once compiled, for this state and every state after it
+- (void)seal
+{
+    NSMutableArray<NSData *> *const keys = [NSMutableArray arrayWithCapacity:_literalChildren.count];
+    _edgeCount = _literalChildren.count;
+    _edges = _edgeCount ? malloc(_edgeCount * sizeof(_LiteralEdge)) : NULL;
+    __block NSUInteger i = 0;
+    [_literalChildren enumerateKeysAndObjectsUsingBlock:^(NSString *segment, DiffusionSelectorMatcherNode *child, BOOL *stop) {
+        NSData *const key = [segment dataUsingEncoding:NSUTF8StringEncoding];
+        [keys addObject:key];
+        self->_edges[i++] = (_LiteralEdge){ key.bytes, key.length, child };
+        [child seal];
+    }];
+    qsort(_edges, _edgeCount, sizeof(_LiteralEdge), _CompareEdges);
+    _edgeKeys = keys;
+
+    for (DiffusionSelectorMatcherNode *child in _patternChildren)
+    {
+        [child seal];
+    }
+}
+
+- (nullable DiffusionSelectorMatcherNode *)literalChildWithBytes:(const uint8_t *)bytes length:(NSUInteger)length
+{
+    NSUInteger low = 0;
+    NSUInteger high = _edgeCount;
+    while (low < high)
+    {
+        const NSUInteger middle = (low + high) / 2;
+        const int order = _CompareBytes(_edges[middle].bytes, _edges[middle].length, bytes, length);
+        if (!order)
+        {
+            return _edges[middle].node;
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return nil;
+}
+
+@end
+
+
+@interface DiffusionFullPathPattern : NSObject
+
+@property(nonatomic, readonly) NSRegularExpression *regex;
+@property(nonatomic, readonly) DiffusionPathQualifier qualifier;
+@property(nonatomic, readonly) NSUInteger index;
+
+@end
+
+@implementation DiffusionFullPathPattern
+
+- (instancetype)initWithRegex:(NSRegularExpression *)regex qualifier:(DiffusionPathQualifier)qualifier index:(NSUInteger)index
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _regex = regex;
+    _qualifier = qualifier;
+    _index = index;
+
+    return self;
+}
+
+@end
+
+
+static BOOL _MatchesWhole(NSRegularExpression *regex, NSString *string, NSRange range)
+{
+    // the expressions are anchored when compiled, and the bounds of the range anchor them, so any match covers it all
+    return [regex rangeOfFirstMatchInString:string options:NSMatchingAnchored range:range].location != NSNotFound;
+}
+
+// whether a segment regular expression was evaluated against the current segment
+typedef NS_ENUM(uint8_t, _Evaluation) {
+    _EvaluationNone = 0,
+    _EvaluationMatched = 1,
+    _EvaluationNotMatched = 2,
+};
+
+
+@implementation DiffusionTopicSelectorMatcher
+{
+    DiffusionSelectorMatcherNode *_root;
+    NSUInteger _nodeCount;
+    NSArray<DiffusionFullPathPattern *> *_fullPathPatterns;
+    // compiled expressions, shared by every selector using the same one, and their positions
+    NSMutableDictionary<NSString *, NSRegularExpression *> *_regexes;
+    NSMutableDictionary<NSString *, NSNumber *> *_regexIndexes;
+    NSUInteger _regexCount;
+}
+
+
+-(instancetype) initWithSelectors:(NSArray<NSString *> *)selectors
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _selectors = [selectors copy];
+    _root = [[DiffusionSelectorMatcherNode alloc] init];
+    _nodeCount = 1;
+    _regexes = [NSMutableDictionary dictionary];
+    _regexIndexes = [NSMutableDictionary dictionary];
+
+    NSMutableArray<DiffusionFullPathPattern *> *const fullPathPatterns = [NSMutableArray array];
+    NSMutableIndexSet *const invalid = [NSMutableIndexSet indexSet];
+    [_selectors enumerateObjectsUsingBlock:^(NSString *selector, NSUInteger index, BOOL *stop) {
+        DiffusionParsedTopicSelector *const parsed = [DiffusionParsedTopicSelector parse:selector];
+        if (!parsed || ![self compileSelector:parsed index:index fullPathPatterns:fullPathPatterns])
+        {
+            [invalid addIndex:index];
+        }
+    }];
+    [_root seal];
+    _fullPathPatterns = fullPathPatterns;
+    _invalidSelectors = invalid;
+    _regexes = nil;
+    _regexIndexes = nil;
+
+    return self;
+}
+
+
+#pragma mark - compiling
+
+- (nullable NSRegularExpression *)regexForPattern:(NSString *)pattern index:(NSUInteger *)index
+{
+    NSRegularExpression *regex = _regexes[pattern];
+    if (!regex)
+    {
+        NSString *const anchored = [NSString stringWithFormat:@"\\A(?:%@)\\z", pattern];
+        regex = [NSRegularExpression regularExpressionWithPattern:anchored options:0 error:nil];
+        if (!regex)
+        {
+            return nil;
+        }
+        _regexes[pattern] = regex;
+        _regexIndexes[pattern] = @(_regexCount++);
+    }
+    *index = _regexIndexes[pattern].unsignedIntegerValue;
+    return regex;
+}
+
+- (BOOL)compileSelector:(DiffusionParsedTopicSelector *)parsed index:(NSUInteger)index fullPathPatterns:(NSMutableArray<DiffusionFullPathPattern *> *)fullPathPatterns
+{
+    if (parsed.type == DiffusionTopicSelectorTypeSet)
+    {
+        // a part that cannot be compiled leaves the whole set out, so that an invalid selector never matches
+        if (![self canCompileSelector:parsed])
+        {
+            return NO;
+        }
+        for (DiffusionParsedTopicSelector *part in parsed.parts)
+        {
+            [self compileSelector:part index:index fullPathPatterns:fullPathPatterns];
+        }
+        return YES;
+    }
+
+    NSUInteger regexIndex;
+    if (parsed.type == DiffusionTopicSelectorTypeFullPath)
+    {
+        NSRegularExpression *const regex = [self regexForPattern:parsed.expression index:&regexIndex];
+        if (!regex)
+        {
+            return NO;
+        }
+        [fullPathPatterns addObject:[[DiffusionFullPathPattern alloc] initWithRegex:regex qualifier:parsed.qualifier index:index]];
+        return YES;
+    }
+
+    const BOOL split = parsed.type == DiffusionTopicSelectorTypeSplitPath;
+    DiffusionSelectorMatcherNode *node = _root;
+    for (NSString *segment in parsed.segments)
+    {
+        if (!split)
+        {
+            DiffusionSelectorMatcherNode *child = node.literalChildren[segment];
+            if (!child)
+            {
+                child = [[DiffusionSelectorMatcherNode alloc] init];
+                node.literalChildren[segment] = child;
+                _nodeCount++;
+            }
+            node = child;
+            continue;
+        }
+
+        DiffusionSelectorMatcherNode *child = node.patternChildrenByPattern[segment];
+        if (!child)
+        {
+            NSRegularExpression *const regex = [self regexForPattern:segment index:&regexIndex];
+            if (!regex)
+            {
+                return NO;
+            }
+            child = [[DiffusionSelectorMatcherNode alloc] init];
+            child.regex = regex;
+            child.regexIndex = regexIndex;
+            node.patternChildrenByPattern[segment] = child;
+            [node.patternChildren addObject:child];
+            _nodeCount++;
+        }
+        node = child;
+    }
+    [node acceptSelector:index qualifier:parsed.qualifier];
+    return YES;
+}
+
+// whether every regular expression of the selector compiles
+- (BOOL)canCompileSelector:(DiffusionParsedTopicSelector *)parsed
+{
+    NSUInteger regexIndex;
+    switch (parsed.type)
+    {
+        case DiffusionTopicSelectorTypePath:
+            return YES;
+        case DiffusionTopicSelectorTypeFullPath:
+            return [self regexForPattern:parsed.expression index:&regexIndex] != nil;
+        case DiffusionTopicSelectorTypeSplitPath:
+            for (NSString *segment in parsed.segments)
+            {
+                if (![self regexForPattern:segment index:&regexIndex])
+                {
+                    return NO;
+                }
+            }
+            return YES;
+        case DiffusionTopicSelectorTypeSet:
+            for (DiffusionParsedTopicSelector *part in parsed.parts)
+            {
+                if (![self canCompileSelector:part])
+                {
+                    return NO;
+                }
+            }
+            return YES;
+    }
+    return NO;
+}
+
+
+#pragma mark - matching
+
+- (NSIndexSet *)indexesOfSelectorsMatchingTopicPath:(NSString *)topicPath
+{
+    NSMutableIndexSet *const matches = [NSMutableIndexSet indexSet];
+    [self matchTopicPath:topicPath into:matches];
+    return matches;
+}
+
+- (BOOL)anySelectorMatchesTopicPath:(NSString *)topicPath
+{
+    return [self matchTopicPath:topicPath into:nil];
+}
+
+// without matches, stops at the first selector matching. YES if any did
+- (BOOL)matchTopicPath:(NSString *)topicPath into:(nullable NSMutableIndexSet *)matches
+{
+    // the path as UTF-8: straight from the string when it holds it that way, else copied to the stack when short enough
+    uint8_t stackBytes[_StackBytes];
+    const uint8_t *bytes = (const uint8_t *)CFStringGetCStringPtr((__bridge CFStringRef)topicPath, kCFStringEncodingUTF8);
+    uint8_t *copiedBytes = NULL;
+    NSUInteger length = 0;
+    if (bytes)
+    {
+        length = strlen((const char *)bytes);
+    }
+    else
+    {
+        const NSUInteger capacity = [topicPath maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        copiedBytes = capacity <= _StackBytes ? stackBytes : malloc(capacity);
+        [topicPath getBytes:copiedBytes maxLength:capacity usedLength:&length encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, topicPath.length) remainingRange:NULL];
+        bytes = copiedBytes;
+    }
+
+    // the states before and after a segment. every state has a single parent, so each side holds at most every state
+    __unsafe_unretained DiffusionSelectorMatcherNode *stackStates[2 * _StackStates];
+    __unsafe_unretained DiffusionSelectorMatcherNode **const states = _nodeCount <= _StackStates
+        ? stackStates
+        : (__unsafe_unretained DiffusionSelectorMatcherNode **)malloc(2 * _nodeCount * sizeof(id));
+    uint8_t stackEvaluations[_StackRegexes];
+    uint8_t *const evaluations = _regexCount <= _StackRegexes ? stackEvaluations : malloc(_regexCount);
+
+    BOOL matched = [self matchBytes:bytes length:length ofTopicPath:topicPath states:states evaluations:evaluations into:matches];
+    if ((matches || !matched) && _fullPathPatterns.count)
+    {
+        matched = [self matchFullPathPatterns:topicPath into:matches] || matched;
+    }
+
+    if (copiedBytes != stackBytes)
+    {
+        free(copiedBytes);
+    }
+    if (states != stackStates)
+    {
+        free(states);
+    }
+    if (evaluations != stackEvaluations)
+    {
+        free(evaluations);
+    }
+    return matched;
+}
+
+- (BOOL)matchBytes:(const uint8_t *)bytes
+            length:(NSUInteger)length
+       ofTopicPath:(NSString *)topicPath
+            states:(__unsafe_unretained DiffusionSelectorMatcherNode **)states
+       evaluations:(uint8_t *)evaluations
+              into:(nullable NSMutableIndexSet *)matches
+{
+    __unsafe_unretained DiffusionSelectorMatcherNode **active = states;
+    // the caller's buffer holds two sides of at least this many states
+    __unsafe_unretained DiffusionSelectorMatcherNode **next = states + MAX(_nodeCount, _StackStates);
+    NSUInteger activeCount = 1;
+    active[0] = _root;
+
+    // the segment is compared as bytes with the literal segments, and handed to the regular expressions as a range of
+    // the string: offsets are kept in UTF-16 units too
+    NSUInteger i = 0;
+    NSUInteger utf16 = 0;
+    while (i < length && activeCount)
+    {
+        const NSUInteger start = i;
+        const NSUInteger utf16Start = utf16;
+        while (i < length && bytes[i] != '/')
+        {
+            // one unit per character, two for the characters taking four bytes
+            const uint8_t byte = bytes[i++];
+            if ((byte & 0xC0) != 0x80)
+            {
+                utf16 += byte >= 0xF0 ? 2 : 1;
+            }
+        }
+        const NSUInteger segmentLength = i - start;
+        const NSRange segmentRange = NSMakeRange(utf16Start, utf16 - utf16Start);
+        if (i < length)
+        {
+            i++;
+            utf16++;
+        }
+        if (!segmentLength)
+        {
+            continue;
+        }
+
+        // a regular expression shared by several states is only evaluated once per segment
+        memset(evaluations, _EvaluationNone, _regexCount);
+        NSUInteger nextCount = 0;
+        for (NSUInteger s = 0; s < activeCount; s++)
+        {
+            __unsafe_unretained DiffusionSelectorMatcherNode *const node = active[s];
+            // the path goes deeper than this state
+            if (node.descendants.count)
+            {
+                if (!matches)
+                {
+                    return YES;
+                }
+                [matches addIndexes:node.descendants];
+            }
+
+            DiffusionSelectorMatcherNode *const literal = [node literalChildWithBytes:bytes + start length:segmentLength];
+            if (literal)
+            {
+                next[nextCount++] = literal;
+            }
+            for (DiffusionSelectorMatcherNode *child in node.patternChildren)
+            {
+                uint8_t *const evaluation = &evaluations[child.regexIndex];
+                if (*evaluation == _EvaluationNone)
+                {
+                    *evaluation = _MatchesWhole(child.regex, topicPath, segmentRange) ? _EvaluationMatched : _EvaluationNotMatched;
+                }
+                if (*evaluation == _EvaluationMatched)
+                {
+                    next[nextCount++] = child;
+                }
+            }
+        }
+
+        __unsafe_unretained DiffusionSelectorMatcherNode **const swap = active;
+        active = next;
+        next = swap;
+        activeCount = nextCount;
+    }
+
+    for (NSUInteger s = 0; s < activeCount; s++)
+    {
+        if (active[s].exact.count)
+        {
+            if (!matches)
+            {
+                return YES;
+            }
+            [matches addIndexes:active[s].exact];
+        }
+    }
+    return matches.count > 0;
+}
+
+- (BOOL)matchFullPathPatterns:(NSString *)topicPath into:(nullable NSMutableIndexSet *)matches
+{
+    // the expressions see the path without empty segments, which only ever costs a copy for a path that has them
+    NSString *const path = [topicPath hasPrefix:@"/"] || [topicPath hasSuffix:@"/"] || [topicPath containsString:@"//"]
+        ? [[DiffusionParsedTopicSelector segmentsOfPath:topicPath] componentsJoinedByString:@"/"]
+        : topicPath;
+    const NSUInteger length = path.length;
+
+    BOOL matched = NO;
+    for (DiffusionFullPathPattern *pattern in _fullPathPatterns)
+    {
+        if ([matches containsIndex:pattern.index])
+        {
+            continue;
+        }
+        BOOL patternMatched = pattern.qualifier != DiffusionPathQualifierDescendants && _MatchesWhole(pattern.regex, path, NSMakeRange(0, length));
+
+        // a descendant of a path the expression matches: every ancestor ends before a separator
+        if (!patternMatched && pattern.qualifier != DiffusionPathQualifierNone)
+        {
+            NSRange separator = [path rangeOfString:@"/" options:NSLiteralSearch];
+            while (separator.location != NSNotFound && !patternMatched)
+            {
+                patternMatched = _MatchesWhole(pattern.regex, path, NSMakeRange(0, separator.location));
+                const NSUInteger from = NSMaxRange(separator);
+                separator = [path rangeOfString:@"/" options:NSLiteralSearch range:NSMakeRange(from, length - from)];
+            }
+        }
+
+        if (patternMatched)
+        {
+            if (!matches)
+            {
+                return YES;
+            }
+            [matches addIndex:pattern.index];
+            matched = YES;
+        }
+    }
+    return matched;
+}
+
+@end
@@ -0,0 +1,323 @@
+//
+//  BackOffReconnectionStrategyTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BackOffReconnectionStrategy.h"
+#import "CircuitBreakerReconnectionStrategy.h"
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionManagerWithReconnectionStrategy.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTimerWheel.h"
+
+@interface BackOffReconnectionStrategyTests : XCTestCase
+
+@end
+
+@implementation BackOffReconnectionStrategyTests
+
+- (void)setUp {
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelWarn);
+}
+
+// the delays of consecutive failed attempts, each attempt made when the previous delay is over
+static NSArray<NSNumber *> *_Delays(BackOffReconnectionStrategy *strategy, NSUInteger count)
+{
+    NSMutableArray<NSNumber *> *const delays = [NSMutableArray array];
+    NSTimeInterval now = 100;
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        const NSTimeInterval delay = [strategy delayBeforeAttemptAtTime:now];
+        [delays addObject:@(delay)];
+        now += delay;
+    }
+    return delays;
+}
+
+
+- (void)testLinearDelays {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    XCTAssertEqualObjects(_Delays(strategy, 8), (@[@0, @1, @2, @3, @4, @5, @5, @5]));
+}
+
+- (void)testExponentialDelays {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:10.0];
+    strategy.mode = BackOffModeExponential;
+    strategy.baseDelay = 0.5;
+    XCTAssertEqualObjects(_Delays(strategy, 7), (@[@0, @0.5, @1, @2, @4, @8, @10]));
+}
+
+- (void)testAttemptsResetWhenConnected {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    XCTAssertEqualObjects(_Delays(strategy, 4), (@[@0, @1, @2, @3]));
+    XCTAssertEqual(strategy.attemptCount, 4);
+
+    // however soon it is asked again, nothing resets the attempts but the session reconnecting
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:1000], 4);
+    [strategy reset];
+    XCTAssertEqual(strategy.attemptCount, 0);
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:1000], 0);
+}
+
+- (void)testAttemptHistoryKeepsTheLatestAttempts {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:100.0];
+    XCTAssertEqualObjects(strategy.recentAttemptDelays, @[]);
+    _Delays(strategy, 40);
+
+    NSArray<NSNumber *> *const delays = strategy.recentAttemptDelays;
+    XCTAssertEqual(delays.count, 16);
+    XCTAssertEqualObjects(delays.firstObject, @24);
+    XCTAssertEqualObjects(delays.lastObject, @39);
+}
+
+- (void)testAttemptsResetAfterAQuietPeriod {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    strategy.mode = BackOffModeExponential;
+    strategy.resetsAfterQuietPeriod = YES;
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:100], 0);
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:100], 1);
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:101], 2);
+
+    // longer than twice the next delay without being asked: the last attempt worked
+    XCTAssertEqual([strategy delayBeforeAttemptAtTime:200], 0);
+}
+
+/**
+
+    A flapping link: down for 6 s, then the first attempt after that gets through, then up for only 4 s before it
+    drops again. Returns the mean time from each drop to the session connected again.
+
+ */
+static NSTimeInterval _MeanReconnectLatency(BackOffReconnectionStrategy *strategy, BOOL stateDriven)
+{
+    const NSTimeInterval down = 6.0, up = 4.0;
+    const NSUInteger outages = 100;
+    NSTimeInterval now = 1000, total = 0;
+    for (NSUInteger i = 0; i < outages; i++)
+    {
+        const NSTimeInterval drop = now;
+        // every attempt fails at once while the link is down
+        do
+        {
+            now += [strategy delayBeforeAttemptAtTime:now];
+        }
+        while (now < drop + down);
+        total += now - drop;
+        if (stateDriven)
+        {
+            [strategy reset];
+        }
+        now += up;
+    }
+    return total / outages;
+}
+
+- (void)testStateDrivenResetReconnectsSoonerThanTheQuietPeriodGuess {
+    BackOffReconnectionStrategy *const guessing = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    guessing.resetsAfterQuietPeriod = YES;
+    const NSTimeInterval guessed = _MeanReconnectLatency(guessing, NO);
+
+    BackOffReconnectionStrategy *const stateDriven = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    const NSTimeInterval reset = _MeanReconnectLatency(stateDriven, YES);
+
+    // flapping link, down 6 s and up 4 s
+    [DiffusionBenchmarkSuite.sharedSuite report:@"backOff.flapping.quietPeriodGuess" value:guessed unit:@"s"];
+    [DiffusionBenchmarkSuite.sharedSuite report:@"backOff.flapping.resetOnConnected" value:reset unit:@"s"];
+    // 0 + 1 + 2 + 3 s of delays, every time
+    XCTAssertEqualWithAccuracy(reset, 6.0, 1e-9);
+    XCTAssertGreaterThan(guessed, reset * 1.4);
+}
+
+- (void)testManagerFeedsTheHealthOnTheClockOfItsDelays {
+    // a wheel driven by hand: the manager times the health on it, and the back-off reads the health at its time
+    DiffusionTimerWheel *const wheel = [[DiffusionTimerWheel alloc] initWithResolution:0.01 targetQueue:nil];
+    DiffusionManagerWithReconnectionStrategy *const manager = [[DiffusionManagerWithReconnectionStrategy alloc] initWithTimerWheel:wheel];
+    CircuitBreakerReconnectionStrategy *const strategy = (CircuitBreakerReconnectionStrategy *)manager.sessionConfiguration.reconnectionStrategy;
+    BackOffReconnectionStrategy *const backOff = strategy.backOff;
+
+    [wheel advanceToTime:100];
+    [manager noteSessionStateChangeFrom:DiffusionConnectionStateConnecting to:DiffusionConnectionStateConnected];
+    [wheel advanceToTime:110];
+    [manager noteSessionStateChangeFrom:DiffusionConnectionStateConnected to:DiffusionConnectionStateRecovering];
+    [wheel advanceToTime:160];
+
+    // connected 10 s of the last 60
+    XCTAssertEqualWithAccuracy([manager.connectionHealth scoreAtTime:wheel.currentTime], 10.0 / 60.0, 1e-9);
+    // the first decorrelated delay is drawn below the base delay, unless the connection is degraded
+    XCTAssertGreaterThanOrEqual([backOff delayBeforeNextAttempt], backOff.baseDelay);
+}
+
+- (void)testSameSeedGivesSameDelays {
+    for (BackOffMode mode = BackOffModeLinear; mode <= BackOffModeDecorrelatedJitter; mode++)
+    {
+        BackOffReconnectionStrategy *const a = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:30.0];
+        BackOffReconnectionStrategy *const b = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:30.0];
+        BackOffReconnectionStrategy *const c = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:30.0];
+        for (BackOffReconnectionStrategy *strategy in @[a, b, c])
+        {
+            strategy.mode = mode;
+            strategy.jitter = 1.0;
+            strategy.seed = strategy == c ? 8 : 7;
+        }
+        NSArray<NSNumber *> *const delays = _Delays(a, 20);
+        XCTAssertEqualObjects(_Delays(b, 20), delays);
+        XCTAssertNotEqualObjects(_Delays(c, 20), delays);
+    }
+}
+
+- (void)testJitterStaysBelowTheNominalDelay {
+    for (uint64_t seed = 1; seed <= 1000; seed++)
+    {
+        BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:10.0];
+        strategy.mode = BackOffModeExponential;
+        strategy.jitter = 0.5;
+        strategy.seed = seed;
+        NSArray<NSNumber *> *const delays = _Delays(strategy, 8);
+        const double nominal[] = {0, 1, 2, 4, 8, 10, 10, 10};
+        // the first attempt is spread below the base delay, the others over the upper half of their delay
+        XCTAssertLessThanOrEqual(delays[0].doubleValue, 0.5);
+        for (NSUInteger i = 1; i < delays.count; i++)
+        {
+            XCTAssertGreaterThanOrEqual(delays[i].doubleValue, nominal[i] / 2);
+            XCTAssertLessThanOrEqual(delays[i].doubleValue, nominal[i]);
+        }
+    }
+}
+
+- (void)testDecorrelatedJitterBounds {
+    for (uint64_t seed = 1; seed <= 1000; seed++)
+    {
+        BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:20.0];
+        strategy.mode = BackOffModeDecorrelatedJitter;
+        strategy.seed = seed;
+        NSArray<NSNumber *> *const delays = _Delays(strategy, 12);
+        XCTAssertLessThanOrEqual(delays[0].doubleValue, 1.0);
+        for (NSUInteger i = 1; i < delays.count; i++)
+        {
+            XCTAssertGreaterThanOrEqual(delays[i].doubleValue, 1.0);
+            XCTAssertLessThanOrEqual(delays[i].doubleValue, MIN(MAX(delays[i - 1].doubleValue * 3, 1.0), 20.0));
+        }
+    }
+}
+
+/**
+
+    A server restart seen by a fleet: every client loses its session at once, the server is back after 20 seconds
+    and accepts 10,000 connections a second, rejecting the rest. Reports the peak rate of attempts reaching the
+    server, over 100 ms, the attempts made in total and when the last client got back.
+
+ */
+typedef struct {
+    NSUInteger peakRate;
+    NSUInteger attempts;
+    NSUInteger reconnected;
+    NSTimeInterval lastReconnection;
+} _FleetResult;
+
+static _FleetResult _SimulateFleet(NSUInteger clients, BackOffMode mode, double jitter)
+{
+    const NSTimeInterval tick = 0.01, horizon = 300, restart = 20;
+    const NSUInteger ticks = (NSUInteger)(horizon / tick), ticksPerBucket = 10, bucketsPerSecond = 10;
+    const NSUInteger acceptedPerBucket = 1000;
+
+    NSMutableArray<BackOffReconnectionStrategy *> *const strategies = [NSMutableArray arrayWithCapacity:clients];
+    for (NSUInteger i = 0; i < clients; i++)
+    {
+        BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:10.0];
+        strategy.mode = mode;
+        strategy.jitter = jitter;
+        strategy.seed = i + 1;
+        [strategies addObject:strategy];
+    }
+
+    // a calendar of attempts: a list of clients per tick, linked through next
+    int32_t *const head = malloc((ticks + 1) * sizeof(int32_t));
+    int32_t *const next = malloc(clients * sizeof(int32_t));
+    memset(head, 0xFF, (ticks + 1) * sizeof(int32_t));
+    for (NSUInteger i = 0; i < clients; i++)
+    {
+        next[i] = i + 1 < clients ? (int32_t)(i + 1) : -1;
+    }
+    head[0] = clients ? 0 : -1;
+
+    _FleetResult result = {0};
+    NSUInteger bucketAttempts = 0, bucketAccepted = 0;
+    for (NSUInteger k = 0; k <= ticks && result.reconnected < clients; k++)
+    {
+        if (k % ticksPerBucket == 0)
+        {
+            bucketAttempts = 0;
+            bucketAccepted = 0;
+        }
+        const NSTimeInterval now = k * tick;
+        for (int32_t i = head[k]; i >= 0;)
+        {
+            const int32_t following = next[i];
+            result.attempts++;
+            if (now >= restart)
+            {
+                bucketAttempts++;
+                result.peakRate = MAX(result.peakRate, bucketAttempts * bucketsPerSecond);
+                if (bucketAccepted < acceptedPerBucket)
+                {
+                    bucketAccepted++;
+                    result.reconnected++;
+                    result.lastReconnection = now;
+                    i = following;
+                    continue;
+                }
+            }
+            // the virtual clock starts well above 0, as the monotonic one does
+            const NSTimeInterval delay = [strategies[i] delayBeforeAttemptAtTime:1000 + now];
+            const NSUInteger at = k + MAX((NSUInteger)ceil(delay / tick - 1e-9), 1);
+            if (at <= ticks)
+            {
+                next[i] = head[at];
+                head[at] = i;
+            }
+            i = following;
+        }
+    }
+    free(head);
+    free(next);
+    return result;
+}
+
+- (void)testFleetPeakReconnectRate {
+    const NSUInteger clients = 100000;
+    NSArray<NSArray *> *const modes = @[@[@"linear", @(BackOffModeLinear), @0.0],
+                                        @[@"exponential", @(BackOffModeExponential), @0.0],
+                                        @[@"exponentialFullJitter", @(BackOffModeExponential), @1.0],
+                                        @[@"decorrelatedJitter", @(BackOffModeDecorrelatedJitter), @0.0]];
+    // server back after 20 s accepting 10,000 connections per second
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    NSUInteger peaks[4];
+    for (NSUInteger m = 0; m < modes.count; m++)
+    {
+        const _FleetResult result = _SimulateFleet(clients, [modes[m][1] integerValue], [modes[m][2] doubleValue]);
+        peaks[m] = result.peakRate;
+        NSString *const name = [@"backOff.fleet." stringByAppendingString:modes[m][0]];
+        [suite report:[name stringByAppendingString:@".peak"] value:result.peakRate unit:@"attempts/s"];
+        [suite report:[name stringByAppendingString:@".attempts"] value:result.attempts unit:@"attempts"];
+        [suite report:[name stringByAppendingString:@".reconnected"] value:result.reconnected unit:@"clients"];
+        [suite report:[name stringByAppendingString:@".lastReconnection"] value:result.lastReconnection unit:@"s"];
+        if ([modes[m][2] doubleValue] > 0 || [modes[m][1] integerValue] == BackOffModeDecorrelatedJitter)
+        {
+            XCTAssertEqual(result.reconnected, clients);
+            XCTAssertLessThan(result.lastReconnection, 60);
+        }
+    }
+    // in lockstep the whole fleet lands in the same 100 ms
+    XCTAssertEqual(peaks[0], clients * 10);
+    XCTAssertEqual(peaks[1], clients * 10);
+    XCTAssertLessThan(peaks[2], peaks[0] / 10);
+    XCTAssertLessThan(peaks[3], peaks[0] / 10);
+}
+
+@end
@@ -0,0 +1,90 @@
+//
+//  DiffusionBenchmarkSuite.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface DiffusionBenchmarkResult : NSObject
+
+@property(nonatomic, readonly) NSString *name;
+// per sample
+@property(nonatomic, readonly) NSUInteger operations;
+// median and fastest of the samples
+@property(nonatomic, readonly) double nanosecondsPerOperation;
+@property(nonatomic, readonly) double minimumNanosecondsPerOperation;
+// from the baseline, 0 when it has none for this benchmark
+@property(nonatomic, readonly) double baselineNanosecondsPerOperation;
+
+-(instancetype) initWithName:(NSString *)name
+                  operations:(NSUInteger)operations
+                      median:(double)median
+                     minimum:(double)minimum
+                    baseline:(double)baseline NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+/**
+
+    Times the hot paths of the project and checks them against a stored baseline.
+
+    Each benchmark is run once to warm up, then a few more times; the median time per operation is what counts. After
+    every benchmark all the results so far are written as JSON to the results file, in the format of the baseline, so
+    that a results file from a reference device can be committed as the new baseline.
+
+    Figures the suite does not time itself, a rate or a size measured by a test, are reported to it and written to the
+    results file with the results, never compared with the baseline.
+
+    A benchmark without a baseline is skipped, as timings only mean something against a baseline from the same device.
+    A gate fails it instead: with nothing to compare with it would pass whatever happens. Record mode lets them all
+    pass, to produce the results file that becomes the baseline.
+
+    The environment can change the defaults of the shared suite:
+
+        DIFFUSION_BENCHMARK_BASELINE    baseline file (default: BenchmarkBaseline.json in the test bundle)
+        DIFFUSION_BENCHMARK_RESULTS     results file (default: DiffusionBenchmarkResults.json in the temporary directory)
+        DIFFUSION_BENCHMARK_THRESHOLD   slowdown that counts as a regression, as a fraction (default 0.25)
+        DIFFUSION_BENCHMARK_RECORD      1 for record mode
+        DIFFUSION_BENCHMARK_GATE        1 to fail a benchmark without a baseline, for the gate of a reference device
+
+ */
+@interface DiffusionBenchmarkSuite : NSObject
+
+// nil to keep the results in memory only
+@property(nonatomic, readonly, nullable) NSURL *resultsURL;
+@property(nonatomic) double regressionThreshold;
+@property(nonatomic, getter=isRecording) BOOL recording;
+// default NO. when set, a benchmark without a baseline fails outside record mode
+@property(nonatomic, getter=isGating) BOOL gating;
+// nanoseconds per operation by benchmark name
+@property(nonatomic, readonly) NSDictionary<NSString *, NSNumber *> *baseline;
+@property(nonatomic, readonly) NSArray<DiffusionBenchmarkResult *> *results;
+// value and unit of every figure reported, by name
+@property(nonatomic, readonly) NSDictionary<NSString *, NSDictionary<NSString *, id> *> *reports;
+
+// configured from the environment
++ (instancetype)sharedSuite;
+
+-(instancetype) initWithBaseline:(NSDictionary<NSString *, NSNumber *> *)baseline resultsURL:(nullable NSURL *)resultsURL NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// the block runs the given number of operations
+- (DiffusionBenchmarkResult *)measure:(NSString *)name operations:(NSUInteger)operations block:(void (NS_NOESCAPE ^)(NSUInteger operations))block;
+
+// replaces any figure reported under the same name
+- (void)report:(NSString *)name value:(double)value unit:(NSString *)unit;
+
+// why the result fails, a regression or a missing baseline when gating, or nil if it passes
+- (nullable NSString *)regressionOfResult:(DiffusionBenchmarkResult *)result;
+
+@end
+
+NS_ASSUME_NONNULL_END
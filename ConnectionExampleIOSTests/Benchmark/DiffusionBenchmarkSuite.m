@@ -0,0 +1,208 @@
+//
+//  DiffusionBenchmarkSuite.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionBenchmarkSuite.h"
+
+#import <sys/utsname.h>
+
+#import "DiffusionTestSupport.h"
+
+static const NSUInteger _SampleCount = 7;
+
+@implementation DiffusionBenchmarkResult
+
+-(instancetype) initWithName:(NSString *)name operations:(NSUInteger)operations median:(double)median minimum:(double)minimum baseline:(double)baseline
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _name = [name copy];
+    _operations = operations;
+    _nanosecondsPerOperation = median;
+    _minimumNanosecondsPerOperation = minimum;
+    _baselineNanosecondsPerOperation = baseline;
+
+    return self;
+}
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    return @{@"nsPerOperation": @(_nanosecondsPerOperation),
+             @"minimumNsPerOperation": @(_minimumNanosecondsPerOperation),
+             @"operations": @(_operations)};
+}
+
+@end
+
+
+@implementation DiffusionBenchmarkSuite
+{
+    NSMutableArray<DiffusionBenchmarkResult *> *_results;
+    NSMutableDictionary<NSString *, NSDictionary<NSString *, id> *> *_reports;
+}
+
+
++ (instancetype)sharedSuite
+{
+    static DiffusionBenchmarkSuite *_suite = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSDictionary<NSString *, NSString *> *const environment = NSProcessInfo.processInfo.environment;
+
+        NSString *const baseline = environment[@"DIFFUSION_BENCHMARK_BASELINE"];
+        NSURL *const baselineURL = baseline.length ? [NSURL fileURLWithPath:baseline] : [[NSBundle bundleForClass:self] URLForResource:@"BenchmarkBaseline" withExtension:@"json"];
+        NSString *const results = environment[@"DIFFUSION_BENCHMARK_RESULTS"];
+        NSURL *const resultsURL = results.length ? [NSURL fileURLWithPath:results] : [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"DiffusionBenchmarkResults.json"]];
+        _suite = [[self alloc] initWithBaseline:[self baselineWithContentsOfURL:baselineURL] resultsURL:resultsURL];
+
+        NSString *const threshold = environment[@"DIFFUSION_BENCHMARK_THRESHOLD"];
+        if (threshold.length)
+        {
+            _suite.regressionThreshold = threshold.doubleValue;
+        }
+        _suite.recording = [environment[@"DIFFUSION_BENCHMARK_RECORD"] isEqualToString:@"1"];
+        _suite.gating = [environment[@"DIFFUSION_BENCHMARK_GATE"] isEqualToString:@"1"];
+    });
+    return _suite;
+}
+
+-(instancetype) initWithBaseline:(NSDictionary<NSString *, NSNumber *> *)baseline resultsURL:(nullable NSURL *)resultsURL
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _baseline = [baseline copy];
+    _resultsURL = [resultsURL copy];
+    _regressionThreshold = 0.25;
+    _results = [NSMutableArray array];
+    _reports = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
++ (NSDictionary<NSString *, NSNumber *> *)baselineWithContentsOfURL:(nullable NSURL *)url
+{
+    NSData *const data = url ? [NSData dataWithContentsOfURL:url] : nil;
+    NSDictionary *const file = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+    NSDictionary *const benchmarks = [file isKindOfClass:NSDictionary.class] ? file[@"benchmarks"] : nil;
+    if (![benchmarks isKindOfClass:NSDictionary.class])
+    {
+        return @{};
+    }
+
+    NSMutableDictionary<NSString *, NSNumber *> *const baseline = [NSMutableDictionary dictionary];
+    [benchmarks enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSDictionary *benchmark, BOOL *stop) {
+        NSNumber *const value = [benchmark isKindOfClass:NSDictionary.class] ? benchmark[@"nsPerOperation"] : nil;
+        if ([value isKindOfClass:NSNumber.class] && value.doubleValue > 0)
+        {
+            baseline[name] = value;
+        }
+    }];
+    return baseline;
+}
+
+- (NSArray<DiffusionBenchmarkResult *> *)results
+{
+    return [_results copy];
+}
+
+- (NSDictionary<NSString *, NSDictionary<NSString *, id> *> *)reports
+{
+    return [_reports copy];
+}
+
+
+#pragma mark - measuring
+
+- (DiffusionBenchmarkResult *)measure:(NSString *)name operations:(NSUInteger)operations block:(void (NS_NOESCAPE ^)(NSUInteger operations))block
+{
+    operations = MAX(operations, (NSUInteger)1);
+    block(operations);
+
+    double samples[_SampleCount];
+    for (NSUInteger i = 0; i < _SampleCount; i++)
+    {
+        @autoreleasepool
+        {
+            const uint64_t start = DiffusionTestNow();
+            block(operations);
+            samples[i] = (double)(DiffusionTestNow() - start) / operations;
+        }
+    }
+    qsort_b(samples, _SampleCount, sizeof(double), ^int(const void *a, const void *b) {
+        const double x = *(const double *)a;
+        const double y = *(const double *)b;
+        return x < y ? -1 : (x > y ? 1 : 0);
+    });
+
+    DiffusionBenchmarkResult *const result = [[DiffusionBenchmarkResult alloc] initWithName:name
+                                                                                 operations:operations
+                                                                                     median:samples[_SampleCount / 2]
+                                                                                    minimum:samples[0]
+                                                                                   baseline:_baseline[name].doubleValue];
+    [_results filterUsingPredicate:[NSPredicate predicateWithFormat:@"name != %@", name]];
+    [_results addObject:result];
+    [self writeResults];
+    return result;
+}
+
+- (void)report:(NSString *)name value:(double)value unit:(NSString *)unit
+{
+    // JSON has no infinity, which a rate over no time would be
+    _reports[name] = @{@"value": isfinite(value) ? @(value) : NSNull.null, @"unit": unit};
+    [self writeResults];
+}
+
+- (nullable NSString *)regressionOfResult:(DiffusionBenchmarkResult *)result
+{
+    const double baseline = result.baselineNanosecondsPerOperation;
+    if (baseline <= 0)
+    {
+        return _recording || !_gating ? nil : [NSString stringWithFormat:@"%@ has no baseline (%.1f ns/op). Run the benchmarks on the reference device with "
+                                   "DIFFUSION_BENCHMARK_RECORD=1 and commit the results file as BenchmarkBaseline.json", result.name, result.nanosecondsPerOperation];
+    }
+    if (result.nanosecondsPerOperation <= baseline * (1.0 + _regressionThreshold))
+    {
+        return nil;
+    }
+    return [NSString stringWithFormat:@"%@ regressed: %.1f ns/op against a baseline of %.1f (+%.0f%%, threshold %.0f%%)",
+            result.name, result.nanosecondsPerOperation, baseline, (result.nanosecondsPerOperation / baseline - 1.0) * 100, _regressionThreshold * 100];
+}
+
+
+#pragma mark - results
+
+- (void)writeResults
+{
+    if (!_resultsURL)
+    {
+        return;
+    }
+
+    struct utsname system;
+    uname(&system);
+
+    NSMutableDictionary<NSString *, id> *const benchmarks = [NSMutableDictionary dictionary];
+    for (DiffusionBenchmarkResult *result in _results)
+    {
+        benchmarks[result.name] = [result dictionaryRepresentation];
+    }
+    NSDictionary<NSString *, id> *const file = @{@"date": [NSISO8601DateFormatter stringFromDate:[NSDate date] timeZone:NSTimeZone.localTimeZone formatOptions:NSISO8601DateFormatWithInternetDateTime],
+                                                  @"machine": @(system.machine),
+                                                  @"system": NSProcessInfo.processInfo.operatingSystemVersionString,
+                                                  @"benchmarks": benchmarks,
+                                                  @"reports": _reports};
+    NSData *const data = [NSJSONSerialization dataWithJSONObject:file options:NSJSONWritingPrettyPrinted | NSJSONWritingSortedKeys error:nil];
+    [data writeToURL:_resultsURL atomically:YES];
+}
+
+@end
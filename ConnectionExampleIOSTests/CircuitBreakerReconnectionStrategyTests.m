@@ -0,0 +1,142 @@
+//
+//  CircuitBreakerReconnectionStrategyTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BackOffReconnectionStrategy.h"
+#import "CircuitBreakerReconnectionStrategy.h"
+#import "DiffusionManagerWithReconnectionStrategy.h"
+
+@interface CircuitBreakerReconnectionStrategyTests : XCTestCase
+
+@end
+
+@implementation CircuitBreakerReconnectionStrategyTests
+
+static CircuitBreakerReconnectionStrategy *_Breaker(NSUInteger threshold)
+{
+    CircuitBreakerReconnectionStrategy *const breaker = [[CircuitBreakerReconnectionStrategy alloc] initWithBackOffStrategy:[[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0]];
+    breaker.failureThreshold = threshold;
+    breaker.probeInterval = 60.0;
+    return breaker;
+}
+
+
+- (void)testOpensAfterConsecutiveFailures {
+    CircuitBreakerReconnectionStrategy *const breaker = _Breaker(3);
+    NSTimeInterval delay;
+    XCTAssertEqual([breaker actionForAttemptAtTime:100 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 0);
+    XCTAssertEqual([breaker actionForAttemptAtTime:100 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 1);
+    XCTAssertEqual([breaker actionForAttemptAtTime:101 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 2);
+    XCTAssertEqual(breaker.state, CircuitBreakerStateClosed);
+
+    // third failure: without a probe the attempt itself waits for the probe interval
+    XCTAssertEqual([breaker actionForAttemptAtTime:103 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 60);
+    XCTAssertEqual(breaker.state, CircuitBreakerStateHalfOpen);
+    XCTAssertEqual(breaker.openedCount, 1);
+    // the back-off would have tried every 5 s, one of those is still made
+    XCTAssertEqual(breaker.avoidedCount, 11);
+
+    // that one failed too
+    XCTAssertEqual([breaker actionForAttemptAtTime:163 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 60);
+    XCTAssertEqual(breaker.avoidedCount, 22);
+    XCTAssertEqual(breaker.openedCount, 1);
+    XCTAssertEqual(breaker.startedCount, 5);
+
+    [breaker noteConnected];
+    XCTAssertEqual(breaker.state, CircuitBreakerStateClosed);
+    XCTAssertEqual([breaker actionForAttemptAtTime:500 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 0);
+}
+
+- (void)testProbesUntilTheServerIsReachable {
+    CircuitBreakerReconnectionStrategy *const breaker = _Breaker(2);
+    breaker.probe = ^(void (^completionHandler)(BOOL reachable)) {
+        completionHandler(YES);
+    };
+    NSTimeInterval delay;
+    [breaker actionForAttemptAtTime:100 reconnectionTimeout:-1 delay:&delay];
+    [breaker actionForAttemptAtTime:100 reconnectionTimeout:-1 delay:&delay];
+    XCTAssertEqual([breaker actionForAttemptAtTime:101 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionProbe);
+    XCTAssertEqual(delay, 60);
+    XCTAssertEqual(breaker.state, CircuitBreakerStateOpen);
+
+    XCTAssertEqual([breaker actionAfterProbe:NO atTime:161 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionProbe);
+    XCTAssertEqual(delay, 60);
+    XCTAssertEqual(breaker.avoidedCount, 24);
+
+    // reachable: the attempt starts at once
+    XCTAssertEqual([breaker actionAfterProbe:YES atTime:221 reconnectionTimeout:-1 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual(delay, 0);
+    XCTAssertEqual(breaker.state, CircuitBreakerStateHalfOpen);
+    XCTAssertEqual(breaker.probeCount, 2);
+    XCTAssertEqual(breaker.startedCount, 3);
+}
+
+- (void)testAbortsWhenTheReconnectionTimeoutWouldBeOver {
+    CircuitBreakerReconnectionStrategy *const breaker = _Breaker(5);
+    NSTimeInterval delay;
+    XCTAssertEqual([breaker actionForAttemptAtTime:100 reconnectionTimeout:2 delay:&delay], CircuitBreakerActionStart);
+    XCTAssertEqual([breaker actionForAttemptAtTime:100 reconnectionTimeout:2 delay:&delay], CircuitBreakerActionStart);
+    // would start at 103, past the 2 s the session has
+    XCTAssertEqual([breaker actionForAttemptAtTime:101 reconnectionTimeout:2 delay:&delay], CircuitBreakerActionAbort);
+    XCTAssertEqual(breaker.abortedCount, 1);
+
+    // while open, a probe too late is not waited for either
+    CircuitBreakerReconnectionStrategy *const open = _Breaker(2);
+    open.probe = ^(void (^completionHandler)(BOOL reachable)) {
+        completionHandler(NO);
+    };
+    [open actionForAttemptAtTime:200 reconnectionTimeout:90 delay:&delay];
+    [open actionForAttemptAtTime:200 reconnectionTimeout:90 delay:&delay];
+    XCTAssertEqual([open actionForAttemptAtTime:201 reconnectionTimeout:90 delay:&delay], CircuitBreakerActionProbe);
+    XCTAssertEqual([open actionAfterProbe:NO atTime:261 reconnectionTimeout:90 delay:&delay], CircuitBreakerActionAbort);
+    XCTAssertEqual(open.abortedCount, 1);
+    XCTAssertEqual(open.state, CircuitBreakerStateClosed);
+}
+
+- (void)testProductionSettingsProbeBeforeTheTimeout {
+    DiffusionManagerWithReconnectionStrategy *const manager = [[DiffusionManagerWithReconnectionStrategy alloc] init];
+    PTDiffusionSessionConfiguration *const configuration = manager.sessionConfiguration;
+    CircuitBreakerReconnectionStrategy *const breaker = (CircuitBreakerReconnectionStrategy *)configuration.reconnectionStrategy;
+    XCTAssertTrue([breaker isKindOfClass:CircuitBreakerReconnectionStrategy.class]);
+    XCTAssertNotNil(breaker.probe);
+    const NSTimeInterval timeout = configuration.reconnectionTimeout.doubleValue;
+    XCTAssertGreaterThan(timeout, 0);
+    XCTAssertLessThan(breaker.probeInterval, timeout);
+
+    // the disconnection, then failed attempts on the back-off until the circuit opens
+    NSTimeInterval now = 1000;
+    NSTimeInterval delay = 0;
+    CircuitBreakerAction action = CircuitBreakerActionStart;
+    for (NSUInteger attempt = 0; attempt <= breaker.failureThreshold; attempt++)
+    {
+        now += delay;
+        action = [breaker actionForAttemptAtTime:now reconnectionTimeout:timeout delay:&delay];
+    }
+    XCTAssertEqual(breaker.state, CircuitBreakerStateOpen);
+    XCTAssertEqual(action, CircuitBreakerActionProbe);
+    XCTAssertEqual(delay, breaker.probeInterval);
+
+    // the server stays down: probed several times before the session gives up
+    while (action == CircuitBreakerActionProbe)
+    {
+        now += delay;
+        action = [breaker actionAfterProbe:NO atTime:now reconnectionTimeout:timeout delay:&delay];
+    }
+    XCTAssertEqual(action, CircuitBreakerActionAbort);
+    XCTAssertGreaterThan(breaker.probeCount, 5);
+    XCTAssertEqual(breaker.abortedCount, 1);
+}
+
+@end
@@ -0,0 +1,273 @@
+//
+//  DiffusionBenchmarkTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BackOffReconnectionStrategy.h"
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTopicSelectorMatcher.h"
+#import "DiffusionTopicValueCache.h"
+#import "DiffusionTypedStreamDispatcher.h"
+
+/**
+
+    The hot paths of an update, from decoding to the handlers, and of reconnecting, timed against the baseline of
+    DiffusionBenchmarkSuite. A benchmark fails when it is slower than its baseline by more than the threshold. One with
+    no baseline is skipped, or fails under DIFFUSION_BENCHMARK_GATE=1.
+
+ */
+@interface DiffusionBenchmarkTests : XCTestCase
+
+@end
+
+@implementation DiffusionBenchmarkTests
+
+static volatile NSUInteger _Sink;
+
+
+- (void)setUp {
+    // what is measured is the work, not the logging of it
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelWarn);
+}
+
+- (void)check:(DiffusionBenchmarkResult *)result {
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    NSString *const regression = [suite regressionOfResult:result];
+    XCTAssertNil(regression, @"%@", regression);
+    if (!regression && result.baselineNanosecondsPerOperation <= 0 && !suite.isRecording)
+    {
+        XCTSkip(@"%@ has no baseline (%.1f ns/op)", result.name, result.nanosecondsPerOperation);
+    }
+}
+
+// a typical sportsbook price update
+static NSDictionary *_Odds(NSUInteger i)
+{
+    return @{@"fixture": [NSString stringWithFormat:@"Fixture%lu", (unsigned long)i],
+             @"market": @"Match Result",
+             @"suspended": @NO,
+             @"updated": @(1580428800000 + i),
+             @"selections": @[@{@"name": @"Home", @"price": @(1.5 + (i % 10) / 100.0)},
+                              @{@"name": @"Draw", @"price": @(3.75)},
+                              @{@"name": @"Away", @"price": @(6.0 - (i % 10) / 100.0)}]};
+}
+
+- (void)testJSONDecode {
+    NSMutableArray<PTDiffusionJSON *> *const values = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [values addObject:[[PTDiffusionJSON alloc] initWithObject:_Odds(i) error:nil]];
+    }
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"json.decode" operations:values.count block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += [[values[i] objectWithError:nil] count];
+        }
+    }]];
+}
+
+- (void)testJSONApplyDelta {
+    PTDiffusionJSON *const original = [[PTDiffusionJSON alloc] initWithObject:_Odds(1) error:nil];
+    PTDiffusionJSON *const updated = [[PTDiffusionJSON alloc] initWithObject:_Odds(2) error:nil];
+    PTDiffusionBinaryDelta *const delta = [updated binaryDiffFromJSON:original error:nil];
+    XCTAssertEqualObjects([original applyDelta:delta error:nil].data, updated.data);
+
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"json.applyDelta" operations:10000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += [original applyDelta:delta error:nil].data.length;
+        }
+    }]];
+}
+
+- (void)testBinaryApplyDelta {
+    NSMutableData *const bytes = [NSMutableData dataWithLength:1024];
+    arc4random_buf(bytes.mutableBytes, bytes.length);
+    PTDiffusionBinary *const original = [[PTDiffusionBinary alloc] initWithData:bytes];
+    // a few fields changed, as in a record of prices
+    for (NSUInteger i = 0; i < bytes.length; i += 128)
+    {
+        ((uint8_t *)bytes.mutableBytes)[i] ^= 0xFF;
+    }
+    PTDiffusionBinary *const updated = [[PTDiffusionBinary alloc] initWithData:bytes];
+    PTDiffusionBinaryDelta *const delta = [updated diffFromBinary:original];
+    XCTAssertEqualObjects([original applyDelta:delta error:nil].data, updated.data);
+
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"binary.applyDelta" operations:10000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += [original applyDelta:delta error:nil].data.length;
+        }
+    }]];
+}
+
+- (void)testFallbackStreamDispatch {
+    DiffusionTypedStreamDispatcher *const dispatcher = [[DiffusionTypedStreamDispatcher alloc] init];
+    NSDictionary<NSNumber *, PTDiffusionValueStream *> *const streams = [dispatcher makeStreamsByTopicType];
+    PTDiffusionValueStream *const JSONStream = streams[@(PTDiffusionTopicType_JSON)];
+    PTDiffusionValueStream *const int64Stream = streams[@(PTDiffusionTopicType_Int64)];
+    __block NSUInteger delivered = 0;
+    dispatcher.JSONHandler = ^(NSString *topicPath, PTDiffusionTopicSpecification *specification, PTDiffusionBytes *value) {
+        delivered++;
+    };
+    dispatcher.int64Handler = ^(NSString *topicPath, int64_t value) {
+        delivered++;
+    };
+
+    PTDiffusionTopicSpecification *const JSON = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    PTDiffusionTopicSpecification *const int64 = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Int64];
+    PTDiffusionJSON *const value = [[PTDiffusionJSON alloc] initWithObject:_Odds(1) error:nil];
+    NSMutableArray<NSString *> *const paths = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [paths addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+
+    id<PTDiffusionJSONValueStreamDelegate> const JSONDelegate = (id<PTDiffusionJSONValueStreamDelegate>)dispatcher;
+    id<PTDiffusionNumberValueStreamDelegate> const numberDelegate = (id<PTDiffusionNumberValueStreamDelegate>)dispatcher;
+    NSNumber *const number = @(42);
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"dispatcher.fallbackStream" operations:20000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i += 2)
+        {
+            NSString *const path = paths[i % paths.count];
+            [JSONDelegate diffusionStream:JSONStream didUpdateTopicPath:path specification:JSON oldJSON:nil newJSON:value];
+            [numberDelegate diffusionStream:int64Stream didUpdateTopicPath:path specification:int64 oldNumber:nil newNumber:number];
+        }
+    }]];
+    XCTAssertGreaterThan(delivered, 0u);
+}
+
+- (void)testValueCacheStoreAndLookup {
+    DiffusionTopicValueCache *const cache = [[DiffusionTopicValueCache alloc] init];
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    NSData *const data = [[PTDiffusionJSON alloc] initWithObject:_Odds(1) error:nil].data;
+    NSMutableArray<NSString *> *const paths = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 10000; i++)
+    {
+        [paths addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"cache.store" operations:paths.count block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            [cache storeData:data specification:specification forTopicPath:paths[i]];
+        }
+    }]];
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"cache.lookup" operations:paths.count block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += [cache valueForTopicPath:paths[i]].data.length;
+        }
+    }]];
+}
+
+- (void)testSelectorMatching {
+    NSMutableArray<NSString *> *const selectors = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 200; i++)
+    {
+        switch (i % 10)
+        {
+            case 0:
+                [selectors addObject:[NSString stringWithFormat:@"*Demos/Sportsbook/Sport%lu/.*/Odds", (unsigned long)(i % 10)]];
+                break;
+            case 1:
+            case 2:
+                [selectors addObject:[NSString stringWithFormat:@"?Demos/Sportsbook/Sport%lu/.*/Fixture%lu//", (unsigned long)(i % 10), (unsigned long)(i % 100)]];
+                break;
+            default:
+                [selectors addObject:[NSString stringWithFormat:@">Demos/Sportsbook/Sport%lu/Competition%lu/Fixture%lu//", (unsigned long)(i % 10), (unsigned long)(i % 50), (unsigned long)i]];
+                break;
+        }
+    }
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:selectors];
+    NSMutableArray<NSString *> *const paths = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        [paths addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Sport%lu/Competition%lu/Fixture%lu/Odds", (unsigned long)(i % 10), (unsigned long)(i % 50), (unsigned long)(i % 200)]];
+    }
+
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"selector.match" operations:paths.count block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += [matcher indexesOfSelectorsMatchingTopicPath:paths[i]].count;
+        }
+    }]];
+}
+
+- (void)testReconnectionDecision {
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    [self check:[DiffusionBenchmarkSuite.sharedSuite measure:@"reconnection.backOff" operations:10000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += (NSUInteger)[strategy delayBeforeNextAttempt];
+        }
+    }]];
+}
+
+- (void)testRegressionThreshold {
+    // a suite of its own, so that nothing measured here reaches the shared results file
+    DiffusionBenchmarkSuite *const suite = [[DiffusionBenchmarkSuite alloc] initWithBaseline:@{@"suite.spin": @100.0} resultsURL:nil];
+    suite.regressionThreshold = 0.5;
+
+    DiffusionBenchmarkResult *const measured = [suite measure:@"suite.spin" operations:1000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += i;
+        }
+    }];
+    XCTAssertEqual(measured.baselineNanosecondsPerOperation, 100.0);
+    XCTAssertEqual(suite.results.count, 1u);
+
+    DiffusionBenchmarkResult *const slower = [[DiffusionBenchmarkResult alloc] initWithName:@"suite.spin" operations:1000 median:160 minimum:150 baseline:100];
+    XCTAssertTrue([[suite regressionOfResult:slower] containsString:@"regressed"]);
+    DiffusionBenchmarkResult *const within = [[DiffusionBenchmarkResult alloc] initWithName:@"suite.spin" operations:1000 median:140 minimum:120 baseline:100];
+    XCTAssertNil([suite regressionOfResult:within]);
+}
+
+- (void)testMissingBaselineFailsOnlyWhenGating {
+    NSURL *const resultsURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString]];
+    DiffusionBenchmarkSuite *const suite = [[DiffusionBenchmarkSuite alloc] initWithBaseline:@{} resultsURL:resultsURL];
+
+    DiffusionBenchmarkResult *const result = [suite measure:@"suite.unknown" operations:1000 block:^(NSUInteger operations) {
+        for (NSUInteger i = 0; i < operations; i++)
+        {
+            _Sink += i;
+        }
+    }];
+    XCTAssertEqual(result.baselineNanosecondsPerOperation, 0.0);
+    XCTAssertNil([suite regressionOfResult:result]);
+    suite.gating = YES;
+    XCTAssertTrue([[suite regressionOfResult:result] containsString:@"no baseline"]);
+    suite.recording = YES;
+    XCTAssertNil([suite regressionOfResult:result]);
+
+    // what record mode writes is the next baseline
+    NSDictionary *const written = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfURL:resultsURL] options:0 error:nil];
+    XCTAssertNotNil(written[@"benchmarks"][@"suite.unknown"][@"nsPerOperation"]);
+    [NSFileManager.defaultManager removeItemAtURL:resultsURL error:nil];
+}
+
+- (void)testReportsAreWrittenButNotGated {
+    NSURL *const resultsURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString]];
+    DiffusionBenchmarkSuite *const suite = [[DiffusionBenchmarkSuite alloc] initWithBaseline:@{} resultsURL:resultsURL];
+
+    [suite report:@"suite.rate" value:1000 unit:@"updates/s"];
+    [suite report:@"suite.rate" value:2000 unit:@"updates/s"];
+    [suite report:@"suite.overNoTime" value:INFINITY unit:@"updates/s"];
+    XCTAssertEqual(suite.results.count, 0u);
+    XCTAssertEqualObjects(suite.reports[@"suite.rate"][@"value"], @2000);
+
+    NSDictionary *const written = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfURL:resultsURL] options:0 error:nil];
+    XCTAssertEqualObjects(written[@"reports"][@"suite.rate"], (@{@"value": @2000, @"unit": @"updates/s"}));
+    XCTAssertEqualObjects(written[@"reports"][@"suite.overNoTime"][@"value"], NSNull.null);
+    [NSFileManager.defaultManager removeItemAtURL:resultsURL error:nil];
+}
+
+@end
@@ -0,0 +1,120 @@
+//
+//  DiffusionConnectionHealthTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionConnectionHealth.h"
+
+@interface DiffusionConnectionHealthTests : XCTestCase
+
+@end
+
+@implementation DiffusionConnectionHealthTests
+
+- (void)testUnknownConnectionIsHealthy {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    XCTAssertEqual([health scoreAtTime:0], 1.0);
+    XCTAssertEqual([health pingFailureRateAtTime:0], 0.0);
+}
+
+- (void)testTimeInEachStateOverTheWindow {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    [health noteState:DiffusionConnectionStateConnected atTime:0];
+    [health noteState:DiffusionConnectionStateRecovering atTime:30];
+    [health noteState:DiffusionConnectionStateConnected atTime:45];
+
+    XCTAssertEqualWithAccuracy([health fractionOfTimeInState:DiffusionConnectionStateConnected atTime:60], 0.75, 1e-9);
+    XCTAssertEqualWithAccuracy([health fractionOfTimeInState:DiffusionConnectionStateRecovering atTime:60], 0.25, 1e-9);
+    XCTAssertEqualWithAccuracy([health scoreAtTime:60], 0.75, 1e-9);
+
+    // the recovery has left the window
+    XCTAssertEqualWithAccuracy([health fractionOfTimeInState:DiffusionConnectionStateConnected atTime:120], 1.0, 1e-9);
+}
+
+- (void)testPingFailuresAndLatency {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [health notePingRoundTripTime:0.1 atTime:i];
+    }
+    XCTAssertEqualWithAccuracy(health.smoothedRoundTripTime, 0.1, 1e-9);
+    XCTAssertEqualWithAccuracy([health scoreAtTime:20], 1.0, 1e-9);
+
+    for (NSUInteger i = 20; i < 40; i++)
+    {
+        [health notePingFailureAtTime:i];
+    }
+    XCTAssertEqualWithAccuracy([health pingFailureRateAtTime:40], 0.5, 1e-9);
+    XCTAssertEqualWithAccuracy([health scoreAtTime:40], 0.5, 1e-9);
+    // the failures have left the window
+    XCTAssertEqual([health pingFailureRateAtTime:101], 0.0);
+
+    // steady but slow round trips lose the latency half of the score
+    for (NSUInteger i = 0; i < 40; i++)
+    {
+        [health notePingRoundTripTime:3.0 atTime:110 + i];
+    }
+    XCTAssertEqualWithAccuracy([health scoreAtTime:150], 0.5, 0.01);
+}
+
+- (void)testUpdateStalls {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    for (NSUInteger i = 0; i <= 100; i++)
+    {
+        [health noteUpdateAtTime:i * 0.1];
+    }
+    // shorter than the minimum stall
+    XCTAssertEqualWithAccuracy([health scoreAtTime:10.5], 1.0, 1e-9);
+    // four times longer than a stall
+    XCTAssertEqualWithAccuracy([health scoreAtTime:14.0], 0.25, 1e-3);
+    XCTAssertEqual(health.stallCount, 0);
+
+    [health noteUpdateAtTime:14.0];
+    XCTAssertEqual(health.stallCount, 1);
+    XCTAssertEqualWithAccuracy([health scoreAtTime:14.1], 1.0, 1e-9);
+}
+
+- (void)testStallAloneRecyclesTheSession {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    [health noteState:DiffusionConnectionStateConnected atTime:0];
+    for (NSUInteger i = 0; i <= 100; i++)
+    {
+        [health noteUpdateAtTime:i * 0.1];
+        if (i % 10 == 0)
+        {
+            [health notePingRoundTripTime:0.1 atTime:i * 0.1];
+        }
+    }
+    XCTAssertFalse([health shouldRecycleSessionAtTime:10.0]);
+
+    // the updates stop, while the pings keep getting through
+    for (NSUInteger i = 11; i <= 60; i++)
+    {
+        [health notePingRoundTripTime:0.1 atTime:i];
+        [health shouldRecycleSessionAtTime:i];
+    }
+    XCTAssertEqual([health pingFailureRateAtTime:60], 0.0);
+    XCTAssertEqualWithAccuracy([health fractionOfTimeInState:DiffusionConnectionStateConnected atTime:60], 1.0, 1e-9);
+    XCTAssertLessThan([health scoreAtTime:60], health.degradedThreshold);
+    XCTAssertTrue([health shouldRecycleSessionAtTime:60]);
+}
+
+- (void)testRecyclesOnlyAfterStayingDegraded {
+    DiffusionConnectionHealth *const health = [[DiffusionConnectionHealth alloc] init];
+    [health notePingFailureAtTime:0];
+    XCTAssertFalse([health shouldRecycleSessionAtTime:1]);
+    XCTAssertFalse([health shouldRecycleSessionAtTime:20]);
+    XCTAssertTrue([health shouldRecycleSessionAtTime:31]);
+
+    // a new session starts with a clean slate
+    [health resetAtTime:32];
+    XCTAssertFalse([health shouldRecycleSessionAtTime:33]);
+    XCTAssertEqual([health scoreAtTime:33], 1.0);
+}
+
+@end
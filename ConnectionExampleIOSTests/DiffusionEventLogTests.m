@@ -0,0 +1,192 @@
+//
+//  DiffusionEventLogTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionEventLog.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionEventLogTests : XCTestCase
+
+@end
+
+@implementation DiffusionEventLogTests
+{
+    NSURL *_url;
+}
+
+- (void)setUp {
+    _url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown {
+    [NSFileManager.defaultManager removeItemAtURL:_url error:nil];
+}
+
+// the records of the file, each as @[event, ID, payload]
+- (NSArray<NSArray *> *)recordsOfFile {
+    NSData *const data = [NSData dataWithContentsOfURL:_url];
+    XCTAssertGreaterThanOrEqual(data.length, sizeof(DiffusionEventLogFileHeader));
+    DiffusionEventLogFileHeader header;
+    [data getBytes:&header length:sizeof(header)];
+    XCTAssertEqual(CFSwapInt32LittleToHost(header.magic), DIFFUSION_EVENT_LOG_MAGIC);
+
+    NSMutableArray<NSArray *> *const records = [NSMutableArray array];
+    NSUInteger offset = CFSwapInt16LittleToHost(header.headerSize);
+    while (offset + sizeof(DiffusionEventLogRecordHeader) <= data.length)
+    {
+        DiffusionEventLogRecordHeader record;
+        [data getBytes:&record range:NSMakeRange(offset, sizeof(record))];
+        offset += sizeof(record);
+        const uint16_t length = CFSwapInt16LittleToHost(record.length);
+        NSData *const payload = [data subdataWithRange:NSMakeRange(offset, length)];
+        offset += length;
+        [records addObject:@[@(CFSwapInt16LittleToHost(record.event)), @(CFSwapInt32LittleToHost(record.ID)), payload]];
+    }
+    XCTAssertEqual(offset, data.length);
+    return records;
+}
+
+static int64_t _Argument(NSData *payload, NSUInteger index)
+{
+    int64_t value;
+    [payload getBytes:&value range:NSMakeRange(index * sizeof(value), sizeof(value))];
+    return (int64_t)CFSwapInt64LittleToHost((uint64_t)value);
+}
+
+
+- (void)testTopicsAndSelectorsAreDefinedOnceBeforeUse {
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+    DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:index error:nil];
+    XCTAssertNotNil(log);
+
+    [log recordSubscribeResultForSelector:@">A//" subscribe:YES errorCode:0];
+    [log recordUpdateOfTopicPath:@"A/B" length:10 topicType:14];
+    [log recordUpdateOfTopicPath:@"A/B" length:12 topicType:14];
+    [log recordPingRoundTripTime:0.0125];
+    [log close];
+
+    NSArray<NSArray *> *const records = [self recordsOfFile];
+    XCTAssertEqual(records.count, 6);
+    XCTAssertEqualObjects(records[0][0], @(DiffusionEventDefineSelector));
+    XCTAssertEqualObjects([[NSString alloc] initWithData:records[0][2] encoding:NSUTF8StringEncoding], @">A//");
+    XCTAssertEqualObjects(records[1][0], @(DiffusionEventSubscribeResult));
+    XCTAssertEqualObjects(records[1][1], records[0][1]);
+
+    const DiffusionTopicID topicID = [index IDForTopicPath:@"A/B"];
+    XCTAssertEqualObjects(records[2][0], @(DiffusionEventDefineTopic));
+    XCTAssertEqualObjects(records[2][1], @(topicID));
+    XCTAssertEqualObjects(records[3][0], @(DiffusionEventUpdate));
+    XCTAssertEqualObjects(records[4][1], @(topicID));
+    XCTAssertEqual(_Argument(records[4][2], 0), 12);
+    XCTAssertEqual(_Argument(records[4][2], 1), 14);
+
+    XCTAssertEqualObjects(records[5][0], @(DiffusionEventPing));
+    XCTAssertEqual(_Argument(records[5][2], 0), 12500);
+}
+
+- (void)testStateChangesSayWhichSessionAndPingFailuresAreRecorded {
+    DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:[[DiffusionTopicPathIndex alloc] init] error:nil];
+    [log recordSessionStateChangeFrom:0 to:DiffusionEventSessionStateConnected sessionID:@"0123-a"];
+    [log recordSessionStateChangeFrom:0 to:DiffusionEventSessionStateConnected sessionID:@"0123-b"];
+    [log recordSessionStateChangeFrom:DiffusionEventSessionStateConnected to:DiffusionEventSessionStateRecovering sessionID:@"0123-a"];
+    [log recordPingFailureWithErrorCode:7];
+    [log close];
+
+    NSArray<NSArray *> *const records = [self recordsOfFile];
+    XCTAssertEqual(records.count, 6);
+    XCTAssertEqualObjects(records[0][0], @(DiffusionEventDefineSession));
+    XCTAssertEqualObjects([[NSString alloc] initWithData:records[0][2] encoding:NSUTF8StringEncoding], @"0123-a");
+    XCTAssertEqualObjects(records[1][1], records[0][1]);
+    XCTAssertEqualObjects(records[2][0], @(DiffusionEventDefineSession));
+    XCTAssertNotEqualObjects(records[3][1], records[1][1]);
+    // already defined
+    XCTAssertEqualObjects(records[4][0], @(DiffusionEventSessionStateChange));
+    XCTAssertEqualObjects(records[4][1], records[1][1]);
+    XCTAssertEqual(_Argument(records[4][2], 1), DiffusionEventSessionStateRecovering);
+    XCTAssertEqualObjects(records[5][0], @(DiffusionEventPingFailure));
+    XCTAssertEqual(_Argument(records[5][2], 0), 7);
+}
+
+- (void)testRotatesAFullLogAndDefinesAgainInTheNextOne {
+    DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:[[DiffusionTopicPathIndex alloc] init] error:nil];
+    log.maximumFileSize = 1024;
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        [log recordUpdateOfTopicPath:@"A/B" length:i topicType:14];
+    }
+    [log close];
+
+    NSURL *const rotated = [_url URLByAppendingPathExtension:@"1"];
+    NSData *const previous = [NSData dataWithContentsOfURL:rotated];
+    [NSFileManager.defaultManager removeItemAtURL:rotated error:nil];
+    XCTAssertGreaterThanOrEqual(previous.length, 1024u);
+    XCTAssertLessThan(previous.length, 1024u + 2 * (sizeof(DiffusionEventLogRecordHeader) + 16));
+
+    // the current file stands on its own: the topic is defined again before it is used
+    NSArray<NSArray *> *const records = [self recordsOfFile];
+    XCTAssertGreaterThan(records.count, 1);
+    XCTAssertEqualObjects(records[0][0], @(DiffusionEventDefineTopic));
+    XCTAssertEqualObjects(records[1][0], @(DiffusionEventUpdate));
+    XCTAssertEqual(_Argument(records.lastObject[2], 0), 99);
+}
+
+- (void)testReleasingTheLogWritesWhatItHolds {
+    @autoreleasepool {
+        DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:[[DiffusionTopicPathIndex alloc] init] error:nil];
+        [log recordPingRoundTripTime:0.01];
+    }
+    XCTAssertEqual([self recordsOfFile].count, 1);
+}
+
+- (void)testNothingIsRecordedAfterClose {
+    DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:[[DiffusionTopicPathIndex alloc] init] error:nil];
+    [log recordSessionStateChangeFrom:0 to:DiffusionEventSessionStateConnected sessionID:nil];
+    [log close];
+    [log recordSessionStateChangeFrom:DiffusionEventSessionStateConnected to:DiffusionEventSessionStateClosed sessionID:nil];
+
+    XCTAssertEqual([self recordsOfFile].count, 1);
+    XCTAssertEqual(log.recordCount, 1);
+}
+
+- (void)testBenchmarkRecordingUpdates {
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+    DiffusionEventLog *const log = [[DiffusionEventLog alloc] initWithURL:_url topicIndex:index error:nil];
+    NSMutableArray<NSString *> *const topics = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 200; i++)
+    {
+        [topics addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+    const NSUInteger count = 200000;
+
+    uint64_t start = DiffusionTestNow();
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [log recordUpdateOfTopicPath:topics[i % topics.count] length:64 topicType:14];
+    }
+    const uint64_t binary = DiffusionTestNow() - start;
+    [log close];
+
+    // what the text log line of the same update costs to format, before it is even written
+    start = DiffusionTestNow();
+    NSUInteger characters = 0;
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        characters += [NSString stringWithFormat:@"\t%@: Updated %@ = %@", @"DiffusionManager", topics[i % topics.count], @(i)].length;
+    }
+    const uint64_t text = DiffusionTestNow() - start;
+
+    XCTAssertGreaterThan(characters, 0);
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"eventLog.binary" value:(double)binary / count unit:@"ns"];
+    [suite report:@"eventLog.binary.size" value:(double)log.byteCount / log.recordCount unit:@"bytes"];
+    [suite report:@"eventLog.text" value:(double)text / count unit:@"ns"];
+}
+
+@end
@@ -0,0 +1,193 @@
+//
+//  DiffusionInboundQueueTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionInboundQueue.h"
+#import "DiffusionManager.h"
+#import "DiffusionProcessingLanes.h"
+
+@interface DiffusionInboundQueueTests : XCTestCase
+
+@end
+
+@implementation DiffusionInboundQueueTests
+
+// holds the consumer inside a block of the topic until released, so that the rest piles up. with processing lanes,
+// only the lane of the topic is held
+static dispatch_semaphore_t _HoldTopic(DiffusionInboundQueue *queue, NSString *topicPath)
+{
+    dispatch_semaphore_t const started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t const release = dispatch_semaphore_create(0);
+    [queue enqueueBlock:^{
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(release, DISPATCH_TIME_FOREVER);
+    } forTopicPath:topicPath priority:DiffusionSubscriptionPriorityCritical];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    return release;
+}
+
+static dispatch_semaphore_t _HoldConsumer(DiffusionInboundQueue *queue)
+{
+    return _HoldTopic(queue, @"Hold");
+}
+
+
+- (void)testDropOldestKeepsTheNewestUpdates {
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:3 policy:DiffusionInboundQueuePolicyDropOldest];
+    dispatch_semaphore_t const release = _HoldConsumer(queue);
+
+    NSMutableArray<NSNumber *> *const run = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5; i++)
+    {
+        XCTAssertTrue([queue enqueueBlock:^{ [run addObject:@(i)]; } forTopicPath:@"A/B" priority:DiffusionSubscriptionPriorityNormal]);
+    }
+    XCTAssertEqual(queue.depth, 3);
+    dispatch_semaphore_signal(release);
+    [queue drain];
+
+    XCTAssertEqualObjects(run, (@[@2, @3, @4]));
+    XCTAssertEqual(queue.droppedCount, 2);
+    XCTAssertEqual(queue.deliveredCount, 4);
+    XCTAssertEqual(queue.maximumDepth, 3);
+}
+
+- (void)testConflateKeepsOneUpdatePerTopicInPlace {
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:8 policy:DiffusionInboundQueuePolicyConflate];
+    dispatch_semaphore_t const release = _HoldConsumer(queue);
+
+    NSMutableArray<NSString *> *const run = [NSMutableArray array];
+    [queue enqueueBlock:^{ [run addObject:@"A1"]; } forTopicPath:@"A" priority:DiffusionSubscriptionPriorityNormal];
+    [queue enqueueBlock:^{ [run addObject:@"B1"]; } forTopicPath:@"B" priority:DiffusionSubscriptionPriorityNormal];
+    [queue enqueueBlock:^{ [run addObject:@"A2"]; } forTopicPath:@"A" priority:DiffusionSubscriptionPriorityNormal];
+    dispatch_semaphore_signal(release);
+    [queue drain];
+
+    XCTAssertEqualObjects(run, (@[@"A2", @"B1"]));
+    XCTAssertEqual(queue.conflatedCount, 1);
+    XCTAssertEqual(queue.droppedCount, 0);
+}
+
+- (void)testDropByPriorityKeepsCriticalUpdates {
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:2 policy:DiffusionInboundQueuePolicyDropByPriority];
+    dispatch_semaphore_t const release = _HoldConsumer(queue);
+
+    NSMutableArray<NSString *> *const run = [NSMutableArray array];
+    [queue enqueueBlock:^{ [run addObject:@"critical"]; } forTopicPath:@"A" priority:DiffusionSubscriptionPriorityCritical];
+    [queue enqueueBlock:^{ [run addObject:@"normal"]; } forTopicPath:@"B" priority:DiffusionSubscriptionPriorityNormal];
+    // replaces the normal update
+    XCTAssertTrue([queue enqueueBlock:^{ [run addObject:@"critical2"]; } forTopicPath:@"C" priority:DiffusionSubscriptionPriorityCritical]);
+    // nothing queued is lower than it
+    XCTAssertFalse([queue enqueueBlock:^{ [run addObject:@"normal2"]; } forTopicPath:@"D" priority:DiffusionSubscriptionPriorityNormal]);
+    dispatch_semaphore_signal(release);
+    [queue drain];
+
+    XCTAssertEqualObjects(run, (@[@"critical", @"critical2"]));
+    XCTAssertEqual(queue.droppedCount, 2);
+}
+
+- (void)testBlockNeverDrops {
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:4 policy:DiffusionInboundQueuePolicyBlock];
+    const NSUInteger count = 1000;
+    __block NSUInteger next = 0;
+    __block BOOL ordered = YES;
+    // the blocking policy is not for the main queue, which the tests run on
+    dispatch_sync(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            [queue enqueueBlock:^{
+                ordered = ordered && next == i;
+                next++;
+                usleep(10);
+            } forTopicPath:@"A/B" priority:DiffusionSubscriptionPriorityNormal];
+        }
+    });
+    [queue drain];
+
+    XCTAssertTrue(ordered);
+    XCTAssertEqual(queue.deliveredCount, count);
+    XCTAssertEqual(queue.droppedCount, 0);
+    XCTAssertLessThanOrEqual(queue.maximumDepth, 4);
+    XCTAssertGreaterThan(queue.blockedCount, 0);
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"inboundQueue.block.blocked" value:queue.blockedCount unit:@"times"];
+    [suite report:@"inboundQueue.block.blockedTime" value:queue.blockedTime * 1e3 unit:@"ms"];
+    [suite report:@"inboundQueue.block.timeInQueue" value:queue.averageTimeInQueue * 1e3 unit:@"ms"];
+}
+
+- (void)testCapacityBoundsWhatWaitsForTheLanes {
+    DiffusionProcessingLanes *const lanes = [[DiffusionProcessingLanes alloc] initWithLaneCount:1];
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:3 policy:DiffusionInboundQueuePolicyDropOldest processingLanes:lanes];
+    dispatch_semaphore_t const release = _HoldTopic(queue, @"Hold");
+
+    NSMutableArray<NSNumber *> *const run = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5; i++)
+    {
+        [queue enqueueBlock:^{ [run addObject:@(i)]; } forTopicPath:[NSString stringWithFormat:@"A/%lu", (unsigned long)i] priority:DiffusionSubscriptionPriorityNormal];
+    }
+    // nothing more was handed to the busy lane
+    XCTAssertEqual(queue.depth, 3);
+    XCTAssertEqual(lanes.dispatchedCount, 1);
+    dispatch_semaphore_signal(release);
+    [queue drain];
+
+    XCTAssertEqualObjects(run, (@[@2, @3, @4]));
+    XCTAssertEqual(queue.droppedCount, 2);
+    XCTAssertEqual(queue.deliveredCount, 4);
+}
+
+- (void)testLanesKeepTopicOrderAndRunInParallel {
+    DiffusionProcessingLanes *const lanes = [[DiffusionProcessingLanes alloc] initWithLaneCount:4];
+    DiffusionInboundQueue *const queue = [[DiffusionInboundQueue alloc] initWithCapacity:16 policy:DiffusionInboundQueuePolicyDropByPriority processingLanes:lanes];
+    // a topic on another lane than the held one
+    NSString *topicPath = nil;
+    for (NSUInteger i = 0; !topicPath; i++)
+    {
+        NSString *const candidate = [NSString stringWithFormat:@"B/%lu", (unsigned long)i];
+        if ([lanes laneForTopicPath:candidate] != [lanes laneForTopicPath:@"Hold"])
+        {
+            topicPath = candidate;
+        }
+    }
+    dispatch_semaphore_t const release = _HoldTopic(queue, @"Hold");
+
+    NSMutableArray<NSNumber *> *const run = [NSMutableArray array];
+    NSObject *const lock = [[NSObject alloc] init];
+    for (NSUInteger i = 0; i < 10; i++)
+    {
+        [queue enqueueBlock:^{
+            @synchronized (lock)
+            {
+                [run addObject:@(i)];
+            }
+        } forTopicPath:topicPath priority:DiffusionSubscriptionPriorityNormal];
+    }
+    // drains while the other lane is still held
+    while (queue.deliveredCount < 10)
+    {
+        usleep(1000);
+    }
+    dispatch_semaphore_signal(release);
+    [queue drain];
+
+    XCTAssertEqualObjects(run, (@[@0, @1, @2, @3, @4, @5, @6, @7, @8, @9]));
+    XCTAssertEqual(queue.deliveredCount, 11);
+    XCTAssertEqual(queue.depth, 0);
+}
+
+- (void)testManagerRefusesTheBlockingPolicy {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    XCTAssertThrowsSpecificNamed(manager.inboundQueue = [[DiffusionInboundQueue alloc] initWithCapacity:4 policy:DiffusionInboundQueuePolicyBlock], NSException, NSInvalidArgumentException);
+    XCTAssertNil(manager.inboundQueue);
+
+    manager.inboundQueue = [[DiffusionInboundQueue alloc] initWithCapacity:4 policy:DiffusionInboundQueuePolicyDropOldest];
+    XCTAssertNotNil(manager.inboundQueue);
+}
+
+@end
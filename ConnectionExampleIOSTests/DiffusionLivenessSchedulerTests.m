@@ -0,0 +1,109 @@
+//
+//  DiffusionLivenessSchedulerTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLivenessScheduler.h"
+
+@interface DiffusionLivenessSchedulerTests : XCTestCase
+
+@end
+
+@implementation DiffusionLivenessSchedulerTests
+
+- (void)testTrafficMakesPingsUnnecessary {
+    DiffusionLivenessScheduler *const scheduler = [[DiffusionLivenessScheduler alloc] init];
+    XCTAssertTrue([scheduler shouldPingAtTime:0]);
+
+    [scheduler noteInboundTrafficAtTime:10.0];
+    XCTAssertFalse([scheduler shouldPingAtTime:11.0]);
+    // proven alive until one interval after the traffic
+    XCTAssertEqualWithAccuracy([scheduler delayBeforeNextCheckAtTime:11.0], 2.0, 1e-9);
+    XCTAssertTrue([scheduler shouldPingAtTime:13.5]);
+    XCTAssertEqual(scheduler.pingCount, 2);
+    XCTAssertEqual(scheduler.skippedCount, 1);
+}
+
+- (void)testFailuresTightenTheInterval {
+    DiffusionLivenessScheduler *const scheduler = [[DiffusionLivenessScheduler alloc] init];
+    XCTAssertEqual(scheduler.currentInterval, 3.0);
+    [scheduler notePingFailureAtTime:1.0];
+    XCTAssertEqual(scheduler.currentInterval, 1.5);
+    [scheduler notePingFailureAtTime:2.0];
+    [scheduler notePingFailureAtTime:3.0];
+    [scheduler notePingFailureAtTime:4.0];
+    XCTAssertEqual(scheduler.currentInterval, scheduler.minimumInterval);
+
+    // traffic from a failing connection does not stand in for a ping
+    [scheduler notePingFailureAtTime:5.0];
+    XCTAssertTrue([scheduler shouldPingAtTime:5.1]);
+
+    [scheduler notePingRoundTripTime:0.05 atTime:6.0];
+    XCTAssertEqual(scheduler.currentInterval, 3.0);
+}
+
+- (void)testErraticRoundTripTimesTightenTheInterval {
+    DiffusionLivenessScheduler *const scheduler = [[DiffusionLivenessScheduler alloc] init];
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [scheduler notePingRoundTripTime:0.050 atTime:i];
+    }
+    XCTAssertEqual(scheduler.currentInterval, 3.0);
+
+    for (NSUInteger i = 0; i < 6; i++)
+    {
+        [scheduler notePingRoundTripTime:(i % 2 ? 0.020 : 0.400) atTime:20 + i];
+    }
+    XCTAssertGreaterThan(scheduler.roundTripTimeVariation * 4, scheduler.smoothedRoundTripTime);
+    XCTAssertEqual(scheduler.currentInterval, 1.5);
+}
+
+- (void)testIdleBackgroundBacksOff {
+    DiffusionLivenessScheduler *const scheduler = [[DiffusionLivenessScheduler alloc] init];
+    scheduler.inBackground = YES;
+    NSTimeInterval time = 0;
+    NSMutableArray<NSNumber *> *const intervals = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 6; i++)
+    {
+        XCTAssertTrue([scheduler shouldPingAtTime:time]);
+        [scheduler notePingRoundTripTime:0.05 atTime:time];
+        [intervals addObject:@(scheduler.currentInterval)];
+        time += [scheduler delayBeforeNextCheckAtTime:time];
+    }
+    XCTAssertEqualObjects(intervals, (@[@30, @60, @120, @240, @300, @300]));
+
+    scheduler.inBackground = NO;
+    XCTAssertEqual(scheduler.currentInterval, 3.0);
+}
+
+- (void)testSimulatedSessionPingsLessUnderTraffic {
+    // a minute of updates every 200ms with a 10 second gap, checked the way the manager does
+    DiffusionLivenessScheduler *const scheduler = [[DiffusionLivenessScheduler alloc] init];
+    NSTimeInterval check = 0;
+    for (NSUInteger tick = 0; tick <= 600; tick++)
+    {
+        const NSTimeInterval time = tick * 0.1;
+        if (tick % 2 == 0 && (time < 20 || time >= 30))
+        {
+            [scheduler noteInboundTrafficAtTime:time];
+        }
+        if (time >= check)
+        {
+            [scheduler shouldPingAtTime:time];
+            check = time + [scheduler delayBeforeNextCheckAtTime:time];
+        }
+    }
+    // a fixed 3 second timer would have pinged 20 times
+    XCTAssertLessThanOrEqual(scheduler.pingCount, 5);
+    XCTAssertGreaterThanOrEqual(scheduler.pingCount, 3);
+    [DiffusionBenchmarkSuite.sharedSuite report:@"liveness.pings" value:scheduler.pingCount unit:@"pings"];
+    [DiffusionBenchmarkSuite.sharedSuite report:@"liveness.skipped" value:scheduler.skippedCount unit:@"pings"];
+}
+
+@end
@@ -0,0 +1,143 @@
+//
+//  DiffusionLogTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionLogTests : XCTestCase
+
+@end
+
+@implementation DiffusionLogTests
+
+- (void)setUp {
+    [DiffusionLog flush];
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelTrace);
+}
+
+- (void)tearDown {
+    [DiffusionLog flush];
+    DiffusionLog.sink = nil;
+}
+
+- (NSMutableString *)captureSink {
+    NSMutableString *const captured = [NSMutableString string];
+    DiffusionLog.sink = ^(const char *lines, size_t length) {
+        [captured appendString:[[NSString alloc] initWithBytes:lines length:length encoding:NSUTF8StringEncoding]];
+    };
+    return captured;
+}
+
+
+- (void)testMessagesReachTheSinkInOrder {
+    NSMutableString *const captured = [self captureSink];
+    DiffusionLogInfo(@"first %d", 1);
+    DiffusionLogError(@"second %@", @"two");
+    [DiffusionLog flush];
+
+    NSArray<NSString *> *const lines = [captured componentsSeparatedByString:@"\n"];
+    XCTAssertEqual(lines.count, 3);
+    XCTAssertTrue([lines[0] hasSuffix:@"first 1"]);
+    XCTAssertTrue([lines[0] containsString:@" I "]);
+    XCTAssertTrue([lines[1] hasSuffix:@"second two"]);
+    XCTAssertTrue([lines[1] containsString:@" E "]);
+}
+
+- (void)testDisabledLevelsDoNotEvaluateTheirArguments {
+    NSMutableString *const captured = [self captureSink];
+    DiffusionLog.level = DiffusionLogLevelWarn;
+    __block NSUInteger evaluated = 0;
+    NSString *(^const argument)(void) = ^{
+        evaluated++;
+        return @"argument";
+    };
+    DiffusionLogDebug(@"%@", argument());
+    DiffusionLogWarn(@"%@", argument());
+    [DiffusionLog flush];
+
+    XCTAssertEqual(evaluated, 1);
+    XCTAssertEqual([captured componentsSeparatedByString:@"\n"].count - 1, 1);
+}
+
+- (void)testLongMessagesAreTruncated {
+    NSMutableString *const captured = [self captureSink];
+    NSString *const longMessage = [@"" stringByPaddingToLength:1000 withString:@"é" startingAtIndex:0];
+    DiffusionLogInfo(@"%@", longMessage);
+    [DiffusionLog flush];
+
+    XCTAssertGreaterThan(captured.length, 0);
+    XCTAssertLessThan(captured.length, 256);
+}
+
+- (void)testConcurrentWritersLoseNothingWhileTheRingHasRoom {
+    NSMutableString *const captured = [self captureSink];
+    const NSUInteger before = DiffusionLog.droppedCount;
+    dispatch_apply(4, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t writer) {
+        for (NSUInteger i = 0; i < 500; i++)
+        {
+            DiffusionLogInfo(@"writer %zu message %lu", writer, (unsigned long)i);
+        }
+    });
+    [DiffusionLog flush];
+
+    XCTAssertEqual(DiffusionLog.droppedCount, before);
+    XCTAssertEqual([captured componentsSeparatedByString:@"\n"].count - 1, 2000);
+}
+
+- (void)testBenchmarkAgainstNSLogAt100kMessagesPerSecond {
+    // the sink still formats every line, it just does not print it
+    __block NSUInteger sunk = 0;
+    DiffusionLog.sink = ^(const char *lines, size_t length) {
+        sunk += length;
+    };
+    const NSUInteger count = 100000;
+    const uint64_t interval = NSEC_PER_SEC / count;
+    NSString *const topicPath = @"Demos/Sportsbook/Football/England/Fixture42/Odds";
+
+    // paced at 100k messages a second, as a busy update stream would be
+    const NSUInteger droppedBefore = DiffusionLog.droppedCount;
+    uint64_t spent = 0;
+    uint64_t worst = 0;
+    uint64_t next = DiffusionTestNow();
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        while (DiffusionTestNow() < next)
+        {
+        }
+        next += interval;
+        const uint64_t start = DiffusionTestNow();
+        DiffusionLogDebug(@"DiffusionManager: Updated %@ = %lu", topicPath, (unsigned long)i);
+        const uint64_t elapsed = DiffusionTestNow() - start;
+        spent += elapsed;
+        worst = MAX(worst, elapsed);
+    }
+    [DiffusionLog flush];
+    const NSUInteger dropped = DiffusionLog.droppedCount - droppedBefore;
+
+    // NSLog cannot keep that pace, so it is measured back to back on fewer messages
+    const NSUInteger nslogCount = 5000;
+    uint64_t nslogSpent = 0;
+    for (NSUInteger i = 0; i < nslogCount; i++)
+    {
+        const uint64_t start = DiffusionTestNow();
+        NSLog(@"DiffusionManager: Updated %@ = %lu", topicPath, (unsigned long)i);
+        nslogSpent += DiffusionTestNow() - start;
+    }
+
+    XCTAssertGreaterThan(sunk, 0);
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"log.diffusionLog" value:(double)spent / count unit:@"ns"];
+    [suite report:@"log.diffusionLog.worst" value:worst / 1e3 unit:@"us"];
+    [suite report:@"log.diffusionLog.dropped" value:dropped unit:@"messages"];
+    [suite report:@"log.nslog" value:(double)nslogSpent / nslogCount unit:@"ns"];
+}
+
+@end
@@ -0,0 +1,122 @@
+//
+//  DiffusionMetricsTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionMetrics.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionMetricsTests : XCTestCase
+
+@end
+
+@implementation DiffusionMetricsTests
+
+- (void)testPercentilesAreWithinTheBucketPrecision {
+    DiffusionHistogram *const histogram = [[DiffusionHistogram alloc] init];
+    for (uint64_t value = 1; value <= 100000; value++)
+    {
+        [histogram recordValue:value];
+    }
+    DiffusionHistogramSnapshot *const snapshot = histogram.snapshot;
+
+    XCTAssertEqual(snapshot.count, 100000);
+    XCTAssertEqual(snapshot.minimum, 1);
+    XCTAssertEqual(snapshot.maximum, 100000);
+    XCTAssertEqualWithAccuracy(snapshot.mean, 50000.5, 1e-6);
+    const double percentiles[] = {1, 50, 90, 99, 99.9};
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+    {
+        const double expected = percentiles[i] * 1000;
+        const uint64_t value = [snapshot valueAtPercentile:percentiles[i]];
+        XCTAssertGreaterThanOrEqual(value, expected);
+        XCTAssertLessThanOrEqual(value, expected * 1.016);
+    }
+    XCTAssertEqual([snapshot valueAtPercentile:100], 100000);
+}
+
+- (void)testSmallValuesAreExactAndLargeOnesClamped {
+    DiffusionHistogram *const histogram = [[DiffusionHistogram alloc] init];
+    [histogram recordValue:0];
+    [histogram recordValue:127];
+    [histogram recordValue:UINT64_MAX];
+    DiffusionHistogramSnapshot *const snapshot = histogram.snapshot;
+
+    XCTAssertEqual([snapshot valueAtPercentile:33], 0);
+    XCTAssertEqual([snapshot valueAtPercentile:66], 127);
+    XCTAssertEqual(snapshot.maximum, DiffusionHistogram.highestTrackableValue);
+
+    [histogram reset];
+    XCTAssertEqual(histogram.snapshot.count, 0);
+    XCTAssertEqual([histogram.snapshot valueAtPercentile:50], 0);
+}
+
+- (void)testConcurrentRecordingLosesNothing {
+    DiffusionHistogram *const histogram = [[DiffusionHistogram alloc] init];
+    dispatch_apply(8, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+        for (uint64_t i = 0; i < 100000; i++)
+        {
+            [histogram recordValue:i % 5000];
+        }
+    });
+    XCTAssertEqual(histogram.snapshot.count, 800000);
+    XCTAssertEqual(histogram.snapshot.maximum, 4999);
+}
+
+- (void)testSnapshotExportsAsJSON {
+    DiffusionMetrics *const metrics = [[DiffusionMetrics alloc] init];
+    [metrics.pingRoundTripTime recordTimeInterval:0.012];
+    [metrics noteUpdateOfLength:100];
+    [metrics noteUpdateOfLength:28];
+    [metrics noteReconnect];
+
+    DiffusionMetricsSnapshot *const snapshot = metrics.snapshot;
+    XCTAssertEqualObjects(snapshot.counters[@"updateCount"], @2);
+    XCTAssertEqualObjects(snapshot.counters[@"byteCount"], @128);
+    XCTAssertEqualObjects(snapshot.counters[@"reconnectCount"], @1);
+    XCTAssertEqual(snapshot.histograms[@"pingRoundTripTime"].maximum, 12000);
+
+    NSError *error = nil;
+    NSData *const json = [NSJSONSerialization dataWithJSONObject:snapshot.dictionaryRepresentation options:0 error:&error];
+    XCTAssertNotNil(json, @"%@", error);
+
+    [metrics reset];
+    XCTAssertEqual(metrics.updateCount, 0);
+    XCTAssertEqual(metrics.pingRoundTripTime.snapshot.count, 0);
+}
+
+- (void)testBenchmarkRecordingWhileSnapshotting {
+    DiffusionHistogram *const histogram = [[DiffusionHistogram alloc] init];
+    const NSUInteger count = 4000000;
+    __block BOOL recording = YES;
+    __block NSUInteger snapshots = 0;
+    dispatch_group_t const group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        while (recording)
+        {
+            [histogram snapshot];
+            snapshots++;
+        }
+    });
+
+    const uint64_t start = DiffusionTestNow();
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [histogram recordValue:i & 0xFFFF];
+    }
+    const uint64_t elapsed = DiffusionTestNow() - start;
+    recording = NO;
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    XCTAssertEqual(histogram.snapshot.count, count);
+    [DiffusionBenchmarkSuite.sharedSuite report:@"histogram.record" value:(double)elapsed / count unit:@"ns"];
+    [DiffusionBenchmarkSuite.sharedSuite report:@"histogram.snapshots" value:snapshots unit:@"snapshots"];
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  DiffusionProcessingLanesTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 24/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionProcessingLanes.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionProcessingLanesTests : XCTestCase
+
+@end
+
+@implementation DiffusionProcessingLanesTests
+
+- (void)testUpdatesOfATopicStayOrdered {
+    DiffusionProcessingLanes *const lanes = [[DiffusionProcessingLanes alloc] initWithLaneCount:4];
+    const NSUInteger topicCount = 32;
+    const NSUInteger updatesPerTopic = 1000;
+
+    // each topic is only ever touched from its own lane, so plain arrays are enough
+    NSMutableArray<NSMutableArray<NSNumber *> *> *const received = [NSMutableArray arrayWithCapacity:topicCount];
+    NSMutableArray<NSString *> *const topics = [NSMutableArray arrayWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        [received addObject:[NSMutableArray arrayWithCapacity:updatesPerTopic]];
+        [topics addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+
+    for (NSUInteger update = 0; update < updatesPerTopic; update++)
+    {
+        for (NSUInteger topic = 0; topic < topicCount; topic++)
+        {
+            NSMutableArray<NSNumber *> *const values = received[topic];
+            [lanes dispatchForTopicPath:topics[topic] block:^{
+                [values addObject:@(update)];
+            }];
+        }
+    }
+    [lanes drain];
+
+    for (NSUInteger topic = 0; topic < topicCount; topic++)
+    {
+        XCTAssertEqual(received[topic].count, updatesPerTopic);
+        for (NSUInteger update = 0; update < updatesPerTopic; update++)
+        {
+            XCTAssertEqual(received[topic][update].unsignedIntegerValue, update);
+        }
+    }
+    XCTAssertEqual(lanes.dispatchedCount, topicCount * updatesPerTopic);
+}
+
+- (void)testLaneSelectionIsStable {
+    XCTAssertEqual([DiffusionProcessingLanes laneForTopicPath:@"Demos/A" laneCount:1], 0u);
+    const NSUInteger lane = [DiffusionProcessingLanes laneForTopicPath:@"Demos/Sportsbook/Football/England" laneCount:8];
+    XCTAssertLessThan(lane, 8u);
+    XCTAssertEqual(lane, [DiffusionProcessingLanes laneForTopicPath:[@"Demos/Sportsbook/Football/England" mutableCopy] laneCount:8]);
+}
+
+/**
+
+    Updates/sec with 1, 2, 4 and 8 lanes, each update costing 20µs of processing.
+
+    Updates are produced from a single serial queue, as the Diffusion callbacks are on the main queue. With one lane
+    the processing is as serial as running it in the callback; more lanes should scale up to the number of cores.
+
+ */
+- (void)testBenchmarkLaneScaling {
+    const NSUInteger updateCount = 40000;
+    const NSUInteger topicCount = 256;
+    const uint64_t processingCost = 20000;
+
+    NSMutableArray<NSString *> *const topics = [NSMutableArray arrayWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        [topics addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+
+    double baseline = 0;
+    for (NSNumber *laneCount in @[@1, @2, @4, @8])
+    {
+        DiffusionProcessingLanes *const lanes = [[DiffusionProcessingLanes alloc] initWithLaneCount:laneCount.unsignedIntegerValue];
+        dispatch_queue_t const delivery = dispatch_queue_create("DiffusionProcessingLanesTests.delivery", DISPATCH_QUEUE_SERIAL);
+
+        const uint64_t start = DiffusionTestNow();
+        dispatch_sync(delivery, ^{
+            for (NSUInteger i = 0; i < updateCount; i++)
+            {
+                [lanes dispatchForTopicPath:topics[i % topicCount] block:^{
+                    // stands in for decoding an update and applying it to the model
+                    DiffusionTestSpin(processingCost);
+                }];
+            }
+        });
+        [lanes drain];
+        const uint64_t elapsed = DiffusionTestNow() - start;
+
+        const double rate = updateCount / (elapsed / 1e9);
+        if (!baseline)
+        {
+            baseline = rate;
+        }
+        // the speedup levels off at the number of cores
+        NSString *const name = [NSString stringWithFormat:@"lanes.%@", laneCount];
+        [DiffusionBenchmarkSuite.sharedSuite report:name value:rate unit:@"updates/s"];
+        [DiffusionBenchmarkSuite.sharedSuite report:[name stringByAppendingString:@".speedup"] value:rate / baseline unit:@"x"];
+    }
+}
+
+@end
@@ -0,0 +1,136 @@
+//
+//  DiffusionReconnectionSimulatorTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "BackOffReconnectionStrategy.h"
+#import "CircuitBreakerReconnectionStrategy.h"
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionReconnectionSimulator.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionReconnectionSimulatorTests : XCTestCase
+
+@end
+
+@implementation DiffusionReconnectionSimulatorTests
+
+- (void)setUp {
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelWarn);
+}
+
+static BackOffReconnectionStrategy *_BackOff(DiffusionReconnectionSimulator *simulator, BackOffMode mode)
+{
+    BackOffReconnectionStrategy *const strategy = [[BackOffReconnectionStrategy alloc] initWithMaxDelay:5.0];
+    strategy.mode = mode;
+    strategy.seed = 7;
+    strategy.scheduler = simulator.scheduler;
+    return strategy;
+}
+
+static CircuitBreakerReconnectionStrategy *_Breaker(DiffusionReconnectionSimulator *simulator)
+{
+    CircuitBreakerReconnectionStrategy *const strategy = [[CircuitBreakerReconnectionStrategy alloc] initWithBackOffStrategy:_BackOff(simulator, BackOffModeLinear)];
+    strategy.probeInterval = 30.0;
+    strategy.reconnectionTimeout = simulator.reconnectionTimeout;
+    strategy.scheduler = simulator.scheduler;
+    __weak DiffusionReconnectionSimulator *const weakSimulator = simulator;
+    strategy.probe = ^(void (^completionHandler)(BOOL reachable)) {
+        completionHandler([weakSimulator linkIsUp]);
+    };
+    return strategy;
+}
+
+
+- (void)testLinearBackOffThroughAnOutage {
+    DiffusionOutageTrace *const trace = [DiffusionOutageTrace longOutageTraceWithDuration:30 count:10];
+    trace.variability = 0;
+    DiffusionReconnectionSimulator *const simulator = [[DiffusionReconnectionSimulator alloc] initWithTrace:trace];
+    DiffusionSimulationResult *const result = [simulator runStrategy:_BackOff(simulator, BackOffModeLinear)];
+
+    // attempts at 0, 3, 7, 12, 18 and 25 s each fail 2 s later, the one at 32 s gets through in 0.1 s
+    XCTAssertEqual(result.outageCount, 10);
+    XCTAssertEqual(result.reconnectedCount, 10);
+    XCTAssertEqual(result.attemptCount, 70);
+    XCTAssertEqualWithAccuracy([result.timeToReconnect valueAtPercentile:50] / 1e6, 32.1, 32.1 * 0.02);
+    XCTAssertEqualWithAccuracy(result.timeToReconnect.maximum / 1e6, 32.1, 32.1 * 0.02);
+}
+
+- (void)testSessionsAreClosedByTheReconnectionTimeout {
+    DiffusionOutageTrace *const trace = [DiffusionOutageTrace longOutageTraceWithDuration:120 count:5];
+    trace.variability = 0;
+    DiffusionReconnectionSimulator *const simulator = [[DiffusionReconnectionSimulator alloc] initWithTrace:trace];
+    DiffusionSimulationResult *const backOff = [simulator runStrategy:_BackOff(simulator, BackOffModeLinear)];
+    XCTAssertEqual(backOff.closedCount, 5);
+    XCTAssertEqual(backOff.reconnectedCount, 0);
+
+    // the breaker sees it coming and gives up sooner
+    DiffusionReconnectionSimulator *const other = [[DiffusionReconnectionSimulator alloc] initWithTrace:trace];
+    DiffusionSimulationResult *const breaker = [other runStrategy:_Breaker(other)];
+    XCTAssertEqual(breaker.abortedCount, 5);
+    XCTAssertLessThan(breaker.attemptCount, backOff.attemptCount);
+}
+
+// what the summary of a result says, as figures
+static void _Report(NSString *name, DiffusionSimulationResult *result)
+{
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:[name stringByAppendingString:@".p50"] value:[result.timeToReconnect valueAtPercentile:50] / 1e6 unit:@"s"];
+    [suite report:[name stringByAppendingString:@".p99"] value:[result.timeToReconnect valueAtPercentile:99] / 1e6 unit:@"s"];
+    [suite report:[name stringByAppendingString:@".attempts"] value:result.outageCount ? (double)result.attemptCount / result.outageCount : 0.0 unit:@"attempts/outage"];
+}
+
+- (void)testStrategiesOnEachTrace {
+    NSArray<DiffusionOutageTrace *> *const traces = @[[DiffusionOutageTrace flappingTraceWithDownTime:6 upTime:4 count:2000],
+                                                      [DiffusionOutageTrace longOutageTraceWithDuration:300 count:200],
+                                                      [DiffusionOutageTrace partialLossTraceWithDuration:60 lossRate:0.7 count:500]];
+    NSArray<NSString *> *const traceNames = @[@"flapping", @"longOutage", @"partialLoss"];
+    NSArray<NSString *> *const names = @[@"linearBackOff", @"decorrelatedJitter", @"circuitBreaker"];
+    for (NSUInteger t = 0; t < traces.count; t++)
+    {
+        DiffusionOutageTrace *const trace = traces[t];
+        NSMutableArray<DiffusionSimulationResult *> *const results = [NSMutableArray array];
+        for (NSUInteger s = 0; s < names.count; s++)
+        {
+            DiffusionReconnectionSimulator *const simulator = [[DiffusionReconnectionSimulator alloc] initWithTrace:trace];
+            simulator.reconnectionTimeout = 600;
+            id<PTDiffusionSessionReconnectionStrategy> const strategy = s == 0 ? _BackOff(simulator, BackOffModeLinear)
+                                                                      : s == 1 ? _BackOff(simulator, BackOffModeDecorrelatedJitter)
+                                                                      : _Breaker(simulator);
+            DiffusionSimulationResult *const result = [simulator runStrategy:strategy];
+            _Report([NSString stringWithFormat:@"simulator.%@.%@", traceNames[t], names[s]], result);
+            XCTAssertEqual(result.outageCount, result.reconnectedCount + result.closedCount + result.abortedCount);
+            XCTAssertEqual(result.reconnectedCount, result.outageCount);
+            [results addObject:result];
+        }
+        if (trace.lossDuration >= 300)
+        {
+            // against a server that is down for minutes, the breaker holds its attempts back
+            XCTAssertLessThan(results[2].attemptCount * 3, results[0].attemptCount);
+        }
+    }
+}
+
+- (void)testMillionOutagesTakeSeconds {
+    const NSUInteger count = 1000000;
+    DiffusionOutageTrace *const trace = [DiffusionOutageTrace flappingTraceWithDownTime:6 upTime:4 count:count];
+    DiffusionReconnectionSimulator *const simulator = [[DiffusionReconnectionSimulator alloc] initWithTrace:trace];
+
+    const uint64_t start = DiffusionTestNow();
+    DiffusionSimulationResult *const result = [simulator runStrategy:_BackOff(simulator, BackOffModeDecorrelatedJitter)];
+    const double seconds = (DiffusionTestNow() - start) / (double)NSEC_PER_SEC;
+
+    [DiffusionBenchmarkSuite.sharedSuite report:@"simulator.event" value:seconds * 1e9 / result.eventCount unit:@"ns"];
+    _Report(@"simulator.million", result);
+    XCTAssertEqual(result.outageCount, count);
+    XCTAssertEqual(result.reconnectedCount, count);
+    XCTAssertLessThan(seconds, 60);
+}
+
+@end
@@ -0,0 +1,70 @@
+//
+//  DiffusionSchedulerTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionScheduler.h"
+
+@interface DiffusionSchedulerTests : XCTestCase
+
+@end
+
+@implementation DiffusionSchedulerTests
+
+- (void)testVirtualSchedulerRunsInTimeOrder {
+    DiffusionVirtualScheduler *const scheduler = [[DiffusionVirtualScheduler alloc] initWithTime:10];
+    NSMutableArray<NSString *> *const ran = [NSMutableArray array];
+    [scheduler scheduleAfterDelay:3 block:^{ [ran addObject:@"c"]; }];
+    [scheduler scheduleAfterDelay:1 block:^{ [ran addObject:@"a"]; }];
+    [scheduler scheduleAfterDelay:1 block:^{ [ran addObject:@"b"]; }];
+    XCTAssertEqual(scheduler.pendingCount, 3);
+
+    [scheduler runUntilTime:12];
+    XCTAssertEqualObjects(ran, (@[@"a", @"b"]));
+    XCTAssertEqual(scheduler.currentTime, 12);
+
+    // scheduled from a block, relative to the time of that block
+    [scheduler scheduleAfterDelay:0 block:^{
+        [scheduler scheduleAfterDelay:5 block:^{ [ran addObject:@"d"]; }];
+    }];
+    [scheduler runUntilIdle];
+    XCTAssertEqualObjects(ran, (@[@"a", @"b", @"c", @"d"]));
+    XCTAssertEqual(scheduler.currentTime, 17);
+    XCTAssertEqual(scheduler.executedCount, 5);
+}
+
+- (void)testVirtualSchedulerKeepsOrderOverManyBlocks {
+    DiffusionVirtualScheduler *const scheduler = [[DiffusionVirtualScheduler alloc] init];
+    __block NSTimeInterval last = -1;
+    __block NSUInteger outOfOrder = 0;
+    for (NSUInteger i = 0; i < 10000; i++)
+    {
+        [scheduler scheduleAfterDelay:(i * 7919) % 1000 block:^{
+            outOfOrder += scheduler.currentTime < last;
+            last = scheduler.currentTime;
+        }];
+    }
+    [scheduler runUntilIdle];
+    XCTAssertEqual(outOfOrder, 0);
+    XCTAssertEqual(scheduler.executedCount, 10000);
+    XCTAssertEqual(scheduler.pendingCount, 0);
+}
+
+- (void)testDispatchSchedulerRunsOnItsQueue {
+    XCTestExpectation *const ran = [self expectationWithDescription:@"ran"];
+    DiffusionDispatchScheduler *const scheduler = DiffusionDispatchScheduler.mainQueueScheduler;
+    const NSTimeInterval start = scheduler.currentTime;
+    [scheduler scheduleAfterDelay:0.05 block:^{
+        XCTAssertTrue(NSThread.isMainThread);
+        XCTAssertGreaterThanOrEqual(scheduler.currentTime - start, 0.04);
+        [ran fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+}
+
+@end
@@ -0,0 +1,67 @@
+//
+//  DiffusionSelectorCoalescerTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 22/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionSelectorCoalescer.h"
+
+@interface DiffusionSelectorCoalescerTests : XCTestCase
+
+@end
+
+@implementation DiffusionSelectorCoalescerTests
+
+- (void)testCovering {
+    XCTAssertTrue([DiffusionSelectorCoalescer selector:@">Demos//" covers:@">Demos/Sportsbook/Football/England//"]);
+    XCTAssertTrue([DiffusionSelectorCoalescer selector:@">Demos//" covers:@">Demos"]);
+    XCTAssertTrue([DiffusionSelectorCoalescer selector:@">Demos/" covers:@">Demos/Sportsbook"]);
+    XCTAssertFalse([DiffusionSelectorCoalescer selector:@">Demos/" covers:@">Demos"]);
+    XCTAssertFalse([DiffusionSelectorCoalescer selector:@">Demos" covers:@">Demos/Sportsbook"]);
+    XCTAssertFalse([DiffusionSelectorCoalescer selector:@">Demos//" covers:@">DemosExtra//"]);
+    XCTAssertFalse([DiffusionSelectorCoalescer selector:@">Demos//" covers:@"?Demos/.*//"]);
+    XCTAssertTrue([DiffusionSelectorCoalescer selector:@"Demos//" covers:@">Demos//"]);
+}
+
+- (void)testCoveringSetKeepsWidestSelectors {
+    NSArray<NSString *> *const selectors = @[@">Demos/Sportsbook/Football/England//",
+                                             @">Demos//",
+                                             @">Demos/Sportsbook",
+                                             @">Other/A",
+                                             @"?Demos/.*/Tennis",
+                                             @"?Demos/.*/Tennis"];
+    NSArray<NSString *> *const expected = @[@">Demos//", @">Other/A", @"?Demos/.*/Tennis"];
+    XCTAssertEqualObjects([DiffusionSelectorCoalescer coveringSetOfSelectors:selectors], expected);
+}
+
+- (void)testWidenAndNarrow {
+    DiffusionSelectorCoalescer *const coalescer = [[DiffusionSelectorCoalescer alloc] init];
+
+    DiffusionSelectorChanges *changes = [coalescer updateWithSelectors:@[@">Demos/Sportsbook/Football/England//"]];
+    XCTAssertEqualObjects(changes.added, @[@">Demos/Sportsbook/Football/England//"]);
+
+    // widening: the narrow selector leaves the covering set
+    changes = [coalescer updateWithSelectors:@[@">Demos/Sportsbook/Football/England//", @">Demos//"]];
+    XCTAssertEqualObjects(changes.added, @[@">Demos//"]);
+    XCTAssertEqualObjects(changes.removed, @[@">Demos/Sportsbook/Football/England//"]);
+    XCTAssertEqualObjects([coalescer selectorCovering:@">Demos/Sportsbook/Football/England//"], @">Demos//");
+
+    // removing a covered selector does not change what the server is asked for
+    changes = [coalescer updateWithSelectors:@[@">Demos//"]];
+    XCTAssertTrue(changes.empty);
+
+    changes = [coalescer updateWithSelectors:@[@">Demos//", @">Demos/Sportsbook/Football/England//"]];
+    XCTAssertTrue(changes.empty);
+
+    // narrowing: the hidden selector comes back
+    changes = [coalescer updateWithSelectors:@[@">Demos/Sportsbook/Football/England//"]];
+    XCTAssertEqualObjects(changes.added, @[@">Demos/Sportsbook/Football/England//"]);
+    XCTAssertEqualObjects(changes.removed, @[@">Demos//"]);
+    XCTAssertNil([coalescer selectorCovering:@">Demos/Sportsbook/Football/England//"]);
+}
+
+@end
@@ -0,0 +1,73 @@
+//
+//  DiffusionSessionPoolTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 20/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionSessionPool.h"
+
+@interface DiffusionSessionPoolTests : XCTestCase
+
+@end
+
+@implementation DiffusionSessionPoolTests
+
+- (void)testShardingIsStable {
+    NSArray<NSString *> *const selectors = @[@">Demos//", @">Demos/Sportsbook/Football/England//", @"?Demos/.*/Tennis//"];
+    for (NSString *selector in selectors)
+    {
+        const NSUInteger shard = [DiffusionSessionPool shardForSelector:selector shardCount:8];
+        XCTAssertLessThan(shard, 8u);
+        XCTAssertEqual(shard, [DiffusionSessionPool shardForSelector:[selector mutableCopy] shardCount:8]);
+    }
+    XCTAssertEqual([DiffusionSessionPool shardForSelector:@">Demos//" shardCount:1], 0u);
+}
+
+- (void)testShardingSpreadsSelectors {
+    NSUInteger counts[4] = {0};
+    for (NSUInteger i = 0; i < 4000; i++)
+    {
+        NSString *const selector = [NSString stringWithFormat:@">Demos/Sportsbook/Football/Fixture%lu//", (unsigned long)i];
+        counts[[DiffusionSessionPool shardForSelector:selector shardCount:4]]++;
+    }
+    for (NSUInteger shard = 0; shard < 4; shard++)
+    {
+        XCTAssertGreaterThan(counts[shard], 800u);
+    }
+}
+
+- (void)testMergeKeepsOneOwnerPerTopic {
+    DiffusionSessionPool *const pool = [[DiffusionSessionPool alloc] initWithShardCount:2];
+
+    XCTAssertTrue([pool acceptTopicPath:@"Demos/A" fromShard:1]);
+    XCTAssertFalse([pool acceptTopicPath:@"Demos/A" fromShard:0]);
+    XCTAssertTrue([pool acceptTopicPath:@"Demos/A" fromShard:1]);
+
+    // the owner giving the topic up lets the other shard take over with its next update
+    [pool releaseTopicPath:@"Demos/A" fromShard:1];
+    XCTAssertTrue([pool acceptTopicPath:@"Demos/A" fromShard:0]);
+    XCTAssertFalse([pool acceptTopicPath:@"Demos/A" fromShard:1]);
+}
+
+- (void)testTopicIsGoneOnlyOnceNoShardIsSubscribed {
+    DiffusionSessionPool *const pool = [[DiffusionSessionPool alloc] initWithShardCount:2];
+
+    XCTAssertTrue([pool retainTopicPath:@"Demos/A" fromShard:1]);
+    XCTAssertFalse([pool retainTopicPath:@"Demos/A" fromShard:0]);
+    XCTAssertEqual([pool referenceCountOfTopicPath:@"Demos/A"], 2u);
+    XCTAssertTrue([pool acceptTopicPath:@"Demos/A" fromShard:1]);
+
+    // the owning shard unsubscribes, the other one still delivers the topic
+    XCTAssertFalse([pool releaseTopicPath:@"Demos/A" fromShard:1]);
+    XCTAssertEqual([pool referenceCountOfTopicPath:@"Demos/A"], 1u);
+    XCTAssertTrue([pool acceptTopicPath:@"Demos/A" fromShard:0]);
+
+    XCTAssertTrue([pool releaseTopicPath:@"Demos/A" fromShard:0]);
+    XCTAssertEqual([pool referenceCountOfTopicPath:@"Demos/A"], 0u);
+}
+
+@end
@@ -0,0 +1,213 @@
+//
+//  DiffusionStandInServerTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionManager.h"
+#import "DiffusionStandInServer.h"
+#import "DiffusionTestSupport.h"
+
+@interface DiffusionStandInServerTests : XCTestCase
+
+@end
+
+@implementation DiffusionStandInServerTests
+
+- (DiffusionStandInScenario *)scenarioNamed:(NSString *)name {
+    NSURL *const url = [[NSBundle bundleForClass:self.class] URLForResource:name withExtension:@"json"];
+    NSError *error = nil;
+    DiffusionStandInScenario *const scenario = [DiffusionStandInScenario scenarioWithContentsOfURL:url error:&error];
+    XCTAssertNotNil(scenario, @"%@", error);
+    return scenario;
+}
+
+- (DiffusionStandInScenario *)smallScenarioWithOutages:(NSArray *)outages {
+    return [[DiffusionStandInScenario alloc] initWithDictionary:@{@"topicCount": @10,
+                                                                   @"topicPrefix": @"StandIn/Small",
+                                                                   @"updatesPerSecond": @100,
+                                                                   @"duration": @1,
+                                                                   @"pingInterval": @0.1,
+                                                                   @"outages": outages}
+                                                          error:nil];
+}
+
+- (void)testLoadsScenarioFiles {
+    DiffusionStandInScenario *const scenario = [self scenarioNamed:@"StandInLoad50k"];
+    XCTAssertEqual(scenario.topicCount, 50000u);
+    XCTAssertEqual(scenario.updatesPerSecond, 20000.0);
+    XCTAssertEqual(scenario.topicType, PTDiffusionTopicType_JSON);
+    XCTAssertEqual(scenario.outages.count, 1u);
+    XCTAssertTrue([scenario isConnectedAtTime:29.9]);
+    XCTAssertFalse([scenario isConnectedAtTime:30.0]);
+    XCTAssertTrue([scenario isConnectedAtTime:35.0]);
+    XCTAssertEqualObjects([scenario topicPathAtIndex:7], @"StandIn/Load/7");
+
+    XCTAssertEqual([self scenarioNamed:@"StandInFlapping"].topicType, PTDiffusionTopicType_Binary);
+}
+
+- (void)testRejectsInvalidScenarios {
+    NSError *error = nil;
+    XCTAssertNil([[DiffusionStandInScenario alloc] initWithDictionary:@{@"topicCount": @10} error:&error]);
+    XCTAssertEqualObjects(error.domain, DiffusionStandInScenarioErrorDomain);
+    XCTAssertEqual(error.code, DiffusionStandInScenarioErrorInvalidFile);
+
+    error = nil;
+    XCTAssertNil([[DiffusionStandInScenario alloc] initWithDictionary:@{@"topicCount": @10, @"updatesPerSecond": @1, @"duration": @1, @"topicType": @"record"} error:&error]);
+    XCTAssertNotNil(error);
+}
+
+- (void)testPlaysSubscribedTopicsOnly {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self smallScenarioWithOutages:@[]] manager:manager];
+
+    // nothing subscribed yet: updates are due but go nowhere
+    [server runUntilTime:0.2];
+    XCTAssertEqual(server.subscribedTopicCount, 0u);
+    XCTAssertEqual(server.skippedUpdateCount, 20u);
+
+    [manager subscribeTo:@"?StandIn/Small/[0-4]"];
+    [server runToCompletion];
+    XCTAssertTrue(server.finished);
+    XCTAssertEqual(server.subscribedTopicCount, 5u);
+    XCTAssertEqual(server.updateCount, 80u);
+    XCTAssertEqual(manager.streamDispatcher.updateCount, 80u);
+    XCTAssertEqual(manager.metrics.updateCount, 80u);
+    XCTAssertEqual(manager.valueCache.count, 5u);
+    XCTAssertNotNil([manager.valueCache valueForTopicPath:@"StandIn/Small/4"]);
+    XCTAssertNil([manager.valueCache valueForTopicPath:@"StandIn/Small/5"]);
+
+    // unsubscribing is seen on the next run, the cached values go with it
+    [manager unsubscribeFrom:@"?StandIn/Small/[0-4]"];
+    [server runUntilTime:2];
+    XCTAssertEqual(server.subscribedTopicCount, 0u);
+    XCTAssertEqual(manager.valueCache.count, 0u);
+}
+
+- (void)testOutagesAndPings {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    [manager subscribeTo:@">StandIn/Small//"];
+    DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self smallScenarioWithOutages:@[@{@"at": @0.5, @"duration": @0.25}]] manager:manager];
+    [server runToCompletion];
+
+    XCTAssertEqual(server.outageCount, 1u);
+    XCTAssertEqual(server.skippedUpdateCount, 25u);
+    XCTAssertEqual(server.updateCount, 75u);
+    XCTAssertEqual(manager.metrics.reconnectCount, 1u);
+
+    // pings at 0.1 to 0.9, the ones at 0.5, 0.6 and 0.7 during the outage
+    XCTAssertEqual(server.pingCount, 9u);
+    XCTAssertEqual([manager.metrics.pingRoundTripTime snapshot].count, 6u);
+    XCTAssertEqual(manager.livenessScheduler.consecutiveFailures, 0u);
+}
+
+- (void)testPacedRunKeepsUpWithTheClock {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    [manager subscribeTo:@">StandIn/Small//"];
+    DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self smallScenarioWithOutages:@[]] manager:manager];
+
+    XCTestExpectation *const finished = [self expectationWithDescription:@"finished"];
+    const uint64_t start = DiffusionTestNow();
+    [server startAtSpeed:4 completionHandler:^{
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    // a second of scenario at four times real time
+    XCTAssertGreaterThanOrEqual((DiffusionTestNow() - start) / (double)NSEC_PER_SEC, 0.2);
+    XCTAssertEqual(server.updateCount, 100u);
+}
+
+- (void)testPooledSessionsDeliverEachUpdateOnce {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self smallScenarioWithOutages:@[]] manager:manager sessionCount:4];
+    XCTAssertNotNil(manager.sessionPool);
+
+    // a narrow selector on another session than the wide one: its topic is sent by both
+    NSString *const wide = @">StandIn/Small//";
+    NSString *narrow = nil;
+    for (NSUInteger i = 0; i < 10 && !narrow; i++)
+    {
+        NSString *const candidate = [NSString stringWithFormat:@">StandIn/Small/%lu", (unsigned long)i];
+        if ([manager.sessionPool shardForSelector:candidate] != [manager.sessionPool shardForSelector:wide])
+        {
+            narrow = candidate;
+        }
+    }
+    XCTAssertNotNil(narrow);
+    [manager subscribeTo:wide];
+    [manager subscribeTo:narrow];
+
+    __block NSUInteger handled = 0;
+    manager.updateHandler = ^(NSString *topicPath, PTDiffusionTopicSpecification *specification, PTDiffusionJSON *value) {
+        handled++;
+    };
+    [server runToCompletion];
+
+    XCTAssertEqual(server.subscribedTopicCount, 10u);
+    XCTAssertEqual(server.updateCount, 100u);
+    XCTAssertEqual(server.sentUpdateCount, 110u);
+    XCTAssertEqual(handled, 100u);
+
+    // the wide selector goes: the narrow one's session still holds its topic and its cached value
+    NSString *const topicPath = [narrow substringFromIndex:1];
+    [manager unsubscribeFrom:wide];
+    [server runUntilTime:server.scenario.duration];
+    XCTAssertEqual(server.subscribedTopicCount, 1u);
+    XCTAssertNotNil([manager.valueCache valueForTopicPath:topicPath]);
+}
+
+/**
+
+    Updates/sec of the load scenario through 1, 2, 4 and 8 pooled sessions, over ten selectors sharded across them.
+    Every update goes through the pool's merging and the manager's delivery path.
+
+ */
+- (void)testPooledLoadThroughput {
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelInfo);
+
+    for (NSNumber *sessionCount in @[@1, @2, @4, @8])
+    {
+        DiffusionManager *const manager = [[DiffusionManager alloc] init];
+        DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self scenarioNamed:@"StandInLoad50k"] manager:manager sessionCount:sessionCount.unsignedIntegerValue];
+        for (NSUInteger digit = 0; digit < 10; digit++)
+        {
+            [manager subscribeTo:[NSString stringWithFormat:@"?StandIn/Load/.*%lu", (unsigned long)digit]];
+        }
+
+        const uint64_t start = DiffusionTestNow();
+        [server runUntilTime:10];
+        const double elapsed = (DiffusionTestNow() - start) / (double)NSEC_PER_SEC;
+
+        XCTAssertEqual(server.subscribedTopicCount, 50000u);
+        XCTAssertEqual(server.sentUpdateCount, server.updateCount);
+        [DiffusionBenchmarkSuite.sharedSuite report:[NSString stringWithFormat:@"standIn.pooled.%@", sessionCount]
+                                              value:server.updateCount / elapsed unit:@"updates/s"];
+    }
+}
+
+- (void)testLoadScenarioThroughput {
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelInfo);
+
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    [manager subscribeTo:@">StandIn/Load//"];
+    DiffusionStandInServer *const server = [[DiffusionStandInServer alloc] initWithScenario:[self scenarioNamed:@"StandInLoad50k"] manager:manager];
+
+    const uint64_t start = DiffusionTestNow();
+    [server runToCompletion];
+    const double elapsed = (DiffusionTestNow() - start) / (double)NSEC_PER_SEC;
+
+    XCTAssertEqual(server.subscribedTopicCount, 50000u);
+    XCTAssertEqual(server.updateCount + server.skippedUpdateCount, 1200000u);
+    XCTAssertEqual(manager.metrics.reconnectCount, 1u);
+    [DiffusionBenchmarkSuite.sharedSuite report:@"standIn.load" value:server.updateCount / elapsed unit:@"updates/s"];
+    [DiffusionBenchmarkSuite.sharedSuite report:@"standIn.load.realTime" value:server.scenario.duration / elapsed unit:@"x"];
+}
+
+@end
@@ -0,0 +1,165 @@
+//
+//  DiffusionSubscriptionBatcherTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 23/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionSubscriptionBatcher.h"
+
+@interface DiffusionSubscriptionBatcherTests : XCTestCase
+
+@end
+
+@implementation DiffusionSubscriptionBatcherTests
+
+- (void)testIntentsFoldIntoTheirReferenceCount {
+    DiffusionSubscriptionBatcher *const batcher = [[DiffusionSubscriptionBatcher alloc] init];
+    batcher.window = 60;
+    __block NSArray<DiffusionSubscriptionIntent *> *flushed = nil;
+    batcher.flushHandler = ^(NSArray<DiffusionSubscriptionIntent *> *intents) {
+        flushed = intents;
+    };
+
+    __block NSUInteger completed = 0;
+    [batcher addSubscribe:@">A" priority:DiffusionSubscriptionPriorityNormal completionHandler:^(NSError *error) { completed++; }];
+    [batcher addSubscribe:@">A" priority:DiffusionSubscriptionPriorityNormal completionHandler:^(NSError *error) { completed++; }];
+    [batcher addUnsubscribe:@">A" completionHandler:^(NSError *error) { completed++; }];
+    [batcher addSubscribe:@">B" priority:DiffusionSubscriptionPriorityNormal completionHandler:nil];
+    [batcher addUnsubscribe:@">B" completionHandler:nil];
+    [batcher addSubscribe:@">C" priority:DiffusionSubscriptionPriorityNormal completionHandler:nil];
+    [batcher addSubscribe:@">C" priority:DiffusionSubscriptionPriorityCritical completionHandler:nil];
+
+    XCTAssertEqual(completed, 0);
+    XCTAssertEqual(batcher.cancelledIntents, 2);
+    XCTAssertEqual(batcher.pendingCount, 2);
+
+    [batcher flush];
+    XCTAssertEqual(flushed.count, 2);
+    XCTAssertEqualObjects(flushed[0].selector, @">A");
+    XCTAssertTrue(flushed[0].isSubscribe);
+    XCTAssertEqual(flushed[0].referenceCount, 1);
+    XCTAssertEqual(flushed[0].completionHandlers.count, 3);
+    XCTAssertEqualObjects(flushed[1].selector, @">C");
+    XCTAssertEqual(flushed[1].referenceCount, 2);
+    XCTAssertEqual(flushed[1].priority, DiffusionSubscriptionPriorityCritical);
+
+    [batcher noteSentRequests:1];
+    XCTAssertEqual(batcher.receivedIntents, 7);
+    XCTAssertEqual(batcher.savedRequests, 6);
+}
+
+- (void)testIntentsOfAnUnsubscribedSelector {
+    DiffusionSubscriptionBatcher *const batcher = [[DiffusionSubscriptionBatcher alloc] init];
+    batcher.window = 60;
+    batcher.referenceCountHandler = ^NSUInteger(NSString *selector) {
+        return 0;
+    };
+    __block NSArray<DiffusionSubscriptionIntent *> *flushed = nil;
+    batcher.flushHandler = ^(NSArray<DiffusionSubscriptionIntent *> *intents) {
+        flushed = intents;
+    };
+
+    // subscribe then unsubscribe: the server never needs to know
+    __block NSUInteger completed = 0;
+    [batcher addSubscribe:@">A" priority:DiffusionSubscriptionPriorityNormal completionHandler:^(NSError *error) { completed++; }];
+    [batcher addUnsubscribe:@">A" completionHandler:^(NSError *error) { completed++; }];
+    XCTAssertEqual(completed, 2);
+    XCTAssertEqual(batcher.pendingCount, 0);
+
+    // unsubscribe then subscribe: the unsubscribe has no reference to release, the selector still has to be subscribed
+    [batcher addUnsubscribe:@">B" completionHandler:^(NSError *error) { completed++; }];
+    [batcher addSubscribe:@">B" priority:DiffusionSubscriptionPriorityCritical completionHandler:^(NSError *error) { completed++; }];
+    XCTAssertEqual(completed, 2);
+    XCTAssertEqual(batcher.cancelledIntents, 2);
+
+    // a lone unsubscribe changes nothing
+    [batcher addUnsubscribe:@">C" completionHandler:^(NSError *error) { completed++; }];
+    XCTAssertEqual(completed, 3);
+    XCTAssertEqual(batcher.cancelledIntents, 3);
+
+    [batcher flush];
+    XCTAssertEqual(flushed.count, 1);
+    XCTAssertEqualObjects(flushed[0].selector, @">B");
+    XCTAssertTrue(flushed[0].isSubscribe);
+    XCTAssertEqual(flushed[0].referenceCount, 1);
+    XCTAssertEqual(flushed[0].priority, DiffusionSubscriptionPriorityCritical);
+    XCTAssertEqual(flushed[0].completionHandlers.count, 2);
+}
+
+- (void)testIntentsOfASubscribedSelector {
+    DiffusionSubscriptionBatcher *const batcher = [[DiffusionSubscriptionBatcher alloc] init];
+    batcher.window = 60;
+    batcher.referenceCountHandler = ^NSUInteger(NSString *selector) {
+        return [selector isEqualToString:@">D"] ? 2 : 1;
+    };
+    __block NSArray<DiffusionSubscriptionIntent *> *flushed = nil;
+    batcher.flushHandler = ^(NSArray<DiffusionSubscriptionIntent *> *intents) {
+        flushed = intents;
+    };
+
+    // subscribe then unsubscribe: the server never needs to know
+    __block NSUInteger completed = 0;
+    [batcher addSubscribe:@">A" priority:DiffusionSubscriptionPriorityNormal completionHandler:^(NSError *error) { completed++; }];
+    [batcher addUnsubscribe:@">A" completionHandler:^(NSError *error) { completed++; }];
+    XCTAssertEqual(completed, 2);
+    XCTAssertEqual(batcher.pendingCount, 0);
+
+    // the second unsubscribe has no reference left to release, so the subscribe restores the only one
+    [batcher addUnsubscribe:@">B" completionHandler:^(NSError *error) { completed++; }];
+    [batcher addUnsubscribe:@">B" completionHandler:^(NSError *error) { completed++; }];
+    [batcher addSubscribe:@">B" priority:DiffusionSubscriptionPriorityNormal completionHandler:^(NSError *error) { completed++; }];
+    XCTAssertEqual(completed, 5);
+    XCTAssertEqual(batcher.cancelledIntents, 5);
+    XCTAssertEqual(batcher.pendingCount, 0);
+
+    [batcher addUnsubscribe:@">C" completionHandler:^(NSError *error) { completed++; }];
+    [batcher addUnsubscribe:@">D" completionHandler:nil];
+    [batcher addUnsubscribe:@">D" completionHandler:nil];
+    XCTAssertEqual(completed, 5);
+
+    [batcher flush];
+    XCTAssertEqual(flushed.count, 2);
+    XCTAssertEqualObjects(flushed[0].selector, @">C");
+    XCTAssertFalse(flushed[0].isSubscribe);
+    XCTAssertEqual(flushed[0].referenceCount, 1);
+    XCTAssertEqual(flushed[0].completionHandlers.count, 1);
+    XCTAssertEqualObjects(flushed[1].selector, @">D");
+    XCTAssertFalse(flushed[1].isSubscribe);
+    XCTAssertEqual(flushed[1].referenceCount, 2);
+}
+
+- (void)testZeroWindowFlushesImmediately {
+    DiffusionSubscriptionBatcher *const batcher = [[DiffusionSubscriptionBatcher alloc] init];
+    DiffusionSubscriptionRegistry *const registry = [[DiffusionSubscriptionRegistry alloc] init];
+    batcher.referenceCountHandler = ^NSUInteger(NSString *selector) {
+        return [registry referenceCountOfSelector:selector];
+    };
+    __block NSUInteger flushes = 0;
+    batcher.flushHandler = ^(NSArray<DiffusionSubscriptionIntent *> *intents) {
+        flushes++;
+        for (DiffusionSubscriptionIntent *intent in intents)
+        {
+            if (intent.isSubscribe)
+            {
+                [registry addSelector:intent.selector priority:intent.priority];
+            }
+            else
+            {
+                [registry removeSelector:intent.selector];
+            }
+        }
+    };
+
+    [batcher addSubscribe:@">A" priority:DiffusionSubscriptionPriorityNormal completionHandler:nil];
+    [batcher addUnsubscribe:@">A" completionHandler:nil];
+
+    XCTAssertEqual(flushes, 2);
+    XCTAssertEqual(batcher.pendingCount, 0);
+    XCTAssertFalse([registry containsSelector:@">A"]);
+}
+
+@end
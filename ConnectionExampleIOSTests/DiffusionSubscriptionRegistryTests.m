@@ -0,0 +1,78 @@
+//
+//  DiffusionSubscriptionRegistryTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 21/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionSubscriptionRegistry.h"
+
+@interface DiffusionSubscriptionRegistryTests : XCTestCase
+
+@end
+
+@implementation DiffusionSubscriptionRegistryTests
+
+- (void)testSelectorStaysActiveUntilTheLastReferenceIsReleased {
+    DiffusionSubscriptionRegistry *const registry = [[DiffusionSubscriptionRegistry alloc] init];
+
+    XCTAssertTrue([registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal]);
+    XCTAssertFalse([registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal]);
+    XCTAssertEqual([registry referenceCountOfSelector:@">A"], 2);
+    XCTAssertEqual(registry.count, 1);
+
+    XCTAssertFalse([registry removeSelector:@">A"]);
+    XCTAssertTrue([registry containsSelector:@">A"]);
+    XCTAssertEqual([registry referenceCountOfSelector:@">A"], 1);
+
+    XCTAssertTrue([registry removeSelector:@">A"]);
+    XCTAssertFalse([registry containsSelector:@">A"]);
+    XCTAssertEqual([registry referenceCountOfSelector:@">A"], 0);
+    XCTAssertEqual(registry.count, 0);
+
+    // nothing left to release
+    XCTAssertFalse([registry removeSelector:@">A"]);
+    XCTAssertEqual([registry referenceCountOfSelector:@">A"], 0);
+}
+
+- (void)testHighestPriorityIsKeptUntilTheSelectorIsInactive {
+    DiffusionSubscriptionRegistry *const registry = [[DiffusionSubscriptionRegistry alloc] init];
+
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityCritical];
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal];
+    XCTAssertEqual([registry priorityOfSelector:@">A"], DiffusionSubscriptionPriorityCritical);
+
+    [registry removeSelector:@">A"];
+    XCTAssertEqual([registry priorityOfSelector:@">A"], DiffusionSubscriptionPriorityCritical);
+
+    [registry removeSelector:@">A"];
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal];
+    XCTAssertEqual([registry priorityOfSelector:@">A"], DiffusionSubscriptionPriorityNormal);
+}
+
+- (void)testSelectorsKeepTheOrderTheyWereFirstSubscribedIn {
+    DiffusionSubscriptionRegistry *const registry = [[DiffusionSubscriptionRegistry alloc] init];
+
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal];
+    [registry addSelector:@">B" priority:DiffusionSubscriptionPriorityCritical];
+    [registry addSelector:@">C" priority:DiffusionSubscriptionPriorityNormal];
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal];
+    [registry removeSelector:@">A"];
+
+    XCTAssertEqualObjects(registry.selectors, (@[@">A", @">B", @">C"]));
+    XCTAssertEqualObjects([registry selectorsWithPriority:DiffusionSubscriptionPriorityNormal], (@[@">A", @">C"]));
+    XCTAssertEqualObjects([registry selectorsWithPriority:DiffusionSubscriptionPriorityCritical], (@[@">B"]));
+
+    [registry removeSelector:@">A"];
+    [registry addSelector:@">A" priority:DiffusionSubscriptionPriorityNormal];
+    XCTAssertEqualObjects(registry.selectors, (@[@">B", @">C", @">A"]));
+}
+
+- (void)testSingleSelectorIsItsOwnExpression {
+    XCTAssertEqualObjects([DiffusionSubscriptionRegistry expressionForSelectors:@[@">A"]], @">A");
+}
+
+@end
@@ -0,0 +1,42 @@
+//
+//  DiffusionTestSupport.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <time.h>
+
+#import "DiffusionLog.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// nanoseconds, on the clock the project times everything with
+static inline uint64_t DiffusionTestNow(void)
+{
+    return clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+}
+
+// keeps the thread busy, as a handler doing real work would
+static inline void DiffusionTestSpin(uint64_t nanoseconds)
+{
+    const uint64_t end = DiffusionTestNow() + nanoseconds;
+    while (DiffusionTestNow() < end)
+    {
+    }
+}
+
+// sets the log level until the end of the test, from setUp or from the test itself
+static inline void DiffusionTestUseLogLevel(XCTestCase *testCase, DiffusionLogLevel level)
+{
+    const DiffusionLogLevel previous = DiffusionLog.level;
+    DiffusionLog.level = level;
+    [testCase addTeardownBlock:^{
+        DiffusionLog.level = previous;
+    }];
+}
+
+NS_ASSUME_NONNULL_END
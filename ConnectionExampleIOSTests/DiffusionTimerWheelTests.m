@@ -0,0 +1,187 @@
+//
+//  DiffusionTimerWheelTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionManager.h"
+#import "DiffusionRandom.h"
+#import "DiffusionTimerWheel.h"
+
+@interface DiffusionTimerWheelTests : XCTestCase
+
+@end
+
+@implementation DiffusionTimerWheelTests
+
+static DiffusionTimerWheel *_ManualWheel(void)
+{
+    return [[DiffusionTimerWheel alloc] initWithResolution:0.01 targetQueue:nil];
+}
+
+- (void)testTimersFireInDeadlineOrder {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    NSMutableArray<NSString *> *const fired = [NSMutableArray array];
+    [wheel scheduleAfterDelay:0.3 leeway:0 block:^{ [fired addObject:@"c"]; }];
+    [wheel scheduleAfterDelay:0.1 leeway:0 block:^{ [fired addObject:@"a"]; }];
+    [wheel scheduleAfterDelay:0.2 leeway:0 block:^{ [fired addObject:@"b"]; }];
+    XCTAssertEqual(wheel.pendingCount, 3);
+    XCTAssertEqualWithAccuracy(wheel.nextWakeupTime, 0.1, 1e-9);
+
+    [wheel advanceToTime:1];
+    XCTAssertEqualObjects(fired, (@[@"a", @"b", @"c"]));
+    XCTAssertEqual(wheel.currentTime, 1);
+    XCTAssertEqual(wheel.pendingCount, 0);
+    XCTAssertEqual(wheel.nextWakeupTime, INFINITY);
+    XCTAssertEqual(wheel.firedCount, 3);
+    XCTAssertEqual(wheel.wakeupCount, 3);
+    XCTAssertEqual(wheel.savedWakeupCount, 0);
+}
+
+- (void)testTimersWithinLeewayShareAWakeup {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    NSMutableArray<NSString *> *const fired = [NSMutableArray array];
+    [wheel scheduleAfterDelay:1.0 leeway:0.5 block:^{ [fired addObject:@"a"]; }];
+    [wheel scheduleAfterDelay:1.2 leeway:0.5 block:^{ [fired addObject:@"b"]; }];
+    [wheel scheduleAfterDelay:1.6 leeway:0 block:^{ [fired addObject:@"c"]; }];
+    XCTAssertEqualWithAccuracy(wheel.nextWakeupTime, 1.5, 1e-9);
+
+    // nothing must fire yet, so nothing does
+    [wheel advanceToTime:1.4];
+    XCTAssertEqual(fired.count, 0);
+
+    // a goes late, and takes b, already due, with it
+    [wheel advanceToTime:1.5];
+    XCTAssertEqualObjects(fired, (@[@"a", @"b"]));
+
+    [wheel advanceToTime:2];
+    XCTAssertEqualObjects(fired, (@[@"a", @"b", @"c"]));
+    XCTAssertEqual(wheel.wakeupCount, 2);
+    XCTAssertEqual(wheel.savedWakeupCount, 1);
+}
+
+- (void)testDefaultLeewayIsAFractionOfTheDelay {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    [wheel scheduleAfterDelay:10 block:^{}];
+    XCTAssertEqualWithAccuracy(wheel.nextWakeupTime, 11, 1e-9);
+
+    wheel.defaultLeewayFraction = 0;
+    [wheel scheduleAfterDelay:5 block:^{}];
+    XCTAssertEqualWithAccuracy(wheel.nextWakeupTime, 5, 1e-9);
+}
+
+- (void)testCancelledTimersDoNotFire {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    __block NSUInteger fired = 0;
+    id<NSObject> const first = [wheel scheduleAfterDelay:1 leeway:0 block:^{ fired++; }];
+    [wheel scheduleAfterDelay:2 leeway:0 block:^{ fired++; }];
+
+    [wheel cancelTimer:first];
+    // twice is harmless
+    [wheel cancelTimer:first];
+    XCTAssertEqual(wheel.pendingCount, 1);
+    XCTAssertEqual(wheel.cancelledCount, 1);
+    XCTAssertEqualWithAccuracy(wheel.nextWakeupTime, 2, 1e-9);
+
+    [wheel advanceToTime:3];
+    XCTAssertEqual(fired, 1);
+    XCTAssertEqual(wheel.wakeupCount, 1);
+}
+
+- (void)testLongDelaysMoveDownTheLevels {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    // one per level, then one beyond the top level (2^24 ticks, about 46 hours)
+    NSArray<NSNumber *> *const delays = @[@0.5, @30, @600, @36000, @200000];
+    NSMutableArray<NSNumber *> *const times = [NSMutableArray array];
+    for (NSNumber *const delay in delays)
+    {
+        [wheel scheduleAfterDelay:delay.doubleValue leeway:0 block:^{
+            [times addObject:@(wheel.currentTime)];
+        }];
+    }
+
+    [wheel advanceToTime:300000];
+    XCTAssertEqual(times.count, delays.count);
+    for (NSUInteger i = 0; i < MIN(times.count, delays.count); i++)
+    {
+        XCTAssertEqualWithAccuracy(times[i].doubleValue, delays[i].doubleValue, 1e-6);
+    }
+}
+
+- (void)testTimersScheduledWhileFiringRunInTheSameAdvance {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    __block NSUInteger ticks = 0;
+    __block __weak dispatch_block_t weakTick;
+    dispatch_block_t const tick = ^{
+        ticks++;
+        [wheel scheduleAfterDelay:1 leeway:0 block:weakTick];
+    };
+    weakTick = tick;
+    [wheel scheduleAfterDelay:1 leeway:0 block:tick];
+
+    [wheel advanceToTime:10];
+    XCTAssertEqual(ticks, 10);
+    XCTAssertEqual(wheel.pendingCount, 1);
+}
+
+- (void)testLeewaySavesMostWakeupsOfManyTimers {
+    DiffusionTimerWheel *const wheel = _ManualWheel();
+    uint64_t random = 42;
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        // a second timer per wakeup already halves them. 10% leeway on 10 s of timers gives about 50
+        [wheel scheduleAfterDelay:DiffusionRandomNext(&random) * 10 block:^{}];
+    }
+
+    [wheel advanceToTime:20];
+    XCTAssertEqual(wheel.firedCount, 1000);
+    XCTAssertLessThan(wheel.wakeupCount, 100);
+    XCTAssertEqual(wheel.savedWakeupCount, 1000 - wheel.wakeupCount);
+}
+
+- (void)testFiresOnTheTargetQueueInOneHop {
+    XCTestExpectation *const fired = [self expectationWithDescription:@"fired"];
+    DiffusionTimerWheel *const wheel = [[DiffusionTimerWheel alloc] init];
+    const NSTimeInterval start = wheel.currentTime;
+    __block NSUInteger count = 0;
+    [wheel scheduleAfterDelay:0.05 leeway:0.05 block:^{
+        XCTAssertTrue(NSThread.isMainThread);
+        count++;
+    }];
+    [wheel scheduleAfterDelay:0.07 leeway:0.05 block:^{
+        XCTAssertTrue(NSThread.isMainThread);
+        XCTAssertGreaterThanOrEqual(wheel.currentTime - start, 0.06);
+        count++;
+        [fired fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertEqual(count, 2);
+    XCTAssertEqual(wheel.wakeupCount, 1);
+    XCTAssertEqual(wheel.savedWakeupCount, 1);
+}
+
+- (void)testFiresOnAQueueOfTheCallersChoice {
+    static const void *const key = &key;
+    dispatch_queue_t const queue = dispatch_queue_create("DiffusionTimerWheelTests.target", DISPATCH_QUEUE_SERIAL);
+    dispatch_queue_set_specific(queue, key, (void *)key, NULL);
+    DiffusionTimerWheel *const wheel = [[DiffusionTimerWheel alloc] initWithResolution:0.01 targetQueue:queue];
+    XCTAssertEqual(wheel.targetQueue, queue);
+
+    XCTestExpectation *const fired = [self expectationWithDescription:@"fired"];
+    [wheel scheduleAfterDelay:0.02 leeway:0.01 block:^{
+        XCTAssertEqual(dispatch_get_specific(key), key);
+        [fired fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+
+    // and the manager's timers go through the wheel it is given
+    DiffusionManager *const manager = [[DiffusionManager alloc] initWithTimerWheel:_ManualWheel()];
+    XCTAssertNil(manager.timerWheel.targetQueue);
+    XCTAssertEqual(manager.subscriptionBatcher.scheduler, manager.timerWheel);
+}
+
+@end
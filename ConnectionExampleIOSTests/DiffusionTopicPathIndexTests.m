@@ -0,0 +1,161 @@
+//
+//  DiffusionTopicPathIndexTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 27/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <mach/mach.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTopicPathIndex.h"
+
+@interface DiffusionTopicPathIndexTests : XCTestCase
+
+@end
+
+@implementation DiffusionTopicPathIndexTests
+
+static uint64_t _Footprint(void)
+{
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return info.phys_footprint;
+}
+
+// 100k topics: 20 sports x 50 competitions x 100 fixtures, in a deep and repetitive tree
+static NSString *_Path(NSUInteger i)
+{
+    return [NSString stringWithFormat:@"Demos/Sportsbook/Sport%lu/Competition%lu/Fixture%lu/Markets/MatchOdds",
+            (unsigned long)(i % 20), (unsigned long)((i / 20) % 50), (unsigned long)(i / 1000)];
+}
+
+
+- (void)testInternAndLookup {
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+
+    const DiffusionTopicID england = [index internTopicPath:@"Demos/Sportsbook/Football/England"];
+    const DiffusionTopicID spain = [index internTopicPath:@"Demos/Sportsbook/Football/Spain"];
+    // splits the node of the two paths above
+    const DiffusionTopicID sportsbook = [index internTopicPath:@"Demos/Sportsbook"];
+    const DiffusionTopicID deeper = [index internTopicPath:@"Demos/Sportsbook/Football/England/Premier/Arsenal"];
+
+    XCTAssertNotEqual(england, DiffusionTopicIDNone);
+    XCTAssertEqual(spain, england + 1);
+    XCTAssertEqual([index internTopicPath:[@"Demos/Sportsbook/Football/England" mutableCopy]], england);
+    XCTAssertEqual(index.count, 4u);
+
+    XCTAssertEqual([index IDForTopicPath:@"Demos/Sportsbook/Football/England"], england);
+    XCTAssertEqual([index IDForTopicPath:@"Demos/Sportsbook"], sportsbook);
+    XCTAssertEqual([index IDForTopicPath:@"Demos/Sportsbook/Football"], DiffusionTopicIDNone);
+    XCTAssertEqual([index IDForTopicPath:@"Demos/Sportsbook/Football/England/Premier"], DiffusionTopicIDNone);
+    XCTAssertEqual([index IDForTopicPath:@"Demos/Other"], DiffusionTopicIDNone);
+
+    XCTAssertEqualObjects([index topicPathForID:england], @"Demos/Sportsbook/Football/England");
+    XCTAssertEqualObjects([index topicPathForID:sportsbook], @"Demos/Sportsbook");
+    XCTAssertEqualObjects([index topicPathForID:deeper], @"Demos/Sportsbook/Football/England/Premier/Arsenal");
+    XCTAssertNil([index topicPathForID:DiffusionTopicIDNone]);
+    XCTAssertNil([index topicPathForID:1000]);
+}
+
+- (void)testEnumerateBranch {
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+    const DiffusionTopicID england = [index internTopicPath:@"Demos/Sportsbook/Football/England"];
+    const DiffusionTopicID spain = [index internTopicPath:@"Demos/Sportsbook/Football/Spain"];
+    const DiffusionTopicID tennis = [index internTopicPath:@"Demos/Sportsbook/Tennis"];
+    [index internTopicPath:@"Other/Football/England"];
+
+    NSMutableSet<NSNumber *> *const football = [NSMutableSet set];
+    [index enumerateTopicIDsInBranch:@"Demos/Sportsbook/Football" usingBlock:^(DiffusionTopicID topicID, BOOL *stop) {
+        [football addObject:@(topicID)];
+    }];
+    XCTAssertEqualObjects(football, ([NSSet setWithObjects:@(england), @(spain), nil]));
+
+    // the branch ends in the middle of a compressed node
+    NSMutableSet<NSNumber *> *const demos = [NSMutableSet set];
+    [index enumerateTopicIDsInBranch:@"Demos" usingBlock:^(DiffusionTopicID topicID, BOOL *stop) {
+        [demos addObject:@(topicID)];
+    }];
+    XCTAssertEqualObjects(demos, ([NSSet setWithObjects:@(england), @(spain), @(tennis), nil]));
+
+    __block NSUInteger visited = 0;
+    [index enumerateTopicIDsInBranch:@"Demos/Other" usingBlock:^(DiffusionTopicID topicID, BOOL *stop) {
+        visited++;
+    }];
+    XCTAssertEqual(visited, 0u);
+}
+
+/**
+
+    Memory per topic and lookup cost at 100k topics, for the index and for a dictionary keyed by path.
+
+ */
+- (void)testBenchmarkHundredThousandTopics {
+    const NSUInteger topicCount = 100000;
+
+    uint64_t before = _Footprint();
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        @autoreleasepool
+        {
+            [index internTopicPath:_Path(i)];
+        }
+    }
+    const uint64_t indexFootprint = _Footprint() - before;
+
+    before = _Footprint();
+    NSMutableDictionary<NSString *, NSNumber *> *const dictionary = [NSMutableDictionary dictionaryWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        @autoreleasepool
+        {
+            dictionary[_Path(i)] = @(i + 1);
+        }
+    }
+    const uint64_t dictionaryFootprint = _Footprint() - before;
+
+    // fresh strings, as delivered by callbacks
+    NSMutableArray<NSString *> *const lookups = [NSMutableArray arrayWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        [lookups addObject:_Path((i * 7919) % topicCount)];
+    }
+
+    uint64_t start = DiffusionTestNow();
+    NSUInteger found = 0;
+    for (NSString *path in lookups)
+    {
+        found += [index IDForTopicPath:path] != DiffusionTopicIDNone;
+    }
+    const uint64_t indexLookup = DiffusionTestNow() - start;
+    XCTAssertEqual(found, topicCount);
+
+    start = DiffusionTestNow();
+    found = 0;
+    for (NSString *path in lookups)
+    {
+        found += dictionary[path] != nil;
+    }
+    const uint64_t dictionaryLookup = DiffusionTestNow() - start;
+    XCTAssertEqual(found, topicCount);
+
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"pathIndex.nodes" value:index.nodeCount unit:@"nodes"];
+    [suite report:@"pathIndex.segments" value:index.segmentCount unit:@"segments"];
+    [suite report:@"pathIndex.footprint" value:(double)indexFootprint / topicCount unit:@"bytes/topic"];
+    [suite report:@"pathIndex.allocated" value:(double)index.memoryUsage / topicCount unit:@"bytes/topic"];
+    [suite report:@"pathIndex.lookup" value:(double)indexLookup / topicCount unit:@"ns"];
+    [suite report:@"pathIndex.dictionary.footprint" value:(double)dictionaryFootprint / topicCount unit:@"bytes/topic"];
+    [suite report:@"pathIndex.dictionary.lookup" value:(double)dictionaryLookup / topicCount unit:@"ns"];
+}
+
+@end
@@ -0,0 +1,174 @@
+//
+//  DiffusionTopicSelectorMatcherTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 28/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+@import Diffusion;
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTopicSelectorMatcher.h"
+
+@interface DiffusionTopicSelectorMatcherTests : XCTestCase
+
+@end
+
+@implementation DiffusionTopicSelectorMatcherTests
+
+static NSArray<NSString *> *_TopicPaths(void)
+{
+    NSMutableArray<NSString *> *const paths = [NSMutableArray array];
+    for (NSString *sport in @[@"Football", @"Tennis", @"Golf"])
+    {
+        [paths addObject:[NSString stringWithFormat:@"Demos/Sportsbook/%@", sport]];
+        for (NSString *country in @[@"England", @"Spain", @"France"])
+        {
+            NSString *const base = [NSString stringWithFormat:@"Demos/Sportsbook/%@/%@", sport, country];
+            [paths addObject:base];
+            for (NSUInteger fixture = 0; fixture < 4; fixture++)
+            {
+                [paths addObject:[NSString stringWithFormat:@"%@/Fixture%lu", base, (unsigned long)fixture]];
+                [paths addObject:[NSString stringWithFormat:@"%@/Fixture%lu/Odds", base, (unsigned long)fixture]];
+            }
+        }
+    }
+    [paths addObjectsFromArray:@[@"Demos", @"Demos/Sportsbook", @"Other/Football/England", @"DemosExtra/Football"]];
+    return paths;
+}
+
+// path, split path and full path selectors with every qualifier, built from the same vocabulary as the paths
+static NSArray<NSString *> *_Selectors(void)
+{
+    NSArray<NSString *> *const bases = @[@">Demos", @">Demos/Sportsbook", @">Demos/Sportsbook/Football/England",
+                                         @">Demos/Sportsbook/Tennis/Spain/Fixture2", @"Demos/Sportsbook/Golf", @">Other",
+                                         @"?Demos/Sportsbook/.*/England", @"?Demos/.*/Football/[ES].*", @"?Demos/Sportsbook/(Tennis|Golf)/.*/Fixture[0-2]",
+                                         @"?.*", @"?Demos/Sportsbook/.*/.*/.*/Odds",
+                                         @"*Demos/Sportsbook/.*/England", @"*Demos/.*Fixture1.*", @"*.*/Odds", @"*Demos"];
+    NSMutableArray<NSString *> *const selectors = [NSMutableArray array];
+    for (NSString *base in bases)
+    {
+        [selectors addObject:base];
+        [selectors addObject:[base stringByAppendingString:@"/"]];
+        [selectors addObject:[base stringByAppendingString:@"//"]];
+    }
+    [selectors addObject:@"#>Demos/Sportsbook/Golf////?Demos/Sportsbook/Tennis/.*"];
+    return selectors;
+}
+
+
+- (void)testAgreesWithDiffusion {
+    NSArray<NSString *> *const selectors = _Selectors();
+    NSArray<NSString *> *const paths = _TopicPaths();
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:selectors];
+    XCTAssertEqual(matcher.invalidSelectors.count, 0u);
+
+    for (NSString *path in paths)
+    {
+        NSIndexSet *const matches = [matcher indexesOfSelectorsMatchingTopicPath:path];
+        [selectors enumerateObjectsUsingBlock:^(NSString *selector, NSUInteger index, BOOL *stop) {
+            const BOOL expected = [[PTDiffusionTopicSelector topicSelectorWithExpression:selector] selectsTopicPath:path];
+            XCTAssertEqual([matches containsIndex:index], expected, @"%@ selecting %@", selector, path);
+        }];
+    }
+}
+
+- (void)testQualifiers {
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:@[@">Demos/A", @">Demos/A//", @">Demos/A/"]];
+    XCTAssertEqualObjects([matcher indexesOfSelectorsMatchingTopicPath:@"Demos/A"], ([NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)]));
+    XCTAssertEqualObjects([matcher indexesOfSelectorsMatchingTopicPath:@"Demos/A/B"], ([NSIndexSet indexSetWithIndexesInRange:NSMakeRange(1, 2)]));
+    XCTAssertEqual([matcher indexesOfSelectorsMatchingTopicPath:@"Demos"].count, 0u);
+    XCTAssertEqual([matcher indexesOfSelectorsMatchingTopicPath:@"Demos/AB"].count, 0u);
+}
+
+- (void)testPathsBeyondASCII {
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:@[@">Café/Menu", @"?Ca.é/M.*", @"?.*/😀", @"*Café/.*", @"?😀/Caf."]];
+    NSMutableIndexSet *const menu = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)];
+    [menu addIndex:3];
+    XCTAssertEqualObjects([matcher indexesOfSelectorsMatchingTopicPath:@"Café/Menu"], menu);
+    XCTAssertEqualObjects([matcher indexesOfSelectorsMatchingTopicPath:@"Café/😀"], ([NSIndexSet indexSetWithIndexesInRange:NSMakeRange(2, 2)]));
+    // the segments after a character taking two UTF-16 units are still handed to the expressions whole
+    XCTAssertEqualObjects([matcher indexesOfSelectorsMatchingTopicPath:@"😀/Café"], [NSIndexSet indexSetWithIndex:4]);
+    XCTAssertFalse([matcher anySelectorMatchesTopicPath:@"😀/Café/Menu"]);
+    XCTAssertTrue([matcher anySelectorMatchesTopicPath:@"/Café//Menu/"]);
+}
+
+- (void)testSelectorSetWithAnInvalidPartNeverMatches {
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:@[@"#>Demos/A////?Demos/[", @"#>Demos/A////"]];
+    XCTAssertEqualObjects(matcher.invalidSelectors, ([NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)]));
+    XCTAssertFalse([matcher anySelectorMatchesTopicPath:@"Demos/A"]);
+}
+
+/**
+
+    Routing an update to its handlers with 1k selectors: the compiled matcher against asking every selector in turn.
+
+ */
+- (void)testBenchmarkThousandSelectors {
+    const NSUInteger selectorCount = 1000;
+    NSMutableArray<NSString *> *const selectors = [NSMutableArray arrayWithCapacity:selectorCount];
+    for (NSUInteger i = 0; i < selectorCount; i++)
+    {
+        switch (i % 20)
+        {
+            case 0:
+                [selectors addObject:[NSString stringWithFormat:@"*Demos/Sportsbook/Sport%lu/.*/Odds", (unsigned long)(i % 10)]];
+                break;
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 5:
+                [selectors addObject:[NSString stringWithFormat:@"?Demos/Sportsbook/Sport%lu/.*/Fixture%lu//", (unsigned long)(i % 10), (unsigned long)(i % 100)]];
+                break;
+            default:
+                [selectors addObject:[NSString stringWithFormat:@">Demos/Sportsbook/Sport%lu/Competition%lu/Fixture%lu//", (unsigned long)(i % 10), (unsigned long)(i % 50), (unsigned long)i]];
+                break;
+        }
+    }
+    NSMutableArray<NSString *> *const paths = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 2000; i++)
+    {
+        [paths addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Sport%lu/Competition%lu/Fixture%lu/Odds", (unsigned long)(i % 10), (unsigned long)(i % 50), (unsigned long)(i % 1000)]];
+    }
+
+    uint64_t start = DiffusionTestNow();
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:selectors];
+    const uint64_t compile = DiffusionTestNow() - start;
+
+    start = DiffusionTestNow();
+    NSUInteger compiledMatches = 0;
+    for (NSString *path in paths)
+    {
+        compiledMatches += [matcher indexesOfSelectorsMatchingTopicPath:path].count;
+    }
+    const uint64_t compiled = DiffusionTestNow() - start;
+
+    NSMutableArray<PTDiffusionTopicSelector *> *const topicSelectors = [NSMutableArray arrayWithCapacity:selectorCount];
+    for (NSString *selector in selectors)
+    {
+        [topicSelectors addObject:[PTDiffusionTopicSelector topicSelectorWithExpression:selector]];
+    }
+    start = DiffusionTestNow();
+    NSUInteger linearMatches = 0;
+    for (NSString *path in paths)
+    {
+        for (PTDiffusionTopicSelector *selector in topicSelectors)
+        {
+            linearMatches += [selector selectsTopicPath:path];
+        }
+    }
+    const uint64_t linear = DiffusionTestNow() - start;
+
+    XCTAssertEqual(compiledMatches, linearMatches);
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"selectorMatcher.compile" value:compile / 1e6 unit:@"ms"];
+    [suite report:@"selectorMatcher.compiled" value:compiled / 1e3 / paths.count unit:@"us/update"];
+    [suite report:@"selectorMatcher.selectsTopicPath" value:linear / 1e3 / paths.count unit:@"us/update"];
+}
+
+@end
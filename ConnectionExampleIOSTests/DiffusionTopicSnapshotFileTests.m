@@ -0,0 +1,154 @@
+//
+//  DiffusionTopicSnapshotFileTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 26/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTopicSnapshotFile.h"
+
+@interface DiffusionTopicSnapshotFileTests : XCTestCase
+
+@end
+
+@implementation DiffusionTopicSnapshotFileTests
+
+static NSArray<DiffusionTopicValue *> *_Values(NSUInteger count)
+{
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    NSMutableArray<DiffusionTopicValue *> *const values = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSString *const path = [NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i];
+        NSData *const data = [[NSString stringWithFormat:@"{\"home\":%lu.5,\"away\":2.25}", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+        [values addObject:[[DiffusionTopicValue alloc] initWithTopicPath:path data:data specification:specification]];
+    }
+    return values;
+}
+
+
+- (NSURL *)temporaryURL {
+    NSString *const name = [NSString stringWithFormat:@"DiffusionTopicSnapshotFileTests-%@.bin", NSUUID.UUID.UUIDString];
+    return [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+- (void)testRoundTrip {
+    NSURL *const url = [self temporaryURL];
+    NSArray<DiffusionTopicValue *> *const written = _Values(100);
+    NSError *error = nil;
+    XCTAssertTrue([DiffusionTopicSnapshotFile writeValues:written toURL:url error:&error], @"%@", error);
+
+    DiffusionTopicSnapshotFile *const snapshot = [DiffusionTopicSnapshotFile snapshotWithContentsOfURL:url error:&error];
+    XCTAssertNotNil(snapshot, @"%@", error);
+    XCTAssertEqual(snapshot.count, 100u);
+
+    NSArray<DiffusionTopicValue *> *const read = snapshot.values;
+    XCTAssertEqual(read.count, written.count);
+    for (NSUInteger i = 0; i < read.count; i++)
+    {
+        XCTAssertEqualObjects(read[i].topicPath, written[i].topicPath);
+        XCTAssertEqualObjects(read[i].data, written[i].data);
+        XCTAssertEqual(read[i].specification.type, PTDiffusionTopicType_JSON);
+        XCTAssertTrue(read[i].isStale);
+    }
+
+    [NSFileManager.defaultManager removeItemAtURL:url error:nil];
+}
+
+- (void)testRejectsInvalidFiles {
+    NSURL *const url = [self temporaryURL];
+    NSError *error = nil;
+
+    [[@"not a snapshot at all" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:url atomically:YES];
+    XCTAssertNil([DiffusionTopicSnapshotFile snapshotWithContentsOfURL:url error:&error]);
+    XCTAssertEqualObjects(error.domain, DiffusionTopicSnapshotErrorDomain);
+
+    // a valid file cut short
+    XCTAssertTrue([DiffusionTopicSnapshotFile writeValues:_Values(10) toURL:url error:nil]);
+    NSData *const full = [NSData dataWithContentsOfURL:url];
+    [[full subdataWithRange:NSMakeRange(0, full.length - 8)] writeToURL:url atomically:YES];
+    XCTAssertNil([DiffusionTopicSnapshotFile snapshotWithContentsOfURL:url error:&error]);
+
+    [NSFileManager.defaultManager removeItemAtURL:url error:nil];
+}
+
+- (void)testLiveValuesAreNotReplacedBySnapshot {
+    NSURL *const url = [self temporaryURL];
+    NSArray<DiffusionTopicValue *> *const values = _Values(10);
+    XCTAssertTrue([DiffusionTopicSnapshotFile writeValues:values toURL:url error:nil]);
+
+    DiffusionTopicValueCache *const cache = [[DiffusionTopicValueCache alloc] init];
+    [cache storeValue:values[0]];
+    [cache storeValues:[DiffusionTopicSnapshotFile snapshotWithContentsOfURL:url error:nil].values replacingExisting:NO];
+
+    XCTAssertFalse([cache valueForTopicPath:values[0].topicPath].isStale);
+    XCTAssertTrue([cache valueForTopicPath:values[1].topicPath].isStale);
+    XCTAssertEqual(cache.count, 10u);
+
+    [NSFileManager.defaultManager removeItemAtURL:url error:nil];
+}
+
+/**
+
+    Time to first render at 1k, 10k and 100k topics: the time until the 20 topics of a screen can be read from the
+    value cache.
+
+    With a snapshot this is mapping the file, seeding the cache and reading the screen. Without one, the screen waits
+    for a session to open and for the initial values to arrive: the session open and subscription round trips are
+    modelled by a fixed 250ms (a fast mobile network), plus the real cost of storing every initial value.
+
+ */
+- (void)testBenchmarkTimeToFirstRender {
+    const uint64_t modelledSessionOpen = 250 * NSEC_PER_MSEC;
+    const NSUInteger screenTopics = 20;
+
+    for (NSNumber *topicCount in @[@1000, @10000, @100000])
+    {
+        const NSUInteger count = topicCount.unsignedIntegerValue;
+        NSArray<DiffusionTopicValue *> *const values = _Values(count);
+        NSURL *const url = [self temporaryURL];
+
+        uint64_t start = DiffusionTestNow();
+        XCTAssertTrue([DiffusionTopicSnapshotFile writeValues:values toURL:url error:nil]);
+        const uint64_t writeTime = DiffusionTestNow() - start;
+        NSNumber *fileSize = nil;
+        [url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+
+        // with a snapshot
+        start = DiffusionTestNow();
+        DiffusionTopicValueCache *cache = [[DiffusionTopicValueCache alloc] init];
+        [cache storeValues:[DiffusionTopicSnapshotFile snapshotWithContentsOfURL:url error:nil].values replacingExisting:NO];
+        NSUInteger rendered = 0;
+        for (NSUInteger i = 0; i < screenTopics; i++)
+        {
+            rendered += [cache valueForTopicPath:values[i].topicPath].data.length ? 1 : 0;
+        }
+        const uint64_t withSnapshot = DiffusionTestNow() - start;
+        XCTAssertEqual(rendered, screenTopics);
+
+        // without: initial values are delivered one update at a time after the session opened
+        start = DiffusionTestNow();
+        cache = [[DiffusionTopicValueCache alloc] init];
+        for (DiffusionTopicValue *value in values)
+        {
+            [cache storeValue:value];
+        }
+        const uint64_t withoutSnapshot = modelledSessionOpen + (DiffusionTestNow() - start);
+
+        DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+        NSString *const name = [NSString stringWithFormat:@"snapshot.%@", topicCount];
+        [suite report:[name stringByAppendingString:@".file"] value:fileSize.doubleValue / 1024 unit:@"KB"];
+        [suite report:[name stringByAppendingString:@".write"] value:writeTime / 1e6 unit:@"ms"];
+        [suite report:[name stringByAppendingString:@".firstRender"] value:withSnapshot / 1e6 unit:@"ms"];
+        [suite report:[name stringByAppendingString:@".firstRenderWithout"] value:withoutSnapshot / 1e6 unit:@"ms"];
+
+        [NSFileManager.defaultManager removeItemAtURL:url error:nil];
+    }
+}
+
+@end
@@ -0,0 +1,203 @@
+//
+//  DiffusionTopicValueCacheTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 25/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import <os/lock.h>
+#import <stdatomic.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionRandom.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTopicValueCache.h"
+
+@interface DiffusionTopicValueCacheTests : XCTestCase
+
+@end
+
+@implementation DiffusionTopicValueCacheTests
+
+- (void)testStoreAndRemove {
+    DiffusionTopicValueCache *const cache = [[DiffusionTopicValueCache alloc] initWithShardCount:4];
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    NSData *const first = [@"1" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *const second = [@"2" dataUsingEncoding:NSUTF8StringEncoding];
+
+    XCTAssertNil([cache valueForTopicPath:@"Demos/A"]);
+
+    [cache storeData:first specification:specification forTopicPath:@"Demos/A"];
+    [cache storeData:first specification:specification forTopicPath:@"Demos/B"];
+    XCTAssertEqualObjects([cache valueForTopicPath:@"Demos/A"].data, first);
+    XCTAssertEqual([cache valueForTopicPath:@"Demos/A"].specification.type, PTDiffusionTopicType_JSON);
+    XCTAssertEqual(cache.count, 2u);
+
+    // a value already read is not affected by later writes
+    DiffusionTopicValue *const read = [cache valueForTopicPath:@"Demos/A"];
+    [cache storeData:second specification:specification forTopicPath:@"Demos/A"];
+    XCTAssertEqualObjects(read.data, first);
+    XCTAssertEqualObjects([cache valueForTopicPath:@"Demos/A"].data, second);
+
+    [cache removeValueForTopicPath:@"Demos/A"];
+    XCTAssertNil([cache valueForTopicPath:@"Demos/A"]);
+    XCTAssertEqual(cache.count, 1u);
+
+    [cache removeAllValues];
+    XCTAssertEqual(cache.count, 0u);
+}
+
+- (void)testReplacedValuesAreReleasedWhileReadersKeepComing {
+    DiffusionTopicValueCache *const cache = [[DiffusionTopicValueCache alloc] initWithShardCount:1];
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    NSData *const data = [@"1" dataUsingEncoding:NSUTF8StringEncoding];
+
+    __weak DiffusionTopicValue *replaced = nil;
+    @autoreleasepool
+    {
+        DiffusionTopicValue *const first = [[DiffusionTopicValue alloc] initWithTopicPath:@"Demos/A" data:data specification:specification];
+        replaced = first;
+        [cache storeValue:first];
+    }
+
+    // readers never leave the shard empty, as on a busy screen
+    __block atomic_bool running = YES;
+    dispatch_group_t const group = dispatch_group_create();
+    for (NSUInteger reader = 0; reader < 4; reader++)
+    {
+        dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            while (atomic_load_explicit(&running, memory_order_relaxed))
+            {
+                @autoreleasepool
+                {
+                    [cache valueForTopicPath:@"Demos/A"];
+                }
+            }
+        });
+    }
+    for (NSUInteger i = 0; i < 100000; i++)
+    {
+        @autoreleasepool
+        {
+            [cache storeData:data specification:specification forTopicPath:i % 2 ? @"Demos/A" : @"Demos/B"];
+        }
+    }
+    XCTAssertLessThan(cache.retiredCount, 10000u);
+    atomic_store(&running, NO);
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    // without readers, two more writes release everything but what the last one replaced
+    [cache storeData:data specification:specification forTopicPath:@"Demos/A"];
+    [cache storeData:data specification:specification forTopicPath:@"Demos/A"];
+    XCTAssertLessThanOrEqual(cache.retiredCount, 1u);
+    XCTAssertNil(replaced);
+    XCTAssertEqual(cache.count, 2u);
+}
+
+/**
+
+    Reads/sec of 1, 2, 4 and 8 reader threads over 10k topics while one writer updates random topics as fast as it
+    can, for the cache and for a dictionary behind a single lock.
+
+ */
+- (void)testBenchmarkReadContention {
+    const NSUInteger topicCount = 10000;
+    const uint64_t duration = 250 * NSEC_PER_MSEC;
+
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON];
+    NSData *const data = [@"{\"price\":1.25}" dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableArray<NSString *> *const topics = [NSMutableArray arrayWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        [topics addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+
+    DiffusionTopicValueCache *const cache = [[DiffusionTopicValueCache alloc] init];
+    NSMutableDictionary<NSString *, DiffusionTopicValue *> *const locked = [NSMutableDictionary dictionary];
+    __block os_unfair_lock lock = OS_UNFAIR_LOCK_INIT;
+    for (NSString *topic in topics)
+    {
+        DiffusionTopicValue *const value = [[DiffusionTopicValue alloc] initWithTopicPath:topic data:data specification:specification];
+        [cache storeValue:value];
+        locked[topic] = value;
+    }
+
+    for (NSNumber *useCache in @[@YES, @NO])
+    {
+        for (NSNumber *readerCount in @[@1, @2, @4, @8])
+        {
+            __block atomic_bool running = YES;
+            __block atomic_ulong reads = 0;
+            __block NSUInteger writes = 0;
+            dispatch_group_t const group = dispatch_group_create();
+            dispatch_queue_t const queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+
+            for (NSUInteger reader = 0; reader < readerCount.unsignedIntegerValue; reader++)
+            {
+                dispatch_group_async(group, queue, ^{
+                    unsigned long count = 0;
+                    uint64_t random = reader + 1;
+                    while (atomic_load_explicit(&running, memory_order_relaxed))
+                    {
+                        NSString *const topic = topics[(NSUInteger)(DiffusionRandomNext(&random) * topicCount)];
+                        DiffusionTopicValue *value = nil;
+                        if (useCache.boolValue)
+                        {
+                            value = [cache valueForTopicPath:topic];
+                        }
+                        else
+                        {
+                            os_unfair_lock_lock(&lock);
+                            value = locked[topic];
+                            os_unfair_lock_unlock(&lock);
+                        }
+                        if (value)
+                        {
+                            count++;
+                        }
+                    }
+                    atomic_fetch_add(&reads, count);
+                });
+            }
+            dispatch_group_async(group, queue, ^{
+                uint64_t random = 104729u;
+                while (atomic_load_explicit(&running, memory_order_relaxed))
+                {
+                    NSString *const topic = topics[(NSUInteger)(DiffusionRandomNext(&random) * topicCount)];
+                    DiffusionTopicValue *const value = [[DiffusionTopicValue alloc] initWithTopicPath:topic data:data specification:specification];
+                    if (useCache.boolValue)
+                    {
+                        [cache storeValue:value];
+                    }
+                    else
+                    {
+                        os_unfair_lock_lock(&lock);
+                        locked[topic] = value;
+                        os_unfair_lock_unlock(&lock);
+                    }
+                    writes++;
+                }
+            });
+
+            const uint64_t start = DiffusionTestNow();
+            while (DiffusionTestNow() - start < duration)
+            {
+                usleep(1000);
+            }
+            atomic_store(&running, NO);
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+            const double seconds = (DiffusionTestNow() - start) / 1e9;
+
+            NSString *const name = [NSString stringWithFormat:@"valueCache.%@.%@", useCache.boolValue ? @"cache" : @"lockedDictionary", readerCount];
+            [DiffusionBenchmarkSuite.sharedSuite report:[name stringByAppendingString:@".reads"] value:atomic_load(&reads) / seconds unit:@"reads/s"];
+            [DiffusionBenchmarkSuite.sharedSuite report:[name stringByAppendingString:@".writes"] value:writes / seconds unit:@"writes/s"];
+        }
+    }
+
+    XCTAssertEqual(cache.count, topicCount);
+}
+
+@end
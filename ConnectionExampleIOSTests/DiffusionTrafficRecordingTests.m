@@ -0,0 +1,194 @@
+//
+//  DiffusionTrafficRecordingTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionLog.h"
+#import "DiffusionManager.h"
+#import "DiffusionStandInServer.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionTrafficRecorder.h"
+#import "DiffusionTrafficReplayer.h"
+
+@interface DiffusionTrafficRecordingTests : XCTestCase
+
+@end
+
+@implementation DiffusionTrafficRecordingTests
+{
+    NSURL *_url;
+}
+
+- (void)setUp {
+    _url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown {
+    [NSFileManager.defaultManager removeItemAtURL:_url error:nil];
+}
+
+// plays a stand-in scenario into a manager that records what it receives
+- (DiffusionManager *)recordScenario:(DiffusionStandInScenario *)scenario {
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    NSError *error = nil;
+    manager.trafficRecorder = [[DiffusionTrafficRecorder alloc] initWithURL:_url topicIndex:manager.topicIndex error:&error];
+    XCTAssertNotNil(manager.trafficRecorder, @"%@", error);
+    [manager subscribeTo:[NSString stringWithFormat:@">%@//", scenario.topicPrefix]];
+    [[[DiffusionStandInServer alloc] initWithScenario:scenario manager:manager] runToCompletion];
+    [manager.trafficRecorder close];
+    return manager;
+}
+
+- (void)testReplayReproducesWhatTheManagerReceived {
+    DiffusionStandInScenario *const scenario = [[DiffusionStandInScenario alloc] initWithDictionary:@{@"topicCount": @10,
+                                                                                                       @"topicType": @"binary",
+                                                                                                       @"updatesPerSecond": @100,
+                                                                                                       @"duration": @1,
+                                                                                                       @"pingInterval": @0.1,
+                                                                                                       @"outages": @[@{@"at": @0.5, @"duration": @0.25}]}
+                                                                                              error:nil];
+    DiffusionManager *const recorded = [self recordScenario:scenario];
+    // definitions, subscriptions, updates, pings and the two state changes of the outage
+    XCTAssertEqual(recorded.trafficRecorder.recordCount, 10u + 10u + 75u + 9u + 2u);
+
+    DiffusionManager *const replayed = [[DiffusionManager alloc] init];
+    NSError *error = nil;
+    DiffusionTrafficReplayer *const replayer = [[DiffusionTrafficReplayer alloc] initWithURL:_url manager:replayed error:&error];
+    XCTAssertNotNil(replayer, @"%@", error);
+    XCTAssertEqual(replayer.recordCount, recorded.trafficRecorder.recordCount);
+    [replayer replayToEnd];
+
+    XCTAssertTrue(replayer.finished);
+    XCTAssertEqual(replayer.replayedUpdateCount, 75u);
+    XCTAssertEqual(replayed.metrics.updateCount, recorded.metrics.updateCount);
+    XCTAssertEqual(replayed.metrics.byteCount, recorded.metrics.byteCount);
+    XCTAssertEqual(replayed.metrics.reconnectCount, 1u);
+    XCTAssertEqual([replayed.metrics.pingRoundTripTime snapshot].count, 6u);
+    XCTAssertEqual(replayed.valueCache.count, 10u);
+    NSString *const topicPath = [scenario topicPathAtIndex:3];
+    XCTAssertEqualObjects([replayed.valueCache valueForTopicPath:topicPath].data, [recorded.valueCache valueForTopicPath:topicPath].data);
+}
+
+- (void)testRecordsAndReplaysPrimitiveTopics {
+    DiffusionManager *const recorded = [[DiffusionManager alloc] init];
+    recorded.trafficRecorder = [[DiffusionTrafficRecorder alloc] initWithURL:_url topicIndex:recorded.topicIndex error:nil];
+    NSDictionary<NSNumber *, PTDiffusionValueStream *> *const streams = [recorded.streamDispatcher makeStreamsByTopicType];
+    id const dispatcher = recorded.streamDispatcher;
+    [(id<PTDiffusionStringValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_String)] didUpdateTopicPath:@"Demos/Name"
+                                                            specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_String]
+                                                                oldString:nil newString:@"Arsenal"];
+    [(id<PTDiffusionNumberValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_Int64)] didUpdateTopicPath:@"Demos/Count"
+                                                            specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Int64]
+                                                                oldNumber:nil newNumber:@(-7)];
+    [(id<PTDiffusionNumberValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_Double)] didUpdateTopicPath:@"Demos/Price"
+                                                            specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Double]
+                                                                oldNumber:nil newNumber:@(2.5)];
+    [recorded.trafficRecorder close];
+    // a definition and an update per topic
+    XCTAssertEqual(recorded.trafficRecorder.recordCount, 6u);
+
+    DiffusionManager *const replayed = [[DiffusionManager alloc] init];
+    __block NSString *name = nil;
+    __block int64_t count = 0;
+    __block double price = 0;
+    replayed.streamDispatcher.stringHandler = ^(NSString *topicPath, NSString *value) {
+        name = value;
+    };
+    replayed.streamDispatcher.int64Handler = ^(NSString *topicPath, int64_t value) {
+        count = value;
+    };
+    replayed.streamDispatcher.doubleHandler = ^(NSString *topicPath, double value) {
+        price = value;
+    };
+    DiffusionTrafficReplayer *const replayer = [[DiffusionTrafficReplayer alloc] initWithURL:_url manager:replayed error:nil];
+    [replayer replayToEnd];
+
+    XCTAssertEqual(replayer.replayedUpdateCount, 3u);
+    XCTAssertEqualObjects(name, @"Arsenal");
+    XCTAssertEqual(count, -7);
+    XCTAssertEqual(price, 2.5);
+    XCTAssertEqual(replayed.metrics.updateCount, 3u);
+    XCTAssertEqualObjects([replayed.valueCache valueForTopicPath:@"Demos/Count"].data, [DiffusionTypedStreamDispatcher dataWithInt64:-7]);
+}
+
+- (void)testReplaysUpToATime {
+    DiffusionTopicPathIndex *const index = [[DiffusionTopicPathIndex alloc] init];
+    DiffusionTrafficRecorder *const recorder = [[DiffusionTrafficRecorder alloc] initWithURL:_url topicIndex:index error:nil];
+    [recorder recordSubscriptionToTopicPath:@"A/B" topicType:PTDiffusionTopicType_Binary];
+    usleep(100000);
+    [recorder recordUpdateOfTopicPath:@"A/B" topicType:PTDiffusionTopicType_Binary value:[@"value" dataUsingEncoding:NSUTF8StringEncoding]];
+    [recorder close];
+
+    DiffusionManager *const manager = [[DiffusionManager alloc] init];
+    DiffusionTrafficReplayer *const replayer = [[DiffusionTrafficReplayer alloc] initWithURL:_url manager:manager error:nil];
+    XCTAssertGreaterThanOrEqual(replayer.duration, 0.1);
+
+    [replayer replayUntilTime:0.05];
+    XCTAssertEqual(replayer.replayedCount, 2u);
+    XCTAssertFalse(replayer.finished);
+    XCTAssertNil([manager.valueCache valueForTopicPath:@"A/B"]);
+
+    // twice as fast as recorded
+    XCTestExpectation *const finished = [self expectationWithDescription:@"finished"];
+    const uint64_t start = DiffusionTestNow();
+    [replayer startAtSpeed:2 completionHandler:^{
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertGreaterThanOrEqual((DiffusionTestNow() - start) / (double)NSEC_PER_SEC, 0.02);
+    XCTAssertEqualObjects([manager.valueCache valueForTopicPath:@"A/B"].data, [@"value" dataUsingEncoding:NSUTF8StringEncoding]);
+
+    // a rewound replay starts again from the first record
+    [replayer rewind];
+    XCTAssertFalse(replayer.finished);
+    [replayer replayToEnd];
+    XCTAssertEqual(replayer.replayedUpdateCount, 2u);
+}
+
+- (void)testRejectsDamagedRecordings {
+    DiffusionTrafficRecorder *const recorder = [[DiffusionTrafficRecorder alloc] initWithURL:_url topicIndex:[[DiffusionTopicPathIndex alloc] init] error:nil];
+    [recorder recordUpdateOfTopicPath:@"A/B" topicType:PTDiffusionTopicType_Binary value:[NSMutableData dataWithLength:100]];
+    [recorder close];
+
+    NSData *const data = [NSData dataWithContentsOfURL:_url];
+    [[data subdataWithRange:NSMakeRange(0, data.length - 10)] writeToURL:_url atomically:YES];
+    NSError *error = nil;
+    XCTAssertNil([[DiffusionTrafficReplayer alloc] initWithURL:_url manager:[[DiffusionManager alloc] init] error:&error]);
+    XCTAssertEqualObjects(error.domain, DiffusionTrafficReplayErrorDomain);
+    XCTAssertEqual(error.code, DiffusionTrafficReplayErrorInvalidFile);
+}
+
+- (void)testBenchmarkReplayThroughput {
+    DiffusionTestUseLogLevel(self, DiffusionLogLevelInfo);
+
+    NSURL *const scenarioURL = [[NSBundle bundleForClass:self.class] URLForResource:@"StandInFlapping" withExtension:@"json"];
+    DiffusionStandInScenario *const scenario = [DiffusionStandInScenario scenarioWithContentsOfURL:scenarioURL error:nil];
+    DiffusionManager *const recorded = [self recordScenario:scenario];
+
+    DiffusionManager *const replayed = [[DiffusionManager alloc] init];
+    DiffusionTrafficReplayer *const replayer = [[DiffusionTrafficReplayer alloc] initWithURL:_url manager:replayed error:nil];
+    uint64_t start = DiffusionTestNow();
+    [replayer replayToEnd];
+    const uint64_t first = DiffusionTestNow() - start;
+
+    // the same file replays into the same calls
+    [replayer rewind];
+    start = DiffusionTestNow();
+    [replayer replayToEnd];
+    const uint64_t second = DiffusionTestNow() - start;
+
+    XCTAssertEqual(replayed.metrics.updateCount, 2 * recorded.metrics.updateCount);
+    const double updates = recorded.metrics.updateCount;
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"replay.recordedBytesPerUpdate" value:recorded.trafficRecorder.byteCount / updates unit:@"bytes"];
+    [suite report:@"replay.first" value:updates / (first / 1e9) unit:@"updates/s"];
+    [suite report:@"replay.second" value:updates / (second / 1e9) unit:@"updates/s"];
+}
+
+@end
@@ -0,0 +1,173 @@
+//
+//  DiffusionTypedStreamDispatcherTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 29/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionTypedStreamDispatcher.h"
+
+@interface DiffusionTypedStreamDispatcherTests : XCTestCase <DiffusionTypedStreamDispatcherDelegate>
+
+@property(nonatomic) NSMutableArray<NSString *> *updatedTopicPaths;
+// NSData for the byte based types, NSString or NSNumber for the primitive ones
+@property(nonatomic) NSMutableArray<id> *updatedValues;
+@property(nonatomic) NSString *rejectedTopicPath;
+
+@end
+
+@implementation DiffusionTypedStreamDispatcherTests
+
+- (void)setUp {
+    self.updatedTopicPaths = [NSMutableArray array];
+    self.updatedValues = [NSMutableArray array];
+    self.rejectedTopicPath = nil;
+}
+
+- (void)testRoutesEachTypeToItsHandler {
+    DiffusionTypedStreamDispatcher *const dispatcher = [[DiffusionTypedStreamDispatcher alloc] init];
+    dispatcher.delegate = self;
+    XCTAssertEqual([dispatcher makeStreams].count, 6u);
+    NSDictionary<NSNumber *, PTDiffusionValueStream *> *const streams = [dispatcher makeStreamsByTopicType];
+
+    __block int64_t int64Value = 0;
+    __block double doubleValue = 0;
+    __block NSString *stringValue = nil;
+    __block PTDiffusionBytes *JSONValue = nil;
+    dispatcher.int64Handler = ^(NSString *topicPath, int64_t value) {
+        int64Value = value;
+    };
+    dispatcher.doubleHandler = ^(NSString *topicPath, double value) {
+        doubleValue = value;
+    };
+    dispatcher.stringHandler = ^(NSString *topicPath, NSString *value) {
+        stringValue = value;
+    };
+    dispatcher.JSONHandler = ^(NSString *topicPath, PTDiffusionTopicSpecification *specification, PTDiffusionBytes *value) {
+        JSONValue = value;
+    };
+
+    id<PTDiffusionNumberValueStreamDelegate> const numbers = (id<PTDiffusionNumberValueStreamDelegate>)dispatcher;
+    [numbers diffusionStream:streams[@(PTDiffusionTopicType_Int64)] didUpdateTopicPath:@"Demos/Count"
+               specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Int64]
+                   oldNumber:nil newNumber:@(9007199254740993LL)];
+    [numbers diffusionStream:streams[@(PTDiffusionTopicType_Double)] didUpdateTopicPath:@"Demos/Price"
+               specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Double]
+                   oldNumber:nil newNumber:@(1.25)];
+    [(id<PTDiffusionStringValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_String)] didUpdateTopicPath:@"Demos/Name"
+                                                            specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_String]
+                                                                oldString:nil newString:@"Arsenal"];
+    // CBOR, as Diffusion carries JSON: an empty map
+    PTDiffusionJSON *const json = [[PTDiffusionJSON alloc] initWithData:[NSData dataWithBytes:(const uint8_t[]){0xA0} length:1]];
+    [(id<PTDiffusionJSONValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_JSON)] didUpdateTopicPath:@"Demos/Match"
+                                                          specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_JSON]
+                                                                oldJSON:nil newJSON:json];
+
+    XCTAssertEqual(int64Value, 9007199254740993LL);
+    XCTAssertEqual(doubleValue, 1.25);
+    XCTAssertEqualObjects(stringValue, @"Arsenal");
+    XCTAssertEqual(JSONValue, json);
+    // the delegate sees every type, not only the byte based ones
+    XCTAssertEqualObjects(self.updatedTopicPaths, (@[@"Demos/Count", @"Demos/Price", @"Demos/Name", @"Demos/Match"]));
+    XCTAssertEqual(dispatcher.updateCount, 4u);
+}
+
+- (void)testPrimitiveValuesReachTheDelegateTyped {
+    DiffusionTypedStreamDispatcher *const dispatcher = [[DiffusionTypedStreamDispatcher alloc] init];
+    dispatcher.delegate = self;
+    NSDictionary<NSNumber *, PTDiffusionValueStream *> *const streams = [dispatcher makeStreamsByTopicType];
+
+    id<PTDiffusionNumberValueStreamDelegate> const numbers = (id<PTDiffusionNumberValueStreamDelegate>)dispatcher;
+    [numbers diffusionStream:streams[@(PTDiffusionTopicType_Int64)] didUpdateTopicPath:@"Demos/Count"
+               specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Int64]
+                   oldNumber:nil newNumber:@(-500)];
+    [(id<PTDiffusionStringValueStreamDelegate>)dispatcher diffusionStream:streams[@(PTDiffusionTopicType_String)] didUpdateTopicPath:@"Demos/Name"
+                                                            specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_String]
+                                                                oldString:nil newString:@"Tottenham"];
+    [numbers diffusionStream:streams[@(PTDiffusionTopicType_Double)] didUpdateTopicPath:@"Demos/Price"
+               specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Double]
+                   oldNumber:nil newNumber:@(-0.5)];
+    // no value: CBOR null, as bytes
+    [numbers diffusionStream:streams[@(PTDiffusionTopicType_Double)] didUpdateTopicPath:@"Demos/Price"
+               specification:[[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Double]
+                   oldNumber:@(-0.5) newNumber:nil];
+
+    XCTAssertEqualObjects(self.updatedValues, (@[@(-500), @"Tottenham", @(-0.5), [NSData dataWithBytes:(const uint8_t[]){0xF6} length:1]]));
+    XCTAssertEqualObjects([DiffusionTypedStreamDispatcher dataWithInt64:-500], ([NSData dataWithBytes:(const uint8_t[]){0x39, 0x01, 0xF3} length:3]));
+}
+
+- (void)testPrimitiveEncodingRoundTrips {
+    for (NSNumber *value in @[@0, @23, @24, @255, @65536, @(INT64_MAX), @(-1), @(-25), @(INT64_MIN)])
+    {
+        XCTAssertEqualObjects([DiffusionTypedStreamDispatcher numberWithData:[DiffusionTypedStreamDispatcher dataWithInt64:value.longLongValue]], value);
+    }
+    XCTAssertEqualObjects([DiffusionTypedStreamDispatcher numberWithData:[DiffusionTypedStreamDispatcher dataWithDouble:-1.5e300]], @(-1.5e300));
+    // smaller floats, as other clients may send them
+    XCTAssertEqualObjects([DiffusionTypedStreamDispatcher numberWithData:[NSData dataWithBytes:(const uint8_t[]){0xF9, 0x3E, 0x00} length:3]], @(1.5));
+    XCTAssertEqualObjects([DiffusionTypedStreamDispatcher numberWithData:[NSData dataWithBytes:(const uint8_t[]){0xFA, 0x47, 0xC3, 0x50, 0x00} length:5]], @(100000.0));
+
+    NSString *const longString = [@"" stringByPaddingToLength:300 withString:@"é" startingAtIndex:0];
+    XCTAssertEqualObjects([DiffusionTypedStreamDispatcher stringWithData:[DiffusionTypedStreamDispatcher dataWithString:longString]], longString);
+    XCTAssertNil([DiffusionTypedStreamDispatcher stringWithData:[DiffusionTypedStreamDispatcher dataWithString:nil]]);
+    XCTAssertNil([DiffusionTypedStreamDispatcher numberWithData:[DiffusionTypedStreamDispatcher dataWithNumber:nil topicType:PTDiffusionTopicType_Double]]);
+    // truncated
+    XCTAssertNil([DiffusionTypedStreamDispatcher stringWithData:[NSData dataWithBytes:(const uint8_t[]){0x65, 'a'} length:2]]);
+}
+
+- (void)testDelegateCanDropUpdates {
+    DiffusionTypedStreamDispatcher *const dispatcher = [[DiffusionTypedStreamDispatcher alloc] init];
+    dispatcher.delegate = self;
+    self.rejectedTopicPath = @"Demos/Count";
+    __block NSUInteger delivered = 0;
+    dispatcher.int64Handler = ^(NSString *topicPath, int64_t value) {
+        delivered++;
+    };
+
+    PTDiffusionValueStream *const stream = [dispatcher makeStreamsByTopicType][@(PTDiffusionTopicType_Int64)];
+    PTDiffusionTopicSpecification *const specification = [[PTDiffusionTopicSpecification alloc] initWithType:PTDiffusionTopicType_Int64];
+    id<PTDiffusionNumberValueStreamDelegate> const numbers = (id<PTDiffusionNumberValueStreamDelegate>)dispatcher;
+    [numbers diffusionStream:stream didUpdateTopicPath:@"Demos/Count" specification:specification oldNumber:nil newNumber:@1];
+    [numbers diffusionStream:stream didUpdateTopicPath:@"Demos/Other" specification:specification oldNumber:nil newNumber:@2];
+    // no value, nothing to hand over
+    [numbers diffusionStream:stream didUpdateTopicPath:@"Demos/Other" specification:specification oldNumber:@2 newNumber:nil];
+
+    XCTAssertEqual(delivered, 1u);
+}
+
+
+#pragma mark - DiffusionTypedStreamDispatcherDelegate
+
+- (BOOL)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher shouldDeliverTopicPath:(NSString *)topicPath fromStream:(PTDiffusionStream *)stream {
+    return ![topicPath isEqualToString:self.rejectedTopicPath];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didSubscribeToTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification fromStream:(PTDiffusionStream *)stream {
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUnsubscribeFromTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification reason:(PTDiffusionTopicUnsubscriptionReason)reason fromStream:(PTDiffusionStream *)stream {
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification bytes:(PTDiffusionBytes *)value {
+    [self.updatedTopicPaths addObject:topicPath];
+    [self.updatedValues addObject:value.data];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification stringValue:(NSString *)value {
+    [self.updatedTopicPaths addObject:topicPath];
+    [self.updatedValues addObject:value ?: [NSNull null]];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification int64Value:(int64_t)value {
+    [self.updatedTopicPaths addObject:topicPath];
+    [self.updatedValues addObject:@(value)];
+}
+
+- (void)typedStreamDispatcher:(DiffusionTypedStreamDispatcher *)dispatcher didUpdateTopicPath:(NSString *)topicPath specification:(PTDiffusionTopicSpecification *)specification doubleValue:(double)value {
+    [self.updatedTopicPaths addObject:topicPath];
+    [self.updatedValues addObject:@(value)];
+}
+
+@end
@@ -0,0 +1,137 @@
+//
+//  DiffusionUpdateConflatorTests.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "DiffusionBenchmarkSuite.h"
+#import "DiffusionRandom.h"
+#import "DiffusionTestSupport.h"
+#import "DiffusionUpdateConflator.h"
+
+@interface DiffusionUpdateConflatorTests : XCTestCase
+
+@end
+
+@implementation DiffusionUpdateConflatorTests
+
+- (void)testOnlyTheLatestValueOfATopicIsDelivered {
+    DiffusionManualTickSource *const ticks = [[DiffusionManualTickSource alloc] init];
+    DiffusionUpdateConflator *const conflator = [[DiffusionUpdateConflator alloc] initWithTickSource:ticks];
+    NSMutableArray<NSDictionary<NSString *, id> *> *const batches = [NSMutableArray array];
+    [conflator addBatchHandler:^(NSDictionary<NSString *, id> *batch) {
+        [batches addObject:batch];
+    }];
+
+    ticks.currentTime = 1.0;
+    [conflator addValue:@1 forTopicPath:@"A/B"];
+    [conflator addValue:@2 forTopicPath:@"A/C"];
+    ticks.currentTime = 1.01;
+    [conflator addValue:@3 forTopicPath:@"A/B"];
+    [ticks tickAtTime:1.016];
+
+    XCTAssertEqual(batches.count, 1);
+    XCTAssertEqualObjects(batches[0], (@{@"A/B": @3, @"A/C": @2}));
+    XCTAssertEqual(conflator.receivedCount, 3);
+    XCTAssertEqual(conflator.deliveredCount, 2);
+    XCTAssertEqual(conflator.conflatedCount, 1);
+    // measured from the first value that was waiting
+    XCTAssertEqualWithAccuracy(conflator.maximumStaleness, 0.016, 1e-9);
+
+    // nothing pending, nothing delivered
+    [ticks tickAtTime:1.032];
+    XCTAssertEqual(batches.count, 1);
+    XCTAssertEqual(conflator.batchCount, 1);
+}
+
+- (void)testTheTickSourceOnlyRunsWithHandlers {
+    DiffusionManualTickSource *const ticks = [[DiffusionManualTickSource alloc] init];
+    DiffusionUpdateConflator *const conflator = [[DiffusionUpdateConflator alloc] initWithTickSource:ticks];
+    __block NSUInteger delivered = 0;
+    id<NSObject> const token = [conflator addBatchHandler:^(NSDictionary<NSString *, id> *batch) {
+        delivered += batch.count;
+    }];
+
+    [conflator addValue:@1 forTopicPath:@"A/B"];
+    [ticks tickAtTime:1.0];
+    XCTAssertEqual(delivered, 1);
+
+    [conflator removeBatchHandler:token];
+    [conflator addValue:@2 forTopicPath:@"A/B"];
+    [ticks tickAtTime:2.0];
+    XCTAssertEqual(delivered, 1);
+}
+
+- (void)testBenchmarkConflationAt10kUpdatesPerSecond {
+    const NSUInteger topicCount = 200;
+    const NSUInteger updatesPerSecond = 10000;
+    const NSTimeInterval duration = 2.0;
+    const NSTimeInterval tickPeriod = 1.0 / 60.0;
+    const uint64_t redrawNanoseconds = 2000;
+
+    NSMutableArray<NSString *> *const topics = [NSMutableArray arrayWithCapacity:topicCount];
+    for (NSUInteger i = 0; i < topicCount; i++)
+    {
+        [topics addObject:[NSString stringWithFormat:@"Demos/Sportsbook/Football/Fixture%lu/Odds", (unsigned long)i]];
+    }
+    // a few busy topics take most of the updates, as with live prices
+    const NSUInteger updateCount = (NSUInteger)(updatesPerSecond * duration);
+    NSMutableArray<NSString *> *const stream = [NSMutableArray arrayWithCapacity:updateCount];
+    uint64_t random = 1;
+    for (NSUInteger i = 0; i < updateCount; i++)
+    {
+        // three in four go to the 20 busy topics
+        const BOOL busy = DiffusionRandomNext(&random) < 0.75;
+        [stream addObject:topics[(NSUInteger)(DiffusionRandomNext(&random) * (busy ? 20 : topicCount))]];
+    }
+
+    // every update redrawn as it arrives
+    uint64_t start = DiffusionTestNow();
+    for (NSUInteger i = 0; i < updateCount; i++)
+    {
+        // stands in for a view redrawing with a new value
+        DiffusionTestSpin(redrawNanoseconds);
+    }
+    const uint64_t direct = DiffusionTestNow() - start;
+
+    // the same load through the conflator, on a virtual clock ticking at 60Hz
+    DiffusionManualTickSource *const ticks = [[DiffusionManualTickSource alloc] init];
+    DiffusionUpdateConflator *const conflator = [[DiffusionUpdateConflator alloc] initWithTickSource:ticks];
+    [conflator addBatchHandler:^(NSDictionary<NSString *, id> *batch) {
+        for (NSUInteger i = 0; i < batch.count; i++)
+        {
+            DiffusionTestSpin(redrawNanoseconds);
+        }
+    }];
+    NSTimeInterval nextTick = tickPeriod;
+    start = DiffusionTestNow();
+    for (NSUInteger i = 0; i < updateCount; i++)
+    {
+        const NSTimeInterval arrival = (NSTimeInterval)i / updatesPerSecond;
+        while (arrival >= nextTick)
+        {
+            [ticks tickAtTime:nextTick];
+            nextTick += tickPeriod;
+        }
+        ticks.currentTime = arrival;
+        [conflator addValue:@(i) forTopicPath:stream[i]];
+    }
+    [ticks tickAtTime:nextTick];
+    const uint64_t conflated = DiffusionTestNow() - start;
+
+    XCTAssertEqual(conflator.deliveredCount + conflator.conflatedCount, updateCount);
+    XCTAssertLessThanOrEqual(conflator.maximumStaleness, tickPeriod + 1e-9);
+    DiffusionBenchmarkSuite *const suite = DiffusionBenchmarkSuite.sharedSuite;
+    [suite report:@"conflation.direct" value:direct / 1e6 unit:@"ms"];
+    [suite report:@"conflation.conflated" value:conflated / 1e6 unit:@"ms"];
+    [suite report:@"conflation.redraws" value:conflator.deliveredCount unit:@"redraws"];
+    [suite report:@"conflation.batches" value:conflator.batchCount unit:@"batches"];
+    [suite report:@"conflation.averageStaleness" value:conflator.averageStaleness * 1e3 unit:@"ms"];
+    [suite report:@"conflation.maximumStaleness" value:conflator.maximumStaleness * 1e3 unit:@"ms"];
+}
+
+@end
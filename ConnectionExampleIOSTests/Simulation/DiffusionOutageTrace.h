@@ -0,0 +1,52 @@
+//
+//  DiffusionOutageTrace.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    A synthetic network for a reconnection simulation: count cycles of a lossy period followed by a clear one. The
+    session drops at the start of each lossy period, during which an attempt fails with the loss rate. A loss rate of 1
+    is an outage, below 1 a partial loss.
+
+    Lossy periods last between (1 - variability) and 1 times their duration, drawn per cycle from the seed, so the
+    same trace is the same network every time.
+
+ */
+@interface DiffusionOutageTrace : NSObject
+
+@property(nonatomic, readonly) NSString *name;
+@property(nonatomic, readonly) NSTimeInterval lossDuration;
+@property(nonatomic, readonly) double lossRate;
+@property(nonatomic, readonly) NSTimeInterval clearDuration;
+@property(nonatomic, readonly) NSUInteger count;
+// default 0.5
+@property(nonatomic) double variability;
+@property(nonatomic) uint64_t seed;
+
+// down for a few seconds, up for a few more, over and over
++ (instancetype)flappingTraceWithDownTime:(NSTimeInterval)down upTime:(NSTimeInterval)up count:(NSUInteger)count;
+// the server is gone for minutes, then stays up for one
++ (instancetype)longOutageTraceWithDuration:(NSTimeInterval)duration count:(NSUInteger)count;
+// most attempts fail for a while, then the network clears for a minute
++ (instancetype)partialLossTraceWithDuration:(NSTimeInterval)duration lossRate:(double)lossRate count:(NSUInteger)count;
+
+-(instancetype) initWithName:(NSString *)name lossDuration:(NSTimeInterval)lossDuration lossRate:(double)lossRate clearDuration:(NSTimeInterval)clearDuration count:(NSUInteger)count NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (NSTimeInterval)cycleDuration;
+// when the lossy period of the cycle ends
+- (NSTimeInterval)endOfLossInCycle:(NSUInteger)cycle;
+// the chance an attempt made at the time fails. 0 after the last cycle
+- (double)lossRateAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,78 @@
+//
+//  DiffusionOutageTrace.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionOutageTrace.h"
+
+#import "DiffusionRandom.h"
+
+@implementation DiffusionOutageTrace
+
+
++ (instancetype)flappingTraceWithDownTime:(NSTimeInterval)down upTime:(NSTimeInterval)up count:(NSUInteger)count
+{
+    return [[self alloc] initWithName:@"flapping" lossDuration:down lossRate:1.0 clearDuration:up count:count];
+}
+
++ (instancetype)longOutageTraceWithDuration:(NSTimeInterval)duration count:(NSUInteger)count
+{
+    return [[self alloc] initWithName:@"long outage" lossDuration:duration lossRate:1.0 clearDuration:60.0 count:count];
+}
+
++ (instancetype)partialLossTraceWithDuration:(NSTimeInterval)duration lossRate:(double)lossRate count:(NSUInteger)count
+{
+    return [[self alloc] initWithName:@"partial loss" lossDuration:duration lossRate:lossRate clearDuration:60.0 count:count];
+}
+
+-(instancetype) initWithName:(NSString *)name lossDuration:(NSTimeInterval)lossDuration lossRate:(double)lossRate clearDuration:(NSTimeInterval)clearDuration count:(NSUInteger)count
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _name = [name copy];
+    _lossDuration = lossDuration;
+    _lossRate = lossRate;
+    _clearDuration = clearDuration;
+    _count = count;
+    _variability = 0.5;
+    _seed = 1;
+
+    return self;
+}
+
+
+- (NSTimeInterval)cycleDuration
+{
+    return _lossDuration + _clearDuration;
+}
+
+// in [0, 1): any cycle can be asked for in any order
+- (double)randomOfCycle:(NSUInteger)cycle
+{
+    return DiffusionRandomAt(_seed + (cycle + 1) * DiffusionRandomIncrement);
+}
+
+- (NSTimeInterval)endOfLossInCycle:(NSUInteger)cycle
+{
+    const double variability = MIN(MAX(_variability, 0.0), 1.0);
+    return cycle * self.cycleDuration + _lossDuration * (1.0 - variability * [self randomOfCycle:cycle]);
+}
+
+- (double)lossRateAtTime:(NSTimeInterval)time
+{
+    const NSTimeInterval cycleDuration = self.cycleDuration;
+    if (time < 0 || cycleDuration <= 0)
+    {
+        return 0.0;
+    }
+    const NSUInteger cycle = (NSUInteger)(time / cycleDuration);
+    return cycle < _count && time < [self endOfLossInCycle:cycle] ? _lossRate : 0.0;
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  DiffusionReconnectionSimulator.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+#import "DiffusionHistogram.h"
+#import "DiffusionOutageTrace.h"
+#import "DiffusionScheduler.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface DiffusionSimulationResult : NSObject
+
+@property(nonatomic, readonly) NSString *traceName;
+@property(nonatomic, readonly) NSUInteger outageCount;
+@property(nonatomic, readonly) NSUInteger reconnectedCount;
+// sessions closed by the reconnection timeout
+@property(nonatomic, readonly) NSUInteger closedCount;
+// sessions closed by the strategy aborting an attempt
+@property(nonatomic, readonly) NSUInteger abortedCount;
+@property(nonatomic, readonly) NSUInteger attemptCount;
+// from the drop to the session connected again, in microseconds
+@property(nonatomic, readonly) DiffusionHistogramSnapshot *timeToReconnect;
+@property(nonatomic, readonly) NSTimeInterval simulatedTime;
+@property(nonatomic, readonly) uint64_t eventCount;
+
+// one line, for the test logs
+- (NSString *)summary;
+
+@end
+
+/**
+
+    Runs a reconnection strategy through the outages of a trace on a virtual clock, as a session would: the strategy
+    is asked to reconnect at each drop and after each failed attempt, and the attempts it starts succeed or fail with
+    the loss rate of the trace at that time.
+
+    The strategy must take its clock and its delays from the simulator's scheduler. It is given no session: what a
+    session's state notifications would tell it, the simulator tells it through noteConnected or reset, when it has
+    either. Sessions still reconnecting after the reconnection timeout are closed, and reopened once the network is
+    clear.
+
+    Nothing waits for real time: a million outages take seconds.
+
+ */
+@interface DiffusionReconnectionSimulator : NSObject
+
+@property(nonatomic, readonly) DiffusionOutageTrace *trace;
+@property(nonatomic, readonly) DiffusionVirtualScheduler *scheduler;
+// default 60. negative does not limit reconnecting
+@property(nonatomic) NSTimeInterval reconnectionTimeout;
+// how long a failed attempt takes to be known as failed (default 2, the Diffusion connection timeout)
+@property(nonatomic) NSTimeInterval failedAttemptDuration;
+// default 0.1
+@property(nonatomic) NSTimeInterval successfulAttemptDuration;
+// for the draws of the partial loss
+@property(nonatomic) uint64_t seed;
+
+-(instancetype) initWithTrace:(DiffusionOutageTrace *)trace NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// whether an attempt made now would get through. what a probe of the server sees
+- (BOOL)linkIsUp;
+
+// the whole trace, once. a simulator runs one strategy
+- (DiffusionSimulationResult *)runStrategy:(id<PTDiffusionSessionReconnectionStrategy>)strategy;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,324 @@
+//
+//  DiffusionReconnectionSimulator.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 31/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionReconnectionSimulator.h"
+
+#import "DiffusionRandom.h"
+
+// what a session's state notifications would tell the strategies that listen to them
+@protocol DiffusionSessionStateListener <NSObject>
+@optional
+- (void)noteConnected;
+- (void)reset;
+@end
+
+
+@interface DiffusionSimulationResult ()
+
+@property(nonatomic, readwrite) NSString *traceName;
+@property(nonatomic, readwrite) NSUInteger outageCount;
+@property(nonatomic, readwrite) NSUInteger reconnectedCount;
+@property(nonatomic, readwrite) NSUInteger closedCount;
+@property(nonatomic, readwrite) NSUInteger abortedCount;
+@property(nonatomic, readwrite) NSUInteger attemptCount;
+@property(nonatomic, readwrite) DiffusionHistogramSnapshot *timeToReconnect;
+@property(nonatomic, readwrite) NSTimeInterval simulatedTime;
+@property(nonatomic, readwrite) uint64_t eventCount;
+
+@end
+
+@implementation DiffusionSimulationResult
+
+
+- (NSString *)summary
+{
+    DiffusionHistogramSnapshot *const times = _timeToReconnect;
+    return [NSString stringWithFormat:@"%@: %lu outages, %lu reconnected in p50 %.1f s, p90 %.1f s, p99 %.1f s, max %.1f s, %lu closed by the timeout, %lu aborted, %lu attempts (%.2f per outage)",
+            _traceName, (unsigned long)_outageCount, (unsigned long)_reconnectedCount,
+            [times valueAtPercentile:50] / 1e6, [times valueAtPercentile:90] / 1e6, [times valueAtPercentile:99] / 1e6, times.maximum / 1e6,
+            (unsigned long)_closedCount, (unsigned long)_abortedCount, (unsigned long)_attemptCount,
+            _outageCount ? (double)_attemptCount / _outageCount : 0.0];
+}
+
+@end
+
+
+@class DiffusionReconnectionSimulator;
+
+// handed to the strategy in place of the session's own
+@interface DiffusionSimulatedAttempt : NSObject
+
+-(instancetype) initWithSimulator:(DiffusionReconnectionSimulator *)simulator generation:(uint64_t)generation NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (void)start;
+- (void)abort;
+
+@end
+
+@interface DiffusionReconnectionSimulator ()
+
+- (void)startAttemptOfGeneration:(uint64_t)generation;
+- (void)abortAttemptOfGeneration:(uint64_t)generation;
+
+@end
+
+
+@implementation DiffusionSimulatedAttempt
+{
+    __weak DiffusionReconnectionSimulator *_simulator;
+    uint64_t _generation;
+    BOOL _used;
+}
+
+
+-(instancetype) initWithSimulator:(DiffusionReconnectionSimulator *)simulator generation:(uint64_t)generation
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _simulator = simulator;
+    _generation = generation;
+
+    return self;
+}
+
+- (void)start
+{
+    if (!_used)
+    {
+        _used = YES;
+        [_simulator startAttemptOfGeneration:_generation];
+    }
+}
+
+- (void)abort
+{
+    if (!_used)
+    {
+        _used = YES;
+        [_simulator abortAttemptOfGeneration:_generation];
+    }
+}
+
+@end
+
+
+@implementation DiffusionReconnectionSimulator
+{
+    id<PTDiffusionSessionReconnectionStrategy> _strategy;
+    uint64_t _random;
+
+    BOOL _connected;
+    BOOL _reconnecting;
+    // changes with every drop and every close, so attempts of an earlier outage are ignored
+    uint64_t _generation;
+    NSTimeInterval _dropTime;
+
+    DiffusionHistogram *_timeToReconnect;
+    NSUInteger _outageCount;
+    NSUInteger _reconnectedCount;
+    NSUInteger _closedCount;
+    NSUInteger _abortedCount;
+    NSUInteger _attemptCount;
+}
+
+// the strategies get no session, see the class comment
+static PTDiffusionSession *_NoSession = nil;
+
+
+-(instancetype) initWithTrace:(DiffusionOutageTrace *)trace
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _trace = trace;
+    _scheduler = [[DiffusionVirtualScheduler alloc] init];
+    _reconnectionTimeout = 60.0;
+    _failedAttemptDuration = 2.0;
+    _successfulAttemptDuration = 0.1;
+    self.seed = 1;
+
+    return self;
+}
+
+
+- (void)setSeed:(uint64_t)seed
+{
+    _seed = seed;
+    _random = seed;
+}
+
+// in [0, 1)
+- (double)nextRandom
+{
+    return DiffusionRandomNext(&_random);
+}
+
+- (BOOL)linkIsUp
+{
+    return [self nextRandom] >= [_trace lossRateAtTime:_scheduler.currentTime];
+}
+
+
+- (DiffusionSimulationResult *)runStrategy:(id<PTDiffusionSessionReconnectionStrategy>)strategy
+{
+    _strategy = strategy;
+    _connected = YES;
+    _reconnecting = NO;
+    _timeToReconnect = [[DiffusionHistogram alloc] init];
+    _outageCount = 0;
+    _reconnectedCount = 0;
+    _closedCount = 0;
+    _abortedCount = 0;
+    _attemptCount = 0;
+
+    if (_trace.count > 0)
+    {
+        [self scheduleDropOfCycle:0];
+    }
+    [_scheduler runUntilIdle];
+    _strategy = nil;
+
+    DiffusionSimulationResult *const result = [[DiffusionSimulationResult alloc] init];
+    result.traceName = _trace.name;
+    result.outageCount = _outageCount;
+    result.reconnectedCount = _reconnectedCount;
+    result.closedCount = _closedCount;
+    result.abortedCount = _abortedCount;
+    result.attemptCount = _attemptCount;
+    result.timeToReconnect = [_timeToReconnect snapshot];
+    result.simulatedTime = _scheduler.currentTime;
+    result.eventCount = _scheduler.executedCount;
+    return result;
+}
+
+- (void)scheduleDropOfCycle:(NSUInteger)cycle
+{
+    [_scheduler scheduleAfterDelay:cycle * _trace.cycleDuration - _scheduler.currentTime block:^{
+        [self dropInCycle:cycle];
+    }];
+}
+
+- (void)dropInCycle:(NSUInteger)cycle
+{
+    if (cycle + 1 < _trace.count)
+    {
+        [self scheduleDropOfCycle:cycle + 1];
+    }
+    // a session still reconnecting, or closed, has nothing to drop
+    if (!_connected)
+    {
+        return;
+    }
+    _connected = NO;
+    _reconnecting = YES;
+    _generation++;
+    _dropTime = _scheduler.currentTime;
+    _outageCount++;
+
+    if (_reconnectionTimeout >= 0)
+    {
+        const uint64_t generation = _generation;
+        [_scheduler scheduleAfterDelay:_reconnectionTimeout block:^{
+            if (generation == self->_generation && self->_reconnecting)
+            {
+                self->_closedCount++;
+                [self closeSession];
+            }
+        }];
+    }
+    [self requestAttempt];
+}
+
+- (void)requestAttempt
+{
+    DiffusionSimulatedAttempt *const attempt = [[DiffusionSimulatedAttempt alloc] initWithSimulator:self generation:_generation];
+    [_strategy diffusionSession:_NoSession wishesToReconnectWithAttempt:(PTDiffusionSessionReconnectionAttempt *)attempt];
+}
+
+- (void)startAttemptOfGeneration:(uint64_t)generation
+{
+    if (generation != _generation || !_reconnecting)
+    {
+        return;
+    }
+    _attemptCount++;
+    if ([self linkIsUp])
+    {
+        [_scheduler scheduleAfterDelay:_successfulAttemptDuration block:^{
+            if (generation == self->_generation && self->_reconnecting)
+            {
+                [self reconnect];
+            }
+        }];
+    }
+    else
+    {
+        [_scheduler scheduleAfterDelay:_failedAttemptDuration block:^{
+            if (generation == self->_generation && self->_reconnecting)
+            {
+                [self requestAttempt];
+            }
+        }];
+    }
+}
+
+- (void)abortAttemptOfGeneration:(uint64_t)generation
+{
+    if (generation != _generation || !_reconnecting)
+    {
+        return;
+    }
+    _abortedCount++;
+    [self closeSession];
+}
+
+- (void)reconnect
+{
+    _reconnecting = NO;
+    _connected = YES;
+    _reconnectedCount++;
+    [_timeToReconnect recordTimeInterval:_scheduler.currentTime - _dropTime];
+
+    id<DiffusionSessionStateListener> const listener = (id<DiffusionSessionStateListener>)_strategy;
+    if ([listener respondsToSelector:@selector(noteConnected)])
+    {
+        [listener noteConnected];
+    }
+    else if ([listener respondsToSelector:@selector(reset)])
+    {
+        [listener reset];
+    }
+}
+
+- (void)closeSession
+{
+    _reconnecting = NO;
+    _generation++;
+    // the next session starts afresh
+    id<DiffusionSessionStateListener> const listener = (id<DiffusionSessionStateListener>)_strategy;
+    if ([listener respondsToSelector:@selector(reset)])
+    {
+        [listener reset];
+    }
+
+    // the application opens a new one once the network is clear
+    const NSTimeInterval now = _scheduler.currentTime;
+    const NSUInteger cycle = _trace.cycleDuration > 0 ? (NSUInteger)(now / _trace.cycleDuration) : _trace.count;
+    const NSTimeInterval clear = cycle < _trace.count ? [_trace endOfLossInCycle:cycle] : now;
+    [_scheduler scheduleAfterDelay:clear - now block:^{
+        self->_connected = YES;
+    }];
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  DiffusionStandInScenario.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@import Diffusion;
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSErrorDomain const DiffusionStandInScenarioErrorDomain;
+
+typedef NS_ERROR_ENUM(DiffusionStandInScenarioErrorDomain, DiffusionStandInScenarioError) {
+    DiffusionStandInScenarioErrorInvalidFile = 1,
+};
+
+// the connection is lost at a time of the scenario and comes back after a while
+@interface DiffusionStandInOutage : NSObject
+
+@property(nonatomic, readonly) NSTimeInterval time;
+@property(nonatomic, readonly) NSTimeInterval duration;
+
+@end
+
+/**
+
+    What a stand-in server plays: how many topics, of which type, how fast they are updated, for how long, and when
+    the connection drops. Read from a JSON file such as
+
+        {
+            "name": "50k topics, 20k updates/s, connection dropped at 30 s",
+            "topicCount": 50000,
+            "topicPrefix": "StandIn/Load",
+            "topicType": "json",
+            "payloadSize": 128,
+            "updatesPerSecond": 20000,
+            "duration": 60,
+            "pingInterval": 3,
+            "pingRoundTripTime": 0.04,
+            "outages": [{"at": 30, "duration": 5}]
+        }
+
+    topicType is "json" or "binary". Only topicCount, updatesPerSecond and duration are required.
+
+ */
+@interface DiffusionStandInScenario : NSObject
+
+@property(nonatomic, readonly) NSString *name;
+@property(nonatomic, readonly) NSUInteger topicCount;
+// topics are "<prefix>/<index>" (default "StandIn")
+@property(nonatomic, readonly) NSString *topicPrefix;
+@property(nonatomic, readonly) PTDiffusionTopicType topicType;
+// bytes per value (default 64)
+@property(nonatomic, readonly) NSUInteger payloadSize;
+// all topics together, round robin
+@property(nonatomic, readonly) double updatesPerSecond;
+@property(nonatomic, readonly) NSTimeInterval duration;
+// 0 (the default) answers no ping
+@property(nonatomic, readonly) NSTimeInterval pingInterval;
+@property(nonatomic, readonly) NSTimeInterval pingRoundTripTime;
+@property(nonatomic, readonly) NSArray<DiffusionStandInOutage *> *outages;
+
++ (nullable instancetype)scenarioWithContentsOfURL:(NSURL *)url error:(NSError **)error;
+
+-(nullable instancetype) initWithDictionary:(NSDictionary<NSString *, id> *)dictionary error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+- (NSString *)topicPathAtIndex:(NSUInteger)index;
+- (BOOL)isConnectedAtTime:(NSTimeInterval)time;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,152 @@
+//
+//  DiffusionStandInScenario.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionStandInScenario.h"
+
+NSErrorDomain const DiffusionStandInScenarioErrorDomain = @"DiffusionStandInScenarioErrorDomain";
+
+@implementation DiffusionStandInOutage
+
+-(instancetype) initWithTime:(NSTimeInterval)time duration:(NSTimeInterval)duration
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _time = time;
+    _duration = duration;
+
+    return self;
+}
+
+@end
+
+
+static NSError *_InvalidScenarioError(NSString *reason)
+{
+    return [NSError errorWithDomain:DiffusionStandInScenarioErrorDomain
+                               code:DiffusionStandInScenarioErrorInvalidFile
+                           userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Invalid stand-in scenario: %@", reason]}];
+}
+
+static double _Number(NSDictionary<NSString *, id> *dictionary, NSString *key, double defaultValue)
+{
+    id const value = dictionary[key];
+    return [value isKindOfClass:NSNumber.class] ? [value doubleValue] : defaultValue;
+}
+
+
+@implementation DiffusionStandInScenario
+
+
++ (nullable instancetype)scenarioWithContentsOfURL:(NSURL *)url error:(NSError **)error
+{
+    NSData *const data = [NSData dataWithContentsOfURL:url options:0 error:error];
+    if (!data)
+    {
+        return nil;
+    }
+    id const dictionary = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+    if (!dictionary)
+    {
+        return nil;
+    }
+    if (![dictionary isKindOfClass:NSDictionary.class])
+    {
+        if (error)
+        {
+            *error = _InvalidScenarioError(@"not a JSON object");
+        }
+        return nil;
+    }
+    return [[self alloc] initWithDictionary:dictionary error:error];
+}
+
+-(nullable instancetype) initWithDictionary:(NSDictionary<NSString *, id> *)dictionary error:(NSError **)error
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+
+    NSString *reason = nil;
+    _topicCount = (NSUInteger)_Number(dictionary, @"topicCount", 0);
+    _updatesPerSecond = _Number(dictionary, @"updatesPerSecond", 0);
+    _duration = _Number(dictionary, @"duration", 0);
+    if (!_topicCount || _updatesPerSecond <= 0 || _duration <= 0)
+    {
+        reason = @"topicCount, updatesPerSecond and duration must be positive";
+    }
+
+    NSString *const type = dictionary[@"topicType"] ?: @"json";
+    if ([type isEqual:@"json"])
+    {
+        _topicType = PTDiffusionTopicType_JSON;
+    }
+    else if ([type isEqual:@"binary"])
+    {
+        _topicType = PTDiffusionTopicType_Binary;
+    }
+    else
+    {
+        reason = [NSString stringWithFormat:@"unknown topic type %@", type];
+    }
+
+    NSMutableArray<DiffusionStandInOutage *> *const outages = [NSMutableArray array];
+    for (NSDictionary<NSString *, id> *outage in dictionary[@"outages"])
+    {
+        if (![outage isKindOfClass:NSDictionary.class])
+        {
+            reason = @"outages must be objects";
+            break;
+        }
+        [outages addObject:[[DiffusionStandInOutage alloc] initWithTime:_Number(outage, @"at", 0) duration:_Number(outage, @"duration", 0)]];
+    }
+    [outages sortUsingComparator:^NSComparisonResult(DiffusionStandInOutage *a, DiffusionStandInOutage *b) {
+        return a.time < b.time ? NSOrderedAscending : (a.time > b.time ? NSOrderedDescending : NSOrderedSame);
+    }];
+
+    if (reason)
+    {
+        if (error)
+        {
+            *error = _InvalidScenarioError(reason);
+        }
+        return nil;
+    }
+
+    _name = [dictionary[@"name"] copy] ?: @"unnamed";
+    _topicPrefix = [dictionary[@"topicPrefix"] copy] ?: @"StandIn";
+    _payloadSize = (NSUInteger)_Number(dictionary, @"payloadSize", 64);
+    _pingInterval = _Number(dictionary, @"pingInterval", 0);
+    _pingRoundTripTime = _Number(dictionary, @"pingRoundTripTime", 0.05);
+    _outages = outages;
+
+    return self;
+}
+
+- (NSString *)topicPathAtIndex:(NSUInteger)index
+{
+    return [NSString stringWithFormat:@"%@/%lu", _topicPrefix, (unsigned long)index];
+}
+
+- (BOOL)isConnectedAtTime:(NSTimeInterval)time
+{
+    for (DiffusionStandInOutage *outage in _outages)
+    {
+        if (time >= outage.time && time < outage.time + outage.duration)
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@end
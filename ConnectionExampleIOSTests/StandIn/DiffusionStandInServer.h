@@ -0,0 +1,66 @@
+//
+//  DiffusionStandInServer.h
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "DiffusionStandInScenario.h"
+
+@class DiffusionManager;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+
+    Plays a scenario into a DiffusionManager in place of a Diffusion server, so the manager can be load tested and
+    benchmarked without a network.
+
+    The manager is driven through the same entry points a session uses: subscription and update notifications reach
+    its stream dispatcher as they would from the fallback streams, and outages and ping answers reach its state and ping
+    bookkeeping. The topics played are the scenario topics selected by the manager's subscriptions, looked at again
+    whenever they change, so subscribing before or during a run works as with a server.
+
+    With several sessions, the server plays a session pool: it sets a pool of its own on the manager, each selector
+    is subscribed on the session the pool shards it to, and an update is sent by every session subscribed to its
+    topic, for the pool to merge.
+
+    Time is scenario time, starting at 0. Used from the main queue, like the Diffusion callbacks.
+
+ */
+@interface DiffusionStandInServer : NSObject
+
+@property(nonatomic, readonly) DiffusionStandInScenario *scenario;
+@property(nonatomic, readonly) NSUInteger sessionCount;
+@property(nonatomic, readonly) NSTimeInterval currentTime;
+@property(nonatomic, readonly, getter=isFinished) BOOL finished;
+
+// counters
+@property(nonatomic, readonly) NSUInteger subscribedTopicCount;
+@property(nonatomic, readonly) NSUInteger updateCount;
+// updates sent by the sessions, more than the update count when sessions share topics
+@property(nonatomic, readonly) NSUInteger sentUpdateCount;
+// updates due during an outage, or while no topic was subscribed
+@property(nonatomic, readonly) NSUInteger skippedUpdateCount;
+@property(nonatomic, readonly) NSUInteger pingCount;
+@property(nonatomic, readonly) NSUInteger outageCount;
+
+// a single session
+-(instancetype) initWithScenario:(DiffusionStandInScenario *)scenario manager:(DiffusionManager *)manager;
+-(instancetype) initWithScenario:(DiffusionStandInScenario *)scenario manager:(DiffusionManager *)manager sessionCount:(NSUInteger)sessionCount NS_DESIGNATED_INITIALIZER;
+-(instancetype) init NS_UNAVAILABLE;
+
+// plays everything due before the time, as fast as possible
+- (void)runUntilTime:(NSTimeInterval)time;
+- (void)runToCompletion;
+
+// plays in step with the clock, speed times faster than real time, until the end of the scenario or stop
+- (void)startAtSpeed:(double)speed completionHandler:(nullable dispatch_block_t)completionHandler;
+- (void)stop;
+
+@end
+
+NS_ASSUME_NONNULL_END
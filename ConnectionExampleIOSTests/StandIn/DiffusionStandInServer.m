@@ -0,0 +1,321 @@
+//
+//  DiffusionStandInServer.m
+//  ConnectionExampleIOSTests
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+#import "DiffusionStandInServer.h"
+
+#import "DiffusionManager.h"
+#import "DiffusionSessionPool.h"
+#import "DiffusionTopicSelectorMatcher.h"
+
+// distinct values cycled through, so conflation and caches see changing values without one allocation per update
+static const NSUInteger _ValueCount = 64;
+// how often a paced run catches up with the clock
+static const NSTimeInterval _PacingInterval = 0.005;
+
+@implementation DiffusionStandInServer
+{
+    DiffusionManager *_manager;
+    // the stream of each session, and the pool merging them with more than one
+    NSArray<PTDiffusionValueStream *> *_streams;
+    DiffusionSessionPool *_pool;
+    PTDiffusionTopicSpecification *_specification;
+    NSArray<PTDiffusionBytes *> *_values;
+
+    NSArray<NSString *> *_selectors;
+    // subscribed topics in scenario order, updated round robin, and the streams of the sessions subscribed to each
+    NSArray<NSString *> *_topicPaths;
+    NSArray<NSArray<PTDiffusionValueStream *> *> *_topicStreams;
+
+    uint64_t _updateIndex;
+    NSUInteger _pingIndex;
+    NSUInteger _outageIndex;
+    BOOL _inOutage;
+
+    dispatch_source_t _timer;
+}
+
+
+-(instancetype) initWithScenario:(DiffusionStandInScenario *)scenario manager:(DiffusionManager *)manager
+{
+    return [self initWithScenario:scenario manager:manager sessionCount:1];
+}
+
+-(instancetype) initWithScenario:(DiffusionStandInScenario *)scenario manager:(DiffusionManager *)manager sessionCount:(NSUInteger)sessionCount
+{
+    self = [super init];
+    if (!self)
+    {
+        return nil;
+    }
+    _scenario = scenario;
+    _manager = manager;
+    _sessionCount = MAX(sessionCount, (NSUInteger)1);
+    _specification = [[PTDiffusionTopicSpecification alloc] initWithType:scenario.topicType];
+    _topicPaths = @[];
+    _topicStreams = @[];
+
+    // the stream the dispatcher makes for the type, as each session would hold it
+    NSMutableArray<PTDiffusionValueStream *> *const sessionStreams = [NSMutableArray arrayWithCapacity:_sessionCount];
+    for (NSUInteger shard = 0; shard < _sessionCount; shard++)
+    {
+        [sessionStreams addObject:[manager.streamDispatcher makeStreamsByTopicType][@(scenario.topicType)]];
+    }
+    _streams = sessionStreams;
+    if (_sessionCount > 1)
+    {
+        _pool = [[DiffusionSessionPool alloc] initWithShardCount:_sessionCount];
+        [_streams enumerateObjectsUsingBlock:^(PTDiffusionValueStream *stream, NSUInteger shard, BOOL *stop) {
+            [self->_pool registerStream:stream forShard:shard];
+        }];
+        manager.sessionPool = _pool;
+    }
+    _values = [self makeValues];
+
+    return self;
+}
+
+- (NSArray<PTDiffusionBytes *> *)makeValues
+{
+    NSMutableArray<PTDiffusionBytes *> *const values = [NSMutableArray arrayWithCapacity:_ValueCount];
+    for (NSUInteger i = 0; i < _ValueCount; i++)
+    {
+        if (_scenario.topicType == PTDiffusionTopicType_JSON)
+        {
+            // the padding makes up the rest of the payload, give or take the encoding overhead
+            NSString *const padding = [@"" stringByPaddingToLength:MAX(_scenario.payloadSize, (NSUInteger)16) - 16 withString:@"x" startingAtIndex:0];
+            [values addObject:[[PTDiffusionJSON alloc] initWithObject:@{@"seq": @(i), @"pad": padding} error:nil]];
+        }
+        else
+        {
+            NSMutableData *const data = [NSMutableData dataWithLength:_scenario.payloadSize];
+            memset(data.mutableBytes, (int)i, data.length);
+            [values addObject:[[PTDiffusionBinary alloc] initWithData:data]];
+        }
+    }
+    return values;
+}
+
+
+#pragma mark - subscriptions
+
+- (void)refreshSubscriptions
+{
+    NSArray<NSString *> *const selectors = _manager.subscriptions.selectors;
+    if (_selectors && [selectors isEqualToArray:_selectors])
+    {
+        return;
+    }
+    _selectors = [selectors copy];
+
+    // the session each selector is subscribed on
+    NSMutableArray<PTDiffusionValueStream *> *const selectorStreams = [NSMutableArray arrayWithCapacity:_selectors.count];
+    for (NSString *selector in _selectors)
+    {
+        [selectorStreams addObject:_streams[_pool ? [_pool shardForSelector:selector] : 0]];
+    }
+
+    DiffusionTopicSelectorMatcher *const matcher = [[DiffusionTopicSelectorMatcher alloc] initWithSelectors:_selectors];
+    NSMutableArray<NSString *> *const topicPaths = [NSMutableArray array];
+    NSMutableArray<NSArray<PTDiffusionValueStream *> *> *const topicStreams = [NSMutableArray array];
+    if (_selectors.count)
+    {
+        for (NSUInteger i = 0; i < _scenario.topicCount; i++)
+        {
+            NSString *const topicPath = [_scenario topicPathAtIndex:i];
+            NSIndexSet *const matching = [matcher indexesOfSelectorsMatchingTopicPath:topicPath];
+            if (!matching.count)
+            {
+                continue;
+            }
+            NSMutableArray<PTDiffusionValueStream *> *const streams = [NSMutableArray arrayWithCapacity:1];
+            [matching enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+                if ([streams indexOfObjectIdenticalTo:selectorStreams[index]] == NSNotFound)
+                {
+                    [streams addObject:selectorStreams[index]];
+                }
+            }];
+            [topicPaths addObject:topicPath];
+            [topicStreams addObject:streams];
+        }
+    }
+
+    // each session tells about its own subscriptions
+    id<PTDiffusionSubscriberStreamDelegate> const dispatcher = (id<PTDiffusionSubscriberStreamDelegate>)_manager.streamDispatcher;
+    NSDictionary<NSString *, NSArray<PTDiffusionValueStream *> *> *const previous = [NSDictionary dictionaryWithObjects:_topicStreams forKeys:_topicPaths];
+    NSDictionary<NSString *, NSArray<PTDiffusionValueStream *> *> *const current = [NSDictionary dictionaryWithObjects:topicStreams forKeys:topicPaths];
+    [_topicPaths enumerateObjectsUsingBlock:^(NSString *topicPath, NSUInteger i, BOOL *stop) {
+        for (PTDiffusionValueStream *stream in self->_topicStreams[i])
+        {
+            if ([current[topicPath] indexOfObjectIdenticalTo:stream] == NSNotFound)
+            {
+                [dispatcher diffusionStream:stream didUnsubscribeFromTopicPath:topicPath specification:self->_specification reason:PTDiffusionTopicUnsubscriptionReason_Requested];
+            }
+        }
+    }];
+    [topicPaths enumerateObjectsUsingBlock:^(NSString *topicPath, NSUInteger i, BOOL *stop) {
+        for (PTDiffusionValueStream *stream in topicStreams[i])
+        {
+            if ([previous[topicPath] indexOfObjectIdenticalTo:stream] == NSNotFound)
+            {
+                [dispatcher diffusionStream:stream didSubscribeToTopicPath:topicPath specification:self->_specification];
+            }
+        }
+    }];
+    _topicPaths = topicPaths;
+    _topicStreams = topicStreams;
+    _subscribedTopicCount = topicPaths.count;
+}
+
+
+#pragma mark - playing
+
+- (void)sendUpdate:(uint64_t)index
+{
+    const NSUInteger topic = (NSUInteger)(index % _topicPaths.count);
+    NSString *const topicPath = _topicPaths[topic];
+    PTDiffusionBytes *const value = _values[index % _values.count];
+    id const dispatcher = _manager.streamDispatcher;
+    for (PTDiffusionValueStream *stream in _topicStreams[topic])
+    {
+        if (_scenario.topicType == PTDiffusionTopicType_JSON)
+        {
+            [(id<PTDiffusionJSONValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:_specification
+                                                                        oldJSON:nil newJSON:(PTDiffusionJSON *)value];
+        }
+        else
+        {
+            [(id<PTDiffusionBinaryValueStreamDelegate>)dispatcher diffusionStream:stream didUpdateTopicPath:topicPath specification:_specification
+                                                                        oldBinary:nil newBinary:(PTDiffusionBinary *)value];
+        }
+        _sentUpdateCount++;
+    }
+}
+
+- (NSTimeInterval)nextOutageChange
+{
+    if (_outageIndex >= _scenario.outages.count)
+    {
+        return INFINITY;
+    }
+    DiffusionStandInOutage *const outage = _scenario.outages[_outageIndex];
+    return _inOutage ? outage.time + outage.duration : outage.time;
+}
+
+- (void)changeOutage
+{
+    if (!_inOutage)
+    {
+        _inOutage = YES;
+        _outageCount++;
+        [_manager noteSessionStateChangeFrom:DiffusionConnectionStateConnected to:DiffusionConnectionStateRecovering];
+    }
+    else
+    {
+        _inOutage = NO;
+        _outageIndex++;
+        [_manager noteSessionStateChangeFrom:DiffusionConnectionStateRecovering to:DiffusionConnectionStateConnected];
+    }
+}
+
+- (void)runUntilTime:(NSTimeInterval)time
+{
+    const NSTimeInterval end = MIN(time, _scenario.duration);
+    const NSTimeInterval pingInterval = _scenario.pingInterval;
+    [self refreshSubscriptions];
+
+    while (YES)
+    {
+        const NSTimeInterval update = _updateIndex / _scenario.updatesPerSecond;
+        const NSTimeInterval ping = pingInterval > 0 ? (_pingIndex + 1) * pingInterval : INFINITY;
+        const NSTimeInterval outage = [self nextOutageChange];
+        const NSTimeInterval next = MIN(update, MIN(ping, outage));
+        if (next >= end)
+        {
+            break;
+        }
+        _currentTime = next;
+
+        if (next == outage)
+        {
+            [self changeOutage];
+        }
+        else if (next == ping)
+        {
+            _pingIndex++;
+            _pingCount++;
+            if (_inOutage)
+            {
+                [_manager notePingFailure];
+            }
+            else
+            {
+                [_manager notePingRoundTripTime:_scenario.pingRoundTripTime];
+            }
+        }
+        else
+        {
+            const uint64_t index = _updateIndex++;
+            if (_inOutage || !_topicPaths.count)
+            {
+                _skippedUpdateCount++;
+                continue;
+            }
+            [self sendUpdate:index];
+            _updateCount++;
+        }
+    }
+
+    _currentTime = MAX(_currentTime, end);
+    _finished = end >= _scenario.duration;
+}
+
+- (void)runToCompletion
+{
+    [self runUntilTime:_scenario.duration];
+}
+
+- (void)startAtSpeed:(double)speed completionHandler:(nullable dispatch_block_t)completionHandler
+{
+    [self stop];
+    const uint64_t started = clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+    const NSTimeInterval from = _currentTime;
+
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_NOW, (uint64_t)(_PacingInterval * NSEC_PER_SEC), (uint64_t)(_PacingInterval * NSEC_PER_SEC / 10));
+    __weak DiffusionStandInServer *weakSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+        DiffusionStandInServer *const server = weakSelf;
+        const NSTimeInterval elapsed = (clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW) - started) / (NSTimeInterval)NSEC_PER_SEC;
+        [server runUntilTime:from + elapsed * speed];
+        if (server.finished)
+        {
+            [server stop];
+            if (completionHandler)
+            {
+                completionHandler();
+            }
+        }
+    });
+    dispatch_resume(_timer);
+}
+
+- (void)stop
+{
+    if (_timer)
+    {
+        dispatch_source_cancel(_timer);
+        _timer = nil;
+    }
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+@end
@@ -0,0 +1,299 @@
+//
+//  DiffusionEventLogDecoder.c
+//  ConnectionExampleIOS
+//
+//  Created by Pedro Loureiro on 30/01/2020.
+//  Copyright © 2020 Pedro Loureiro. All rights reserved.
+//
+
+// turns an event log written by DiffusionEventLog back into text, or CSV with -c. a rotated log (DiffusionEvents.log.1)
+// decodes on its own
+//
+//     cc -O2 -o diffusion-eventlog Tools/DiffusionEventLogDecoder.c
+//     ./diffusion-eventlog [-c] DiffusionEvents.log
+
+// gmtime_r is POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../ConnectionExampleIOS/Logging/DiffusionEventLogFormat.h"
+
+#define MAXIMUM_ARGUMENTS (DIFFUSION_EVENT_LOG_MAXIMUM_PAYLOAD / 8)
+// IDs are handed out from 1 up, anything this large comes from a damaged file
+#define MAXIMUM_NAME_ID (1u << 24)
+
+// topic, selector and session definitions, indexed by ID
+typedef struct
+{
+    char **names;
+    uint32_t capacity;
+} NameTable;
+
+static uint16_t ReadLE16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static uint32_t ReadLE32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint64_t ReadLE64(const uint8_t *bytes)
+{
+    return (uint64_t)ReadLE32(bytes) | (uint64_t)ReadLE32(bytes + 4) << 32;
+}
+
+// 0 if the ID is too large to be a real one
+static int NameTableSet(NameTable *table, uint32_t ID, const uint8_t *name, uint16_t length)
+{
+    if (ID >= MAXIMUM_NAME_ID)
+    {
+        return 0;
+    }
+    if (ID >= table->capacity)
+    {
+        uint32_t capacity = table->capacity ? table->capacity : 64;
+        while (capacity <= ID)
+        {
+            capacity *= 2;
+        }
+        table->names = realloc(table->names, capacity * sizeof(char *));
+        memset(table->names + table->capacity, 0, (capacity - table->capacity) * sizeof(char *));
+        table->capacity = capacity;
+    }
+    free(table->names[ID]);
+    table->names[ID] = malloc(length + 1u);
+    memcpy(table->names[ID], name, length);
+    table->names[ID][length] = '\0';
+    return 1;
+}
+
+static const char *NameTableGet(const NameTable *table, uint32_t ID)
+{
+    return ID < table->capacity && table->names[ID] ? table->names[ID] : "?";
+}
+
+static const char *EventName(uint16_t event)
+{
+    switch (event)
+    {
+        case DiffusionEventSessionStateChange: return "state";
+        case DiffusionEventPing: return "ping";
+        case DiffusionEventPingFailure: return "ping-fail";
+        case DiffusionEventSubscribeResult: return "subscribe";
+        case DiffusionEventUpdate: return "update";
+        default: return "unknown";
+    }
+}
+
+static const char *StateName(int64_t state)
+{
+    if (state & DiffusionEventSessionStateClosed)
+    {
+        return state & DiffusionEventSessionStateError ? "closed-with-error" : "closed";
+    }
+    if (state & DiffusionEventSessionStateRecovering)
+    {
+        return "recovering";
+    }
+    return state & DiffusionEventSessionStateConnected ? "connected" : "connecting";
+}
+
+// fields: time, event, name, then the arguments. names are quoted for CSV
+static void PrintRecord(FILE *out, int csv, uint64_t startTime, const DiffusionEventLogRecordHeader *record,
+                        const int64_t *arguments, unsigned count, const NameTable *topics, const NameTable *selectors,
+                        const NameTable *sessions)
+{
+    const uint64_t time = startTime + record->timestamp;
+    const time_t seconds = (time_t)(time / 1000000000u);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[80];
+    snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+             utc.tm_hour, utc.tm_min, utc.tm_sec, (unsigned)(time % 1000000000u / 1000u));
+
+    const char *name = "";
+    if (record->event == DiffusionEventUpdate)
+    {
+        name = NameTableGet(topics, record->ID);
+    }
+    else if (record->event == DiffusionEventSubscribeResult)
+    {
+        name = NameTableGet(selectors, record->ID);
+    }
+    else if (record->event == DiffusionEventSessionStateChange && record->ID)
+    {
+        name = NameTableGet(sessions, record->ID);
+    }
+
+    if (csv)
+    {
+        fprintf(out, "%s,%s,\"", stamp, EventName(record->event));
+        for (const char *c = name; *c; c++)
+        {
+            if (*c == '"')
+            {
+                fputc('"', out);
+            }
+            fputc(*c, out);
+        }
+        fputc('"', out);
+        for (unsigned i = 0; i < count; i++)
+        {
+            fprintf(out, ",%" PRId64, arguments[i]);
+        }
+        fputc('\n', out);
+        return;
+    }
+
+    fprintf(out, "%s %-9s ", stamp, EventName(record->event));
+    switch (record->event)
+    {
+        case DiffusionEventSessionStateChange:
+            if (*name)
+            {
+                fprintf(out, "[%s] ", name);
+            }
+            fprintf(out, "%s -> %s\n", StateName(count > 0 ? arguments[0] : 0), StateName(count > 1 ? arguments[1] : 0));
+            break;
+        case DiffusionEventPing:
+            fprintf(out, "rtt %.3f ms\n", count > 0 ? arguments[0] / 1000.0 : 0.0);
+            break;
+        case DiffusionEventPingFailure:
+            if (count > 0 && arguments[0])
+            {
+                fprintf(out, "error %" PRId64 "\n", arguments[0]);
+            }
+            else
+            {
+                fputc('\n', out);
+            }
+            break;
+        case DiffusionEventSubscribeResult:
+            fprintf(out, "%s [%s] %s", count > 0 && arguments[0] ? "subscribe" : "unsubscribe", name,
+                    count > 1 && arguments[1] ? "failed" : "succeeded");
+            if (count > 1 && arguments[1])
+            {
+                fprintf(out, " (error %" PRId64 ")", arguments[1]);
+            }
+            fputc('\n', out);
+            break;
+        case DiffusionEventUpdate:
+            fprintf(out, "%s %" PRId64 " bytes (type %" PRId64 ")\n", name, count > 0 ? arguments[0] : 0, count > 1 ? arguments[1] : 0);
+            break;
+        default:
+            fprintf(out, "event %u id %u", record->event, record->ID);
+            for (unsigned i = 0; i < count; i++)
+            {
+                fprintf(out, " %" PRId64, arguments[i]);
+            }
+            fputc('\n', out);
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int csv = 0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-c"))
+        {
+            csv = 1;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [-c] <event log>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        perror(path);
+        return 1;
+    }
+
+    uint8_t header[sizeof(DiffusionEventLogFileHeader)];
+    if (fread(header, sizeof(header), 1, in) != 1 || ReadLE32(header) != DIFFUSION_EVENT_LOG_MAGIC)
+    {
+        fprintf(stderr, "%s: not an event log\n", path);
+        fclose(in);
+        return 1;
+    }
+    if (ReadLE16(header + 4) != DIFFUSION_EVENT_LOG_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported version %u\n", path, ReadLE16(header + 4));
+        fclose(in);
+        return 1;
+    }
+    // later versions may have a larger header
+    const uint16_t headerSize = ReadLE16(header + 6);
+    const uint64_t startTime = ReadLE64(header + 8);
+    if (headerSize > sizeof(header))
+    {
+        fseek(in, headerSize, SEEK_SET);
+    }
+
+    if (csv)
+    {
+        printf("time,event,name,arg0,arg1\n");
+    }
+
+    NameTable topics = {0};
+    NameTable selectors = {0};
+    NameTable sessions = {0};
+    uint8_t bytes[sizeof(DiffusionEventLogRecordHeader)];
+    uint8_t payload[DIFFUSION_EVENT_LOG_MAXIMUM_PAYLOAD];
+    int64_t arguments[MAXIMUM_ARGUMENTS];
+    int status = 0;
+    while (fread(bytes, sizeof(bytes), 1, in) == 1)
+    {
+        const DiffusionEventLogRecordHeader record = {
+            .event = ReadLE16(bytes),
+            .length = ReadLE16(bytes + 2),
+            .ID = ReadLE32(bytes + 4),
+            .timestamp = ReadLE64(bytes + 8),
+        };
+        if (record.length > sizeof(payload) || (record.length && fread(payload, record.length, 1, in) != 1))
+        {
+            // the app was killed in the middle of a write
+            fprintf(stderr, "%s: truncated record\n", path);
+            status = 1;
+            break;
+        }
+
+        if (record.event == DiffusionEventDefineTopic || record.event == DiffusionEventDefineSelector || record.event == DiffusionEventDefineSession)
+        {
+            NameTable *const table = record.event == DiffusionEventDefineTopic ? &topics : record.event == DiffusionEventDefineSelector ? &selectors : &sessions;
+            if (!NameTableSet(table, record.ID, payload, record.length))
+            {
+                fprintf(stderr, "%s: definition of ID %u out of range, skipped\n", path, record.ID);
+                status = 1;
+            }
+            continue;
+        }
+
+        const unsigned count = record.length / 8;
+        for (unsigned i = 0; i < count; i++)
+        {
+            arguments[i] = (int64_t)ReadLE64(payload + i * 8);
+        }
+        PrintRecord(stdout, csv, startTime, &record, arguments, count, &topics, &selectors, &sessions);
+    }
+
+    fclose(in);
+    return status;
+}